@@ -1,4 +1,5 @@
 #include <core/core.h>
+#include <intrin.h>
 
 bool testPtInRect(const point_t& pt, const rect_t& rect)
 {
@@ -142,6 +143,7 @@ struct stack_mem_data_t
 {
     size_t  size;
     size_t  allocated;
+    size_t  maxAllocated;
     uint8_t data[1];
 };
 
@@ -149,8 +151,9 @@ void  stack_mem_init(stack_mem_t* stack, void* mem, size_t size)
 {
     *stack = (stack_mem_t)mem;
 
-    (*stack)->size = size;
-    (*stack)->allocated = 0;
+    (*stack)->size = size - offsetof(stack_mem_data_t, data);
+    (*stack)->allocated    = 0;
+    (*stack)->maxAllocated = 0;
 }
 
 void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align)
@@ -168,6 +171,7 @@ void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align)
     void* p = stack->data + stack->allocated;
 
     stack->allocated += size;
+    stack->maxAllocated = core::max(stack->maxAllocated, stack->allocated);
 
     return p;
 }
@@ -180,23 +184,67 @@ void  stack_mem_reset(stack_mem_t stack, void* ptr)
     stack->allocated = (uint8_t*)ptr - stack->data;
 }
 
+size_t stack_mem_marker(stack_mem_t stack)
+{
+    return stack->allocated;
+}
+
+void stack_mem_rewind(stack_mem_t stack, size_t marker)
+{
+    assert(marker<=stack->allocated);
+
+    stack->allocated = marker;
+}
+
+size_t stack_mem_high_water(stack_mem_t stack)
+{
+    return stack->maxAllocated;
+}
+
 namespace core
 {
     static const size_t THREAD_DATA_STACK_SIZE = 256 * (1<<10);
+    static const size_t MAX_THREAD_STACKS      = 64;
 
-    static stack_mem_t mainThreadDataStack = 0;
-    static uint8_t* threadDataStackMem;
+    static CORE_THREAD_LOCAL stack_mem_t threadDataStack = 0;
+
+    // Slots are claimed with CAS, cleared under lock so statistics never read freed stack
+    static atomic_t             threadStacksLock = 0;
+    static stack_mem_t volatile threadStacks[MAX_THREAD_STACKS];
+
+    static const size_t FRAME_ALLOC_SIZE = 4*(1<<20);
+
+    // Index of current buffer and its allocated size change together in one atomic,
+    // so allocation racing with swap never gets offset of one buffer in the other one
+    static const long FRAME_ALLOC_BUFFER_BIT  = 1L << 30;
+    static const long FRAME_ALLOC_OFFSET_MASK = FRAME_ALLOC_BUFFER_BIT - 1;
+
+    struct frame_alloc_t
+    {
+        uint8_t*  buffers[2];
+        atomic_t  state;
+        size_t    maxAllocated;
+    };
+
+    static frame_alloc_t frameAlloc;
 
     static const size_t MSPACE_CORE_SIZE = 1*(1<<20);
     static mspace_t mspace_core;
 
     void init()
     {
-        threadDataStackMem = (uint8_t*)malloc(THREAD_DATA_STACK_SIZE);
-        stack_mem_init(&mainThreadDataStack, threadDataStackMem, THREAD_DATA_STACK_SIZE);
+        thread_data_init();
+
+        frameAlloc.buffers[0]   = (uint8_t*)malloc(FRAME_ALLOC_SIZE);
+        frameAlloc.buffers[1]   = (uint8_t*)malloc(FRAME_ALLOC_SIZE);
+        frameAlloc.state        = 0;
+        frameAlloc.maxAllocated = 0;
+
+        mem_utils_select((cpu_features() & CPU_FEATURE_AVX) ? MEM_UTILS_AVX : MEM_UTILS_SSE2);
 
         profilerInit();
-        mt::init(1, 128);
+        profilerSetThreadName("Main");
+        mt::init(0, 4096);
 
         mspace_core = mem_create_space(MSPACE_CORE_SIZE);
     }
@@ -207,16 +255,96 @@ namespace core
         mspace_core = 0;
 
         mt::fini();
+        profilerFini();
 
-        free(threadDataStackMem);
+        free(frameAlloc.buffers[0]);
+        free(frameAlloc.buffers[1]);
+        memset(&frameAlloc, 0, sizeof(frameAlloc));
+
+        thread_data_fini();
+    }
+
+    void thread_data_init()
+    {
+        assert(threadDataStack == 0);
+
+        stack_mem_init(&threadDataStack, malloc(THREAD_DATA_STACK_SIZE), THREAD_DATA_STACK_SIZE);
+
+        // Threads beyond MAX_THREAD_STACKS are not counted in statistics
+        for (size_t i = 0; i < MAX_THREAD_STACKS; ++i)
+        {
+            if (_InterlockedCompareExchangePointer((void* volatile*)&threadStacks[i], threadDataStack, 0) == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    void thread_data_fini()
+    {
+        assert(threadDataStack);
+
+        atomicLock(&threadStacksLock);
+        for (size_t i = 0; i < MAX_THREAD_STACKS; ++i)
+        {
+            if (threadStacks[i] == threadDataStack)
+            {
+                threadStacks[i] = 0;
+            }
+        }
+        atomicUnlock(&threadStacksLock);
+
+        free(threadDataStack);
+        threadDataStack = 0;
+
+        profilerThreadFini();
+        mem_thread_fini();
+    }
+
+    static uint32_t detectCPUFeatures()
+    {
+        int      info[4];
+        uint32_t features = 0;
+
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool sse41   = (info[2] & (1<<19)) != 0;
+        bool fma     = (info[2] & (1<<12)) != 0;
+        bool osxsave = (info[2] & (1<<27)) != 0;
+        bool avx     = (info[2] & (1<<28)) != 0;
+
+        features |= sse41 ? CPU_FEATURE_SSE41 : 0;
+
+        // OS should save YMM registers on context switch
+        if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            features |= CPU_FEATURE_AVX;
+            features |= fma ? CPU_FEATURE_FMA : 0;
+
+            if (maxLeaf >= 7)
+            {
+                __cpuidex(info, 7, 0);
+                features |= (info[1] & (1<<5)) ? CPU_FEATURE_AVX2 : 0;
+            }
+        }
+
+        return features;
+    }
+
+    uint32_t cpu_features()
+    {
+        static uint32_t features = detectCPUFeatures();
+
+        return features;
     }
 
-    //TODO: make mt!!!!!
     stack_mem_t get_thread_data_stack()
     {
-        assert(mainThreadDataStack);
+        assert(threadDataStack);
 
-        return mainThreadDataStack;
+        return threadDataStack;
     }
 
     void* thread_stack_alloc(size_t size, size_t align)
@@ -228,6 +356,71 @@ namespace core
     {
         stack_mem_reset(get_thread_data_stack(), ptr);
     }
+
+    size_t thread_stack_high_water()
+    {
+        size_t highWater = 0;
+
+        atomicLock(&threadStacksLock);
+        for (size_t i = 0; i < MAX_THREAD_STACKS; ++i)
+        {
+            stack_mem_t stack = threadStacks[i];
+            if (stack)
+            {
+                highWater = core::max(highWater, stack_mem_high_water(stack));
+            }
+        }
+        atomicUnlock(&threadStacksLock);
+
+        return highWater;
+    }
+
+    void* frame_alloc(size_t size, size_t align)
+    {
+        size_t reserve = size + align;
+
+        // Exhausted buffer stops growing, so offset never carries into buffer bit
+        if ((size_t)(frameAlloc.state & FRAME_ALLOC_OFFSET_MASK) + reserve > FRAME_ALLOC_SIZE)
+        {
+            return 0;
+        }
+
+        long     state  = _InterlockedExchangeAdd(&frameAlloc.state, (long)reserve);
+        size_t   offset = (size_t)(state & FRAME_ALLOC_OFFSET_MASK);
+        uint8_t* buffer = frameAlloc.buffers[(state & FRAME_ALLOC_BUFFER_BIT) ? 1 : 0];
+
+        assert(buffer);
+
+        if (offset + reserve > FRAME_ALLOC_SIZE)
+        {
+            return 0;
+        }
+
+        uint8_t* ptr = buffer + offset;
+
+        if (align)
+        {
+            size_t rem = (size_t)ptr % align;
+            ptr += rem ? align - rem : 0;
+        }
+
+        return ptr;
+    }
+
+    void frame_alloc_swap()
+    {
+        // Only swap changes buffer bit, allocations in flight land either before swap
+        // in old buffer or after it in new one
+        long state = _InterlockedExchange(&frameAlloc.state, (frameAlloc.state & FRAME_ALLOC_BUFFER_BIT) ^ FRAME_ALLOC_BUFFER_BIT);
+
+        size_t allocated = core::min((size_t)(state & FRAME_ALLOC_OFFSET_MASK), FRAME_ALLOC_SIZE);
+        frameAlloc.maxAllocated = core::max(frameAlloc.maxAllocated, allocated);
+    }
+
+    size_t frame_alloc_high_water()
+    {
+        return frameAlloc.maxAllocated;
+    }
 };
 
 extern "C"
@@ -238,6 +431,7 @@ extern "C"
 #define ETLSF_free(ptr) mem_free(core::mspace_core, ptr)
 #define ETLSF_fls bit_fls
 #define ETLSF_ffs bit_ffs
+#define ETLSF_pause() _mm_pause()
 #define ETLSF_align2 bit_align_up
 #include "etlsf.c"
 
@@ -266,6 +460,11 @@ extern "C"
 
 #ifdef __WIN32__
 #include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 namespace core
@@ -278,4 +477,447 @@ namespace core
         _exit(1);
 #endif
     }
-}
\ No newline at end of file
+}
+
+//--------------------------------------------------------------------------
+
+static const char MJSON_BLOB_EXT[] = ".bjson";
+
+// Only files in real directories can be mapped, not the ones inside of archives
+static uint8_t* map_file(const char* name, size_t* size, void** mapping)
+{
+    const char* dir = PHYSFS_getRealDir(name);
+    char        path[1024];
+
+    if (!dir) return 0;
+
+    if (cstr_copy(path, dir) || cstr_concat(path, PHYSFS_getDirSeparator()) || cstr_concat(path, name))
+        return 0;
+
+#ifdef __WIN32__
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE) return 0;
+
+    LARGE_INTEGER fileSize;
+    HANDLE        map  = 0;
+    void*         data = 0;
+
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 && (uint64_t)fileSize.QuadPart <= SIZE_MAX)
+    {
+        map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map) data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    // View keeps file open
+    CloseHandle(file);
+
+    if (!data)
+    {
+        if (map) CloseHandle(map);
+        return 0;
+    }
+
+    *size    = (size_t)fileSize.QuadPart;
+    *mapping = map;
+#else
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) return 0;
+
+    struct stat st;
+    void*       data = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (data == MAP_FAILED) return 0;
+
+    *size    = (size_t)st.st_size;
+    *mapping = data;
+#endif
+
+    return (uint8_t*)data;
+}
+
+static void unmap_file(uint8_t* data, size_t size, void* mapping)
+{
+#ifdef __WIN32__
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap(data, size);
+#endif
+}
+
+static bool mjson_file_load_blob(mjson_file_t* file, const char* blobName)
+{
+    file->data = map_file(blobName, &file->size, &file->mapping);
+
+    if (!file->data)
+    {
+        memory_t blob;
+
+        if (!mem_file(&blob, blobName)) return false;
+
+        file->data = blob.buffer;
+        file->size = blob.size;
+    }
+
+    file->top = mjson_blob_get_top_element(file->data, file->size, true);
+
+    if (!file->top)
+    {
+        mjson_file_free(file);
+        return false;
+    }
+
+    return true;
+}
+
+static void mjson_file_write_blob(const char* blobName, const void* data, size_t size)
+{
+    // Interrupted write leaves blob that fails validation and gets compiled again
+    PHYSFS_File* dst = PHYSFS_getWriteDir() ? PHYSFS_openWrite(blobName) : 0;
+
+    if (dst)
+    {
+        PHYSFS_write(dst, data, (PHYSFS_uint32)size, 1);
+        PHYSFS_close(dst);
+    }
+}
+
+// Blob could be mapped read only, it is copied to update header and written back
+static void mjson_file_update_source_time(mjson_file_t* file, const char* blobName, PHYSFS_sint64 sourceTime)
+{
+    size_t   size = file->size;
+    uint8_t* data = (uint8_t*)malloc(size);
+
+    if (!data) return;
+
+    memcpy(data, file->data, size);
+    ((mjson_blob_header_t*)data)->source_time = (uint64_t)sourceTime;
+
+    mjson_file_free(file);
+
+    file->top     = mjson_blob_get_top_element(data, size, false);
+    file->data    = data;
+    file->size    = size;
+    file->mapping = 0;
+
+    mjson_file_write_blob(blobName, data, size);
+}
+
+static bool mjson_file_compile(mjson_file_t* file, const char* name, const char* blobName, PHYSFS_sint64 sourceTime)
+{
+    memory_t text;
+
+    if (!mem_file(&text, name)) return false;
+
+    // Storage can be several times bigger than text(e.g. nested arrays) and parser
+    // doesn't tell overflow from syntax error, so buffer grows up to the worst case size
+    size_t          capacity    = text.size * 2 + 256;
+    size_t          maxCapacity = text.size * 16 + 256;
+    uint8_t*        data        = 0;
+    mjson_element_t top         = 0;
+
+    for (; capacity <= maxCapacity; capacity *= 2)
+    {
+        data = (uint8_t*)malloc(sizeof(mjson_blob_header_t) + capacity);
+
+        if (!data) break;
+
+        if (mjson_parse((const char*)text.buffer, text.size, data + sizeof(mjson_blob_header_t), capacity, &top))
+            break;
+
+        free(data);
+        data = 0;
+    }
+
+    if (top)
+    {
+        mjson_blob_header_t* header = (mjson_blob_header_t*)data;
+
+        mjson_blob_init_header(header, top, (const char*)text.buffer, text.size, (uint64_t)sourceTime);
+
+        file->top     = top;
+        file->data    = data;
+        file->size    = sizeof(mjson_blob_header_t) + header->storage_size;
+        file->mapping = 0;
+
+        mjson_file_write_blob(blobName, data, file->size);
+    }
+
+    mem_free(&text);
+
+    return top != 0;
+}
+
+bool mjson_file_load(mjson_file_t* file, const char* name)
+{
+    char blobName[1024];
+
+    mem_zero(file);
+
+    if (cstr_copy(blobName, name) || cstr_concat(blobName, MJSON_BLOB_EXT))
+        return false;
+
+    // Text could be missing, e.g. when only blobs are shipped
+    PHYSFS_sint64 sourceTime = PHYSFS_getLastModTime(name);
+    PHYSFS_sint64 sourceSize = -1;
+    PHYSFS_File*  source     = PHYSFS_openRead(name);
+
+    if (source)
+    {
+        sourceSize = PHYSFS_fileLength(source);
+        PHYSFS_close(source);
+    }
+
+    if (PHYSFS_exists(blobName) && mjson_file_load_blob(file, blobName))
+    {
+        const mjson_blob_header_t* header = (const mjson_blob_header_t*)file->data;
+
+        if (sourceSize < 0)
+            return true;
+
+        if (header->source_size == (uint64_t)sourceSize && header->source_time == (uint64_t)sourceTime)
+            return true;
+
+        // Modification time changes on checkout or copy, content hash decides then
+        // and new time is stored, so text is not hashed again on next load
+        memory_t text;
+
+        if (header->source_size == (uint64_t)sourceSize && mem_file(&text, name))
+        {
+            bool sameSource = mjson_hash(text.buffer, text.size) == header->source_hash;
+
+            mem_free(&text);
+
+            if (sameSource)
+            {
+                mjson_file_update_source_time(file, blobName, sourceTime);
+                return true;
+            }
+        }
+
+        mjson_file_free(file);
+    }
+
+    return mjson_file_compile(file, name, blobName, sourceTime);
+}
+
+void mjson_file_free(mjson_file_t* file)
+{
+    if (file->mapping)
+    {
+        unmap_file(file->data, file->size, file->mapping);
+    }
+    else if (file->data)
+    {
+        free(file->data);
+    }
+
+    mem_zero(file);
+}
+
+//--------------------------------------------------------------------------
+
+bool mapped_file_open(mapped_file_t* file, const char* name)
+{
+    mem_zero(file);
+
+    file->data = map_file(name, &file->size, &file->mapping);
+
+    if (file->data) return true;
+
+    PHYSFS_File* src = PHYSFS_openRead(name);
+
+    if (!src) return false;
+
+    PHYSFS_sint64 size = PHYSFS_fileLength(src);
+
+    if (size > 0 && (uint64_t)size <= UINT32_MAX)
+    {
+        file->size = (size_t)size;
+        file->data = (uint8_t*)_aligned_malloc(file->size, MAPPED_FILE_ALIGNMENT);
+
+        if (file->data && PHYSFS_read(src, file->data, (PHYSFS_uint32)file->size, 1) != 1)
+        {
+            _aligned_free(file->data);
+            file->data = 0;
+        }
+    }
+
+    PHYSFS_close(src);
+
+    if (!file->data) mem_zero(file);
+
+    return file->data != 0;
+}
+
+void mapped_file_close(mapped_file_t* file)
+{
+    if (file->mapping)
+    {
+        unmap_file(file->data, file->size, file->mapping);
+    }
+    else if (file->data)
+    {
+        _aligned_free(file->data);
+    }
+
+    mem_zero(file);
+}
+
+//--------------------------------------------------------------------------
+
+static inline bool str_is_delim(char c, const char* delims)
+{
+    for (; *delims; ++delims)
+    {
+        if (c == *delims) return true;
+    }
+
+    return false;
+}
+
+bool str_next_token(str_view_t* text, str_view_t* token, const char* delims)
+{
+    const char* s = text->str;
+    const char* e = text->str + text->size;
+
+    while (s < e && str_is_delim(*s, delims)) ++s;
+
+    token->str = s;
+
+    while (s < e && !str_is_delim(*s, delims)) ++s;
+
+    token->size = s - token->str;
+    text->str   = s;
+    text->size  = e - s;
+
+    return token->size != 0;
+}
+
+bool str_equal(str_view_t str, const char* literal)
+{
+    size_t len = strlen(literal);
+
+    return str.size == len && memcmp(str.str, literal, len) == 0;
+}
+
+//--------------------------------------------------------------------------
+
+static const size_t TEXT_READER_CHUNK_SIZE = 1024 * 1024;
+
+bool text_reader_open(text_reader_t* reader, const char* name)
+{
+    mem_zero(reader);
+
+    reader->data = map_file(name, &reader->size, &reader->mapping);
+
+    if (reader->data)
+    {
+        reader->cur = (const char*)reader->data;
+        reader->end = reader->cur + reader->size;
+
+        return true;
+    }
+
+    reader->file = PHYSFS_openRead(name);
+
+    if (!reader->file) return false;
+
+    reader->capacity = TEXT_READER_CHUNK_SIZE;
+    reader->buffer   = (char*)malloc(reader->capacity);
+    reader->cur      = reader->buffer;
+    reader->end      = reader->buffer;
+
+    if (!reader->buffer)
+    {
+        text_reader_close(reader);
+        return false;
+    }
+
+    return true;
+}
+
+void text_reader_init(text_reader_t* reader, const char* text, size_t size)
+{
+    mem_zero(reader);
+
+    reader->cur = text;
+    reader->end = text + size;
+}
+
+void text_reader_close(text_reader_t* reader)
+{
+    if (reader->mapping) unmap_file(reader->data, reader->size, reader->mapping);
+    if (reader->file)    PHYSFS_close(reader->file);
+    if (reader->buffer)  free(reader->buffer);
+
+    mem_zero(reader);
+}
+
+// Moves unread part to the front of buffer and appends next chunk of file,
+// buffer grows if single line doesn't fit
+static bool text_reader_fill(text_reader_t* reader)
+{
+    if (!reader->file) return false;
+
+    size_t tail = reader->end - reader->cur;
+
+    if (tail == reader->capacity)
+    {
+        char* buffer = (char*)realloc(reader->buffer, reader->capacity * 2);
+
+        if (!buffer) return false;
+
+        reader->cur      = buffer + (reader->cur - reader->buffer);
+        reader->buffer   = buffer;
+        reader->capacity = reader->capacity * 2;
+    }
+
+    memmove(reader->buffer, reader->cur, tail);
+
+    PHYSFS_sint64 read = PHYSFS_read(reader->file, reader->buffer + tail, 1, (PHYSFS_uint32)(reader->capacity - tail));
+
+    reader->cur = reader->buffer;
+    reader->end = reader->buffer + tail + (read > 0 ? (size_t)read : 0);
+
+    return read > 0;
+}
+
+bool text_reader_line(text_reader_t* reader, str_view_t* line)
+{
+    const char* eol;
+    size_t      searched = 0;
+
+    // memchr is vectorized by CRT, only new data is searched after refill
+    while (!(eol = (const char*)memchr(reader->cur + searched, '\n', reader->end - reader->cur - searched)))
+    {
+        searched = reader->end - reader->cur;
+
+        if (!text_reader_fill(reader))
+        {
+            // Last line without line break
+            if (reader->cur == reader->end) return false;
+
+            eol = reader->end;
+            break;
+        }
+    }
+
+    line->str  = reader->cur;
+    line->size = eol - reader->cur;
+
+    if (line->size && line->str[line->size - 1] == '\r') --line->size;
+
+    reader->cur = eol < reader->end ? eol + 1 : eol;
+
+    return true;
+}
@@ -130,6 +130,31 @@
     #endif
 #endif
 
+#ifndef ETLSF_atomic_cas
+    #if defined (_MSC_VER) && (_MSC_VER >= 1400)
+
+        #include <intrin.h>
+
+        #pragma intrinsic(_InterlockedCompareExchange)
+        #pragma intrinsic(_InterlockedExchange)
+
+        #define ETLSF_atomic_cas(ptr, value, comparand) _InterlockedCompareExchange(ptr, value, comparand)
+        #define ETLSF_atomic_exchange(ptr, value) _InterlockedExchange(ptr, value)
+
+    #else
+
+        #define ETLSF_atomic_cas(ptr, value, comparand) __sync_val_compare_and_swap(ptr, comparand, value)
+        #define ETLSF_atomic_exchange(ptr, value) __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST)
+
+    #endif
+#endif
+
+#ifndef ETLSF_pause
+    #define ETLSF_pause()
+#endif
+
+typedef volatile long etlsf_atomic_t;
+
 enum etlsf_private
 {
     /* All allocation sizes and addresses are aligned to 256 bytes. */
@@ -159,18 +184,22 @@ enum etlsf_private
 
     ALLOC_SIZE_MIN = (size_t)1 << ALIGN_SIZE_LOG2,
     ALLOC_SIZE_MAX = (size_t)1 << MAX_MSB,
+
+    /* Index 0 is reserved for invalid id, last one marks ranges waiting in deferred free list. */
+    ALLOCS_MAX = 0xFFFFFFFE,
+    PENDING_FREE_INDEX = 0xFFFFFFFF,
 };
 
 struct etlsf_range_t
 {
-    uint16_t  next_phys_index;
-    uint16_t  prev_phys_index;
+    uint32_t  next_phys_index;
+    uint32_t  prev_phys_index;
 
     uint32_t  offset  : 31;
     uint32_t  is_free :  1;
 
-    uint16_t  next_free_index;
-    uint16_t  prev_free_index;
+    uint32_t  next_free_index;
+    uint32_t  prev_free_index;
 };
 
 struct etlsf_private_t
@@ -181,11 +210,20 @@ struct etlsf_private_t
     uint32_t log2_bitset;
     uint32_t scale_bitset[LOG2_COUNT];
     /* Head of free lists. */
-    uint16_t free_ranges[LOG2_COUNT][SCALE_VALUE_COUNT];
+    uint32_t free_ranges[LOG2_COUNT][SCALE_VALUE_COUNT];
+
+    uint32_t flags;
+    /* Range at offset 0, changes only during defragmentation. */
+    uint32_t first_phys_index;
+
+    /* Thread safe mode only. */
+    etlsf_atomic_t lock;
+    /* Ranges freed while arena was locked, linked by next_free_index. */
+    etlsf_atomic_t deferred_free_head;
 
-    uint16_t num_ranges;
-    uint16_t next_unused_trailing_index;
-    uint16_t first_free_storage_index;
+    uint32_t num_ranges;
+    uint32_t next_unused_trailing_index;
+    uint32_t first_free_storage_index;
     struct etlsf_range_t storage[1];
 };
 
@@ -193,25 +231,37 @@ struct etlsf_private_t
 #define ETLSF_validate_size(size) ETLSF_assert(size > 0 && size <= ALLOC_SIZE_MAX)
 #define ETLSF_validate_index(index) ETLSF_assert(index && (index <= arena->next_unused_trailing_index))
 
-static size_t   arena_total_size(size_t max_allocs);
+static size_t   arena_total_size    (size_t max_allocs);
+static void     arena_lock          (etlsf_t arena);
+static int      arena_try_lock      (etlsf_t arena);
+static void     arena_unlock        (etlsf_t arena);
+static void     arena_free_range    (etlsf_t arena, uint32_t index);
+static void     arena_defer_free    (etlsf_t arena, uint32_t index);
+static void     arena_flush_deferred(etlsf_t arena);
+static uint32_t arena_relocate_range(etlsf_t arena, uint32_t free_index, etlsf_relocation_t* relocation);
 
-static uint16_t storage_alloc_range_data(etlsf_t arena);
-static void     storage_free_range_data (etlsf_t arena, uint16_t index);
+static uint32_t storage_alloc_range_data(etlsf_t arena);
+static void     storage_free_range_data (etlsf_t arena, uint32_t index);
 
-static uint32_t calc_range_size     (etlsf_t arena, uint16_t index);
+static uint32_t calc_range_size     (etlsf_t arena, uint32_t index);
 static void     create_initial_range(etlsf_t arena);
-static uint32_t split_range         (etlsf_t arena, uint16_t index, uint32_t size);
-static void     merge_ranges        (etlsf_t arena, uint16_t target_index, uint16_t source_index);
+static uint32_t split_range         (etlsf_t arena, uint32_t index, uint32_t size);
+static void     merge_ranges        (etlsf_t arena, uint32_t target_index, uint32_t source_index);
 
-static void     freelist_insert_range(etlsf_t arena, uint16_t index);
-static void     freelist_remove_range(etlsf_t arena, uint16_t index);
-static uint16_t freelist_find_suitable(etlsf_t arena, uint32_t size);
+static void     freelist_insert_range(etlsf_t arena, uint32_t index);
+static void     freelist_remove_range(etlsf_t arena, uint32_t index);
+static uint32_t freelist_find_suitable(etlsf_t arena, uint32_t size);
 
 //-------------------------  API implementation  ----------------------------//
 
-etlsf_t etlsf_create(uint32_t size, uint16_t max_allocs)
+etlsf_t etlsf_create(uint32_t size, uint32_t max_allocs)
 {
-    if (max_allocs == 0 || size < ALLOC_SIZE_MIN || size > ALLOC_SIZE_MAX)
+    return etlsf_create_ex(size, max_allocs, 0);
+}
+
+etlsf_t etlsf_create_ex(uint32_t size, uint32_t max_allocs, uint32_t flags)
+{
+    if (max_allocs == 0 || max_allocs > ALLOCS_MAX || size < ALLOC_SIZE_MIN || size > ALLOC_SIZE_MAX)
     {
         return 0;
     }
@@ -223,6 +273,7 @@ etlsf_t etlsf_create(uint32_t size, uint16_t max_allocs)
         ETLSF_memset(arena, sizeof(struct etlsf_private_t), 0); // sets also all lists point to zero block
 
         arena->size = size;
+        arena->flags = flags;
         arena->num_ranges = max_allocs;
 
         create_initial_range(arena);
@@ -248,7 +299,10 @@ etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size)
         //Align up to min alignment, should not overflow
         uint32_t adjusted_size = (size + ALIGN_SIZE_MASK) & ~ALIGN_SIZE_MASK;
 
-        uint16_t index = freelist_find_suitable(arena, adjusted_size);
+        arena_lock(arena);
+        arena_flush_deferred(arena);
+
+        uint32_t index = freelist_find_suitable(arena, adjusted_size);
 
         if (index)
         {
@@ -257,7 +311,7 @@ etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size)
 
             freelist_remove_range(arena, index);
 
-            uint16_t remainder_index = split_range(arena, index, adjusted_size);
+            uint32_t remainder_index = split_range(arena, index, adjusted_size);
 
             if (remainder_index)
             {
@@ -266,6 +320,8 @@ etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size)
 
             id.value = index;
         }
+
+        arena_unlock(arena);
     }
 
     return id;
@@ -275,27 +331,16 @@ void etlsf_free_range(etlsf_t arena, etlsf_alloc_t id)
 {
     if (arena && etlsf_alloc_is_valid(arena, id))
     {
-        uint16_t index = id.value;
-
-        //Merge prev block if free
-        uint16_t prev_index = ETLSF_range(index).prev_phys_index;
-        if (prev_index && ETLSF_range(prev_index).is_free)
+        if (arena_try_lock(arena))
         {
-            freelist_remove_range(arena, prev_index);
-            merge_ranges(arena, prev_index, index);
-
-            index = prev_index;
+            arena_free_range(arena, id.value);
+            arena_flush_deferred(arena);
+            arena_unlock(arena);
         }
-
-        //Merge next block if free
-        uint16_t next_index = ETLSF_range(index).next_phys_index;
-        if (next_index && ETLSF_range(next_index).is_free)
+        else
         {
-            freelist_remove_range(arena, next_index);
-            merge_ranges(arena, index, next_index);
+            arena_defer_free(arena, id.value);
         }
-
-        freelist_insert_range(arena, index);
     }
 }
 
@@ -311,8 +356,56 @@ uint32_t etlsf_alloc_offset(etlsf_t arena, etlsf_alloc_t id)
 
 int etlsf_alloc_is_valid(etlsf_t arena, etlsf_alloc_t id)
 {
-    uint16_t index = id.value;
-    return arena && (index != 0) && (index <= arena->next_unused_trailing_index) && !ETLSF_range(index).is_free;
+    uint32_t index = id.value;
+    return arena && (index != 0) && (index <= arena->next_unused_trailing_index) &&
+           !ETLSF_range(index).is_free && (ETLSF_range(index).prev_free_index != PENDING_FREE_INDEX);
+}
+
+uint32_t etlsf_defragment(etlsf_t arena, etlsf_relocation_t* relocations, uint32_t max_relocations)
+{
+    uint32_t num_relocations = etlsf_defragment_begin(arena, relocations, max_relocations);
+
+    etlsf_defragment_end(arena);
+
+    return num_relocations;
+}
+
+uint32_t etlsf_defragment_begin(etlsf_t arena, etlsf_relocation_t* relocations, uint32_t max_relocations)
+{
+    uint32_t num_relocations = 0;
+
+    if (arena)
+    {
+        // Stays locked until etlsf_defragment_end, relocated sources are already free
+        arena_lock(arena);
+        arena_flush_deferred(arena);
+
+        uint32_t index = relocations ? arena->first_phys_index : 0;
+
+        while (index && num_relocations < max_relocations)
+        {
+            // Free ranges are always merged, so free range is followed by allocated one or ends arena
+            if (ETLSF_range(index).is_free && ETLSF_range(index).next_phys_index)
+            {
+                index = arena_relocate_range(arena, index, &relocations[num_relocations++]);
+            }
+            else
+            {
+                index = ETLSF_range(index).next_phys_index;
+            }
+        }
+    }
+
+    return num_relocations;
+}
+
+void etlsf_defragment_end(etlsf_t arena)
+{
+    if (arena)
+    {
+        arena_flush_deferred(arena);
+        arena_unlock(arena);
+    }
 }
 
 //------------------------------  Arena utils  --------------------------------//
@@ -322,8 +415,160 @@ static size_t arena_total_size(size_t max_allocs)
     return sizeof(struct etlsf_private_t) + max_allocs * sizeof(struct etlsf_range_t);
 }
 
+static void arena_lock(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    if (arena->flags & ETLSF_THREAD_SAFE)
+    {
+        while (ETLSF_atomic_exchange(&arena->lock, 1) == 1)
+        {
+            ETLSF_pause();
+        }
+    }
+}
+
+static int arena_try_lock(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    return !(arena->flags & ETLSF_THREAD_SAFE) || ETLSF_atomic_exchange(&arena->lock, 1) == 0;
+}
+
+static void arena_unlock(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    if (arena->flags & ETLSF_THREAD_SAFE)
+    {
+        ETLSF_atomic_exchange(&arena->lock, 0);
+    }
+}
+
+static void arena_free_range(etlsf_t arena, uint32_t index)
+{
+    ETLSF_assert(arena);
+    ETLSF_validate_index(index);
+
+    //Merge prev block if free
+    uint32_t prev_index = ETLSF_range(index).prev_phys_index;
+    if (prev_index && ETLSF_range(prev_index).is_free)
+    {
+        freelist_remove_range(arena, prev_index);
+        merge_ranges(arena, prev_index, index);
+
+        index = prev_index;
+    }
+
+    //Merge next block if free
+    uint32_t next_index = ETLSF_range(index).next_phys_index;
+    if (next_index && ETLSF_range(next_index).is_free)
+    {
+        freelist_remove_range(arena, next_index);
+        merge_ranges(arena, index, next_index);
+    }
+
+    freelist_insert_range(arena, index);
+}
+
+// Lock-free push, list is only taken as a whole under arena lock so there is no ABA problem
+static void arena_defer_free(etlsf_t arena, uint32_t index)
+{
+    ETLSF_assert(arena);
+    ETLSF_validate_index(index);
+
+    ETLSF_range(index).prev_free_index = PENDING_FREE_INDEX;
+
+    long head;
+
+    do
+    {
+        head = arena->deferred_free_head;
+        ETLSF_range(index).next_free_index = (uint32_t)head;
+    }
+    while (ETLSF_atomic_cas(&arena->deferred_free_head, (long)index, head) != head);
+}
+
+static void arena_flush_deferred(etlsf_t arena)
+{
+    ETLSF_assert(arena);
+
+    if (!(arena->flags & ETLSF_THREAD_SAFE) || !arena->deferred_free_head)
+    {
+        return;
+    }
+
+    uint32_t index = (uint32_t)ETLSF_atomic_exchange(&arena->deferred_free_head, 0);
+
+    while (index)
+    {
+        uint32_t next_index = ETLSF_range(index).next_free_index;
+
+        ETLSF_range(index).prev_free_index = 0;
+        arena_free_range(arena, index);
+
+        index = next_index;
+    }
+}
+
+/*
+** Swaps free range with allocated range following it and merges free range
+** with the next one if possible. Returns index of the free range.
+*/
+static uint32_t arena_relocate_range(etlsf_t arena, uint32_t free_index, etlsf_relocation_t* relocation)
+{
+    ETLSF_assert(arena);
+    ETLSF_assert(relocation);
+    ETLSF_validate_index(free_index);
+    ETLSF_assert(ETLSF_range(free_index).is_free);
+
+    uint32_t index = ETLSF_range(free_index).next_phys_index;
+    ETLSF_validate_index(index);
+    ETLSF_assert(!ETLSF_range(index).is_free);
+
+    uint32_t size = calc_range_size(arena, index);
+    uint32_t prev_index = ETLSF_range(free_index).prev_phys_index;
+    uint32_t next_index = ETLSF_range(index).next_phys_index;
+
+    // Free list is keyed by size, remove before neighbours change
+    freelist_remove_range(arena, free_index);
+
+    relocation->id.value = index;
+    relocation->src_offset = ETLSF_range(index).offset;
+    relocation->dst_offset = ETLSF_range(free_index).offset;
+    relocation->size = size;
+
+    ETLSF_range(index).offset = relocation->dst_offset;
+    ETLSF_range(free_index).offset = relocation->dst_offset + size;
+
+    if (prev_index)
+    {
+        ETLSF_range(prev_index).next_phys_index = index;
+    }
+    else
+    {
+        arena->first_phys_index = index;
+    }
+
+    ETLSF_range(index).prev_phys_index = prev_index;
+    ETLSF_range(index).next_phys_index = free_index;
+    ETLSF_range(free_index).prev_phys_index = index;
+    ETLSF_range(free_index).next_phys_index = next_index;
+    ETLSF_range(next_index).prev_phys_index = free_index;
+
+    if (next_index && ETLSF_range(next_index).is_free)
+    {
+        freelist_remove_range(arena, next_index);
+        merge_ranges(arena, free_index, next_index);
+    }
+
+    freelist_insert_range(arena, free_index);
+
+    return free_index;
+}
+
 //----------------------------  Storage utils  --------------------------------//
-static uint16_t storage_alloc_range_data(etlsf_t arena)
+static uint32_t storage_alloc_range_data(etlsf_t arena)
 {
     ETLSF_assert(arena);
 
@@ -331,7 +576,7 @@ static uint16_t storage_alloc_range_data(etlsf_t arena)
     {
         ETLSF_validate_index(arena->first_free_storage_index);
 
-        uint16_t index = arena->first_free_storage_index;
+        uint32_t index = arena->first_free_storage_index;
         arena->first_free_storage_index = ETLSF_range(index).next_phys_index;
 
         return index;
@@ -345,11 +590,11 @@ static uint16_t storage_alloc_range_data(etlsf_t arena)
     return 0;
 }
 
-static void storage_free_range_data(etlsf_t arena, uint16_t index)
+static void storage_free_range_data(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(index);
-    ETLSF_assert(arena->next_unused_trailing_index && (arena->next_unused_trailing_index < arena->num_ranges));
+    ETLSF_assert(arena->next_unused_trailing_index && (arena->next_unused_trailing_index <= arena->num_ranges));
 
     if (index == arena->next_unused_trailing_index)
     {
@@ -364,12 +609,12 @@ static void storage_free_range_data(etlsf_t arena, uint16_t index)
 
 //---------------------------  Physical ranges operations  --------------------------//
 
-static uint32_t calc_range_size(etlsf_t arena, uint16_t index)
+static uint32_t calc_range_size(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(index);
 
-    uint16_t next = ETLSF_range(index).next_phys_index;
+    uint32_t next = ETLSF_range(index).next_phys_index;
     uint32_t size = (next ? ETLSF_range(next).offset : arena->size) - ETLSF_range(index).offset;
     ETLSF_validate_size(size);
 
@@ -385,15 +630,16 @@ static void create_initial_range(etlsf_t arena)
     ** so that the prev_phys_block field falls outside of the pool -
     ** it will never be used.
     */
-    uint16_t index = storage_alloc_range_data(arena);
+    uint32_t index = storage_alloc_range_data(arena);
     ETLSF_range(index).prev_phys_index = 0;
     ETLSF_range(index).next_phys_index = 0;
     ETLSF_range(index).offset = 0;
+    arena->first_phys_index = index;
     freelist_insert_range(arena, index);
 }
 
 // returns block created after split
-static uint32_t split_range(etlsf_t arena, uint16_t index, uint32_t size)
+static uint32_t split_range(etlsf_t arena, uint32_t index, uint32_t size)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(index);
@@ -401,12 +647,12 @@ static uint32_t split_range(etlsf_t arena, uint16_t index, uint32_t size)
     
     uint32_t bsize = calc_range_size(arena, index);
 
-    uint16_t new_index = 0;
+    uint32_t new_index = 0;
     int can_split = bsize >= size + ALLOC_SIZE_MIN;
 
     if (can_split && (new_index = storage_alloc_range_data(arena)))
     {
-        uint16_t next_index = ETLSF_range(index).next_phys_index;
+        uint32_t next_index = ETLSF_range(index).next_phys_index;
         uint32_t offset = ETLSF_range(index).offset;
 
         ETLSF_range(index).next_phys_index = new_index;
@@ -421,14 +667,14 @@ static uint32_t split_range(etlsf_t arena, uint16_t index, uint32_t size)
     return new_index;
 }
 
-static void merge_ranges(etlsf_t arena, uint16_t target_index, uint16_t source_index)
+static void merge_ranges(etlsf_t arena, uint32_t target_index, uint32_t source_index)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(target_index);
     ETLSF_validate_index(source_index);
     ETLSF_assert(ETLSF_range(target_index).next_phys_index == source_index);
 
-    uint16_t source_next_index = ETLSF_range(source_index).next_phys_index;
+    uint32_t source_next_index = ETLSF_range(source_index).next_phys_index;
     ETLSF_range(target_index).next_phys_index = source_next_index;
     ETLSF_range(source_next_index).prev_phys_index = target_index;
 
@@ -469,7 +715,7 @@ static inline void align_size_to_log2_scale(uint32_t size, uint32_t* log2, uint3
 //------------------------------  Free list operations  ------------------------------//
 
 //It is a bug when prev phys block is free
-static void freelist_insert_range(etlsf_t arena, uint16_t index)
+static void freelist_insert_range(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(index);
@@ -478,7 +724,7 @@ static void freelist_insert_range(etlsf_t arena, uint16_t index)
     uint32_t size = calc_range_size(arena, index);
     size_to_log2_scale(size, &log2, &scale);
 
-    uint16_t next_free_index = arena->free_ranges[log2][scale];
+    uint32_t next_free_index = arena->free_ranges[log2][scale];
     if (next_free_index)
     {
         ETLSF_validate_index(next_free_index);
@@ -498,7 +744,7 @@ static void freelist_insert_range(etlsf_t arena, uint16_t index)
     arena->scale_bitset[log2] |= (1 << scale);
 }
 
-static void freelist_remove_range(etlsf_t arena, uint16_t index)
+static void freelist_remove_range(etlsf_t arena, uint32_t index)
 {
     ETLSF_assert(arena);
     ETLSF_validate_index(index);
@@ -507,8 +753,8 @@ static void freelist_remove_range(etlsf_t arena, uint16_t index)
     uint32_t size = calc_range_size(arena, index);
     size_to_log2_scale(size, &log2, &scale);
 
-    uint16_t prev_index = ETLSF_range(index).prev_free_index;
-    uint16_t next_index = ETLSF_range(index).next_free_index;
+    uint32_t prev_index = ETLSF_range(index).prev_free_index;
+    uint32_t next_index = ETLSF_range(index).next_free_index;
 
     if (next_index)
     {
@@ -543,12 +789,12 @@ static void freelist_remove_range(etlsf_t arena, uint16_t index)
     }
 }
 
-static uint16_t freelist_find_suitable(etlsf_t arena, uint32_t size)
+static uint32_t freelist_find_suitable(etlsf_t arena, uint32_t size)
 {
     ETLSF_assert(arena);
     ETLSF_validate_size(size);
 
-    uint16_t index = 0;
+    uint32_t index = 0;
 
     if (size)
     {
@@ -584,6 +830,9 @@ static uint16_t freelist_find_suitable(etlsf_t arena, uint32_t size)
 #undef ETLSF_free
 #undef ETLSF_fls
 #undef ETLSF_ffs
+#undef ETLSF_atomic_cas
+#undef ETLSF_atomic_exchange
+#undef ETLSF_pause
 #undef ETLSF_range
 #undef ETLSF_validate_index
 #undef ETLSF_validate_size
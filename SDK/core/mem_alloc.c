@@ -3,31 +3,680 @@
 #define ONLY_MSPACES 1
 #include "malloc.c.h"
 
+// Thread caching front end for dlmalloc mspaces.
+//
+// Small allocations(up to MEM_SMALL_SIZE_MAX bytes with default alignment) are served
+// from per thread caches, each cache owns 64Kb slabs carved into objects of one size class.
+// Slabs are allocated from the underlying mspace and registered in per space hash table,
+// so mem_free can tell small objects from regular dlmalloc chunks by masking the pointer.
+// Table uses linear probing with backward shift deletion, lookups are lock-free and retry
+// misses that overlapped with entries being moved.
+// Objects freed by the owner thread go to its local free list, surplus is flushed in batches
+// to the central per class lists, refills take batches back. Objects freed by other threads
+// are pushed to owner's lock-free remote free list and collected by the owner on refill.
+// Caches of finished threads flush their free lists to central lists and are abandoned,
+// next thread using the space adopts them; frees targeting abandoned cache go to central lists.
+// Central objects are kept in free lists of their slabs, slabs are linked to partial or empty
+// list of the class, when more than MEM_MAX_EMPTY_SLABS slabs of a class have all their
+// objects in central lists, slab becoming empty is returned to dlmalloc.
+// Everything else goes directly to dlmalloc which has its own lock.
+
+enum mem_alloc_private
+{
+    MEM_SMALL_SIZE_GRANULARITY = 16,
+    MEM_SMALL_SIZE_MAX         = 256,
+    MEM_NUM_SIZE_CLASSES       = MEM_SMALL_SIZE_MAX / MEM_SMALL_SIZE_GRANULARITY,
+
+    MEM_SLAB_SIZE              = 64 * 1024,
+    MEM_SLAB_HEADER_SIZE       = 64,
+    MEM_MAX_SLABS_PER_SPACE    = 2048,
+    MEM_SLAB_TABLE_SIZE        = MEM_MAX_SLABS_PER_SPACE * 2,
+
+    MEM_BATCH_SIZE             = 32,
+    MEM_MAX_LOCAL_OBJECTS      = MEM_BATCH_SIZE * 8,
+
+    MEM_MAX_CACHED_SPACES      = 32,
+
+    MEM_MAX_EMPTY_SLABS        = 2,
+};
+
+struct mem_free_object_t
+{
+    mem_free_object_t* next;
+};
+
+struct mem_thread_cache_t;
+
+struct mem_slab_t
+{
+    mem_thread_cache_t* owner;
+    uint32_t            sizeClass;
+
+    // Written under centralLock
+    uint32_t            numCentral;
+    mem_free_object_t*  centralFree;
+    mem_slab_t*         prev;
+    mem_slab_t*         next;
+};
+
+struct mem_thread_cache_t
+{
+    mem_free_object_t*  freeLists[MEM_NUM_SIZE_CLASSES];
+    uint32_t            numFree[MEM_NUM_SIZE_CLASSES];
+
+    // Bump allocation from the most recent slab of every class
+    uint8_t*            slabCursor[MEM_NUM_SIZE_CLASSES];
+    uint8_t*            slabEnd[MEM_NUM_SIZE_CLASSES];
+
+    mem_thread_cache_t* nextAbandoned;
+    volatile long       isAbandoned;
+
+    // Pushed by other threads, popped as a whole by the owner
+    CORE_ALIGN(CORE_CACHE_LINE_SIZE) void* volatile remoteFree;
+};
+
+struct mem_central_list_t
+{
+    // Slabs with some of objects in central list
+    mem_slab_t* partial;
+    // Slabs with all objects in central list
+    mem_slab_t* empty;
+    uint32_t    numEmptySlabs;
+};
+
+struct mspace_internal_t
+{
+    mspace              dlspace;
+    uint32_t            slot;
+    uint32_t            epoch;
+
+    atomic_t            centralLock;
+    mem_central_list_t  central[MEM_NUM_SIZE_CLASSES];
+    mem_thread_cache_t* abandoned;
+    uint32_t            numSlabs;
+
+    // Written under centralLock, read without lock, version is odd while entries are moved
+    void* volatile      slabTable[MEM_SLAB_TABLE_SIZE];
+    atomic_t            slabTableVersion;
+};
+
+struct mem_cache_ref_t
+{
+    mem_thread_cache_t* cache;
+    uint32_t            epoch;
+};
+
+static mspace_internal_t* volatile memSpaces[MEM_MAX_CACHED_SPACES];
+static uint32_t                    memSpaceEpochs[MEM_MAX_CACHED_SPACES];
+static atomic_t                    memSpacesLock = 0;
+static atomic_t                    memEpochCounter = 0;
+
+static CORE_THREAD_LOCAL mem_cache_ref_t threadCaches[MEM_MAX_CACHED_SPACES];
+
+static __forceinline uint32_t mem_size_class(size_t size)
+{
+    return size ? (uint32_t)((size - 1) / MEM_SMALL_SIZE_GRANULARITY) : 0;
+}
+
+static __forceinline size_t mem_class_size(uint32_t sizeClass)
+{
+    return (sizeClass + 1) * MEM_SMALL_SIZE_GRANULARITY;
+}
+
+static __forceinline uint32_t mem_slab_capacity(uint32_t sizeClass)
+{
+    return (uint32_t)((MEM_SLAB_SIZE - MEM_SLAB_HEADER_SIZE) / mem_class_size(sizeClass));
+}
+
+static __forceinline mem_slab_t* mem_slab_from_ptr(void* ptr)
+{
+    return (mem_slab_t*)((uintptr_t)ptr & ~(uintptr_t)(MEM_SLAB_SIZE - 1));
+}
+
+static __forceinline uint32_t mem_slab_hash(void* slab)
+{
+    return (uint32_t)(((uintptr_t)slab / MEM_SLAB_SIZE) * 2654435761u) & (MEM_SLAB_TABLE_SIZE - 1);
+}
+
+static bool mem_is_slab(mspace_internal_t* space, void* slab)
+{
+    for (;;)
+    {
+        long version = space->slabTableVersion;
+        if (version & 1)
+        {
+            _mm_pause();
+            continue;
+        }
+        _ReadWriteBarrier();
+
+        uint32_t i = mem_slab_hash(slab);
+        for (uint32_t n = 0; n < MEM_SLAB_TABLE_SIZE; ++n, i = (i + 1) & (MEM_SLAB_TABLE_SIZE - 1))
+        {
+            void* entry = space->slabTable[i];
+            if (entry == slab) return true;
+            if (entry == 0)    break;
+        }
+
+        // Entry could be moved past probe position meanwhile
+        _ReadWriteBarrier();
+        if (space->slabTableVersion == version) return false;
+    }
+}
+
+static bool mem_register_slab(mspace_internal_t* space, void* slab)
+{
+    uint32_t i = mem_slab_hash(slab);
+    for (uint32_t n = 0; n < MEM_SLAB_TABLE_SIZE; ++n, i = (i + 1) & (MEM_SLAB_TABLE_SIZE - 1))
+    {
+        if (!space->slabTable[i])
+        {
+            _ReadWriteBarrier();
+            space->slabTable[i] = slab;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void mem_unregister_slab(mspace_internal_t* space, void* slab)
+{
+    uint32_t hole = mem_slab_hash(slab);
+    uint32_t n    = 0;
+
+    for (; n < MEM_SLAB_TABLE_SIZE && space->slabTable[hole] != slab; ++n, hole = (hole + 1) & (MEM_SLAB_TABLE_SIZE - 1))
+    {
+        if (!space->slabTable[hole]) return;
+    }
+
+    if (n == MEM_SLAB_TABLE_SIZE) return;
+
+    _InterlockedIncrement(&space->slabTableVersion);
+
+    // Shift later entries of the cluster back, entry can fill the hole when its probe passes it.
+    // Entry is copied before its old slot is reused, so lookups never miss it without retrying.
+    uint32_t i = (hole + 1) & (MEM_SLAB_TABLE_SIZE - 1);
+    for (n = 1; n < MEM_SLAB_TABLE_SIZE && space->slabTable[i]; ++n, i = (i + 1) & (MEM_SLAB_TABLE_SIZE - 1))
+    {
+        void*    entry = space->slabTable[i];
+        uint32_t home  = mem_slab_hash(entry);
+
+        if (((i - home) & (MEM_SLAB_TABLE_SIZE - 1)) >= ((i - hole) & (MEM_SLAB_TABLE_SIZE - 1)))
+        {
+            space->slabTable[hole] = entry;
+            hole = i;
+        }
+    }
+    space->slabTable[hole] = 0;
+
+    _InterlockedIncrement(&space->slabTableVersion);
+}
+
+static mem_thread_cache_t* mem_create_cache(mspace_internal_t* space)
+{
+    atomicLock(&space->centralLock);
+    mem_thread_cache_t* cache = space->abandoned;
+    if (cache)
+    {
+        space->abandoned = cache->nextAbandoned;
+        cache->isAbandoned = 0;
+    }
+    atomicUnlock(&space->centralLock);
+
+    if (!cache)
+    {
+        cache = (mem_thread_cache_t*)mspace_memalign(space->dlspace, CORE_CACHE_LINE_SIZE, sizeof(mem_thread_cache_t));
+        if (cache)
+        {
+            memset(cache, 0, sizeof(mem_thread_cache_t));
+        }
+    }
+
+    return cache;
+}
+
+static __forceinline mem_thread_cache_t* mem_get_cache(mspace_internal_t* space)
+{
+    if (space->slot >= MEM_MAX_CACHED_SPACES)
+    {
+        return 0;
+    }
+
+    mem_cache_ref_t* ref = &threadCaches[space->slot];
+    if (ref->epoch != space->epoch)
+    {
+        // Cache belongs to destroyed space or was not created yet
+        ref->cache = mem_create_cache(space);
+        ref->epoch = space->epoch;
+    }
+
+    return ref->cache;
+}
+
+static __forceinline void mem_push_local(mem_thread_cache_t* cache, uint32_t sizeClass, void* ptr)
+{
+    mem_free_object_t* obj = (mem_free_object_t*)ptr;
+
+    obj->next = cache->freeLists[sizeClass];
+    cache->freeLists[sizeClass] = obj;
+    ++cache->numFree[sizeClass];
+}
+
+static void mem_collect_remote(mem_thread_cache_t* cache)
+{
+    if (!cache->remoteFree)
+    {
+        return;
+    }
+
+    mem_free_object_t* obj = (mem_free_object_t*)_InterlockedExchangePointer(&cache->remoteFree, 0);
+    while (obj)
+    {
+        mem_free_object_t* next = obj->next;
+        mem_push_local(cache, mem_slab_from_ptr(obj)->sizeClass, obj);
+        obj = next;
+    }
+}
+
+static __forceinline void mem_link_slab(mem_slab_t** list, mem_slab_t* slab)
+{
+    slab->prev = 0;
+    slab->next = *list;
+    if (*list)
+    {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static __forceinline void mem_unlink_slab(mem_slab_t** list, mem_slab_t* slab)
+{
+    if (slab->prev)
+    {
+        slab->prev->next = slab->next;
+    }
+    else
+    {
+        *list = slab->next;
+    }
+
+    if (slab->next)
+    {
+        slab->next->prev = slab->prev;
+    }
+}
+
+// Returns object to free list of its slab, called under centralLock
+static void mem_push_central(mspace_internal_t* space, mem_slab_t* slab, void* ptr)
+{
+    mem_central_list_t* central = &space->central[slab->sizeClass];
+    mem_free_object_t*  obj     = (mem_free_object_t*)ptr;
+
+    obj->next         = slab->centralFree;
+    slab->centralFree = obj;
+
+    if (slab->numCentral++ == 0)
+    {
+        mem_link_slab(&central->partial, slab);
+    }
+
+    if (slab->numCentral == mem_slab_capacity(slab->sizeClass))
+    {
+        mem_unlink_slab(&central->partial, slab);
+
+        if (central->numEmptySlabs < MEM_MAX_EMPTY_SLABS)
+        {
+            mem_link_slab(&central->empty, slab);
+            ++central->numEmptySlabs;
+        }
+        else
+        {
+            mem_unregister_slab(space, slab);
+            mspace_free(space->dlspace, slab);
+            --space->numSlabs;
+        }
+    }
+}
+
+// Moves count objects from local free list to central lists
+static void mem_flush(mspace_internal_t* space, mem_thread_cache_t* cache, uint32_t sizeClass, uint32_t count)
+{
+    if (!count)
+    {
+        return;
+    }
+
+    mem_free_object_t* obj = cache->freeLists[sizeClass];
+
+    atomicLock(&space->centralLock);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mem_free_object_t* next = obj->next;
+        mem_push_central(space, mem_slab_from_ptr(obj), obj);
+        obj = next;
+    }
+    atomicUnlock(&space->centralLock);
+
+    cache->freeLists[sizeClass] = obj;
+    cache->numFree[sizeClass]  -= count;
+}
+
+static bool mem_refill(mspace_internal_t* space, mem_thread_cache_t* cache, uint32_t sizeClass)
+{
+    mem_collect_remote(cache);
+    if (cache->freeLists[sizeClass])
+    {
+        return true;
+    }
+
+    size_t objSize = mem_class_size(sizeClass);
+
+    if (cache->slabCursor[sizeClass] + objSize <= cache->slabEnd[sizeClass])
+    {
+        uint8_t* cursor = cache->slabCursor[sizeClass];
+        for (uint32_t i = 0; i < MEM_BATCH_SIZE && cursor + objSize <= cache->slabEnd[sizeClass]; ++i, cursor += objSize)
+        {
+            mem_push_local(cache, sizeClass, cursor);
+        }
+        cache->slabCursor[sizeClass] = cursor;
+
+        return true;
+    }
+
+    mem_central_list_t* central = &space->central[sizeClass];
+    mem_slab_t*         slab    = 0;
+
+    atomicLock(&space->centralLock);
+    if (central->partial || central->empty)
+    {
+        uint32_t capacity = mem_slab_capacity(sizeClass);
+
+        // Partial slabs go first, so empty ones stay whole and can be released
+        for (uint32_t i = 0; i < MEM_BATCH_SIZE; ++i)
+        {
+            mem_slab_t* objSlab = central->partial ? central->partial : central->empty;
+            if (!objSlab)
+            {
+                break;
+            }
+
+            if (objSlab->numCentral == capacity)
+            {
+                mem_unlink_slab(&central->empty, objSlab);
+                mem_link_slab(&central->partial, objSlab);
+                --central->numEmptySlabs;
+            }
+
+            mem_free_object_t* obj = objSlab->centralFree;
+            objSlab->centralFree = obj->next;
+
+            if (--objSlab->numCentral == 0)
+            {
+                mem_unlink_slab(&central->partial, objSlab);
+            }
+
+            mem_push_local(cache, sizeClass, obj);
+        }
+    }
+    else if (space->numSlabs < MEM_MAX_SLABS_PER_SPACE)
+    {
+        slab = (mem_slab_t*)mspace_memalign(space->dlspace, MEM_SLAB_SIZE, MEM_SLAB_SIZE);
+        if (slab)
+        {
+            memset(slab, 0, sizeof(mem_slab_t));
+            slab->owner     = cache;
+            slab->sizeClass = sizeClass;
+
+            if (mem_register_slab(space, slab))
+            {
+                ++space->numSlabs;
+            }
+            else
+            {
+                // Full table, request falls back to dlmalloc
+                mspace_free(space->dlspace, slab);
+                slab = 0;
+            }
+        }
+    }
+    atomicUnlock(&space->centralLock);
+
+    if (slab)
+    {
+        cache->slabCursor[sizeClass] = (uint8_t*)slab + MEM_SLAB_HEADER_SIZE;
+        cache->slabEnd[sizeClass]    = (uint8_t*)slab + MEM_SLAB_SIZE;
+
+        return mem_refill(space, cache, sizeClass);
+    }
+
+    return cache->freeLists[sizeClass] != 0;
+}
+
+static void* mem_alloc_small(mspace_internal_t* space, size_t size)
+{
+    mem_thread_cache_t* cache = mem_get_cache(space);
+    if (!cache)
+    {
+        return 0;
+    }
+
+    uint32_t sizeClass = mem_size_class(size);
+
+    if (!cache->freeLists[sizeClass] && !mem_refill(space, cache, sizeClass))
+    {
+        return 0;
+    }
+
+    mem_free_object_t* obj = cache->freeLists[sizeClass];
+    cache->freeLists[sizeClass] = obj->next;
+    --cache->numFree[sizeClass];
+
+    return obj;
+}
+
+static void mem_free_small(mspace_internal_t* space, mem_slab_t* slab, void* ptr)
+{
+    mem_thread_cache_t* cache = mem_get_cache(space);
+
+    if (slab->owner == cache)
+    {
+        uint32_t sizeClass = slab->sizeClass;
+
+        mem_push_local(cache, sizeClass, ptr);
+        if (cache->numFree[sizeClass] > MEM_MAX_LOCAL_OBJECTS)
+        {
+            mem_flush(space, cache, sizeClass, MEM_BATCH_SIZE);
+        }
+    }
+    else
+    {
+        mem_thread_cache_t* owner = slab->owner;
+
+        if (owner->isAbandoned)
+        {
+            atomicLock(&space->centralLock);
+            // Cache could be adopted meanwhile, objects in central list are fine for new owner too
+            mem_push_central(space, slab, ptr);
+            atomicUnlock(&space->centralLock);
+
+            return;
+        }
+
+        mem_free_object_t* obj = (mem_free_object_t*)ptr;
+        void*              head;
+
+        do
+        {
+            head      = owner->remoteFree;
+            obj->next = (mem_free_object_t*)head;
+        }
+        while (_InterlockedCompareExchangePointer(&owner->remoteFree, obj, head) != head);
+    }
+}
+
+static __forceinline bool mem_is_small_request(size_t size, size_t alignment)
+{
+    return size <= MEM_SMALL_SIZE_MAX && alignment <= MEM_SMALL_SIZE_GRANULARITY;
+}
+
 mspace_t mem_create_space(size_t capacity)
 {
-    return (mspace_t)create_mspace(capacity, 1);
+    mspace dlspace = create_mspace(capacity, 1);
+    if (!dlspace)
+    {
+        return 0;
+    }
+
+    mspace_internal_t* space = (mspace_internal_t*)mspace_memalign(dlspace, CORE_CACHE_LINE_SIZE, sizeof(mspace_internal_t));
+    if (!space)
+    {
+        destroy_mspace(dlspace);
+        return 0;
+    }
+
+    memset(space, 0, sizeof(mspace_internal_t));
+    space->dlspace = dlspace;
+    space->epoch   = (uint32_t)_InterlockedIncrement(&memEpochCounter);
+    space->slot    = MEM_MAX_CACHED_SPACES;
+
+    // Spaces without free slot work without thread caches
+    atomicLock(&memSpacesLock);
+    for (uint32_t i = 0; i < MEM_MAX_CACHED_SPACES; ++i)
+    {
+        if (!memSpaces[i])
+        {
+            memSpaces[i]      = space;
+            memSpaceEpochs[i] = space->epoch;
+            space->slot       = i;
+            break;
+        }
+    }
+    atomicUnlock(&memSpacesLock);
+
+    return space;
 }
 
 void mem_destroy_space(mspace_t mspace)
 {
     assert(mspace);
-    destroy_mspace(mspace);
+
+    if (mspace->slot < MEM_MAX_CACHED_SPACES)
+    {
+        atomicLock(&memSpacesLock);
+        memSpaces[mspace->slot]      = 0;
+        memSpaceEpochs[mspace->slot] = 0;
+        atomicUnlock(&memSpacesLock);
+
+        threadCaches[mspace->slot].cache = 0;
+        threadCaches[mspace->slot].epoch = 0;
+    }
+
+    // Slabs, caches and space header are regular chunks of dlmalloc space
+    destroy_mspace(mspace->dlspace);
 }
 
 void* mem_alloc(mspace_t mspace, size_t size, size_t alignment)
 {
     assert(mspace);
-    return mspace_malloc2(mspace, size, alignment, 0);
+
+    if (mem_is_small_request(size, alignment))
+    {
+        void* ptr = mem_alloc_small(mspace, size);
+        if (ptr)
+        {
+            return ptr;
+        }
+    }
+
+    return mspace_malloc2(mspace->dlspace, size, alignment, 0);
 }
 
 void* mem_realloc(mspace_t mspace, void* ptr, size_t size, size_t alignment)
 {
     assert(mspace);
-    return mspace_realloc2(mspace, ptr, size, alignment, 0);
+
+    if (!ptr)
+    {
+        return mem_alloc(mspace, size, alignment);
+    }
+
+    mem_slab_t* slab = mem_slab_from_ptr(ptr);
+    if (!mem_is_slab(mspace, slab))
+    {
+        return mspace_realloc2(mspace->dlspace, ptr, size, alignment, 0);
+    }
+
+    size_t oldSize = mem_class_size(slab->sizeClass);
+    if (mem_is_small_request(size, alignment) && size <= oldSize && size > oldSize - MEM_SMALL_SIZE_GRANULARITY)
+    {
+        return ptr;
+    }
+
+    void* newPtr = mem_alloc(mspace, size, alignment);
+    if (newPtr)
+    {
+        memcpy(newPtr, ptr, size < oldSize ? size : oldSize);
+        mem_free_small(mspace, slab, ptr);
+    }
+
+    return newPtr;
 }
 
 void  mem_free(mspace_t mspace, void* ptr)
 {
     assert(mspace);
-    mspace_free(mspace, ptr);
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    mem_slab_t* slab = mem_slab_from_ptr(ptr);
+    if (mem_is_slab(mspace, slab))
+    {
+        mem_free_small(mspace, slab, ptr);
+    }
+    else
+    {
+        mspace_free(mspace->dlspace, ptr);
+    }
+}
+
+void mem_thread_fini()
+{
+    for (uint32_t i = 0; i < MEM_MAX_CACHED_SPACES; ++i)
+    {
+        mem_cache_ref_t* ref = &threadCaches[i];
+        if (!ref->cache)
+        {
+            continue;
+        }
+
+        atomicLock(&memSpacesLock);
+        mspace_internal_t* space = memSpaces[i];
+        if (space && memSpaceEpochs[i] == ref->epoch)
+        {
+            mem_thread_cache_t* cache = ref->cache;
+
+            // Later frees go to central lists, remote frees pushed before that are collected here
+            _InterlockedExchange(&cache->isAbandoned, 1);
+            mem_collect_remote(cache);
+
+            for (uint32_t sizeClass = 0; sizeClass < MEM_NUM_SIZE_CLASSES; ++sizeClass)
+            {
+                mem_flush(space, cache, sizeClass, cache->numFree[sizeClass]);
+            }
+
+            // Slabs still point to the cache, next thread using the space adopts it
+            atomicLock(&space->centralLock);
+            cache->nextAbandoned = space->abandoned;
+            space->abandoned     = cache;
+            atomicUnlock(&space->centralLock);
+        }
+        atomicUnlock(&memSpacesLock);
+
+        ref->cache = 0;
+        ref->epoch = 0;
+    }
 }
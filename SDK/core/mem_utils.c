@@ -1,123 +1,621 @@
-void mem_set(void *dest, size_t len, uint8_t value)
+#include <emmintrin.h>
+#include <immintrin.h>
+
+// Bigger fills and copies bypass cache with non-temporal stores: they would evict
+// the whole working set anyway, and mapped GL buffers are write combined memory
+#define MEM_STREAM_THRESHOLD (4 * 1024 * 1024)
+
+// Implementations below handle sizes above 32 bytes, smaller ones are done inline
+typedef void (*mem_fill_func_t)(uint8_t* dp, size_t len, const __m128i* pattern, int stream);
+typedef void (*mem_copy_func_t)(uint8_t* dp, const uint8_t* sp, size_t len, int stream);
+
+//--------------------------------------------------------------------------
+// Small sizes
+//--------------------------------------------------------------------------
+
+// Up to 32 bytes with two possibly overlapping stores from the both ends,
+// pattern repeats with element size, so dp should be aligned to element
+static void mem_fill_small(uint8_t* dp, size_t len, __m128i pattern)
 {
-    uint8_t *dp = (uint8_t*)dest;
-    size_t tlen = len;
+    if (len >= 16)
+    {
+        _mm_storeu_si128((__m128i*)dp,              pattern);
+        _mm_storeu_si128((__m128i*)(dp + len - 16), pattern);
+    }
+    else if (len >= 8)
+    {
+        _mm_storel_epi64((__m128i*)dp,             pattern);
+        _mm_storel_epi64((__m128i*)(dp + len - 8), pattern);
+    }
+    else if (len >= 4)
+    {
+        uint32_t value = (uint32_t)_mm_cvtsi128_si32(pattern);
+
+        *(uint32_t*)dp             = value;
+        *(uint32_t*)(dp + len - 4) = value;
+    }
+    else if (len >= 2)
+    {
+        uint16_t value = (uint16_t)_mm_cvtsi128_si32(pattern);
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+        *(uint16_t*)dp             = value;
+        *(uint16_t*)(dp + len - 2) = value;
+    }
+    else if (len)
+    {
+        *dp = (uint8_t)_mm_cvtsi128_si32(pattern);
+    }
 }
 
-void mem_set8(uint8_t *dp, size_t len, uint8_t value)
+// Up to 32 bytes, everything is loaded before the first store, so ranges can overlap
+static void mem_copy_small(uint8_t* dp, const uint8_t* sp, size_t len)
 {
-    size_t tlen = len;
+    if (len >= 16)
+    {
+        __m128i head = _mm_loadu_si128((const __m128i*)sp);
+        __m128i tail = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+
+        _mm_storeu_si128((__m128i*)dp,              head);
+        _mm_storeu_si128((__m128i*)(dp + len - 16), tail);
+    }
+    else if (len >= 8)
+    {
+        __m128i head = _mm_loadl_epi64((const __m128i*)sp);
+        __m128i tail = _mm_loadl_epi64((const __m128i*)(sp + len - 8));
+
+        _mm_storel_epi64((__m128i*)dp,             head);
+        _mm_storel_epi64((__m128i*)(dp + len - 8), tail);
+    }
+    else if (len >= 4)
+    {
+        uint32_t head = *(const uint32_t*)sp;
+        uint32_t tail = *(const uint32_t*)(sp + len - 4);
+
+        *(uint32_t*)dp             = head;
+        *(uint32_t*)(dp + len - 4) = tail;
+    }
+    else if (len >= 2)
+    {
+        uint16_t head = *(const uint16_t*)sp;
+        uint16_t tail = *(const uint16_t*)(sp + len - 2);
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+        *(uint16_t*)dp             = head;
+        *(uint16_t*)(dp + len - 2) = tail;
+    }
+    else if (len)
+    {
+        *dp = *sp;
+    }
 }
 
-void mem_set16(uint16_t *dp, size_t len, uint16_t value)
+//--------------------------------------------------------------------------
+// SSE2
+//--------------------------------------------------------------------------
+// Unaligned head and tail are stored separately, the rest is done with aligned
+// stores. Copies load head and tail first and store them last, in between loads
+// of each iteration precede its stores, so forward copy is safe when destination
+// is below source and backward one when it is above.
+
+// Up to 128 bytes without loops, head and tail halves may overlap
+static void mem_fill_medium_sse2(uint8_t* dp, size_t len, __m128i v)
 {
-    size_t tlen = len;
+    uint8_t* end = dp + len;
+
+    _mm_storeu_si128((__m128i*)dp,         v);
+    _mm_storeu_si128((__m128i*)(dp + 16),  v);
+    _mm_storeu_si128((__m128i*)(end - 32), v);
+    _mm_storeu_si128((__m128i*)(end - 16), v);
+
+    if (len > 64)
+    {
+        _mm_storeu_si128((__m128i*)(dp + 32),  v);
+        _mm_storeu_si128((__m128i*)(dp + 48),  v);
+        _mm_storeu_si128((__m128i*)(end - 64), v);
+        _mm_storeu_si128((__m128i*)(end - 48), v);
+    }
+}
+
+static void mem_copy_medium_sse2(uint8_t* dp, const uint8_t* sp, size_t len)
+{
+    const uint8_t* send = sp + len;
+    uint8_t*       dend = dp + len;
+
+    __m128i h0 = _mm_loadu_si128((const __m128i*)sp);
+    __m128i h1 = _mm_loadu_si128((const __m128i*)(sp + 16));
+    __m128i t0 = _mm_loadu_si128((const __m128i*)(send - 32));
+    __m128i t1 = _mm_loadu_si128((const __m128i*)(send - 16));
+
+    if (len > 64)
+    {
+        __m128i h2 = _mm_loadu_si128((const __m128i*)(sp + 32));
+        __m128i h3 = _mm_loadu_si128((const __m128i*)(sp + 48));
+        __m128i t2 = _mm_loadu_si128((const __m128i*)(send - 64));
+        __m128i t3 = _mm_loadu_si128((const __m128i*)(send - 48));
+
+        _mm_storeu_si128((__m128i*)(dp + 32),   h2);
+        _mm_storeu_si128((__m128i*)(dp + 48),   h3);
+        _mm_storeu_si128((__m128i*)(dend - 64), t2);
+        _mm_storeu_si128((__m128i*)(dend - 48), t3);
+    }
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+    _mm_storeu_si128((__m128i*)dp,          h0);
+    _mm_storeu_si128((__m128i*)(dp + 16),   h1);
+    _mm_storeu_si128((__m128i*)(dend - 32), t0);
+    _mm_storeu_si128((__m128i*)(dend - 16), t1);
 }
 
+static void mem_fill_sse2(uint8_t* dp, size_t len, const __m128i* pattern, int stream)
+{
+    __m128i  v = *pattern;
 
-void mem_set32(uint32_t *dp, size_t len, uint32_t value)
+    if (len <= 128)
+    {
+        mem_fill_medium_sse2(dp, len, v);
+
+        return;
+    }
+
+    size_t   skip = 16 - ((uintptr_t)dp & 15);
+    uint8_t* d = dp + skip;
+    size_t   n = len - skip;
+
+    _mm_storeu_si128((__m128i*)dp,              v);
+    _mm_storeu_si128((__m128i*)(dp + len - 16), v);
+
+    if (stream)
+    {
+        for (; n > 64; d += 64, n -= 64)
+        {
+            _mm_stream_si128((__m128i*)d,        v);
+            _mm_stream_si128((__m128i*)(d + 16), v);
+            _mm_stream_si128((__m128i*)(d + 32), v);
+            _mm_stream_si128((__m128i*)(d + 48), v);
+        }
+        _mm_sfence();
+    }
+
+    for (; n > 64; d += 64, n -= 64)
+    {
+        _mm_store_si128((__m128i*)d,        v);
+        _mm_store_si128((__m128i*)(d + 16), v);
+        _mm_store_si128((__m128i*)(d + 32), v);
+        _mm_store_si128((__m128i*)(d + 48), v);
+    }
+
+    for (; n > 16; d += 16, n -= 16)
+    {
+        _mm_store_si128((__m128i*)d, v);
+    }
+}
+
+static void mem_copy_forward_sse2(uint8_t* dp, const uint8_t* sp, size_t len, int stream)
 {
-    size_t tlen = len;
+    if (len <= 128)
+    {
+        mem_copy_medium_sse2(dp, sp, len);
+
+        return;
+    }
+
+    __m128i        head = _mm_loadu_si128((const __m128i*)sp);
+    __m128i        tail = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+    size_t         skip = 16 - ((uintptr_t)dp & 15);
+    uint8_t*       d = dp + skip;
+    const uint8_t* s = sp + skip;
+    size_t         n = len - skip;
+
+    if (stream)
+    {
+        for (; n > 64; d += 64, s += 64, n -= 64)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+            __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+
+            _mm_stream_si128((__m128i*)d,        v0);
+            _mm_stream_si128((__m128i*)(d + 16), v1);
+            _mm_stream_si128((__m128i*)(d + 32), v2);
+            _mm_stream_si128((__m128i*)(d + 48), v3);
+        }
+        _mm_sfence();
+    }
+
+    for (; n > 64; d += 64, s += 64, n -= 64)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(s + 48));
+
+        _mm_store_si128((__m128i*)d,        v0);
+        _mm_store_si128((__m128i*)(d + 16), v1);
+        _mm_store_si128((__m128i*)(d + 32), v2);
+        _mm_store_si128((__m128i*)(d + 48), v3);
+    }
 
-    if (tlen)  do { *dp++ = value; } while(--tlen);
+    for (; n > 16; d += 16, s += 16, n -= 16)
+    {
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((const __m128i*)s));
+    }
+
+    _mm_storeu_si128((__m128i*)dp,              head);
+    _mm_storeu_si128((__m128i*)(dp + len - 16), tail);
 }
 
-void mem_move(void *dest, const void *src, size_t len)
+// Overlapping ranges only, so never streams
+static void mem_copy_backward_sse2(uint8_t* dp, const uint8_t* sp, size_t len, int stream)
 {
-    const uint8_t*  sp = (const uint8_t*)src;
-    uint8_t*        dp = (uint8_t*)dest;
+    if (len <= 128)
+    {
+        mem_copy_medium_sse2(dp, sp, len);
+
+        return;
+    }
 
-    uint32_t tlen = len;
+    __m128i head = _mm_loadu_si128((const __m128i*)sp);
+    __m128i tail = _mm_loadu_si128((const __m128i*)(sp + len - 16));
+    size_t  cut  = (uintptr_t)(dp + len) & 15;
+    size_t  n    = len - (cut ? cut : 16);
 
-    if (tlen == 0) return;
-    
-    //  Determine if we need to copy forward or backward (overlap)
-    if ((uintptr_t)dp < (uintptr_t)sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    (void)stream;
+
+    for (; n > 64; )
+    {
+        n -= 64;
+
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(sp + n));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(sp + n + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(sp + n + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(sp + n + 48));
+
+        _mm_store_si128((__m128i*)(dp + n),      v0);
+        _mm_store_si128((__m128i*)(dp + n + 16), v1);
+        _mm_store_si128((__m128i*)(dp + n + 32), v2);
+        _mm_store_si128((__m128i*)(dp + n + 48), v3);
+    }
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    for (; n > 16; )
+    {
+        n -= 16;
 
-        do { *--dp = *--sp; } while (--tlen);
+        _mm_store_si128((__m128i*)(dp + n), _mm_loadu_si128((const __m128i*)(sp + n)));
     }
+
+    _mm_storeu_si128((__m128i*)(dp + len - 16), tail);
+    _mm_storeu_si128((__m128i*)dp,              head);
 }
 
+//--------------------------------------------------------------------------
+// AVX
+//--------------------------------------------------------------------------
+// Same as SSE2 with 32 byte stores. 256 bit integer loads and stores are
+// already part of AVX, AVX2 is not needed.
 
-void mem_move8(uint8_t *dp, const uint8_t *sp, size_t len)
+// Up to 256 bytes without loops, 32 byte vectors are passed by pointer, Win32 can not align them on stack
+static void mem_fill_medium_avx(uint8_t* dp, size_t len, const __m256i* pattern)
 {
-    uint32_t tlen = len;
+    __m256i  v   = *pattern;
+    uint8_t* end = dp + len;
 
-    if (tlen == 0) return;
+    _mm256_storeu_si256((__m256i*)dp,         v);
+    _mm256_storeu_si256((__m256i*)(end - 32), v);
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    if (len > 64)
+    {
+        _mm256_storeu_si256((__m256i*)(dp + 32),  v);
+        _mm256_storeu_si256((__m256i*)(end - 64), v);
+    }
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    if (len > 128)
+    {
+        _mm256_storeu_si256((__m256i*)(dp + 64),   v);
+        _mm256_storeu_si256((__m256i*)(dp + 96),   v);
+        _mm256_storeu_si256((__m256i*)(end - 128), v);
+        _mm256_storeu_si256((__m256i*)(end - 96),  v);
+    }
+}
 
-        do { *--dp = *--sp; } while (--tlen);
+static void mem_copy_medium_avx(uint8_t* dp, const uint8_t* sp, size_t len)
+{
+    const uint8_t* send = sp + len;
+    uint8_t*       dend = dp + len;
+
+    __m256i h0 = _mm256_loadu_si256((const __m256i*)sp);
+    __m256i t0 = _mm256_loadu_si256((const __m256i*)(send - 32));
+
+    if (len > 128)
+    {
+        __m256i h1 = _mm256_loadu_si256((const __m256i*)(sp + 32));
+        __m256i h2 = _mm256_loadu_si256((const __m256i*)(sp + 64));
+        __m256i h3 = _mm256_loadu_si256((const __m256i*)(sp + 96));
+        __m256i t1 = _mm256_loadu_si256((const __m256i*)(send - 64));
+        __m256i t2 = _mm256_loadu_si256((const __m256i*)(send - 96));
+        __m256i t3 = _mm256_loadu_si256((const __m256i*)(send - 128));
+
+        _mm256_storeu_si256((__m256i*)(dp + 32),    h1);
+        _mm256_storeu_si256((__m256i*)(dp + 64),    h2);
+        _mm256_storeu_si256((__m256i*)(dp + 96),    h3);
+        _mm256_storeu_si256((__m256i*)(dend - 64),  t1);
+        _mm256_storeu_si256((__m256i*)(dend - 96),  t2);
+        _mm256_storeu_si256((__m256i*)(dend - 128), t3);
+    }
+    else if (len > 64)
+    {
+        __m256i h1 = _mm256_loadu_si256((const __m256i*)(sp + 32));
+        __m256i t1 = _mm256_loadu_si256((const __m256i*)(send - 64));
+
+        _mm256_storeu_si256((__m256i*)(dp + 32),   h1);
+        _mm256_storeu_si256((__m256i*)(dend - 64), t1);
     }
+
+    _mm256_storeu_si256((__m256i*)dp,          h0);
+    _mm256_storeu_si256((__m256i*)(dend - 32), t0);
 }
 
+static void mem_fill_avx(uint8_t* dp, size_t len, const __m128i* pattern, int stream)
+{
+    __m256i v = _mm256_insertf128_si256(_mm256_castsi128_si256(*pattern), *pattern, 1);
 
-void mem_move16(uint16_t *dp, const uint16_t *sp, size_t len)
+    if (len <= 256)
+    {
+        mem_fill_medium_avx(dp, len, &v);
+        _mm256_zeroupper();
+
+        return;
+    }
+
+    size_t   skip = 32 - ((uintptr_t)dp & 31);
+    uint8_t* d = dp + skip;
+    size_t   n = len - skip;
+
+    _mm256_storeu_si256((__m256i*)dp,              v);
+    _mm256_storeu_si256((__m256i*)(dp + len - 32), v);
+
+    if (stream)
+    {
+        for (; n > 128; d += 128, n -= 128)
+        {
+            _mm256_stream_si256((__m256i*)d,        v);
+            _mm256_stream_si256((__m256i*)(d + 32), v);
+            _mm256_stream_si256((__m256i*)(d + 64), v);
+            _mm256_stream_si256((__m256i*)(d + 96), v);
+        }
+        _mm_sfence();
+    }
+
+    for (; n > 128; d += 128, n -= 128)
+    {
+        _mm256_store_si256((__m256i*)d,        v);
+        _mm256_store_si256((__m256i*)(d + 32), v);
+        _mm256_store_si256((__m256i*)(d + 64), v);
+        _mm256_store_si256((__m256i*)(d + 96), v);
+    }
+
+    for (; n > 32; d += 32, n -= 32)
+    {
+        _mm256_store_si256((__m256i*)d, v);
+    }
+
+    _mm256_zeroupper();
+}
+
+static void mem_copy_forward_avx(uint8_t* dp, const uint8_t* sp, size_t len, int stream)
 {
-    uint32_t tlen = len;
+    if (len <= 256)
+    {
+        mem_copy_medium_avx(dp, sp, len);
+        _mm256_zeroupper();
 
-    if (tlen == 0) return;
+        return;
+    }
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+    __m256i        head = _mm256_loadu_si256((const __m256i*)sp);
+    __m256i        tail = _mm256_loadu_si256((const __m256i*)(sp + len - 32));
+    size_t         skip = 32 - ((uintptr_t)dp & 31);
+    uint8_t*       d = dp + skip;
+    const uint8_t* s = sp + skip;
+    size_t         n = len - skip;
+
+    if (stream)
+    {
+        for (; n > 128; d += 128, s += 128, n -= 128)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+            __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+            __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+            __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+
+            _mm256_stream_si256((__m256i*)d,        v0);
+            _mm256_stream_si256((__m256i*)(d + 32), v1);
+            _mm256_stream_si256((__m256i*)(d + 64), v2);
+            _mm256_stream_si256((__m256i*)(d + 96), v3);
+        }
+        _mm_sfence();
+    }
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    for (; n > 128; d += 128, s += 128, n -= 128)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)s);
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(s + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(s + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*)(s + 96));
+
+        _mm256_store_si256((__m256i*)d,        v0);
+        _mm256_store_si256((__m256i*)(d + 32), v1);
+        _mm256_store_si256((__m256i*)(d + 64), v2);
+        _mm256_store_si256((__m256i*)(d + 96), v3);
+    }
 
-        do { *--dp = *--sp; } while (--tlen);
+    for (; n > 32; d += 32, s += 32, n -= 32)
+    {
+        _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((const __m256i*)s));
     }
 
+    _mm256_storeu_si256((__m256i*)dp,              head);
+    _mm256_storeu_si256((__m256i*)(dp + len - 32), tail);
+    _mm256_zeroupper();
 }
 
+static void mem_copy_backward_avx(uint8_t* dp, const uint8_t* sp, size_t len, int stream)
+{
+    if (len <= 256)
+    {
+        mem_copy_medium_avx(dp, sp, len);
+        _mm256_zeroupper();
 
-void mem_move32(uint32_t *dp, const uint32_t *sp, size_t len)
+        return;
+    }
+
+    __m256i head = _mm256_loadu_si256((const __m256i*)sp);
+    __m256i tail = _mm256_loadu_si256((const __m256i*)(sp + len - 32));
+    size_t  cut  = (uintptr_t)(dp + len) & 31;
+    size_t  n    = len - (cut ? cut : 32);
+
+    (void)stream;
+
+    for (; n > 128; )
+    {
+        n -= 128;
+
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(sp + n));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(sp + n + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(sp + n + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*)(sp + n + 96));
+
+        _mm256_store_si256((__m256i*)(dp + n),      v0);
+        _mm256_store_si256((__m256i*)(dp + n + 32), v1);
+        _mm256_store_si256((__m256i*)(dp + n + 64), v2);
+        _mm256_store_si256((__m256i*)(dp + n + 96), v3);
+    }
+
+    for (; n > 32; )
+    {
+        n -= 32;
+
+        _mm256_store_si256((__m256i*)(dp + n), _mm256_loadu_si256((const __m256i*)(sp + n)));
+    }
+
+    _mm256_storeu_si256((__m256i*)(dp + len - 32), tail);
+    _mm256_storeu_si256((__m256i*)dp,              head);
+    _mm256_zeroupper();
+}
+
+//--------------------------------------------------------------------------
+// Dispatch
+//--------------------------------------------------------------------------
+
+static int             mem_impl          = MEM_UTILS_SSE2;
+static mem_fill_func_t mem_fill_impl     = mem_fill_sse2;
+static mem_copy_func_t mem_forward_impl  = mem_copy_forward_sse2;
+static mem_copy_func_t mem_backward_impl = mem_copy_backward_sse2;
+
+int mem_utils_select(int impl)
+{
+    int prev = mem_impl;
+
+    mem_impl = impl;
+
+    if (impl == MEM_UTILS_AVX)
+    {
+        mem_fill_impl     = mem_fill_avx;
+        mem_forward_impl  = mem_copy_forward_avx;
+        mem_backward_impl = mem_copy_backward_avx;
+    }
+    else
+    {
+        mem_fill_impl     = mem_fill_sse2;
+        mem_forward_impl  = mem_copy_forward_sse2;
+        mem_backward_impl = mem_copy_backward_sse2;
+    }
+
+    return prev;
+}
+
+static void mem_fill(uint8_t* dp, size_t len, __m128i pattern)
+{
+    if (len <= 32)
+    {
+        mem_fill_small(dp, len, pattern);
+    }
+    else
+    {
+        mem_fill_impl(dp, len, &pattern, len >= MEM_STREAM_THRESHOLD);
+    }
+}
+
+void mem_set(void *dest, size_t len, uint8_t value)
+{
+    mem_fill((uint8_t*)dest, len, _mm_set1_epi8((char)value));
+}
+
+void mem_set8(uint8_t *dp, size_t len, uint8_t value)
+{
+    mem_fill(dp, len, _mm_set1_epi8((char)value));
+}
+
+void mem_set16(uint16_t *dp, size_t len, uint16_t value)
 {
-    uint32_t tlen = len;
+    // Pattern should start at element boundary
+    if ((uintptr_t)dp & 1)
+    {
+        for (; len; --len) *dp++ = value;
+
+        return;
+    }
+
+    mem_fill((uint8_t*)dp, len * sizeof(uint16_t), _mm_set1_epi16((short)value));
+}
+
+void mem_set32(uint32_t *dp, size_t len, uint32_t value)
+{
+    if ((uintptr_t)dp & 3)
+    {
+        for (; len; --len) *dp++ = value;
+
+        return;
+    }
 
-    if (tlen == 0) return;
+    mem_fill((uint8_t*)dp, len * sizeof(uint32_t), _mm_set1_epi32((int)value));
+}
 
-    //  Determine if we need to copy forward or backward (overlap)
-    if (dp < sp) {
-        //  Copy forward.
-       do { *dp++ = *sp++; } while(--tlen);
-    } else {
-        //  Copy backwards,
+void mem_move(void *dest, const void *src, size_t len)
+{
+    uint8_t*       dp = (uint8_t*)dest;
+    const uint8_t* sp = (const uint8_t*)src;
 
-        //go to end of the memory to copy
-        sp += len;
-        dp += len;
+    if (dp == sp) return;
 
-        do { *--dp = *--sp; } while (--tlen);
+    if (len <= 32)
+    {
+        mem_copy_small(dp, sp, len);
     }
+    else if ((uintptr_t)dp - (uintptr_t)sp >= len)
+    {
+        // Destination is below source or ranges do not overlap at all
+        int stream = len >= MEM_STREAM_THRESHOLD && (uintptr_t)sp - (uintptr_t)dp >= len;
+
+        mem_forward_impl(dp, sp, len, stream);
+    }
+    else
+    {
+        mem_backward_impl(dp, sp, len, 0);
+    }
+}
+
+void mem_move8(uint8_t *dp, const uint8_t *sp, size_t len)
+{
+    mem_move(dp, sp, len);
+}
 
+void mem_move16(uint16_t *dp, const uint16_t *sp, size_t len)
+{
+    mem_move(dp, sp, len * sizeof(uint16_t));
+}
+
+void mem_move32(uint32_t *dp, const uint32_t *sp, size_t len)
+{
+    mem_move(dp, sp, len * sizeof(uint32_t));
 }
 
 void mem_copy(void *dest, const void *src, size_t len)
@@ -127,15 +625,15 @@ void mem_copy(void *dest, const void *src, size_t len)
 
 void mem_copy8(uint8_t *dp, const uint8_t *sp, size_t len)
 {
-    mem_move8(dp, sp, len);
+    mem_move(dp, sp, len);
 }
 
 void mem_copy16(uint16_t *dp, const uint16_t *sp, size_t len)
 {
-    mem_move16(dp, dp, len);
+    mem_move(dp, sp, len * sizeof(uint16_t));
 }
 
 void mem_copy32(uint32_t *dp, const uint32_t *sp, size_t len)
 {
-    mem_move32(dp, sp, len);
+    mem_move(dp, sp, len * sizeof(uint32_t));
 }
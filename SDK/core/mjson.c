@@ -1,8 +1,17 @@
 /* Generated by re2c 0.13.6 on Sat Nov 09 13:49:31 2013 */
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#   define MJSON_USE_SSE2
+#   include <emmintrin.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   endif
+#endif
+
 #include "mjson.h"
 
 enum mjson_token_t
@@ -57,8 +66,23 @@ struct _mjson_entry_t
 #define TRUE  1
 #define FALSE 0
 
-typedef struct _mjson_parser_t  mjson_parser_t;
-typedef struct _mjson_entry_t   mjson_entry_t;
+struct _mjson_index_slot_t
+{
+    uint32_t hash;
+    uint32_t offset; // key offset from dictionary, 0 for empty slot
+};
+
+// Followed by (mask+1) slots
+struct _mjson_index_t
+{
+    mjson_element_t dictionary;
+    uint32_t        mask;
+    uint32_t        count;
+};
+
+typedef struct _mjson_parser_t      mjson_parser_t;
+typedef struct _mjson_entry_t       mjson_entry_t;
+typedef struct _mjson_index_slot_t  mjson_index_slot_t;
 
 static void* parsectx_allocate_output(mjson_parser_t* ctx, ptrdiff_t size);
 
@@ -67,7 +91,11 @@ static void parsectx_next_token    (mjson_parser_t* context);
 static int parse_value_list    (mjson_parser_t *context);
 static int parse_key_value_pair(mjson_parser_t *context, int stop_token);
 
+static size_t          element_size(mjson_element_t element);
 static mjson_element_t next_element(mjson_element_t element);
+static uint32_t        hash_key(const char* key, size_t len);
+
+static int simd_enabled = TRUE;
 
 int mjson_parse(const char *json_data, size_t json_data_size, void* storage_buf, size_t storage_buf_size, const mjson_entry_t** top_element)
 {
@@ -115,14 +143,85 @@ int mjson_parse(const char *json_data, size_t json_data_size, void* storage_buf,
     return 1;
 }
 
-mjson_element_t mjson_get_top_element(void* storage_buf, size_t storage_buf_size)
+mjson_element_t mjson_get_top_element(const void* storage_buf, size_t storage_buf_size)
 {
-    mjson_element_t top = (mjson_element_t)storage_buf;
-    
-    RETURN_VAL_IF_FAIL(top, NULL);
+    const uint32_t* fourcc = (const uint32_t*)storage_buf;
+    mjson_element_t top;
+
+    RETURN_VAL_IF_FAIL(fourcc, NULL);
+    RETURN_VAL_IF_FAIL(storage_buf_size >= sizeof(uint32_t) + sizeof(mjson_entry_t), NULL);
+    RETURN_VAL_IF_FAIL(*fourcc == '23JB', NULL);
+
+    top = (mjson_element_t)(fourcc + 1);
+
     RETURN_VAL_IF_FAIL(top->id == MJSON_ID_DICT32 || top->id == MJSON_ID_ARRAY32, NULL);
-    RETURN_VAL_IF_FAIL(top->val_u32 <= storage_buf_size, NULL);
-    
+    RETURN_VAL_IF_FAIL(top->val_u32 <= storage_buf_size - sizeof(uint32_t) - sizeof(mjson_entry_t), NULL);
+
+    return top;
+}
+
+size_t mjson_get_storage_size(mjson_element_t top_element)
+{
+    RETURN_VAL_IF_FAIL(top_element, 0);
+
+    return sizeof(uint32_t) + element_size(top_element);
+}
+
+// FNV-1a over 32 bit words, storage is always 4 byte aligned and padded
+uint32_t mjson_hash(const void* data, size_t size)
+{
+    const uint8_t* ptr  = (const uint8_t*)data;
+    uint32_t       hash = 2166136261u;
+    uint32_t       word;
+
+    for (; size >= sizeof(uint32_t); size -= sizeof(uint32_t), ptr += sizeof(uint32_t))
+    {
+        memcpy(&word, ptr, sizeof(uint32_t));
+        hash = (hash ^ word) * 16777619u;
+    }
+
+    while (size--)
+        hash = (hash ^ *ptr++) * 16777619u;
+
+    return hash;
+}
+
+void mjson_blob_init_header(mjson_blob_header_t* header, mjson_element_t top_element,
+                            const char* json_data, size_t json_data_size, uint64_t source_time)
+{
+    const uint32_t* storage = (const uint32_t*)top_element - 1;
+
+    assert(header);
+    assert(top_element);
+
+    header->magic        = MJSON_BLOB_MAGIC;
+    header->version      = MJSON_BLOB_VERSION;
+    header->storage_size = (uint32_t)mjson_get_storage_size(top_element);
+    header->storage_hash = mjson_hash(storage, header->storage_size);
+    header->source_size  = (uint32_t)json_data_size;
+    header->source_hash  = mjson_hash(json_data, json_data_size);
+    header->source_time  = source_time;
+}
+
+mjson_element_t mjson_blob_get_top_element(const void* blob, size_t blob_size, int check_hash)
+{
+    const mjson_blob_header_t* header  = (const mjson_blob_header_t*)blob;
+    const uint8_t*             storage = (const uint8_t*)(header + 1);
+    mjson_element_t            top;
+
+    RETURN_VAL_IF_FAIL(header, NULL);
+    RETURN_VAL_IF_FAIL(((uintptr_t)header & 3) == 0, NULL);
+    RETURN_VAL_IF_FAIL(blob_size >= sizeof(mjson_blob_header_t), NULL);
+    RETURN_VAL_IF_FAIL(header->magic == MJSON_BLOB_MAGIC, NULL);
+    RETURN_VAL_IF_FAIL(header->version == MJSON_BLOB_VERSION, NULL);
+    RETURN_VAL_IF_FAIL(header->storage_size <= blob_size - sizeof(mjson_blob_header_t), NULL);
+
+    top = mjson_get_top_element(storage, header->storage_size);
+
+    RETURN_VAL_IF_FAIL(top, NULL);
+    RETURN_VAL_IF_FAIL(mjson_get_storage_size(top) == header->storage_size, NULL);
+    RETURN_VAL_IF_FAIL(!check_hash || mjson_hash(storage, header->storage_size) == header->storage_hash, NULL);
+
     return top;
 }
 
@@ -165,6 +264,7 @@ mjson_element_t mjson_get_member_first(mjson_element_t dictionary, mjson_element
 {
     RETURN_VAL_IF_FAIL(dictionary, NULL);
     RETURN_VAL_IF_FAIL(dictionary->id == MJSON_ID_DICT32, NULL);
+    RETURN_VAL_IF_FAIL(dictionary->val_u32 > 0, NULL);
     RETURN_VAL_IF_FAIL((dictionary+1)->id == MJSON_ID_UTF8_KEY32, NULL);
     
     *value = next_element(dictionary+1);
@@ -196,13 +296,116 @@ mjson_element_t mjson_get_member_next(mjson_element_t dictionary, mjson_element_
 
 mjson_element_t mjson_get_member(mjson_element_t dictionary, const char* name)
 {
-    mjson_element_t key, result;
-    
+    mjson_element_t key, result = NULL;
+    size_t          len;
+
+    RETURN_VAL_IF_FAIL(name, NULL);
+
+    len = strlen(name);
     key = mjson_get_member_first(dictionary, &result);
-    while (key && strncmp(name, (char*)(key+1), key->val_u32) != 0)
-        result = mjson_get_member_next(dictionary, key, &result);
-    
-    return result;
+    while (key && (key->val_u32 != len || memcmp(name, key+1, len) != 0))
+        key = mjson_get_member_next(dictionary, key, &result);
+
+    return key ? result : NULL;
+}
+
+size_t mjson_index_size(mjson_element_t dictionary)
+{
+    mjson_element_t key, value;
+    uint32_t        count = 0, capacity = 2;
+
+    RETURN_VAL_IF_FAIL(dictionary, 0);
+    RETURN_VAL_IF_FAIL(dictionary->id == MJSON_ID_DICT32, 0);
+
+    for (key = mjson_get_member_first(dictionary, &value); key; key = mjson_get_member_next(dictionary, key, &value))
+        ++count;
+
+    // Keep load factor at most 1/2 so probe sequences stay short
+    while (capacity < count * 2)
+        capacity *= 2;
+
+    return sizeof(struct _mjson_index_t) + capacity * sizeof(mjson_index_slot_t);
+}
+
+mjson_index_t mjson_index_build(mjson_element_t dictionary, void* storage_buf, size_t storage_buf_size)
+{
+    struct _mjson_index_t* index = (struct _mjson_index_t*)storage_buf;
+    mjson_index_slot_t*    slots;
+    mjson_element_t        key, value, other;
+    size_t                 size;
+    uint32_t               hash, i;
+
+    size = mjson_index_size(dictionary);
+
+    RETURN_VAL_IF_FAIL(size > 0, NULL);
+    RETURN_VAL_IF_FAIL(index, NULL);
+    RETURN_VAL_IF_FAIL(((uintptr_t)index & 3) == 0, NULL);
+    RETURN_VAL_IF_FAIL(size <= storage_buf_size, NULL);
+
+    slots = (mjson_index_slot_t*)(index + 1);
+
+    index->dictionary = dictionary;
+    index->mask       = (uint32_t)((size - sizeof(struct _mjson_index_t)) / sizeof(mjson_index_slot_t)) - 1;
+    index->count      = 0;
+
+    memset(slots, 0, (index->mask + 1) * sizeof(mjson_index_slot_t));
+
+    for (key = mjson_get_member_first(dictionary, &value); key; key = mjson_get_member_next(dictionary, key, &value))
+    {
+        hash = hash_key((const char*)(key+1), key->val_u32);
+
+        // Duplicate keys: first one wins, same as in mjson_get_member
+        for (i = hash & index->mask; slots[i].offset; i = (i + 1) & index->mask)
+        {
+            other = (mjson_element_t)((const uint8_t*)dictionary + slots[i].offset);
+
+            if (slots[i].hash == hash && other->val_u32 == key->val_u32 && memcmp(other+1, key+1, key->val_u32) == 0)
+                break;
+        }
+
+        if (slots[i].offset)
+            continue;
+
+        slots[i].hash   = hash;
+        slots[i].offset = (uint32_t)((const uint8_t*)key - (const uint8_t*)dictionary);
+        ++index->count;
+    }
+
+    return index;
+}
+
+mjson_element_t mjson_index_get_member(mjson_index_t index, const char* name)
+{
+    const mjson_index_slot_t* slots;
+    mjson_element_t           key;
+    size_t                    len;
+    uint32_t                  hash, i;
+
+    RETURN_VAL_IF_FAIL(index, NULL);
+    RETURN_VAL_IF_FAIL(name, NULL);
+
+    len   = strlen(name);
+    hash  = hash_key(name, len);
+    slots = (const mjson_index_slot_t*)(index + 1);
+
+    for (i = hash & index->mask; slots[i].offset; i = (i + 1) & index->mask)
+    {
+        key = (mjson_element_t)((const uint8_t*)index->dictionary + slots[i].offset);
+
+        if (slots[i].hash == hash && key->val_u32 == len && memcmp(key+1, name, len) == 0)
+            return next_element(key);
+    }
+
+    return NULL;
+}
+
+int mjson_enable_simd(int enable)
+{
+    int prev = simd_enabled;
+
+    simd_enabled = enable;
+
+    return prev;
 }
 
 int mjson_get_type(mjson_element_t element)
@@ -299,6 +502,17 @@ static mjson_element_t next_element(mjson_element_t element)
     return (mjson_element_t)((uint8_t*)element + size);
 }
 
+// FNV-1a
+static uint32_t hash_key(const char* key, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    while (len--)
+        hash = (hash ^ (uint8_t)*key++) * 16777619u;
+
+    return hash;
+}
+
 static void* parsectx_reserve_output(mjson_parser_t* ctx, ptrdiff_t size)
 {
     return (ctx->bjson_limit - ctx->bjson < size) ? 0 : ctx->bjson;
@@ -371,6 +585,109 @@ static void unicode_cp_to_utf8(uint32_t uni_cp, uint8_t* utf8char/*[6]*/, size_t
     utf8char[0] = uni_cp | first;
 }
 
+static uint32_t hex_digit_value(uint8_t ch)
+{
+    if (ch <= '9') return ch - '0';
+    if (ch <= 'F') return ch - 'A' + 10;
+
+    return ch - 'a' + 10;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// SIMD scanning
+/////////////////////////////////////////////////////////////////////////////
+
+#ifdef MJSON_USE_SSE2
+
+static uint32_t first_set_bit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+
+    _BitScanForward(&index, mask);
+
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+#endif
+
+static int is_whitespace(uint8_t ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+// Returns first non whitespace character or end of input
+static uint8_t* scan_whitespace(uint8_t* c, uint8_t* e)
+{
+#ifdef MJSON_USE_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    const __m128i lf    = _mm_set1_epi8('\n');
+    const __m128i cr    = _mm_set1_epi8('\r');
+
+    __m128i  chunk, ws;
+    uint32_t mask;
+#endif
+
+    // Tokens are usually separated by single space or not separated at all
+    if (c < e && !is_whitespace(*c)) return c;
+    if (c+1 < e && !is_whitespace(c[1])) return c+1;
+
+#ifdef MJSON_USE_SSE2
+    while (e - c >= 16)
+    {
+        chunk = _mm_loadu_si128((const __m128i*)c);
+        ws    = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, lf),    _mm_cmpeq_epi8(chunk, cr))
+        );
+        mask  = ~_mm_movemask_epi8(ws) & 0xFFFF;
+
+        if (mask) return c + first_set_bit(mask);
+
+        c += 16;
+    }
+#endif
+
+    while (c < e && is_whitespace(*c)) ++c;
+
+    return c;
+}
+
+// Returns first quote, backslash, zero character or end of input
+static uint8_t* scan_string(uint8_t* c, uint8_t* e)
+{
+#ifdef MJSON_USE_SSE2
+    const __m128i quote     = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero      = _mm_setzero_si128();
+
+    __m128i  chunk, stop;
+    uint32_t mask;
+
+    while (e - c >= 16)
+    {
+        chunk = _mm_loadu_si128((const __m128i*)c);
+        stop  = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(chunk, zero)
+        );
+        mask  = _mm_movemask_epi8(stop);
+
+        if (mask) return c + first_set_bit(mask);
+
+        c += 16;
+    }
+#endif
+
+    while (c < e && *c != '"' && *c != '\\' && *c != 0) ++c;
+
+    return c;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Lexer+Parser code
 /////////////////////////////////////////////////////////////////////////////
@@ -395,6 +712,40 @@ static void parsectx_next_token(mjson_parser_t* context)
 
     while (TRUE)
     {
+        // Fast path for whitespace, structural characters and strings without escapes,
+        // everything else(comments, numbers, identifiers, escaped strings) goes through re2c lexer
+        if (simd_enabled)
+        {
+            c = scan_whitespace(c, e);
+            s = c;
+
+            if (c < e)
+            {
+                switch (*c)
+                {
+                    case '{': ++c; token = TOK_LEFT_CURLY_BRACKET;  goto done;
+                    case '}': ++c; token = TOK_RIGHT_CURLY_BRACKET; goto done;
+                    case '[': ++c; token = TOK_LEFT_BRACKET;        goto done;
+                    case ']': ++c; token = TOK_RIGHT_BRACKET;       goto done;
+                    case ':': ++c; token = TOK_COLON;               goto done;
+                    case '=': ++c; token = TOK_EQUAL;               goto done;
+                    case ',': ++c; token = TOK_COMMA;               goto done;
+                    case '"':
+                        m = scan_string(c+1, e);
+
+                        if (m < e && *m == '"')
+                        {
+                            c     = m + 1;
+                            token = TOK_NOESC_STRING;
+                            goto done;
+                        }
+
+                        m = NULL;
+                        break;
+                }
+            }
+        }
+
         s = c;
 
 
@@ -1336,41 +1687,37 @@ done:
 
 static int parse_number(mjson_parser_t *context)
 {
-    int            num_parsed;
-    uint8_t        bjson_id;
-    const char*    format;
+    const char*    str = (const char*)context->start;
     mjson_entry_t* bdata;
 
+    bdata = (mjson_entry_t*)parsectx_allocate_output(context, (ptrdiff_t)sizeof(mjson_entry_t));
+
+    if (!bdata) return 0;
+
+    // sscanf is not used here: it measures length of the whole remaining input on every call
     switch(context->token)
     {
         case TOK_OCT_NUMBER:
-            bjson_id = MJSON_ID_SINT32;
-            format   = "%o";
+            bdata->id      = MJSON_ID_SINT32;
+            bdata->val_u32 = (uint32_t)strtoul(str, NULL, 8);
             break;
         case TOK_HEX_NUMBER:
-            bjson_id = MJSON_ID_SINT32;
-            format   = "%x";
+            bdata->id      = MJSON_ID_SINT32;
+            bdata->val_u32 = (uint32_t)strtoul(str, NULL, 16);
             break;
         case TOK_DEC_NUMBER:
-            bjson_id = MJSON_ID_SINT32;
-            format   = "%d";
+            bdata->id      = MJSON_ID_SINT32;
+            bdata->val_s32 = (int32_t)strtol(str, NULL, 10);
             break;
         case TOK_FLOAT_NUMBER:
-            bjson_id = MJSON_ID_FLOAT32;
-            format   = "%f";
+            bdata->id      = MJSON_ID_FLOAT32;
+            bdata->val_f32 = (float)strtod(str, NULL);
             break;
         default:
             assert(!"unknown token");
+            return 0;
     }
 
-    bdata = (mjson_entry_t*)parsectx_allocate_output(context, (ptrdiff_t)sizeof(mjson_entry_t));
-
-    if (!bdata) return 0;
-
-    bdata->id = bjson_id;
-    num_parsed = sscanf((char*)context->start, format, &bdata->val_u32);
-    assert(num_parsed == 1);
-
     parsectx_next_token(context);
     return 1;
 }
@@ -1393,7 +1740,6 @@ static int parse_string(mjson_parser_t *context, uint32_t id)
     const uint8_t* str_src;
     ptrdiff_t      str_len;
     size_t         len;
-    int            num_parsed;
 
     assert(
         context->token == TOK_STRING       ||
@@ -1436,6 +1782,21 @@ static int parse_string(mjson_parser_t *context, uint32_t id)
 
     while (TRUE)
     {
+        if (simd_enabled)
+        {
+            s = scan_string(c, e);
+
+            if (s != c)
+            {
+                str_dst = (uint8_t*)parsectx_allocate_output(context, s - c);
+
+                if (!str_dst) return 0;
+
+                memcpy(str_dst, c, s - c);
+                c = s;
+            }
+        }
+
         s = c;
 
 
@@ -1593,8 +1954,8 @@ yy143:
 
                 if (!str_dst) return 0;
 
-                num_parsed = sscanf((char*)(s + 2), "%4x", &ch);
-                assert(num_parsed == 1);
+                ch = (hex_digit_value(s[2]) << 12) | (hex_digit_value(s[3]) << 8) |
+                     (hex_digit_value(s[4]) << 4)  |  hex_digit_value(s[5]);
                 unicode_cp_to_utf8(ch, str_dst, &len);
 
                 parsectx_advance_output(context, len);
@@ -1,4 +1,5 @@
 #include <core/core.h>
+#include <immintrin.h>
 
 namespace ml
 {
@@ -657,6 +658,371 @@ namespace ml
 
         return nout?(allin?IT_INSIDE:IT_INTERSECT):IT_OUTSIDE;
     }
+
+    void extractFrustumPlanes(frustum_planes* planes, const mat4x4* frustum)
+    {
+        // Matrix columns are stored in r0-r3, clip space point is x*r0 + y*r1 + z*r2 + r3,
+        // planes are w+x>=0, w-x>=0, w+y>=0, w-y>=0, w+z>=0, w-z>=0
+        v128 m[4] = {frustum->r0, frustum->r1, frustum->r2, frustum->r3};
+        v128 rows[4];
+
+        transpose_mat4(rows, m);
+
+        v128 p[6];
+
+        p[0] = vi_add(rows[3], rows[0]);
+        p[1] = vi_sub(rows[3], rows[0]);
+        p[2] = vi_add(rows[3], rows[1]);
+        p[3] = vi_sub(rows[3], rows[1]);
+        p[4] = vi_add(rows[3], rows[2]);
+        p[5] = vi_sub(rows[3], rows[2]);
+
+        for (int i = 0; i < 6; ++i)
+        {
+            v128 n = vi_div(p[i], vi_sqrt(vi_set_all(vi_dot3(p[i], p[i]))));
+
+            planes->nx[i] = vi_swizzle<0, 0, 0, 0>(n);
+            planes->ny[i] = vi_swizzle<1, 1, 1, 1>(n);
+            planes->nz[i] = vi_swizzle<2, 2, 2, 2>(n);
+            planes->d [i] = vi_swizzle<3, 3, 3, 3>(n);
+        }
+    }
+
+    void intersectionTestSOA4(int result[4], const frustum_planes* planes,
+                              v128 minX, v128 minY, v128 minZ,
+                              v128 maxX, v128 maxY, v128 maxZ)
+    {
+        v128 half = vi_set_all(0.5f);
+
+        v128 cx = vi_mul(vi_add(minX, maxX), half);
+        v128 cy = vi_mul(vi_add(minY, maxY), half);
+        v128 cz = vi_mul(vi_add(minZ, maxZ), half);
+        v128 ex = vi_mul(vi_sub(maxX, minX), half);
+        v128 ey = vi_mul(vi_sub(maxY, minY), half);
+        v128 ez = vi_mul(vi_sub(maxZ, minZ), half);
+
+        v128 outside   = vi_set_zero();
+        v128 intersect = vi_set_zero();
+
+        for (int i = 0; i < 6; ++i)
+        {
+            // Signed distance of box center and projected box radius
+            v128 dist = vi_mad(cx, planes->nx[i], vi_mad(cy, planes->ny[i], vi_mad(cz, planes->nz[i], planes->d[i])));
+            v128 rad  = vi_mad(ex, vi_abs(planes->nx[i]), vi_mad(ey, vi_abs(planes->ny[i]), vi_mul(ez, vi_abs(planes->nz[i]))));
+
+            outside   = vi_or(outside,   vi_cmp_lt(vi_add(dist, rad), vi_set_zero()));
+            intersect = vi_or(intersect, vi_cmp_lt(vi_sub(dist, rad), vi_set_zero()));
+        }
+
+        int outMask   = vi_mask(outside);
+        int crossMask = vi_mask(intersect);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            result[i] = (outMask&(1<<i)) ? IT_OUTSIDE : (crossMask&(1<<i)) ? IT_INTERSECT : IT_INSIDE;
+        }
+    }
+
+    // Appends base+i for every set bit i of mask, branch free
+    static inline size_t appendVisible(uint32_t* visible, size_t numVisible, uint32_t base, uint32_t mask, uint32_t width)
+    {
+        for (uint32_t i = 0; i < width; ++i)
+        {
+            visible[numVisible] = base + i;
+            numVisible += (mask >> i) & 1;
+        }
+
+        return numVisible;
+    }
+
+    // Copies tail of component arrays into zero padded buffer of width elements
+    static inline void loadTail(float* dst, const float* src, size_t count, size_t width)
+    {
+        for (size_t i = 0; i < width; ++i)
+        {
+            dst[i] = i < count ? src[i] : 0.0f;
+        }
+    }
+
+    static __forceinline v128 outsideAABB4(const frustum_planes* planes, v128 minX, v128 minY, v128 minZ, v128 maxX, v128 maxY, v128 maxZ)
+    {
+        v128 half = vi_set_all(0.5f);
+
+        v128 cx = vi_mul(vi_add(minX, maxX), half);
+        v128 cy = vi_mul(vi_add(minY, maxY), half);
+        v128 cz = vi_mul(vi_add(minZ, maxZ), half);
+        v128 ex = vi_mul(vi_sub(maxX, minX), half);
+        v128 ey = vi_mul(vi_sub(maxY, minY), half);
+        v128 ez = vi_mul(vi_sub(maxZ, minZ), half);
+
+        v128 outside = vi_set_zero();
+
+        for (int i = 0; i < 6; ++i)
+        {
+            v128 dist = vi_mad(cx, planes->nx[i], vi_mad(cy, planes->ny[i], vi_mad(cz, planes->nz[i], planes->d[i])));
+            v128 rad  = vi_mad(ex, vi_abs(planes->nx[i]), vi_mad(ey, vi_abs(planes->ny[i]), vi_mul(ez, vi_abs(planes->nz[i]))));
+
+            outside = vi_or(outside, vi_cmp_lt(vi_add(dist, rad), vi_set_zero()));
+        }
+
+        return outside;
+    }
+
+    static __forceinline v128 outsideSphere4(const frustum_planes* planes, v128 x, v128 y, v128 z, v128 r)
+    {
+        v128 outside = vi_set_zero();
+        v128 negR    = vi_neg(r);
+
+        for (int i = 0; i < 6; ++i)
+        {
+            v128 dist = vi_mad(x, planes->nx[i], vi_mad(y, planes->ny[i], vi_mad(z, planes->nz[i], planes->d[i])));
+
+            outside = vi_or(outside, vi_cmp_lt(dist, negR));
+        }
+
+        return outside;
+    }
+
+    static size_t cullAABBsSSE(uint32_t* visible, const frustum_planes* planes, size_t count,
+                               const float* minX, const float* minY, const float* minZ,
+                               const float* maxX, const float* maxY, const float* maxZ)
+    {
+        size_t numVisible = 0;
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+        {
+            v128 outside = outsideAABB4(
+                planes,
+                vi_loadu_v4(minX + i), vi_loadu_v4(minY + i), vi_loadu_v4(minZ + i),
+                vi_loadu_v4(maxX + i), vi_loadu_v4(maxY + i), vi_loadu_v4(maxZ + i)
+            );
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~vi_mask(outside) & 0xF, 4);
+        }
+
+        if (i < count)
+        {
+            size_t tail = count - i;
+            float  bounds[6][4];
+
+            loadTail(bounds[0], minX + i, tail, 4);
+            loadTail(bounds[1], minY + i, tail, 4);
+            loadTail(bounds[2], minZ + i, tail, 4);
+            loadTail(bounds[3], maxX + i, tail, 4);
+            loadTail(bounds[4], maxY + i, tail, 4);
+            loadTail(bounds[5], maxZ + i, tail, 4);
+
+            v128 outside = outsideAABB4(
+                planes,
+                vi_loadu_v4(bounds[0]), vi_loadu_v4(bounds[1]), vi_loadu_v4(bounds[2]),
+                vi_loadu_v4(bounds[3]), vi_loadu_v4(bounds[4]), vi_loadu_v4(bounds[5])
+            );
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~vi_mask(outside) & ((1 << tail) - 1), (uint32_t)tail);
+        }
+
+        return numVisible;
+    }
+
+    static size_t cullSpheresSSE(uint32_t* visible, const frustum_planes* planes, size_t count,
+                                 const float* x, const float* y, const float* z, const float* radius)
+    {
+        size_t numVisible = 0;
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+        {
+            v128 outside = outsideSphere4(planes, vi_loadu_v4(x + i), vi_loadu_v4(y + i), vi_loadu_v4(z + i), vi_loadu_v4(radius + i));
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~vi_mask(outside) & 0xF, 4);
+        }
+
+        if (i < count)
+        {
+            size_t tail = count - i;
+            float  spheres[4][4];
+
+            loadTail(spheres[0], x      + i, tail, 4);
+            loadTail(spheres[1], y      + i, tail, 4);
+            loadTail(spheres[2], z      + i, tail, 4);
+            loadTail(spheres[3], radius + i, tail, 4);
+
+            v128 outside = outsideSphere4(planes, vi_loadu_v4(spheres[0]), vi_loadu_v4(spheres[1]), vi_loadu_v4(spheres[2]), vi_loadu_v4(spheres[3]));
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~vi_mask(outside) & ((1 << tail) - 1), (uint32_t)tail);
+        }
+
+        return numVisible;
+    }
+
+    // 8 wide AVX versions, planes are broadcasted to 256 bit registers once per call
+    struct frustum_planes_avx
+    {
+        __m256 nx[6], ny[6], nz[6], d[6];
+        __m256 ax[6], ay[6], az[6];
+    };
+
+    static void loadPlanesAVX(frustum_planes_avx* dst, const frustum_planes* planes)
+    {
+        for (int i = 0; i < 6; ++i)
+        {
+            dst->nx[i] = _mm256_set1_ps(vi_get_x(planes->nx[i]));
+            dst->ny[i] = _mm256_set1_ps(vi_get_x(planes->ny[i]));
+            dst->nz[i] = _mm256_set1_ps(vi_get_x(planes->nz[i]));
+            dst->d [i] = _mm256_set1_ps(vi_get_x(planes->d [i]));
+            dst->ax[i] = _mm256_set1_ps(vi_get_x(vi_abs(planes->nx[i])));
+            dst->ay[i] = _mm256_set1_ps(vi_get_x(vi_abs(planes->ny[i])));
+            dst->az[i] = _mm256_set1_ps(vi_get_x(vi_abs(planes->nz[i])));
+        }
+    }
+
+    static __forceinline int outsideAABB8(const frustum_planes_avx* planes, const float* minX, const float* minY, const float* minZ,
+                                          const float* maxX, const float* maxY, const float* maxZ)
+    {
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 zero = _mm256_setzero_ps();
+
+        __m256 bminX = _mm256_loadu_ps(minX), bmaxX = _mm256_loadu_ps(maxX);
+        __m256 bminY = _mm256_loadu_ps(minY), bmaxY = _mm256_loadu_ps(maxY);
+        __m256 bminZ = _mm256_loadu_ps(minZ), bmaxZ = _mm256_loadu_ps(maxZ);
+
+        __m256 cx = _mm256_mul_ps(_mm256_add_ps(bminX, bmaxX), half);
+        __m256 cy = _mm256_mul_ps(_mm256_add_ps(bminY, bmaxY), half);
+        __m256 cz = _mm256_mul_ps(_mm256_add_ps(bminZ, bmaxZ), half);
+        __m256 ex = _mm256_mul_ps(_mm256_sub_ps(bmaxX, bminX), half);
+        __m256 ey = _mm256_mul_ps(_mm256_sub_ps(bmaxY, bminY), half);
+        __m256 ez = _mm256_mul_ps(_mm256_sub_ps(bmaxZ, bminZ), half);
+
+        __m256 outside = zero;
+
+        for (int i = 0; i < 6; ++i)
+        {
+            // Same operation order as SSE version, so both paths produce identical results
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(cz, planes->nz[i]), planes->d[i]);
+            dist = _mm256_add_ps(_mm256_mul_ps(cy, planes->ny[i]), dist);
+            dist = _mm256_add_ps(_mm256_mul_ps(cx, planes->nx[i]), dist);
+
+            __m256 rad = _mm256_mul_ps(ez, planes->az[i]);
+            rad = _mm256_add_ps(_mm256_mul_ps(ey, planes->ay[i]), rad);
+            rad = _mm256_add_ps(_mm256_mul_ps(ex, planes->ax[i]), rad);
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(dist, rad), zero, _CMP_LT_OQ));
+        }
+
+        return _mm256_movemask_ps(outside);
+    }
+
+    static __forceinline int outsideSphere8(const frustum_planes_avx* planes, const float* x, const float* y, const float* z, const float* radius)
+    {
+        __m256 cx   = _mm256_loadu_ps(x);
+        __m256 cy   = _mm256_loadu_ps(y);
+        __m256 cz   = _mm256_loadu_ps(z);
+        __m256 negR = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius));
+
+        __m256 outside = _mm256_setzero_ps();
+
+        for (int i = 0; i < 6; ++i)
+        {
+            __m256 dist = _mm256_add_ps(_mm256_mul_ps(cz, planes->nz[i]), planes->d[i]);
+            dist = _mm256_add_ps(_mm256_mul_ps(cy, planes->ny[i]), dist);
+            dist = _mm256_add_ps(_mm256_mul_ps(cx, planes->nx[i]), dist);
+
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, negR, _CMP_LT_OQ));
+        }
+
+        return _mm256_movemask_ps(outside);
+    }
+
+    static size_t cullAABBsAVX(uint32_t* visible, const frustum_planes* planes, size_t count,
+                               const float* minX, const float* minY, const float* minZ,
+                               const float* maxX, const float* maxY, const float* maxZ)
+    {
+        CORE_ALIGN(32) frustum_planes_avx planes8;
+        loadPlanesAVX(&planes8, planes);
+
+        size_t numVisible = 0;
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            int outside = outsideAABB8(&planes8, minX + i, minY + i, minZ + i, maxX + i, maxY + i, maxZ + i);
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~outside & 0xFF, 8);
+        }
+
+        if (i < count)
+        {
+            size_t tail = count - i;
+            float  bounds[6][8];
+
+            loadTail(bounds[0], minX + i, tail, 8);
+            loadTail(bounds[1], minY + i, tail, 8);
+            loadTail(bounds[2], minZ + i, tail, 8);
+            loadTail(bounds[3], maxX + i, tail, 8);
+            loadTail(bounds[4], maxY + i, tail, 8);
+            loadTail(bounds[5], maxZ + i, tail, 8);
+
+            int outside = outsideAABB8(&planes8, bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~outside & ((1 << tail) - 1), (uint32_t)tail);
+        }
+
+        _mm256_zeroupper();
+
+        return numVisible;
+    }
+
+    static size_t cullSpheresAVX(uint32_t* visible, const frustum_planes* planes, size_t count,
+                                 const float* x, const float* y, const float* z, const float* radius)
+    {
+        CORE_ALIGN(32) frustum_planes_avx planes8;
+        loadPlanesAVX(&planes8, planes);
+
+        size_t numVisible = 0;
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8)
+        {
+            int outside = outsideSphere8(&planes8, x + i, y + i, z + i, radius + i);
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~outside & 0xFF, 8);
+        }
+
+        if (i < count)
+        {
+            size_t tail = count - i;
+            float  spheres[4][8];
+
+            loadTail(spheres[0], x      + i, tail, 8);
+            loadTail(spheres[1], y      + i, tail, 8);
+            loadTail(spheres[2], z      + i, tail, 8);
+            loadTail(spheres[3], radius + i, tail, 8);
+
+            int outside = outsideSphere8(&planes8, spheres[0], spheres[1], spheres[2], spheres[3]);
+            numVisible = appendVisible(visible, numVisible, (uint32_t)i, ~outside & ((1 << tail) - 1), (uint32_t)tail);
+        }
+
+        _mm256_zeroupper();
+
+        return numVisible;
+    }
+
+    size_t cullAABBs(uint32_t* visible, const frustum_planes* planes, size_t count,
+                     const float* minX, const float* minY, const float* minZ,
+                     const float* maxX, const float* maxY, const float* maxZ)
+    {
+        if (core::cpu_features() & core::CPU_FEATURE_AVX)
+        {
+            return cullAABBsAVX(visible, planes, count, minX, minY, minZ, maxX, maxY, maxZ);
+        }
+
+        return cullAABBsSSE(visible, planes, count, minX, minY, minZ, maxX, maxY, maxZ);
+    }
+
+    size_t cullSpheres(uint32_t* visible, const frustum_planes* planes, size_t count,
+                       const float* x, const float* y, const float* z, const float* radius)
+    {
+        if (core::cpu_features() & core::CPU_FEATURE_AVX)
+        {
+            return cullSpheresAVX(visible, planes, count, x, y, z, radius);
+        }
+
+        return cullSpheresSSE(visible, planes, count, x, y, z, radius);
+    }
 }
 
 #include <math.h>
@@ -684,6 +1050,11 @@ namespace ml
         return ::expf(x);
     }
 
+    float exp2 (float x)
+    {
+        return ::exp2f(x);
+    }
+
     float pow  (float x, float y)
     {
         return ::powf(x, y);
@@ -749,3 +1120,932 @@ namespace ml
         return ::atan2f(y, x);
     }
 }
+
+// Vector math functions
+//
+// Polynomials and argument reduction follow Cephes single precision library.
+// Kernels are written once over vi_wide.h traits, so scalar, SSE and AVX2 versions
+// do the same operations in the same order and give bitwise identical results.
+namespace ml
+{
+    static const float MATH_TWO_OVER_PI = 0.636619772367581343f;
+    static const float MATH_PIO4        = 0.785398163397448310f;
+    static const float MATH_PIO2        = 1.570796326794896619f;
+    static const float MATH_PI          = 3.141592653589793238f;
+    static const float MATH_TAN_PIO8    = 0.414213562373095049f;
+    static const float MATH_SQRTHF      = 0.707106781186547524f;
+    static const float MATH_LOG2E       = 1.442695040888963407f;
+    static const float MATH_LOG2EA      = 0.442695040888963407f; // log2(e) - 1
+
+    // pi/2 in 3 parts, q * part is exact for first 2 parts if |q| < 2^15
+    static const float SINCOS_PIO2_1 = 1.5703125f;
+    static const float SINCOS_PIO2_2 = 4.837512969970703125e-4f;
+    static const float SINCOS_PIO2_3 = 7.54978995489188216e-8f;
+
+    // sin(r) = r + r^3 * P(r^2), cos(r) = 1 - r^2/2 + r^4 * P(r^2), |r| <= pi/4
+    static const float SIN_P[3] = { -1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f };
+    static const float COS_P[3] = {  2.443315711809948e-5f, -1.388731625493765e-3f, 4.166664568298827e-2f };
+
+    // ln(2) in 2 parts
+    static const float EXP_C1 = 0.693359375f;
+    static const float EXP_C2 = -2.12194440e-4f;
+    // Inputs are clamped to range where result is not yet 0 or inf
+    static const float EXP_LO = -104.0f;
+    static const float EXP_HI = 88.72283935546875f;
+    // exp(r) = 1 + r + r^2 * P(r), |r| <= ln(2)/2
+    static const float EXP_P[6] = {
+        1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f,
+        4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f
+    };
+
+    static const float EXP2_LO = -151.0f;
+    static const float EXP2_HI = 128.0f;
+    // 2^r = 1 + r * P(r), |r| <= 0.5
+    static const float EXP2_P[6] = {
+        1.535336188319500e-4f, 1.339887440266574e-3f, 9.618437357674640e-3f,
+        5.550332471162809e-2f, 2.402264791363012e-1f, 6.931472028550421e-1f
+    };
+
+    // ln(1 + m) = m - m^2/2 + m^3 * P(m), sqrt(0.5) - 1 <= m <= sqrt(2) - 1
+    static const float LOG_P[9] = {
+         7.0376836292e-2f, -1.1514610310e-1f,  1.1676998740e-1f,
+        -1.2420140846e-1f,  1.4249322787e-1f, -1.6668057665e-1f,
+         2.0000714765e-1f, -2.4999993993e-1f,  3.3333331174e-1f
+    };
+
+    // atan(t) = t + t^3 * P(t^2), |t| <= tan(pi/8)
+    static const float ATAN_P[4] = { 8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f };
+
+    static const float FLT_MIN_NORMAL = 1.17549435e-38f;
+    static const float TWO_POW_23     = 8388608.0f;
+    static const float TWO_POW_24     = 16777216.0f;
+    static const float TWO_POW_12     = 4096.0f;
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Kernels, simd is one of vi_scalar_t, vi_sse41_t or vi_avx2_t
+    //------------------------------------------------------------------------------------------------------------------
+
+    // Horner scheme, unrolled at compile time, coef[0] is for the highest power
+    template <typename simd, int count>
+    struct horner
+    {
+        static __forceinline typename simd::vf eval(typename simd::vf x, const float* coef)
+        {
+            return simd::mad(horner<simd, count - 1>::eval(x, coef), x, simd::set(coef[count - 1]));
+        }
+    };
+
+    template <typename simd>
+    struct horner<simd, 1>
+    {
+        static __forceinline typename simd::vf eval(typename simd::vf x, const float* coef)
+        {
+            return simd::set(coef[0]);
+        }
+    };
+
+    // Degree 8 polynomial with Estrin scheme, dependency chain is half as long as Horner's
+    template <typename simd>
+    static __forceinline typename simd::vf polyEstrin9(typename simd::vf x, const float* c)
+    {
+        typedef typename simd::vf vf;
+
+        vf x2 = simd::mul(x, x);
+        vf x4 = simd::mul(x2, x2);
+        vf x8 = simd::mul(x4, x4);
+
+        vf p01 = simd::mad(simd::set(c[7]), x, simd::set(c[8]));
+        vf p23 = simd::mad(simd::set(c[5]), x, simd::set(c[6]));
+        vf p45 = simd::mad(simd::set(c[3]), x, simd::set(c[4]));
+        vf p67 = simd::mad(simd::set(c[1]), x, simd::set(c[2]));
+
+        vf p03 = simd::mad(p23, x2, p01);
+        vf p47 = simd::mad(p67, x2, p45);
+
+        return simd::add(simd::mad(p47, x4, p03), simd::mul(simd::set(c[0]), x8));
+    }
+
+    template <typename simd>
+    static __forceinline typename simd::vf isNaN(typename simd::vf x)
+    {
+        return simd::cmp_unord(x, x);
+    }
+
+    // x * 2^n, n in [-252, 254] is split in 2 halves so both scale factors are normal numbers
+    // and denormal results are rounded correctly
+    template <typename simd>
+    static __forceinline typename simd::vf scale(typename simd::vf x, typename simd::vi n)
+    {
+        typedef typename simd::vi vi;
+
+        vi bias = simd::iset(127);
+        vi n1   = simd::template isra<1>(n);
+        vi n2   = simd::isub(n, n1);
+
+        typename simd::vf s1 = simd::as_float(simd::template isll<23>(simd::iadd(n1, bias)));
+        typename simd::vf s2 = simd::as_float(simd::template isll<23>(simd::iadd(n2, bias)));
+
+        return simd::mul(simd::mul(x, s1), s2);
+    }
+
+    template <typename simd>
+    static __forceinline void sincosKernel(typename simd::vf* s, typename simd::vf* c, typename simd::vf x)
+    {
+        typedef typename simd::vf vf;
+        typedef typename simd::vi vi;
+
+        vi one = simd::iset(1);
+        vi two = simd::iset(2);
+
+        // Reduction is done for |x|, sine is odd so sign of x is applied to it at the end
+        vf ax = simd::abs(x);
+        vf q  = simd::round(simd::mul(ax, simd::set(MATH_TWO_OVER_PI)));
+        vi qi = simd::cvt_to_int(q);
+
+        vf r = simd::sub(ax, simd::mul(q, simd::set(SINCOS_PIO2_1)));
+        r = simd::sub(r, simd::mul(q, simd::set(SINCOS_PIO2_2)));
+        r = simd::sub(r, simd::mul(q, simd::set(SINCOS_PIO2_3)));
+
+        vf z  = simd::mul(r, r);
+        vf ps = simd::mad(simd::mul(horner<simd, 3>::eval(z, SIN_P), z), r, r);
+        vf pc = simd::mul(simd::mul(horner<simd, 3>::eval(z, COS_P), z), z);
+        pc = simd::sub(pc, simd::mul(z, simd::set(0.5f)));
+        pc = simd::add(pc, simd::set(1.0f));
+
+        // Odd quadrants swap sine and cosine, sine is negative in quadrants 2 and 3, cosine in 1 and 2
+        vf swap    = simd::as_float(simd::icmp_eq(simd::iand(qi, one), one));
+        vf sinSign = simd::as_float(simd::template isll<30>(simd::iand(qi, two)));
+        sinSign = simd::bit_xor(sinSign, simd::bit_and(x, simd::seti(VI_SIGN_MASK)));
+        vf cosSign = simd::as_float(simd::template isll<30>(simd::iand(simd::iadd(qi, one), two)));
+
+        *s = simd::bit_xor(simd::select(ps, pc, swap), sinSign);
+        *c = simd::bit_xor(simd::select(pc, ps, swap), cosSign);
+    }
+
+    // x = 2^e * (1 + m), y = ln(1 + m) - m
+    template <typename simd>
+    static __forceinline void logReduce(typename simd::vf* e, typename simd::vf* m, typename simd::vf* y, typename simd::vf x)
+    {
+        typedef typename simd::vf vf;
+        typedef typename simd::vi vi;
+
+        // Denormals are normalized first
+        vf small = simd::cmp_lt(x, simd::set(FLT_MIN_NORMAL));
+        x = simd::select(x, simd::mul(x, simd::set(TWO_POW_23)), small);
+
+        vi bits = simd::as_int(x);
+        vf ef   = simd::cvt_to_float(simd::isub(simd::template isrl<23>(bits), simd::iset(126)));
+        vf f    = simd::as_float(simd::ior(simd::iand(bits, simd::iset(0x007FFFFF)), simd::iset(0x3F000000)));
+
+        // f is in [0.5, 1), f < sqrt(0.5) is doubled to keep m around 0
+        vf lt = simd::cmp_lt(f, simd::set(MATH_SQRTHF));
+        ef = simd::sub(ef, simd::bit_and(small, simd::set(23.0f)));
+        ef = simd::sub(ef, simd::bit_and(lt, simd::set(1.0f)));
+        f  = simd::sub(simd::add(f, simd::bit_and(lt, f)), simd::set(1.0f));
+
+        vf z = simd::mul(f, f);
+        vf p = simd::mul(f, simd::mul(z, polyEstrin9<simd>(f, LOG_P)));
+
+        *e = ef;
+        *m = f;
+        *y = simd::sub(p, simd::mul(z, simd::set(0.5f)));
+    }
+
+    template <typename simd>
+    static __forceinline typename simd::vf logSpecial(typename simd::vf r, typename simd::vf x)
+    {
+        typename simd::vf zero = simd::zero();
+
+        r = simd::select(r, simd::seti((int)(VI_INF_AS_INT | VI_SIGN_MASK)), simd::cmp_eq(x, zero));
+        r = simd::select(r, x, simd::cmp_eq(x, simd::seti(VI_INF_AS_INT)));
+        r = simd::select(r, simd::seti(VI_QNAN_AS_INT), simd::cmp_lt(x, zero));
+
+        return simd::select(r, x, isNaN<simd>(x));
+    }
+
+    struct sin_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typename simd::vf s, c;
+            sincosKernel<simd>(&s, &c, x);
+            return s;
+        }
+    };
+
+    struct cos_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typename simd::vf s, c;
+            sincosKernel<simd>(&s, &c, x);
+            return c;
+        }
+    };
+
+    struct exp_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typedef typename simd::vf vf;
+
+            vf xc = simd::max(simd::min(x, simd::set(EXP_HI)), simd::set(EXP_LO));
+            vf n  = simd::round(simd::mul(xc, simd::set(MATH_LOG2E)));
+
+            vf r = simd::sub(xc, simd::mul(n, simd::set(EXP_C1)));
+            r = simd::sub(r, simd::mul(n, simd::set(EXP_C2)));
+
+            vf p = simd::mul(horner<simd, 6>::eval(r, EXP_P), simd::mul(r, r));
+            p = simd::add(simd::add(p, r), simd::set(1.0f));
+            p = scale<simd>(p, simd::cvt_to_int(n));
+
+            return simd::select(p, x, isNaN<simd>(x));
+        }
+    };
+
+    struct exp2_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typedef typename simd::vf vf;
+
+            vf xc = simd::max(simd::min(x, simd::set(EXP2_HI)), simd::set(EXP2_LO));
+            vf n  = simd::round(xc);
+            vf r  = simd::sub(xc, n);
+
+            vf p = simd::mad(horner<simd, 6>::eval(r, EXP2_P), r, simd::set(1.0f));
+            p = scale<simd>(p, simd::cvt_to_int(n));
+
+            return simd::select(p, x, isNaN<simd>(x));
+        }
+    };
+
+    struct ln_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typename simd::vf e, m, y;
+            logReduce<simd>(&e, &m, &y, x);
+
+            y = simd::mad(e, simd::set(EXP_C2), y);
+            typename simd::vf r = simd::mad(e, simd::set(EXP_C1), simd::add(m, y));
+
+            return logSpecial<simd>(r, x);
+        }
+    };
+
+    struct lg2_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typename simd::vf e, m, y;
+            logReduce<simd>(&e, &m, &y, x);
+
+            // log2(1 + m) = (m + y) * log2(e), multiplication by 1 is split out to keep precision
+            typename simd::vf r = simd::mul(y, simd::set(MATH_LOG2EA));
+            r = simd::mad(m, simd::set(MATH_LOG2EA), r);
+            r = simd::add(simd::add(simd::add(r, y), m), e);
+
+            return logSpecial<simd>(r, x);
+        }
+    };
+
+    struct pow_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x, typename simd::vf y)
+        {
+            typedef typename simd::vf vf;
+
+            vf r   = exp2_kernel::run<simd>(simd::mul(y, lg2_kernel::run<simd>(x)));
+            vf one = simd::set(1.0f);
+
+            return simd::select(r, one, simd::bit_or(simd::cmp_eq(y, simd::zero()), simd::cmp_eq(x, one)));
+        }
+    };
+
+    struct atan2_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf y, typename simd::vf x)
+        {
+            typedef typename simd::vf vf;
+
+            vf one = simd::set(1.0f);
+            vf ax  = simd::abs(x);
+            vf ay  = simd::abs(y);
+            vf mx  = simd::max(ax, ay);
+            vf mn  = simd::min(ax, ay);
+
+            // t = atan argument in [0, 1], 0/0 and inf/inf are resolved explicitly
+            vf t = simd::div(mn, mx);
+            t = simd::select(t, one, simd::cmp_eq(mn, mx));
+            t = simd::select(t, simd::zero(), simd::cmp_eq(mx, simd::zero()));
+
+            vf big = simd::cmp_gt(t, simd::set(MATH_TAN_PIO8));
+            t = simd::select(t, simd::div(simd::sub(t, one), simd::add(t, one)), big);
+
+            vf z = simd::mul(t, t);
+            vf r = simd::mad(simd::mul(horner<simd, 4>::eval(z, ATAN_P), z), t, t);
+            r = simd::add(r, simd::bit_and(big, simd::set(MATH_PIO4)));
+
+            r = simd::select(r, simd::sub(simd::set(MATH_PIO2), r), simd::cmp_gt(ay, ax));
+            // Sign of x selects left half plane, -0 included
+            r = simd::select(r, simd::sub(simd::set(MATH_PI), r), x);
+            r = simd::bit_xor(r, simd::bit_and(y, simd::seti(VI_SIGN_MASK)));
+
+            return simd::select(r, simd::add(x, y), simd::cmp_unord(x, y));
+        }
+    };
+
+    struct rsqrt_kernel
+    {
+        template <typename simd>
+        static __forceinline typename simd::vf run(typename simd::vf x)
+        {
+            typedef typename simd::vf vf;
+
+            // Estimate treats denormals as 0, they are scaled to normal range: rsqrt(x*2^24) * 2^12
+            vf small = simd::cmp_lt(x, simd::set(FLT_MIN_NORMAL));
+            x = simd::select(x, simd::mul(x, simd::set(TWO_POW_24)), small);
+
+            // Newton step in residual form: r = e + e/2 * (1 - x*e^2)
+            vf e = simd::rsqrt(x);
+            vf h = simd::sub(simd::set(1.0f), simd::mul(simd::mul(x, e), e));
+            vf r = simd::mad(simd::mul(simd::set(0.5f), e), h, e);
+
+            // Newton step gives NaN for 0 and inf, estimate is exact there
+            vf special = simd::bit_or(simd::cmp_eq(x, simd::zero()), simd::cmp_eq(x, simd::seti(VI_INF_AS_INT)));
+            r = simd::select(r, e, special);
+
+            return simd::select(r, simd::mul(r, simd::set(TWO_POW_12)), small);
+        }
+    };
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Array processing, tails are computed in zero padded temporary
+    //------------------------------------------------------------------------------------------------------------------
+    typedef void (*unary_array_t)  (float* dst, const float* src, size_t count);
+    typedef void (*binary_array_t) (float* dst, const float* a, const float* b, size_t count);
+    typedef void (*sincos_array_t) (float* s, float* c, const float* x, size_t count);
+
+    static inline void storeTail(float* dst, const float* src, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dst[i] = src[i];
+        }
+    }
+
+    template <typename simd, typename kernel>
+    static void unaryArrayWide(float* dst, const float* src, size_t count)
+    {
+        const size_t width = simd::width;
+        size_t       i     = 0;
+
+        for (; i + width <= count; i += width)
+        {
+            simd::store(dst + i, kernel::template run<simd>(simd::load(src + i)));
+        }
+
+        if (i < count)
+        {
+            float tmp[width];
+            loadTail(tmp, src + i, count - i, width);
+            simd::store(tmp, kernel::template run<simd>(simd::load(tmp)));
+            storeTail(dst + i, tmp, count - i);
+        }
+
+        simd::finish();
+    }
+
+    template <typename simd, typename kernel>
+    static void binaryArrayWide(float* dst, const float* a, const float* b, size_t count)
+    {
+        const size_t width = simd::width;
+        size_t       i     = 0;
+
+        for (; i + width <= count; i += width)
+        {
+            simd::store(dst + i, kernel::template run<simd>(simd::load(a + i), simd::load(b + i)));
+        }
+
+        if (i < count)
+        {
+            float tmp[2][width];
+            loadTail(tmp[0], a + i, count - i, width);
+            loadTail(tmp[1], b + i, count - i, width);
+            simd::store(tmp[0], kernel::template run<simd>(simd::load(tmp[0]), simd::load(tmp[1])));
+            storeTail(dst + i, tmp[0], count - i);
+        }
+
+        simd::finish();
+    }
+
+    template <typename simd>
+    static void sincosArrayWide(float* s, float* c, const float* x, size_t count)
+    {
+        typedef typename simd::vf vf;
+
+        const size_t width = simd::width;
+        size_t       i     = 0;
+
+        for (; i + width <= count; i += width)
+        {
+            vf vs, vc;
+            sincosKernel<simd>(&vs, &vc, simd::load(x + i));
+            simd::store(s + i, vs);
+            simd::store(c + i, vc);
+        }
+
+        if (i < count)
+        {
+            float tmp[2][width];
+            vf    vs, vc;
+            loadTail(tmp[0], x + i, count - i, width);
+            sincosKernel<simd>(&vs, &vc, simd::load(tmp[0]));
+            simd::store(tmp[0], vs);
+            simd::store(tmp[1], vc);
+            storeTail(s + i, tmp[0], count - i);
+            storeTail(c + i, tmp[1], count - i);
+        }
+
+        simd::finish();
+    }
+
+    template <typename kernel>
+    static void unaryArray(float* dst, const float* src, size_t count)
+    {
+        unary_array_t func = core::cpu_select<unary_array_t>(
+            unaryArrayWide<vi_scalar_t, kernel>,
+            unaryArrayWide<vi_sse41_t,  kernel>,
+            unaryArrayWide<vi_avx2_t,   kernel>
+        );
+
+        func(dst, src, count);
+    }
+
+    template <typename kernel>
+    static void binaryArray(float* dst, const float* a, const float* b, size_t count)
+    {
+        binary_array_t func = core::cpu_select<binary_array_t>(
+            binaryArrayWide<vi_scalar_t, kernel>,
+            binaryArrayWide<vi_sse41_t,  kernel>,
+            binaryArrayWide<vi_avx2_t,   kernel>
+        );
+
+        func(dst, a, b, count);
+    }
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Public interface
+    //------------------------------------------------------------------------------------------------------------------
+    v128 sin(v128 x)
+    {
+        return sin_kernel::run<vi_sse41_t>(x);
+    }
+
+    v128 cos(v128 x)
+    {
+        return cos_kernel::run<vi_sse41_t>(x);
+    }
+
+    void sincos(v128* s, v128* c, v128 x)
+    {
+        sincosKernel<vi_sse41_t>(s, c, x);
+    }
+
+    v128 exp(v128 x)
+    {
+        return exp_kernel::run<vi_sse41_t>(x);
+    }
+
+    v128 exp2(v128 x)
+    {
+        return exp2_kernel::run<vi_sse41_t>(x);
+    }
+
+    v128 ln(v128 x)
+    {
+        return ln_kernel::run<vi_sse41_t>(x);
+    }
+
+    v128 lg2(v128 x)
+    {
+        return lg2_kernel::run<vi_sse41_t>(x);
+    }
+
+    v128 pow(v128 x, v128 y)
+    {
+        return pow_kernel::run<vi_sse41_t>(x, y);
+    }
+
+    v128 atan2(v128 y, v128 x)
+    {
+        return atan2_kernel::run<vi_sse41_t>(y, x);
+    }
+
+    v128 rsqrt(v128 x)
+    {
+        return rsqrt_kernel::run<vi_sse41_t>(x);
+    }
+
+    void sinArray(float* dst, const float* x, size_t count)
+    {
+        unaryArray<sin_kernel>(dst, x, count);
+    }
+
+    void cosArray(float* dst, const float* x, size_t count)
+    {
+        unaryArray<cos_kernel>(dst, x, count);
+    }
+
+    void sincosArray(float* s, float* c, const float* x, size_t count)
+    {
+        sincos_array_t func = core::cpu_select<sincos_array_t>(
+            sincosArrayWide<vi_scalar_t>,
+            sincosArrayWide<vi_sse41_t>,
+            sincosArrayWide<vi_avx2_t>
+        );
+
+        func(s, c, x, count);
+    }
+
+    void expArray(float* dst, const float* x, size_t count)
+    {
+        unaryArray<exp_kernel>(dst, x, count);
+    }
+
+    void exp2Array(float* dst, const float* x, size_t count)
+    {
+        unaryArray<exp2_kernel>(dst, x, count);
+    }
+
+    void lnArray(float* dst, const float* x, size_t count)
+    {
+        unaryArray<ln_kernel>(dst, x, count);
+    }
+
+    void lg2Array(float* dst, const float* x, size_t count)
+    {
+        unaryArray<lg2_kernel>(dst, x, count);
+    }
+
+    void powArray(float* dst, const float* x, const float* y, size_t count)
+    {
+        binaryArray<pow_kernel>(dst, x, y, count);
+    }
+
+    void atan2Array(float* dst, const float* y, const float* x, size_t count)
+    {
+        binaryArray<atan2_kernel>(dst, y, x, count);
+    }
+
+    void rsqrtArray(float* dst, const float* x, size_t count)
+    {
+        unaryArray<rsqrt_kernel>(dst, x, count);
+    }
+}
+
+// Batch transforms
+//
+// Elements are processed in blocks of one cache line per stream, next lines of all input
+// streams are prefetched ahead. Matrix and quaternion kernels use the same operation order
+// as per element functions, so results are the same.
+namespace ml
+{
+    enum
+    {
+        STREAM_BLOCK    = 16, // floats in cache line
+        STREAM_PREFETCH = 64, // prefetch distance in floats
+    };
+
+    // Kernel defines simd traits, numInputs and numOutputs streams and run(vf* out, const vf* in)
+    template <typename kernel_t>
+    static void processStreams(const kernel_t& kernel, float* const* dst, const float* const* src, size_t count)
+    {
+        typedef typename kernel_t::simd simd;
+        typedef typename simd::vf       vf;
+
+        const size_t width = simd::width;
+        size_t       i     = 0;
+
+        vf in [kernel_t::numInputs];
+        vf out[kernel_t::numOutputs];
+
+        for (; i + STREAM_BLOCK <= count; i += STREAM_BLOCK)
+        {
+            for (int s = 0; s < kernel_t::numInputs; ++s)
+            {
+                _mm_prefetch((const char*)(src[s] + i + STREAM_PREFETCH), _MM_HINT_T0);
+            }
+
+            for (size_t j = i; j < i + STREAM_BLOCK; j += width)
+            {
+                for (int s = 0; s < kernel_t::numInputs; ++s) in[s] = simd::load(src[s] + j);
+                kernel.run(out, in);
+                for (int s = 0; s < kernel_t::numOutputs; ++s) simd::store(dst[s] + j, out[s]);
+            }
+        }
+
+        for (; i + width <= count; i += width)
+        {
+            for (int s = 0; s < kernel_t::numInputs; ++s) in[s] = simd::load(src[s] + i);
+            kernel.run(out, in);
+            for (int s = 0; s < kernel_t::numOutputs; ++s) simd::store(dst[s] + i, out[s]);
+        }
+
+        if (i < count)
+        {
+            float tmp[width];
+
+            for (int s = 0; s < kernel_t::numInputs; ++s)
+            {
+                loadTail(tmp, src[s] + i, count - i, width);
+                in[s] = simd::load(tmp);
+            }
+
+            kernel.run(out, in);
+
+            for (int s = 0; s < kernel_t::numOutputs; ++s)
+            {
+                simd::store(tmp, out[s]);
+                storeTail(dst[s] + i, tmp, count - i);
+            }
+        }
+
+        simd::finish();
+    }
+
+    // Same as MUL_MAT4_VEC4 for w = 1(point) or w = 0(vector)
+    template <typename simd_t, bool point>
+    struct transform_kernel
+    {
+        typedef simd_t            simd;
+        typedef typename simd::vf vf;
+
+        enum { numInputs = 3, numOutputs = 3 };
+
+        vf m[4][3];
+
+        transform_kernel(const v128* mat)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int r = 0; r < 3; ++r)
+                {
+                    m[c][r] = simd::set(mat[c].m128_f32[r]);
+                }
+            }
+        }
+
+        __forceinline void run(vf* out, const vf* in) const
+        {
+            for (int r = 0; r < 3; ++r)
+            {
+                vf t = point ? simd::mad(in[2], m[2][r], m[3][r]) : simd::mul(in[2], m[2][r]);
+                t = simd::mad(in[1], m[1][r], t);
+                out[r] = simd::mad(in[0], m[0][r], t);
+            }
+        }
+    };
+
+    // Inputs are a[column][row] followed by b[column][row], same as mul_mat4
+    template <typename simd_t>
+    struct mul_mat4_kernel
+    {
+        typedef simd_t            simd;
+        typedef typename simd::vf vf;
+
+        enum { numInputs = 32, numOutputs = 16 };
+
+        __forceinline void run(vf* out, const vf* in) const
+        {
+            const vf* a = in;
+            const vf* b = in + 16;
+
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int r = 0; r < 4; ++r)
+                {
+                    vf t = simd::mul(b[c*4 + 3], a[12 + r]);
+                    t = simd::mad(b[c*4 + 2], a[8 + r], t);
+                    t = simd::mad(b[c*4 + 1], a[4 + r], t);
+                    out[c*4 + r] = simd::mad(b[c*4 + 0], a[r], t);
+                }
+            }
+        }
+    };
+
+    // Same operation order as v128 mul_quat
+    template <typename simd>
+    static __forceinline void mulQuatSoA(typename simd::vf* r, const typename simd::vf* q0, const typename simd::vf* q1)
+    {
+        typedef typename simd::vf vf;
+
+        vf x = simd::mul(q1[3], q0[0]);
+        vf y = simd::mul(q1[3], q0[1]);
+        vf z = simd::mul(q1[3], q0[2]);
+        vf w = simd::mul(q1[3], q0[3]);
+
+        x = simd::add(x, simd::mul(q1[2], q0[1]));
+        y = simd::sub(y, simd::mul(q1[2], q0[0]));
+        z = simd::add(z, simd::mul(q1[2], q0[3]));
+        w = simd::sub(w, simd::mul(q1[2], q0[2]));
+
+        x = simd::sub(x, simd::mul(q1[1], q0[2]));
+        y = simd::add(y, simd::mul(q1[1], q0[3]));
+        z = simd::add(z, simd::mul(q1[1], q0[0]));
+        w = simd::sub(w, simd::mul(q1[1], q0[1]));
+
+        r[0] = simd::add(x, simd::mul(q1[0], q0[3]));
+        r[1] = simd::add(y, simd::mul(q1[0], q0[2]));
+        r[2] = simd::sub(z, simd::mul(q1[0], q0[1]));
+        r[3] = simd::sub(w, simd::mul(q1[0], q0[0]));
+    }
+
+    // Inputs are dq0 real, dq0 dual, dq1 real, dq1 dual, same as mul_dual_quat
+    template <typename simd_t>
+    struct mul_dual_quat_kernel
+    {
+        typedef simd_t            simd;
+        typedef typename simd::vf vf;
+
+        enum { numInputs = 16, numOutputs = 8 };
+
+        __forceinline void run(vf* out, const vf* in) const
+        {
+            vf t0[4], t1[4];
+
+            mulQuatSoA<simd>(out, in,     in + 8);
+            mulQuatSoA<simd>(t0,  in + 4, in + 8);
+            mulQuatSoA<simd>(t1,  in,     in + 12);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                out[4 + i] = simd::add(t0[i], t1[i]);
+            }
+        }
+    };
+
+    // Homogeneous form, works for non unit quaternions same as quat_to_mat4x3
+    template <typename simd_t>
+    struct quat_to_mat4x3_kernel
+    {
+        typedef simd_t            simd;
+        typedef typename simd::vf vf;
+
+        enum { numInputs = 4, numOutputs = 12 };
+
+        __forceinline void run(vf* out, const vf* in) const
+        {
+            vf x = in[0], y = in[1], z = in[2], w = in[3];
+
+            vf xx = simd::mul(x, x), yy = simd::mul(y, y), zz = simd::mul(z, z), ww = simd::mul(w, w);
+            vf xy = simd::mul(x, y), xz = simd::mul(x, z), yz = simd::mul(y, z);
+            vf wx = simd::mul(w, x), wy = simd::mul(w, y), wz = simd::mul(w, z);
+
+            vf wxx = simd::add(ww, xx), wmx = simd::sub(ww, xx);
+            vf yz2 = simd::add(yy, zz), ymz = simd::sub(yy, zz);
+
+            out[0]  = simd::sub(wxx, yz2);
+            out[1]  = simd::add(simd::add(xy, wz), simd::add(xy, wz));
+            out[2]  = simd::add(simd::sub(xz, wy), simd::sub(xz, wy));
+            out[3]  = simd::zero();
+
+            out[4]  = simd::add(simd::sub(xy, wz), simd::sub(xy, wz));
+            out[5]  = simd::add(wmx, ymz);
+            out[6]  = simd::add(simd::add(yz, wx), simd::add(yz, wx));
+            out[7]  = simd::zero();
+
+            out[8]  = simd::add(simd::add(xz, wy), simd::add(xz, wy));
+            out[9]  = simd::add(simd::sub(yz, wx), simd::sub(yz, wx));
+            out[10] = simd::sub(wmx, ymz);
+            out[11] = simd::zero();
+        }
+    };
+
+    template <typename simd, bool point>
+    static void transformWide(vec3_soa* dst, const v128* m, const vec3_soa* src, size_t count)
+    {
+        transform_kernel<simd, point> kernel(m);
+
+        const float* in [3] = { src->x, src->y, src->z };
+        float*       out[3] = { dst->x, dst->y, dst->z };
+
+        processStreams(kernel, out, in, count);
+    }
+
+    template <typename simd>
+    static void mulMat4Wide(mat4_soa* r, const mat4_soa* a, const mat4_soa* b, size_t count)
+    {
+        const float* in [32];
+        float*       out[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            in[i]      = a->m[i / 4][i % 4];
+            in[16 + i] = b->m[i / 4][i % 4];
+            out[i]     = r->m[i / 4][i % 4];
+        }
+
+        processStreams(mul_mat4_kernel<simd>(), out, in, count);
+    }
+
+    template <typename simd>
+    static void mulDualQuatWide(dual_quat_soa* r, const dual_quat_soa* dq0, const dual_quat_soa* dq1, size_t count)
+    {
+        const float* in[16] = {
+            dq0->real.x, dq0->real.y, dq0->real.z, dq0->real.w,
+            dq0->dual.x, dq0->dual.y, dq0->dual.z, dq0->dual.w,
+            dq1->real.x, dq1->real.y, dq1->real.z, dq1->real.w,
+            dq1->dual.x, dq1->dual.y, dq1->dual.z, dq1->dual.w,
+        };
+        float* out[8] = {
+            r->real.x, r->real.y, r->real.z, r->real.w,
+            r->dual.x, r->dual.y, r->dual.z, r->dual.w,
+        };
+
+        processStreams(mul_dual_quat_kernel<simd>(), out, in, count);
+    }
+
+    template <typename simd>
+    static void quatToMat4x3Wide(mat4_soa* m, const quat_soa* q, size_t count)
+    {
+        const float* in[4] = { q->x, q->y, q->z, q->w };
+        float*       out[12];
+
+        for (int i = 0; i < 12; ++i)
+        {
+            out[i] = m->m[i / 4][i % 4];
+        }
+
+        processStreams(quat_to_mat4x3_kernel<simd>(), out, in, count);
+    }
+
+    typedef void (*transform_soa_t)     (vec3_soa* dst, const v128* m, const vec3_soa* src, size_t count);
+    typedef void (*mul_mat4_soa_t)      (mat4_soa* r, const mat4_soa* a, const mat4_soa* b, size_t count);
+    typedef void (*mul_dual_quat_soa_t) (dual_quat_soa* r, const dual_quat_soa* dq0, const dual_quat_soa* dq1, size_t count);
+    typedef void (*quat_to_mat4x3_soa_t)(mat4_soa* m, const quat_soa* q, size_t count);
+
+    void transformPointsSoA(vec3_soa* dst, const v128* m/*[4]*/, const vec3_soa* src, size_t count)
+    {
+        transform_soa_t func = core::cpu_select<transform_soa_t>(
+            transformWide<vi_scalar_t, true>,
+            transformWide<vi_sse41_t,  true>,
+            transformWide<vi_avx2_t,   true>
+        );
+
+        func(dst, m, src, count);
+    }
+
+    void transformVectorsSoA(vec3_soa* dst, const v128* m/*[4]*/, const vec3_soa* src, size_t count)
+    {
+        transform_soa_t func = core::cpu_select<transform_soa_t>(
+            transformWide<vi_scalar_t, false>,
+            transformWide<vi_sse41_t,  false>,
+            transformWide<vi_avx2_t,   false>
+        );
+
+        func(dst, m, src, count);
+    }
+
+    void mulMat4SoA(mat4_soa* r, const mat4_soa* a, const mat4_soa* b, size_t count)
+    {
+        mul_mat4_soa_t func = core::cpu_select<mul_mat4_soa_t>(
+            mulMat4Wide<vi_scalar_t>,
+            mulMat4Wide<vi_sse41_t>,
+            mulMat4Wide<vi_avx2_t>
+        );
+
+        func(r, a, b, count);
+    }
+
+    void mulDualQuatSoA(dual_quat_soa* r, const dual_quat_soa* dq0, const dual_quat_soa* dq1, size_t count)
+    {
+        mul_dual_quat_soa_t func = core::cpu_select<mul_dual_quat_soa_t>(
+            mulDualQuatWide<vi_scalar_t>,
+            mulDualQuatWide<vi_sse41_t>,
+            mulDualQuatWide<vi_avx2_t>
+        );
+
+        func(r, dq0, dq1, count);
+    }
+
+    void quatToMat4x3SoA(mat4_soa* m, const quat_soa* q, size_t count)
+    {
+        quat_to_mat4x3_soa_t func = core::cpu_select<quat_to_mat4x3_soa_t>(
+            quatToMat4x3Wide<vi_scalar_t>,
+            quatToMat4x3Wide<vi_sse41_t>,
+            quatToMat4x3Wide<vi_avx2_t>
+        );
+
+        func(m, q, count);
+    }
+}
@@ -3,381 +3,1069 @@
 
 namespace mt
 {
-    static const uint32_t MAX_EVENTS = 128;
-    
-    static const uint32_t ID_TYPE_BITS  =  4;
-    static const uint32_t ID_GEN_BITS   =  8;
-    static const uint32_t ID_INDEX_BITS = 20;
+    static const uint32_t ID_TYPE_MT_EVENT = 1;
+    static const uint32_t ID_TYPE_MT_JOB   = 2;
 
-    static const uint32_t ID_TYPE_OFFSET  = ID_INDEX_BITS + ID_GEN_BITS;
-    static const uint32_t ID_GEN_OFFSET   = ID_INDEX_BITS;
-    static const uint32_t ID_INDEX_OFFSET = 0;
+    //--------------------------------------------------------------------------
+    // Job system
 
-    static const uint32_t ID_TYPE_MASK  = ((1 << ID_TYPE_BITS ) - 1) << ID_TYPE_OFFSET;
-    static const uint32_t ID_GEN_NASK   = ((1 << ID_GEN_BITS  ) - 1) << ID_GEN_OFFSET;
-    static const uint32_t ID_INDEX_MASK = ((1 << ID_INDEX_BITS) - 1) << ID_INDEX_OFFSET;
+    static const uint32_t MAX_WORKER_THREADS    = 64;
+    static const uint32_t MAX_JOB_CONTINUATIONS = 8;
+    static const uint32_t JOB_DATA_SIZE         = 2 * CORE_CACHE_LINE_SIZE;
+    static const uint32_t WORKER_SPIN_COUNT     = 64;
+    static const uint32_t WORKER_SLEEP_MS       = 1;
+    static const uint32_t EXTERNAL_QUEUE_SIZE   = 1024;
 
-    static const uint32_t ID_TYPE_MT_EVENT = 1;
+    struct job_header_t
+    {
+        job_func_t  function;
+        void*       arg;
+        uint32_t    handle;
+        uint32_t    parent;
+        atomic_t    unfinishedJobs;
+        atomic_t    numContinuations;
+        uint32_t    continuations[MAX_JOB_CONTINUATIONS];
+    };
+
+    // Job occupies whole number of cache lines, so threads working on different jobs do not share lines
+    struct job_data_t : job_header_t
+    {
+        uint8_t payload[JOB_DATA_SIZE - sizeof(job_header_t)];
+    };
 
-    static const uint32_t ID_INVALID_TYPE = 0x0F;
+    static_assert(sizeof(job_data_t) == JOB_DATA_SIZE, "Fix job_data_t padding");
+
+    // Chase-Lev work stealing deque: owner pushes and pops at bottom, thieves steal from top.
+    // Indices are free running and compared through unsigned difference to survive wrap around.
+    struct job_queue_t
+    {
+        atomic_t   top;
+        uint8_t    pad0[CORE_CACHE_LINE_SIZE - sizeof(atomic_t)];
+        atomic_t   bottom;
+        uint8_t    pad1[CORE_CACHE_LINE_SIZE - sizeof(atomic_t)];
+        uint32_t*  jobs;
+        uint32_t   mask;
+        uint32_t   nextJob;   // job ring position of the owner thread
+        uint8_t    pad2[CORE_CACHE_LINE_SIZE - sizeof(uint32_t*) - 2*sizeof(uint32_t)];
+    };
+
+    // Jobs created and run by threads outside of job system: slots are allocated
+    // under lock from block after workers' slots, jobs are published through shared queue.
+    struct external_jobs_t
+    {
+        core::mpmc_ring_t<uint32_t, EXTERNAL_QUEUE_SIZE> queue;
+        atomic_t                                         lock;
+        uint32_t                                         nextJob;
+    };
 
-    uint32_t handleConstruct(uint32_t type, uint32_t gen, uint32_t index)
+    struct scheduler_t
     {
-        assert( type != ID_INVALID_TYPE );
+        job_queue_t*  queues;
+        job_data_t*   jobs;
+        uint32_t      jobsPerThread;
+        uint32_t      workerCount;
+        external_jobs_t external;
+        SDL_Thread*   threads[MAX_WORKER_THREADS];
+        SDL_sem*      wakeup;
+        atomic_t      sleepingWorkers;
+        atomic_t      shutdown;
+        int           started;
+    };
+
+    static scheduler_t scheduler;
 
-        assert( type  < (1<<(ID_TYPE_BITS )) );
-        assert( gen   < (1<<(ID_GEN_BITS  )) );
-        assert( index < (1<<(ID_INDEX_BITS)) );
+    static CORE_THREAD_LOCAL uint32_t tlsWorkerIndex = INVALID_HANDLE;
+    static CORE_THREAD_LOCAL uint32_t tlsRandomState = 0;
 
-        return (type  << ID_TYPE_OFFSET ) |
-               (gen   << ID_GEN_OFFSET  ) |
-               (index << ID_INDEX_OFFSET);
+    static inline long queueDistance(long from, long to)
+    {
+        return (long)((unsigned long)to - (unsigned long)from);
     }
 
-    uint32_t handleIncGen(uint32_t handle)
+    static inline long queueNext(long index)
     {
-        return (handle & ~ID_GEN_NASK) | ((handle + (1 << ID_GEN_OFFSET)) & ID_GEN_NASK);
+        return (long)((unsigned long)index + 1);
     }
 
-    struct FixedStack
+    static bool queuePush(job_queue_t* queue, uint32_t job)
     {
-        uint32_t array[MAX_EVENTS];
-        uint32_t pointer;
-    };
+        long b = queue->bottom;
+        long t = queue->top;
 
-    FixedStack freeEventID;
+        if ((unsigned long)queueDistance(t, b) > queue->mask)
+        {
+            return false;
+        }
 
-    struct event_t
+        queue->jobs[b & queue->mask] = job;
+        // x86 does not reorder stores, only compiler has to be fenced
+        _ReadWriteBarrier();
+        queue->bottom = queueNext(b);
+
+        return true;
+    }
+
+    static uint32_t queuePop(job_queue_t* queue)
     {
-        uint32_t   handle;
-        uint32_t   signaled;
-        SDL_cond*  cond;
-        SDL_mutex* mutex;
-    };
+        long b = (long)((unsigned long)queue->bottom - 1);
+        // Full barrier: store to bottom should be visible before top is read
+        _InterlockedExchange(&queue->bottom, b);
+        long t = queue->top;
+
+        long size = queueDistance(t, b);
+
+        if (size < 0)
+        {
+            queue->bottom = t;
+            return INVALID_HANDLE;
+        }
 
-    event_t eventPool[MAX_EVENTS];
+        uint32_t job = queue->jobs[b & queue->mask];
 
-    event_t* getEventByHandle(uint32_t eventID)
+        if (size > 0)
+        {
+            return job;
+        }
+
+        // Last job in the queue, race against thieves
+        if (_InterlockedCompareExchange(&queue->top, queueNext(t), t) != t)
+        {
+            job = INVALID_HANDLE;
+        }
+
+        queue->bottom = queueNext(t);
+
+        return job;
+    }
+
+    static uint32_t queueSteal(job_queue_t* queue)
     {
-        uint32_t index = eventID & ID_INDEX_OFFSET;
-        if (index < MAX_EVENTS && eventPool[index].handle == eventID)
+        long t = queue->top;
+        _ReadWriteBarrier();
+        long b = queue->bottom;
+
+        if (queueDistance(t, b) <= 0)
         {
-            return &eventPool[index];
+            return INVALID_HANDLE;
         }
 
-        return 0;
+        uint32_t job = queue->jobs[t & queue->mask];
+
+        if (_InterlockedCompareExchange(&queue->top, queueNext(t), t) != t)
+        {
+            return INVALID_HANDLE;
+        }
+
+        return job;
     }
 
-    uint32_t eventPoolAllocEvent()
+    static inline job_data_t* jobData(uint32_t handle)
     {
-        assert(freeEventID.pointer < MAX_EVENTS);
+        assert(core::handle_type(handle) == ID_TYPE_MT_JOB);
+        assert((handle & core::HANDLE_INDEX_MASK) < (scheduler.workerCount + 1) * scheduler.jobsPerThread);
 
-        uint32_t handle = handleIncGen(freeEventID.array[freeEventID.pointer++]);
-        uint32_t index  = handle & ID_INDEX_OFFSET;
-        assert(index < MAX_EVENTS);
+        return &scheduler.jobs[handle & core::HANDLE_INDEX_MASK];
+    }
 
-        eventPool[index].handle   = handle;
-        eventPool[index].signaled = false;
+    uint32_t workerCount()
+    {
+        return scheduler.workerCount;
+    }
 
-        return handle;
+    uint32_t workerIndex()
+    {
+        return tlsWorkerIndex;
     }
 
-    void eventPoolReleaseEvent(uint32_t eventID)
+    static uint32_t randomWorker()
     {
-        assert(freeEventID.pointer > 0);
-        
-        event_t* event = getEventByHandle(eventID);
-        assert(event);
+        // xorshift32
+        uint32_t x = tlsRandomState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        tlsRandomState = x;
+
+        return x % scheduler.workerCount;
+    }
 
-        event->handle = INVALID_HANDLE;
+    static inline bool isWorker(uint32_t worker)
+    {
+        return worker < scheduler.workerCount;
+    }
 
-        freeEventID.array[--freeEventID.pointer] = eventID;
+    static uint32_t getJob()
+    {
+        uint32_t worker = workerIndex();
+        uint32_t job    = INVALID_HANDLE;
+
+        if (isWorker(worker))
+        {
+            job = queuePop(&scheduler.queues[worker]);
+        }
+
+        if (job != INVALID_HANDLE || core::mpmc_ring_pop(scheduler.external.queue, &job))
+        {
+            return job;
+        }
+
+        // Thieves need own queue for spawned jobs
+        if (!isWorker(worker))
+        {
+            return INVALID_HANDLE;
+        }
+
+        uint32_t victim = randomWorker();
+        for (uint32_t i = 0; i < scheduler.workerCount; ++i)
+        {
+            if (victim != worker)
+            {
+                job = queueSteal(&scheduler.queues[victim]);
+                if (job != INVALID_HANDLE)
+                {
+                    return job;
+                }
+            }
+
+            victim = (victim + 1 == scheduler.workerCount) ? 0 : victim + 1;
+        }
+
+        return INVALID_HANDLE;
     }
 
-    void syncAndReleaseEvent(uint32_t handle)
+    static void executeJob(uint32_t handle);
+
+    static void notifyWorkers()
     {
-        event_t* event = getEventByHandle(handle);
-        assert(event);
+        // Locked read acts as full barrier between job publication and sleepers check
+        if (_InterlockedCompareExchange(&scheduler.sleepingWorkers, 0, 0) > 0)
+        {
+            SDL_SemPost(scheduler.wakeup);
+        }
+    }
+
+    static void pushJob(uint32_t handle)
+    {
+        uint32_t worker = workerIndex();
+        bool     pushed = isWorker(worker) ?
+                          queuePush(&scheduler.queues[worker], handle) :
+                          core::mpmc_ring_push(scheduler.external.queue, handle);
+
+        if (pushed)
+        {
+            notifyWorkers();
+        }
+        else
+        {
+            // Queue overflow: execute in place instead of failing
+            executeJob(handle);
+        }
+    }
+
+    static void finishJob(uint32_t handle)
+    {
+        job_data_t* job = jobData(handle);
+
+        // Copy everything needed before decrement: slot can be reused as soon as counter reaches 0
+        uint32_t parent           = job->parent;
+        uint32_t numContinuations = job->numContinuations;
+        uint32_t continuations[MAX_JOB_CONTINUATIONS];
+
+        for (uint32_t i = 0; i < numContinuations; ++i)
+        {
+            continuations[i] = job->continuations[i];
+        }
+
+        if (_InterlockedDecrement(&job->unfinishedJobs) == 0)
+        {
+            for (uint32_t i = 0; i < numContinuations; ++i)
+            {
+                pushJob(continuations[i]);
+            }
+
+            if (parent != INVALID_HANDLE)
+            {
+                finishJob(parent);
+            }
+        }
+    }
+
+    static void executeJob(uint32_t handle)
+    {
+        job_data_t* job = jobData(handle);
+
+        job->function(handle, job->arg);
+        finishJob(handle);
+    }
 
-        SDL_LockMutex(event->mutex);
-        while (!event->signaled)
+    // Reuse slots in ring order, skipping jobs that are still in flight
+    static job_data_t* jobFindFree(uint32_t block, uint32_t* nextJob)
+    {
+        for (uint32_t probe = 0; probe < scheduler.jobsPerThread; ++probe)
         {
-            SDL_CondWait(event->cond, event->mutex);
+            uint32_t    index = block * scheduler.jobsPerThread + ((*nextJob)++ & (scheduler.jobsPerThread - 1));
+            job_data_t* job   = &scheduler.jobs[index];
+
+            if (job->unfinishedJobs == 0)
+            {
+                return job;
+            }
         }
-        SDL_UnlockMutex(event->mutex);
 
-        eventPoolReleaseEvent(handle);
+        return 0;
     }
 
-    void eventPoolCreate()
+    static uint32_t jobAlloc(uint32_t parent, job_func_t func, void* arg)
     {
-        for (size_t i = 0; i < MAX_EVENTS; ++i)
+        uint32_t    worker = workerIndex();
+        job_data_t* job    = 0;
+
+        if (isWorker(worker))
+        {
+            job = jobFindFree(worker, &scheduler.queues[worker].nextJob);
+        }
+        else
+        {
+            external_jobs_t* external = &scheduler.external;
+
+            atomicLock(&external->lock);
+            job = jobFindFree(scheduler.workerCount, &external->nextJob);
+            // Claim slot before other external threads can see it free
+            if (job)
+            {
+                job->unfinishedJobs = 1;
+            }
+            atomicUnlock(&external->lock);
+        }
+
+        if (!job)
         {
-            freeEventID.array[i] = handleConstruct(ID_TYPE_MT_EVENT, 0, i);
+            return INVALID_HANDLE;
         }
 
-        freeEventID.pointer = 0;
+        job->function         = func;
+        job->arg              = arg;
+        job->parent           = parent;
+        job->numContinuations = 0;
+        job->unfinishedJobs   = 1;
+
+        _ReadWriteBarrier();
 
-        for (size_t i = 0; i < MAX_EVENTS; ++i)
+        job->handle = core::handle_inc_gen(job->handle);
+
+        if (parent != INVALID_HANDLE)
         {
-            eventPool[i].handle   = INVALID_HANDLE;
-            eventPool[i].signaled = 0;
-            eventPool[i].cond     = SDL_CreateCond();
-            eventPool[i].mutex    = SDL_CreateMutex();
-        }        
+            job_data_t* parentJob = jobData(parent);
+            assert(parentJob->handle == parent);
+            assert(parentJob->unfinishedJobs > 0);
+
+            _InterlockedIncrement(&parentJob->unfinishedJobs);
+        }
+
+        return job->handle;
     }
 
-    void eventPoolDestroy()
+    uint32_t jobCreate(job_func_t func, void* arg)
     {
-        freeEventID.pointer = MAX_EVENTS;
+        assert(func);
+        return jobAlloc(INVALID_HANDLE, func, arg);
+    }
 
-        for (size_t i = 0; i < MAX_EVENTS; ++i)
+    uint32_t jobCreateChild(uint32_t parent, job_func_t func, void* arg)
+    {
+        assert(func);
+        return jobAlloc(parent, func, arg);
+    }
+
+    bool jobAddContinuation(uint32_t ancestor, uint32_t continuation)
+    {
+        job_data_t* job = jobData(ancestor);
+        assert(job->handle == ancestor);
+
+        long index = _InterlockedIncrement(&job->numContinuations) - 1;
+        if (index >= (long)MAX_JOB_CONTINUATIONS)
         {
-            eventPool[i].handle   = INVALID_HANDLE;
-            eventPool[i].signaled = 0;
-            SDL_DestroyCond(eventPool[i].cond);
-            SDL_DestroyMutex(eventPool[i].mutex);
-        }        
+            _InterlockedDecrement(&job->numContinuations);
+            return false;
+        }
+
+        job->continuations[index] = continuation;
+
+        return true;
     }
 
-    static const size_t MAX_POOL_THREADS = 8;
+    void jobRun(uint32_t job)
+    {
+        assert(jobData(job)->handle == job);
+        pushJob(job);
+    }
 
-    typedef struct {
-        void (*function)(void *);
-        void*     argument;
-        event_t*  event;
-    } task_t;
-
-    struct threadpool_t
-    {
-        SDL_mutex*  lock;
-        SDL_cond*   notify;
-        SDL_Thread* threads[MAX_POOL_THREADS];
-        task_t*     queue;
-        int         thread_count;
-        int         queue_size;
-        int         head;
-        int         tail;
-        int         count;
-        int         shutdown;
-        int         started;
-    };
+    bool jobIsFinished(uint32_t handle)
+    {
+        if (handle == INVALID_HANDLE)
+        {
+            return true;
+        }
 
-    static int SDLCALL threadpoolThread(void* poolPtr);
-    static void releaseMTResources();
+        job_data_t* job = jobData(handle);
 
-    threadpool_t pool;
+        return job->handle != handle || job->unfinishedJobs == 0;
+    }
 
-    void init(int thread_count, int queue_size)
+    void jobWait(uint32_t handle)
     {
-        int  i;
-        char threadName[8] = "Worker\0";
+        while (!jobIsFinished(handle))
+        {
+            uint32_t job = getJob();
+            if (job != INVALID_HANDLE)
+            {
+                executeJob(job);
+            }
+            else
+            {
+                _mm_pause();
+            }
+        }
+    }
 
-        assert(thread_count < MAX_POOL_THREADS);
+    void yield()
+    {
+        SDL_Delay(0);
+    }
 
-        memset(&pool, 0, sizeof(threadpool_t));
+    struct parallel_for_data_t
+    {
+        range_func_t  function;
+        void*         arg;
+        uint32_t      begin;
+        uint32_t      end;
+        uint32_t      grainSize;
+    };
 
-        /* Initialize */
-        pool.thread_count = thread_count;
-        pool.queue_size   = queue_size;
+    static_assert(sizeof(parallel_for_data_t) <= sizeof(((job_data_t*)0)->payload), "parallel_for_data_t does not fit job payload");
 
-        /* Allocate thread and task queue */
-        pool.queue = (task_t*)malloc(sizeof(task_t) * queue_size);
+    static void parallelForJob(uint32_t job, void* arg);
 
-        pool.lock   = SDL_CreateMutex();
-        pool.notify = SDL_CreateCond();
+    static uint32_t parallelForCreate(uint32_t parent, const parallel_for_data_t& range)
+    {
+        uint32_t handle = jobAlloc(parent, parallelForJob, 0);
 
-        /* Initialize mutex and conditional variable first */
-        if (pool.lock    == NULL  ||
-            pool.notify  == NULL  ||
-            pool.queue   == NULL)
+        if (handle == INVALID_HANDLE)
         {
-            goto err;
+            return INVALID_HANDLE;
         }
 
-        for(i = 0; i < thread_count; i++)
+        job_data_t* job = jobData(handle);
+
+        memcpy(job->payload, &range, sizeof(range));
+        job->arg = job->payload;
+
+        return handle;
+    }
+
+    static void parallelForJob(uint32_t job, void* arg)
+    {
+        parallel_for_data_t range = *(parallel_for_data_t*)arg;
+
+        // Split off upper halves for other workers, keep lower part for this one
+        while (range.end - range.begin > range.grainSize)
         {
-            threadName[6] = 0x30+i;
+            uint32_t mid = range.begin + (range.end - range.begin) / 2;
 
-            pool.threads[i] = SDL_CreateThread(threadpoolThread, threadName, &pool);
-            if (pool.threads[i] == 0)
+            parallel_for_data_t upper = range;
+            upper.begin = mid;
+
+            uint32_t child = parallelForCreate(job, upper);
+            if (child == INVALID_HANDLE)
             {
-                goto err;
+                // Out of job slots, process the rest of range here
+                break;
             }
 
-            pool.started++;
+            jobRun(child);
+
+            range.end = mid;
         }
 
-        return;
+        range.function(range.begin, range.end, range.arg);
+    }
 
-    err:
-        releaseMTResources();
+    uint32_t parallelFor(range_func_t func, void* arg, uint32_t count, uint32_t grainSize)
+    {
+        assert(func);
+
+        parallel_for_data_t range = { func, arg, 0, count, grainSize ? grainSize : 1 };
+
+        uint32_t job = parallelForCreate(INVALID_HANDLE, range);
+
+        if (job == INVALID_HANDLE)
+        {
+            func(0, count, arg);
+            return INVALID_HANDLE;
+        }
+
+        jobRun(job);
+
+        return job;
     }
 
-    void fini()
+    //--------------------------------------------------------------------------
+    // Events
+
+    // Event table grows by pages which are never moved or freed until fini,
+    // so lookups and lock-free free list traversal never touch released memory.
+    static const uint32_t EVENT_PAGE_BITS   = 8;
+    static const uint32_t EVENT_PAGE_SIZE   = 1 << EVENT_PAGE_BITS;
+    static const uint32_t EVENT_PAGE_MASK   = EVENT_PAGE_SIZE - 1;
+    static const uint32_t MAX_EVENT_PAGES   = (1 << core::HANDLE_INDEX_BITS) / EVENT_PAGE_SIZE;
+    static const uint32_t EVENT_SPIN_COUNT  = 256;
+    static const uint32_t INVALID_INDEX     = 0xFFFFFFFF;
+
+    struct event_t
     {
-        if (SDL_LockMutex(pool.lock) != 0)
+        uint32_t  handle;
+        uint32_t  nextFree;
+        atomic_t  signaled;
+        atomic_t  waiters;
+    };
+
+    struct event_table_t
+    {
+        event_t* volatile   pages[MAX_EVENT_PAGES];
+        atomic_t            numPages;
+        // Free list head: index in low 32 bits, ABA tag in high 32 bits
+        volatile int64_t    freeHead;
+        // Parking lot shared by all events, only touched when waiter gave up spinning
+        SDL_mutex*          parkLock;
+        SDL_cond*           parkCond;
+    };
+
+    static event_table_t eventTable;
+
+    static inline event_t* eventByIndex(uint32_t index)
+    {
+        return &eventTable.pages[index >> EVENT_PAGE_BITS][index & EVENT_PAGE_MASK];
+    }
+
+    // Slot of handle regardless of generation, it stays valid after event is released
+    static event_t* getEventSlotByHandle(uint32_t eventID)
+    {
+        uint32_t index = eventID & core::HANDLE_INDEX_MASK;
+        uint32_t page  = index >> EVENT_PAGE_BITS;
+
+        if (core::handle_type(eventID) != ID_TYPE_MT_EVENT ||
+            page >= MAX_EVENT_PAGES || eventTable.pages[page] == 0)
         {
-            return;
+            return 0;
         }
 
-        do
+        return eventByIndex(index);
+    }
+
+    static event_t* getEventByHandle(uint32_t eventID)
+    {
+        event_t* event = getEventSlotByHandle(eventID);
+
+        return event && event->handle == eventID ? event : 0;
+    }
+
+    static void eventFreeListPush(uint32_t first, uint32_t last)
+    {
+        for (;;)
         {
-            /* Already shutting down */
-            if(pool.shutdown)
+            int64_t  head = eventTable.freeHead;
+            uint64_t tag  = ((uint64_t)head >> 32) + 1;
+
+            eventByIndex(last)->nextFree = (uint32_t)head;
+
+            int64_t newHead = (int64_t)((tag << 32) | first);
+            if (_InterlockedCompareExchange64(&eventTable.freeHead, newHead, head) == head)
             {
-                break;
+                return;
             }
+        }
+    }
 
-            pool.shutdown = 1;
+    static uint32_t eventFreeListPop()
+    {
+        for (;;)
+        {
+            int64_t  head  = eventTable.freeHead;
+            uint32_t index = (uint32_t)head;
 
-            /* Wake up all worker threads */
-            if (SDL_CondBroadcast(pool.notify) != 0 ||
-                SDL_UnlockMutex(pool.lock) != 0)
+            if (index == INVALID_INDEX)
             {
-                break;
+                return INVALID_INDEX;
             }
 
-            /* Join all worker thread */
-            for(int i = 0; i < pool.thread_count; i++)
+            // nextFree can be stale if other thread popped the event, tag makes CAS fail in that case
+            uint64_t tag     = ((uint64_t)head >> 32) + 1;
+            int64_t  newHead = (int64_t)((tag << 32) | eventByIndex(index)->nextFree);
+
+            if (_InterlockedCompareExchange64(&eventTable.freeHead, newHead, head) == head)
             {
-                SDL_WaitThread(pool.threads[i], NULL);
+                return index;
             }
         }
-        while(0);
-
-        SDL_UnlockMutex(pool.lock);
-    
-        releaseMTResources();
     }
 
-    int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle)
+    static bool eventTableGrow()
     {
-        int err = 0;
-        int next;
+        uint32_t page = _InterlockedIncrement(&eventTable.numPages) - 1;
 
-        if(taskFunc == NULL)
+        if (page >= MAX_EVENT_PAGES)
         {
-            return invalidValue;
+            _InterlockedDecrement(&eventTable.numPages);
+            return false;
         }
 
-        if(SDL_LockMutex(pool.lock) != 0)
+        event_t* events = (event_t*)malloc(sizeof(event_t) * EVENT_PAGE_SIZE);
+        if (events == 0)
+        {
+            return false;
+        }
+
+        uint32_t first = page << EVENT_PAGE_BITS;
+
+        for (uint32_t i = 0; i < EVENT_PAGE_SIZE; ++i)
+        {
+            events[i].handle   = core::handle_construct(ID_TYPE_MT_EVENT, 0, first + i);
+            events[i].nextFree = first + i + 1;
+            events[i].signaled = 0;
+            events[i].waiters  = 0;
+        }
+
+        // Page is published before any of its events can be popped from free list
+        eventTable.pages[page] = events;
+        eventFreeListPush(first, first + EVENT_PAGE_SIZE - 1);
+
+        return true;
+    }
+
+    static void eventTableCreate()
+    {
+        memset(&eventTable, 0, sizeof(eventTable));
+
+        eventTable.freeHead = INVALID_INDEX;
+        eventTable.parkLock = SDL_CreateMutex();
+        eventTable.parkCond = SDL_CreateCond();
+
+        eventTableGrow();
+    }
+
+    static void eventTableDestroy()
+    {
+        for (uint32_t i = 0; i < MAX_EVENT_PAGES; ++i)
         {
-            return lockFailure;
+            free(eventTable.pages[i]);
         }
 
-        next = pool.tail + 1;
-        next = (next == pool.queue_size) ? 0 : next;
+        SDL_DestroyCond(eventTable.parkCond);
+        SDL_DestroyMutex(eventTable.parkLock);
+
+        memset(&eventTable, 0, sizeof(eventTable));
+    }
+
+    uint32_t eventCreate()
+    {
+        uint32_t index;
 
-        do
+        while ((index = eventFreeListPop()) == INVALID_INDEX)
         {
-            /* Are we full? */
-            if(pool.count == pool.queue_size)
+            if (!eventTableGrow())
             {
-                err = queueFull;
-                break;
+                assert(!"Event table is exhausted");
+                return INVALID_HANDLE;
             }
+        }
+
+        event_t* event = eventByIndex(index);
+
+        // Waiters are not reset: thread parked on released handle still counts in the slot
+        event->signaled = 0;
+
+        return event->handle;
+    }
+
+    void eventRelease(uint32_t handle)
+    {
+        event_t* event = getEventByHandle(handle);
+        assert(event);
+
+        // Waiters of eventWaitAny that woke on other event could still be registered,
+        // they unregister through the slot. New generation invalidates all copies of released handle
+        event->handle = core::handle_inc_gen(event->handle);
+
+        uint32_t index = handle & core::HANDLE_INDEX_MASK;
+        eventFreeListPush(index, index);
+    }
+
+    void eventSignal(uint32_t handle)
+    {
+        event_t* event = getEventByHandle(handle);
+        assert(event);
+
+        // Full barrier: flag is visible before waiters count is checked
+        _InterlockedExchange(&event->signaled, 1);
+
+        if (event->waiters > 0)
+        {
+            SDL_LockMutex(eventTable.parkLock);
+            SDL_CondBroadcast(eventTable.parkCond);
+            SDL_UnlockMutex(eventTable.parkLock);
+        }
+    }
+
+    bool eventIsSignaled(uint32_t handle)
+    {
+        event_t* event = getEventByHandle(handle);
+
+        // Released events were signaled before release
+        return event == 0 || event->signaled != 0;
+    }
 
-            /* Are we shutting down? */
-            if(pool.shutdown)
+    static size_t eventFindSignaled(const uint32_t* events, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (eventIsSignaled(events[i]))
             {
-                err = shutdown;
-                break;
+                return i;
             }
+        }
 
-            event_t* event = 0;
-            if (handle)
+        return count;
+    }
+
+    static void eventHelpOrPause()
+    {
+        uint32_t job = workerIndex() < scheduler.workerCount ? getJob() : INVALID_HANDLE;
+
+        if (job != INVALID_HANDLE)
+        {
+            executeJob(job);
+        }
+        else
+        {
+            _mm_pause();
+        }
+    }
+
+    size_t eventWaitAny(const uint32_t* events, size_t count)
+    {
+        assert(events && count > 0);
+
+        size_t signaled = eventFindSignaled(events, count);
+
+        for (uint32_t spin = 0; signaled == count && spin < EVENT_SPIN_COUNT; ++spin)
+        {
+            eventHelpOrPause();
+            signaled = eventFindSignaled(events, count);
+        }
+
+        if (signaled != count)
+        {
+            return signaled;
+        }
+
+        // Park: register as waiter first, so signaling thread is guaranteed to broadcast.
+        // Counts are kept per slot, so they stay balanced if events are released meanwhile.
+        for (size_t i = 0; i < count; ++i)
+        {
+            event_t* event = getEventSlotByHandle(events[i]);
+            if (event) _InterlockedIncrement(&event->waiters);
+        }
+
+        SDL_LockMutex(eventTable.parkLock);
+        while ((signaled = eventFindSignaled(events, count)) == count)
+        {
+            SDL_CondWait(eventTable.parkCond, eventTable.parkLock);
+        }
+        SDL_UnlockMutex(eventTable.parkLock);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            event_t* event = getEventSlotByHandle(events[i]);
+            if (event) _InterlockedDecrement(&event->waiters);
+        }
+
+        return signaled;
+    }
+
+    void eventWaitAll(const uint32_t* events, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            eventWaitAny(&events[i], 1);
+        }
+    }
+
+    void eventWait(uint32_t handle)
+    {
+        eventWaitAny(&handle, 1);
+    }
+
+    void syncAndReleaseEvent(uint32_t handle)
+    {
+        eventWaitAny(&handle, 1);
+        eventRelease(handle);
+    }
+
+    //--------------------------------------------------------------------------
+    // Async tasks
+
+    struct async_task_data_t
+    {
+        void    (*function)(void*);
+        void*     argument;
+        uint32_t  event;
+    };
+
+    static_assert(sizeof(async_task_data_t) <= sizeof(((job_data_t*)0)->payload), "async_task_data_t does not fit job payload");
+
+    static void asyncTaskJob(uint32_t, void* arg)
+    {
+        async_task_data_t* task = (async_task_data_t*)arg;
+
+        task->function(task->argument);
+
+        if (task->event != INVALID_HANDLE)
+        {
+            eventSignal(task->event);
+        }
+    }
+
+    int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle)
+    {
+        if (taskFunc == NULL)
+        {
+            return invalidValue;
+        }
+
+        if (scheduler.shutdown)
+        {
+            return shutdown;
+        }
+
+        uint32_t event = INVALID_HANDLE;
+        if (handle)
+        {
+            event = eventCreate();
+            if (event == INVALID_HANDLE)
             {
-                *handle = eventPoolAllocEvent();
-                event = getEventByHandle(*handle);
+                return queueFull;
             }
 
-            /* Add task to queue */
-            pool.queue[pool.tail].function = taskFunc;
-            pool.queue[pool.tail].argument = arg;
-            pool.queue[pool.tail].event    = event;
-            pool.tail = next;
-            pool.count += 1;
+            *handle = event;
+        }
 
-            /* pthread_cond_broadcast */
-            if (SDL_CondSignal(pool.notify) != 0)
+        uint32_t job = jobAlloc(INVALID_HANDLE, asyncTaskJob, 0);
+
+        if (job == INVALID_HANDLE)
+        {
+            if (handle)
             {
-                err = lockFailure;
-                break;
+                eventRelease(event);
+                *handle = INVALID_HANDLE;
             }
+
+            return queueFull;
         }
-        while(0);
 
-        if(SDL_UnlockMutex(pool.lock) != 0)
+        job_data_t* data = jobData(job);
+
+        async_task_data_t task = { taskFunc, arg, event };
+        memcpy(data->payload, &task, sizeof(task));
+        data->arg = data->payload;
+
+        jobRun(job);
+
+        return noError;
+    }
+
+    //--------------------------------------------------------------------------
+    // Workers
+
+    static int SDLCALL workerThread(void* arg)
+    {
+        tlsWorkerIndex = (uint32_t)(uintptr_t)arg;
+        tlsRandomState = 0x9E3779B9u * (tlsWorkerIndex + 1);
+
+        core::thread_data_init();
+
+        char threadName[16];
+        SDL_snprintf(threadName, sizeof(threadName), "Worker%d", tlsWorkerIndex - 1);
+        profilerSetThreadName(threadName);
+
+        uint32_t spin = 0;
+
+        while (!scheduler.shutdown)
         {
-            err = lockFailure;
+            uint32_t job = getJob();
+
+            if (job != INVALID_HANDLE)
+            {
+                executeJob(job);
+                spin = 0;
+                continue;
+            }
+
+            if (++spin < WORKER_SPIN_COUNT)
+            {
+                _mm_pause();
+                continue;
+            }
+
+            // Announce sleep first and check queues again, so push either sees sleeper or job is found here
+            _InterlockedIncrement(&scheduler.sleepingWorkers);
+
+            job = getJob();
+            if (job == INVALID_HANDLE && !scheduler.shutdown)
+            {
+                SDL_SemWaitTimeout(scheduler.wakeup, WORKER_SLEEP_MS);
+            }
+
+            _InterlockedDecrement(&scheduler.sleepingWorkers);
+
+            if (job != INVALID_HANDLE)
+            {
+                executeJob(job);
+            }
+
+            spin = 0;
         }
 
-        return err;
+        core::thread_data_fini();
+
+        return 0;
     }
 
     static void releaseMTResources()
     {
-        assert(pool.started <= 0);
+        assert(scheduler.started <= 0);
 
-        free(pool.queue);
- 
-        SDL_LockMutex(pool.lock);
-        SDL_DestroyMutex(pool.lock);
-        SDL_DestroyCond(pool.notify);
+        if (scheduler.wakeup)
+        {
+            SDL_DestroySemaphore(scheduler.wakeup);
+        }
+
+        for (uint32_t i = 0; scheduler.queues && i < scheduler.workerCount; ++i)
+        {
+            free(scheduler.queues[i].jobs);
+        }
 
-        memset(&pool, 0, sizeof(threadpool_t));
+        _aligned_free(scheduler.queues);
+        _aligned_free(scheduler.jobs);
+
+        memset(&scheduler, 0, sizeof(scheduler_t));
+
+        tlsWorkerIndex = INVALID_HANDLE;
     }
 
-    static int SDLCALL threadpoolThread(void* poolPtr)
+    void init(int threadCount, int jobsPerThread)
     {
-        threadpool_t*   pool = (threadpool_t*)poolPtr;
-        task_t          task;
+        char threadName[16];
+
+        if (threadCount <= 0)
+        {
+            threadCount = core::max(SDL_GetCPUCount() - 1, 1);
+        }
+
+        threadCount = core::min(threadCount, (int)MAX_WORKER_THREADS - 1);
+
+        assert(bit_is_pow2(jobsPerThread));
+        // Extra block of job slots is used by external threads
+        assert((uint32_t)(threadCount + 2) * jobsPerThread <= (1 << core::HANDLE_INDEX_BITS));
+
+        memset(&scheduler, 0, sizeof(scheduler_t));
+
+        scheduler.workerCount   = threadCount + 1;
+        scheduler.jobsPerThread = jobsPerThread;
+
+        size_t totalJobs = (scheduler.workerCount + 1) * scheduler.jobsPerThread;
+
+        scheduler.queues = (job_queue_t*)_aligned_malloc(sizeof(job_queue_t) * scheduler.workerCount, CORE_CACHE_LINE_SIZE);
+        scheduler.jobs   = (job_data_t*) _aligned_malloc(sizeof(job_data_t)  * totalJobs,             CORE_CACHE_LINE_SIZE);
+        scheduler.wakeup = SDL_CreateSemaphore(0);
+
+        if (scheduler.queues == NULL ||
+            scheduler.jobs   == NULL ||
+            scheduler.wakeup == NULL)
+        {
+            goto err;
+        }
+
+        memset(scheduler.queues, 0, sizeof(job_queue_t) * scheduler.workerCount);
+        memset(scheduler.jobs,   0, sizeof(job_data_t)  * totalJobs);
+
+        for (size_t i = 0; i < totalJobs; ++i)
+        {
+            scheduler.jobs[i].handle = core::handle_construct(ID_TYPE_MT_JOB, 0, i);
+        }
 
-        for(;;)
+        for (uint32_t i = 0; i < scheduler.workerCount; ++i)
         {
-            /* Lock must be taken to wait on conditional variable */
-            SDL_LockMutex(pool->lock);
+            scheduler.queues[i].jobs = (uint32_t*)malloc(sizeof(uint32_t) * jobsPerThread);
+            scheduler.queues[i].mask = jobsPerThread - 1;
 
-            /* Wait on condition variable, check for spurious wakeups.
-               When returning from pthread_cond_wait(), we own the lock. */
-            while((pool->count == 0) && (!pool->shutdown))
+            if (scheduler.queues[i].jobs == NULL)
             {
-                SDL_CondWait(pool->notify, pool->lock);
+                goto err;
             }
+        }
+
+        core::mpmc_ring_reset(scheduler.external.queue);
+
+        eventTableCreate();
+
+        // Main thread is worker 0
+        tlsWorkerIndex = 0;
+        tlsRandomState = 0x9E3779B9u;
+
+        for (int i = 0; i < threadCount; i++)
+        {
+            SDL_snprintf(threadName, sizeof(threadName), "Worker%d", i);
 
-            if(pool->shutdown)
+            scheduler.threads[i] = SDL_CreateThread(workerThread, threadName, (void*)(uintptr_t)(i + 1));
+            if (scheduler.threads[i] == 0)
             {
+                // Queues of missing workers stay empty, remaining threads still run all jobs
                 break;
             }
 
-            /* Grab our task */
-            task.function = pool->queue[pool->head].function;
-            task.argument = pool->queue[pool->head].argument;
-            task.event    = pool->queue[pool->head].event;
+            scheduler.started++;
+        }
 
-            pool->head += 1;
-            pool->head = (pool->head == pool->queue_size) ? 0 : pool->head;
-            pool->count -= 1;
+        return;
 
-            /* Unlock */
-            SDL_UnlockMutex(pool->lock);
+    err:
+        releaseMTResources();
+    }
 
-            (*(task.function))(task.argument);
+    void fini()
+    {
+        if (scheduler.shutdown)
+        {
+            return;
+        }
 
-            if (task.event)
-            {
-                SDL_LockMutex(task.event->mutex);
-                task.event->signaled = true;
-                SDL_CondBroadcast(task.event->cond);
-                SDL_UnlockMutex(task.event->mutex);
-            }
+        scheduler.shutdown = 1;
+
+        /* Wake up all worker threads */
+        for (int i = 0; i < scheduler.started; i++)
+        {
+            SDL_SemPost(scheduler.wakeup);
         }
 
-        pool->started--;
+        /* Join all worker thread */
+        for (int i = 0; i < scheduler.started; i++)
+        {
+            SDL_WaitThread(scheduler.threads[i], NULL);
+        }
 
-        SDL_UnlockMutex(pool->lock);
+        scheduler.started = 0;
 
-        return 0;
+        eventTableDestroy();
+        releaseMTResources();
     }
 }
@@ -2,17 +2,140 @@
 #include <core/profiler.h>
 
 #define LOG2_RES 21
-#define MAX_PROFILER_IDS        2048
 
 static_assert(MAX_PROFILER_IDS<=0x10000, "Maximum id should not exceed capacity of uint16_t");
+static_assert((PROFILER_THREAD_EVENTS&(PROFILER_THREAD_EVENTS-1))==0, "Thread event ring size should be power of 2");
+
+struct profiler_raw_event_t
+{
+    uint64_t timestamp;    // TSC
+    uint16_t id;
+    uint16_t phase;
+};
+
+// Written only by owner thread, head is published after event data.
+// Ring of exited thread is reused by thread registered later, head continues
+// from last value, so readers keep their cursors and events of previous owner
+// are still drained and merged, on the same track.
+struct profiler_thread_events_t
+{
+    profiler_raw_event_t events[PROFILER_THREAD_EVENTS];
+    volatile uint32_t    head;
+    uint32_t             slot;
+    uint16_t             tid;
+    char                 name[30];
+};
+
+atomic_t                 profilerRecording = 0;
 
 static atomic_t          lastId        = 0;
-static atomic_t          doCapture     = 0;
 static atomic_t          captureActive = 0;
+static atomic_t          flightRecorderActive = 0;
 static const char*       idNames[MAX_PROFILER_IDS];
+static atomic_t          scopeLock     = 0;
+
+static const profiler_scope_desc_t* idScopes[MAX_PROFILER_IDS];
+
+#if defined(_MSC_VER)
+// Section parts are sorted by name, so all scope descriptors lie between these two
+__declspec(allocate("prfscope$a")) static profiler_scope_desc_t scopesBegin = {0};
+__declspec(allocate("prfscope$z")) static profiler_scope_desc_t scopesEnd   = {0};
+#endif
 
 static event_capture_t capture;
 
+// Range of pending capture in TSC, events are merged on data retrieval
+static uint64_t          captureStartTSC;
+static uint64_t          captureEndTSC;
+static bool              captureMerged = true;
+static uint32_t          flightRecorderWindowMs;
+
+// Reference points to convert TSC to performance counter frequency
+static uint64_t          initTSC;
+static uint64_t          initCounter;
+
+static atomic_t                  numThreadEvents = 0;
+static profiler_thread_events_t* threadEvents[MAX_PROFILER_THREADS];
+
+static CORE_THREAD_LOCAL profiler_thread_events_t* localEvents = 0;
+
+// Slots of exited threads
+static atomic_t          threadSlotsLock = 0;
+static uint32_t          numFreeSlots    = 0;
+static uint32_t          freeSlots[MAX_PROFILER_THREADS];
+
+// Events drained from thread ring during capture, so capture is not limited by ring size
+struct capture_thread_events_t
+{
+    profiler_raw_event_t* events;
+    uint32_t              count;
+    uint32_t              capacity;
+    uint32_t              cursor;   // Next ring index to drain
+
+    // Owner of slot when capture data was taken, slot could be reused before saving
+    uint16_t              tid;
+    char                  name[30];
+};
+
+static capture_thread_events_t captureThreads[MAX_PROFILER_THREADS];
+static uint32_t                captureStoredEvents;
+static uint32_t                captureDroppedEvents;
+static bool                    captureFromRings;
+
+#define MAX_STATS_DEPTH         32
+#define STATS_FRAME_RING_SIZE   64
+
+struct stats_thread_state_t
+{
+    uint32_t cursor;
+    uint32_t depth;
+
+    struct
+    {
+        uint16_t id;
+        uint64_t begin;
+        uint64_t children;
+    } stack[MAX_STATS_DEPTH];
+};
+
+struct profiler_stats_t
+{
+    SDL_Thread*            thread;
+    atomic_t               running;
+
+    uint32_t               numFrames;         // Size of window
+    uint32_t               frameIndex;        // Number of finished frames
+
+    // Frame start timestamps, written by main thread in profilerStartSyncPoint
+    uint64_t               frameStarts[STATS_FRAME_RING_SIZE];
+    volatile uint32_t      frameHead;
+    volatile uint32_t      frameTail;
+
+    stats_thread_state_t   threads[MAX_PROFILER_THREADS];
+
+    // Accumulated times of the current frame in TSC
+    uint64_t               inclusive[MAX_PROFILER_IDS];
+    uint64_t               exclusive[MAX_PROFILER_IDS];
+    uint32_t               calls    [MAX_PROFILER_IDS];
+    uint16_t               parents  [MAX_PROFILER_IDS];
+
+    // numFrames entries per scope
+    float*                 historyInclusive;
+    float*                 historyExclusive;
+    uint16_t*              historyCalls;
+    float*                 sortBuffer;
+
+    uint32_t               pendingSize;
+    profiler_scope_stats_t pending[MAX_PROFILER_IDS];
+
+    atomic_t               tableLock;
+    uint32_t               tableSize;
+    profiler_scope_stats_t table[MAX_PROFILER_IDS];
+};
+
+static atomic_t          statsActive = 0;
+static profiler_stats_t* stats       = 0;
+
 void event_capture_init(event_capture_t* capture, uint64_t freq, uint32_t log2res)
 {
     assert(capture);
@@ -24,24 +147,27 @@ void event_capture_init(event_capture_t* capture, uint64_t freq, uint32_t log2re
     capture->freq       = freq;
     capture->quantShift = quantShift;
     capture->maxPeriod  = (1ul<<TIME_BITS)<<quantShift;
+    capture->maxEvents  = MAX_PROFILER_EVENTS;
 }
 
 void event_capture_start(event_capture_t* capture, uint64_t startTime)
 {
-    capture->numEvents = 0;
-    capture->startTime = startTime;
+    capture->numEvents  = 0;
+    capture->numDropped = 0;
+    capture->startTime  = startTime;
 }
 
 void event_capture_stop(event_capture_t* capture, uint64_t endTime)
 {
     capture->endTime = (uint32_t)core::min((endTime-capture->startTime) >> capture->quantShift, (1ull<<TIME_BITS)-1);
 }
+
+// Not thread safe, captures are filled from per thread rings by single thread
 void event_capture_add(event_capture_t* capture, uint16_t trackID, uint16_t eventID, EventPhase eventPhase, uint64_t ts)
 {
-    atomic_t count = _InterlockedIncrement(&capture->numEvents);
-    if (count<=capture->numEvents)
+    if (capture->numEvents < capture->maxEvents)
     {
-        profiler_event_t&  evt = capture->events[count-1];
+        profiler_event_t&  evt = capture->events[capture->numEvents++];
         evt.id        = eventID;
         evt.phase     = eventPhase;
         evt.tid       = trackID;
@@ -49,25 +175,328 @@ void event_capture_add(event_capture_t* capture, uint16_t trackID, uint16_t even
     }
     else
     {
-        _InterlockedDecrement(&capture->numEvents);
+        ++capture->numDropped;
+    }
+}
+
+static uint64_t profilerTSCFrequency()
+{
+    uint64_t tsc     = __rdtsc();
+    uint64_t counter = SDL_GetPerformanceCounter();
+
+    if (counter == initCounter) return SDL_GetPerformanceFrequency();
+
+    return (uint64_t)((double)(tsc - initTSC) * (double)SDL_GetPerformanceFrequency() / (double)(counter - initCounter));
+}
+
+static profiler_thread_events_t* profilerRegisterThread()
+{
+    profiler_thread_events_t* buffer = 0;
+
+    atomicLock(&threadSlotsLock);
+    if (numFreeSlots)
+    {
+        buffer = threadEvents[freeSlots[--numFreeSlots]];
+    }
+    atomicUnlock(&threadSlotsLock);
+
+    SDL_threadID  tid = SDL_ThreadID();
+    //TODO: Quick hack! Works on win32
+    assert(tid<=65535);
+
+    if (buffer)
+    {
+        buffer->tid     = (uint16_t)tid;
+        buffer->name[0] = 0;
+
+        localEvents = buffer;
+
+        return buffer;
+    }
+
+    long slot = _InterlockedIncrement(&numThreadEvents) - 1;
+    if (slot >= MAX_PROFILER_THREADS)
+    {
+        _InterlockedDecrement(&numThreadEvents);
+        return 0;
+    }
+
+    buffer = (profiler_thread_events_t*)malloc(sizeof(profiler_thread_events_t));
+
+    buffer->head    = 0;
+    buffer->slot    = (uint32_t)slot;
+    buffer->tid     = (uint16_t)tid;
+    buffer->name[0] = 0;
+
+    _ReadWriteBarrier();
+    threadEvents[slot] = buffer;
+    localEvents        = buffer;
+
+    return buffer;
+}
+
+void profilerThreadFini()
+{
+    profiler_thread_events_t* buffer = localEvents;
+    if (!buffer) return;
+
+    localEvents = 0;
+
+    // Ring stays allocated, readers could still be consuming it
+    atomicLock(&threadSlotsLock);
+    freeSlots[numFreeSlots++] = buffer->slot;
+    atomicUnlock(&threadSlotsLock);
+}
+
+// Owners of slots are stored with capture data, slots could be reused before capture is saved
+static void profilerSnapshotThreadNames()
+{
+    uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        profiler_thread_events_t* buffer = threadEvents[t];
+
+        captureThreads[t].tid     = buffer ? buffer->tid : 0;
+        captureThreads[t].name[0] = 0;
+        if (buffer) cstr_copy(captureThreads[t].name, buffer->name);
     }
 }
 
+// Merges per thread event sequences [cursor, end) ordered by time into capture,
+// index of event is masked to support both rings and drained arrays.
+static void profilerMergeEvents(profiler_raw_event_t** events, uint32_t* cursor, uint32_t* end, uint32_t mask,
+                                uint32_t numThreads, uint64_t startTSC, uint64_t endTSC)
+{
+    event_capture_init (&capture, profilerTSCFrequency(), LOG2_RES);
+    event_capture_start(&capture, startTSC);
+
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        while (cursor[t] != end[t] && events[t][cursor[t] & mask].timestamp < startTSC)
+        {
+            ++cursor[t];
+        }
+    }
+
+    for (;;)
+    {
+        uint32_t next   = MAX_PROFILER_THREADS;
+        uint64_t nextTS = endTSC;
+
+        for (uint32_t t = 0; t < numThreads; ++t)
+        {
+            if (cursor[t] == end[t]) continue;
+
+            uint64_t ts = events[t][cursor[t] & mask].timestamp;
+            if (ts <= nextTS)
+            {
+                next   = t;
+                nextTS = ts;
+            }
+        }
+
+        if (next == MAX_PROFILER_THREADS) break;
+
+        profiler_raw_event_t& evt = events[next][cursor[next]++ & mask];
+
+        event_capture_add(&capture, threadEvents[next]->tid, evt.id, (EventPhase)evt.phase, evt.timestamp);
+    }
+
+    event_capture_stop(&capture, endTSC);
+}
+
+// Merges events of all thread rings with timestamps in range [startTSC, endTSC].
+// Owners could still write to rings(flight recorder), so the oldest quarter
+// of every ring is skipped - it would take that many events to overwrite data being merged.
+static void profilerMergeThreadEvents(uint64_t startTSC, uint64_t endTSC)
+{
+    profiler_raw_event_t* events[MAX_PROFILER_THREADS];
+    uint32_t              cursor[MAX_PROFILER_THREADS];
+    uint32_t              end   [MAX_PROFILER_THREADS];
+
+    uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+    uint32_t margin     = flightRecorderActive ? PROFILER_THREAD_EVENTS/4 : 0;
+
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        profiler_thread_events_t* buffer = threadEvents[t];
+
+        events[t] = 0;
+        cursor[t] = end[t] = 0;
+        if (!buffer) continue;
+
+        uint32_t head = buffer->head;
+        _ReadWriteBarrier();
+
+        events[t] = buffer->events;
+        cursor[t] = head - core::min<uint32_t>(head, PROFILER_THREAD_EVENTS - margin);
+        end[t]    = head;
+    }
+
+    profilerMergeEvents(events, cursor, end, PROFILER_THREAD_EVENTS-1, numThreads, startTSC, endTSC);
+}
+
+// Copies events published since last drain into capture arrays. Events overwritten
+// by owner before or during copy and events exceeding MAX_PROFILER_EVENTS are counted as dropped.
+static void profilerDrainCaptureEvents()
+{
+    uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        profiler_thread_events_t* buffer = threadEvents[t];
+        capture_thread_events_t&  dst    = captureThreads[t];
+
+        if (!buffer) continue;
+
+        uint32_t head = buffer->head;
+        _ReadWriteBarrier();
+
+        uint32_t first = dst.cursor;
+        uint32_t count = head - first;
+        uint32_t space = MAX_PROFILER_EVENTS - captureStoredEvents;
+
+        dst.cursor = head;
+
+        if (count > PROFILER_THREAD_EVENTS)
+        {
+            captureDroppedEvents += count - PROFILER_THREAD_EVENTS;
+            first = head - PROFILER_THREAD_EVENTS;
+            count = PROFILER_THREAD_EVENTS;
+        }
+
+        if (count > space)
+        {
+            captureDroppedEvents += count - space;
+            count = space;
+        }
+
+        if (dst.count + count > dst.capacity)
+        {
+            uint32_t capacity = core::max(dst.capacity * 2, core::max<uint32_t>(dst.count + count, PROFILER_THREAD_EVENTS));
+            profiler_raw_event_t* events = (profiler_raw_event_t*)realloc(dst.events, capacity * sizeof(profiler_raw_event_t));
+            if (!events)
+            {
+                captureDroppedEvents += count;
+                continue;
+            }
+
+            dst.events   = events;
+            dst.capacity = capacity;
+        }
+
+        profiler_raw_event_t* out = dst.events + dst.count;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            out[i] = buffer->events[(first + i) & (PROFILER_THREAD_EVENTS-1)];
+        }
+
+        // Writer overwrites index i while storing event i + PROFILER_THREAD_EVENTS, so
+        // only indices after head - PROFILER_THREAD_EVENTS are intact after copy
+        _ReadWriteBarrier();
+        uint32_t lost = buffer->head - first;
+        lost = lost >= PROFILER_THREAD_EVENTS ? core::min(lost - PROFILER_THREAD_EVENTS + 1, count) : 0;
+
+        if (lost)
+        {
+            memmove(out, out + lost, (count - lost) * sizeof(profiler_raw_event_t));
+            captureDroppedEvents += lost;
+            count -= lost;
+        }
+
+        dst.count           += count;
+        captureStoredEvents += count;
+    }
+}
+
+static void profilerMergeCaptureEvents(uint64_t startTSC, uint64_t endTSC)
+{
+    profiler_raw_event_t* events[MAX_PROFILER_THREADS];
+    uint32_t              cursor[MAX_PROFILER_THREADS];
+    uint32_t              end   [MAX_PROFILER_THREADS];
+
+    uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        events[t] = captureThreads[t].events;
+        cursor[t] = 0;
+        end[t]    = threadEvents[t] ? captureThreads[t].count : 0;
+    }
+
+    profilerMergeEvents(events, cursor, end, 0xFFFFFFFF, numThreads, startTSC, endTSC);
+
+    capture.numDropped += captureDroppedEvents;
+}
+
 void profilerInit()
 {
+    initTSC     = __rdtsc();
+    initCounter = SDL_GetPerformanceCounter();
+
+#if defined(_MSC_VER)
+    for (profiler_scope_desc_t* desc = &scopesBegin + 1; desc < &scopesEnd; ++desc)
+    {
+        // Skip padding
+        if (desc->name) profilerRegisterScope(desc);
+    }
+#endif
+
     event_capture_init(&capture, SDL_GetPerformanceFrequency(), LOG2_RES);
 }
 
+void profilerFini()
+{
+    assert(!captureActive);
+
+    profilerStopStats();
+
+    flightRecorderActive = FALSE;
+    profilerRecording    = FALSE;
+
+    for (size_t i = 0; i < MAX_PROFILER_THREADS; ++i)
+    {
+        free(threadEvents[i]);
+        threadEvents[i] = 0;
+
+        free(captureThreads[i].events);
+        mem_zero(&captureThreads[i]);
+    }
+
+    numThreadEvents = 0;
+    localEvents     = 0;
+    numFreeSlots    = 0;
+}
+
 void profilerStartCapture()
 {
-    captureActive = TRUE;
-    event_capture_start(&capture, SDL_GetPerformanceCounter());
+    // Threads registered later start their rings from 0
+    for (uint32_t t = 0; t < MAX_PROFILER_THREADS; ++t)
+    {
+        profiler_thread_events_t* buffer = threadEvents[t];
+
+        captureThreads[t].count  = 0;
+        captureThreads[t].cursor = buffer ? buffer->head : 0;
+    }
+
+    captureStoredEvents  = 0;
+    captureDroppedEvents = 0;
+
+    captureStartTSC = __rdtsc();
+    captureActive   = TRUE;
 }
 
 void profilerStopCapture()
 {
     captureActive = FALSE;
-    event_capture_stop(&capture, SDL_GetPerformanceCounter());
+    captureEndTSC = __rdtsc();
+
+    profilerDrainCaptureEvents();
+    profilerSnapshotThreadNames();
+
+    captureFromRings = false;
+    captureMerged    = false;
 }
 
 int profilerIsCaptureActive()
@@ -75,29 +504,322 @@ int profilerIsCaptureActive()
     return captureActive;
 }
 
+void profilerStartFlightRecorder(uint32_t windowMs)
+{
+    flightRecorderWindowMs = windowMs;
+    flightRecorderActive   = TRUE;
+}
+
+void profilerStopFlightRecorder()
+{
+    flightRecorderActive = FALSE;
+}
+
+int profilerIsFlightRecorderActive()
+{
+    return flightRecorderActive;
+}
+
+void profilerSnapshotFlightRecorder()
+{
+    assert(!captureActive);
+
+    uint64_t window = profilerTSCFrequency() * flightRecorderWindowMs / 1000;
+
+    captureEndTSC   = __rdtsc();
+    captureStartTSC  = captureEndTSC - core::min(window, captureEndTSC - initTSC);
+    captureFromRings = true;
+    captureMerged    = false;
+
+    profilerSnapshotThreadNames();
+}
+
+static int compareFloat(const void* a, const void* b)
+{
+    float fa = *(const float*)a;
+    float fb = *(const float*)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+static float profilerPercentile(const float* sorted, uint32_t count, float p)
+{
+    // Nearest rank
+    uint32_t rank = (uint32_t)ml::ceil(p * count);
+    return sorted[core::max<uint32_t>(core::min(rank, count), 1) - 1];
+}
+
+static void profilerStatsConsume(stats_thread_state_t* state, profiler_thread_events_t* buffer, uint64_t frameStart, uint64_t frameEnd)
+{
+    uint32_t head = buffer->head;
+    _ReadWriteBarrier();
+
+    // Owner overwrote unread events, nesting is lost
+    if (head - state->cursor > PROFILER_THREAD_EVENTS - PROFILER_THREAD_EVENTS/4)
+    {
+        state->cursor = head - (PROFILER_THREAD_EVENTS - PROFILER_THREAD_EVENTS/4);
+        state->depth  = 0;
+    }
+
+    for (; state->cursor != head; ++state->cursor)
+    {
+        const profiler_raw_event_t& evt = buffer->events[state->cursor & (PROFILER_THREAD_EVENTS-1)];
+
+        if (evt.timestamp >= frameEnd) break;
+        if (evt.timestamp <  frameStart) continue;
+
+        uint32_t depth = state->depth;
+
+        if (evt.phase == PROF_EVENT_PHASE_BEGIN)
+        {
+            if (depth < MAX_STATS_DEPTH)
+            {
+                state->stack[depth].id       = evt.id;
+                state->stack[depth].begin    = evt.timestamp;
+                state->stack[depth].children = 0;
+
+                stats->parents[evt.id] = depth > 0 ? state->stack[depth-1].id : PROFILER_INVALID_ID;
+            }
+
+            state->depth = depth + 1;
+        }
+        else if (evt.phase == PROF_EVENT_PHASE_END && depth > 0)
+        {
+            uint32_t top = depth - 1;
+
+            if (top < MAX_STATS_DEPTH)
+            {
+                //ignore not opened interval
+                if (state->stack[top].id != evt.id) continue;
+
+                uint64_t inclusive = evt.timestamp - state->stack[top].begin;
+
+                stats->inclusive[evt.id] += inclusive;
+                stats->exclusive[evt.id] += inclusive - core::min(inclusive, state->stack[top].children);
+                stats->calls    [evt.id] += 1;
+
+                if (top > 0) state->stack[top-1].children += inclusive;
+            }
+
+            state->depth = top;
+        }
+    }
+}
+
+static void profilerStatsFinishFrame()
+{
+    uint32_t numIds    = core::min<uint32_t>(lastId, MAX_PROFILER_IDS);
+    uint32_t numFrames = stats->numFrames;
+    uint32_t slot      = stats->frameIndex % numFrames;
+    double   scale     = 1000000.0 / (double)profilerTSCFrequency();
+
+    for (uint32_t id = 0; id < numIds; ++id)
+    {
+        stats->historyInclusive[id*numFrames + slot] = (float)(stats->inclusive[id] * scale);
+        stats->historyExclusive[id*numFrames + slot] = (float)(stats->exclusive[id] * scale);
+        stats->historyCalls    [id*numFrames + slot] = (uint16_t)core::min<uint32_t>(stats->calls[id], 0xFFFF);
+
+        stats->inclusive[id] = 0;
+        stats->exclusive[id] = 0;
+        stats->calls    [id] = 0;
+    }
+
+    ++stats->frameIndex;
+
+    uint32_t window = core::min(stats->frameIndex, numFrames);
+
+    stats->pendingSize = 0;
+    for (uint32_t id = 0; id < numIds; ++id)
+    {
+        const float*    incl  = stats->historyInclusive + id*numFrames;
+        const float*    excl  = stats->historyExclusive + id*numFrames;
+        const uint16_t* calls = stats->historyCalls     + id*numFrames;
+
+        uint32_t count      = 0;
+        uint32_t totalCalls = 0;
+        float    sumIncl    = 0.0f;
+        float    sumExcl    = 0.0f;
+
+        for (uint32_t f = 0; f < window; ++f)
+        {
+            if (calls[f] == 0) continue;
+
+            stats->sortBuffer[count++] = incl[f];
+
+            totalCalls += calls[f];
+            sumIncl    += incl[f];
+            sumExcl    += excl[f];
+        }
+
+        if (count == 0) continue;
+
+        qsort(stats->sortBuffer, count, sizeof(float), compareFloat);
+
+        profiler_scope_stats_t& entry = stats->pending[stats->pendingSize++];
+
+        entry.id            = (uint16_t)id;
+        entry.parentId      = stats->parents[id];
+        entry.numFrames     = count;
+        entry.callsPerFrame = (float)totalCalls / count;
+        entry.inclusiveMin  = stats->sortBuffer[0];
+        entry.inclusiveAvg  = sumIncl / count;
+        entry.inclusiveMax  = stats->sortBuffer[count-1];
+        entry.exclusiveAvg  = sumExcl / count;
+        entry.p50           = profilerPercentile(stats->sortBuffer, count, 0.50f);
+        entry.p95           = profilerPercentile(stats->sortBuffer, count, 0.95f);
+        entry.p99           = profilerPercentile(stats->sortBuffer, count, 0.99f);
+    }
+
+    atomicLock(&stats->tableLock);
+    memcpy(stats->table, stats->pending, stats->pendingSize * sizeof(profiler_scope_stats_t));
+    stats->tableSize = stats->pendingSize;
+    atomicUnlock(&stats->tableLock);
+}
+
+static int SDLCALL profilerStatsThread(void*)
+{
+    while (stats->running)
+    {
+        // Frame is complete when start of the next one is known
+        while (stats->frameHead - stats->frameTail >= 2)
+        {
+            uint32_t tail       = stats->frameTail;
+            uint64_t frameStart = stats->frameStarts[ tail    & (STATS_FRAME_RING_SIZE-1)];
+            uint64_t frameEnd   = stats->frameStarts[(tail+1) & (STATS_FRAME_RING_SIZE-1)];
+
+            uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+            for (uint32_t t = 0; t < numThreads; ++t)
+            {
+                if (threadEvents[t])
+                {
+                    profilerStatsConsume(&stats->threads[t], threadEvents[t], frameStart, frameEnd);
+                }
+            }
+
+            profilerStatsFinishFrame();
+
+            _ReadWriteBarrier();
+            stats->frameTail = tail + 1;
+        }
+
+        SDL_Delay(1);
+    }
+
+    return 0;
+}
+
+void profilerStartStats(uint32_t numFrames)
+{
+    assert(numFrames > 0 && numFrames <= MAX_PROFILER_STATS_FRAMES);
+
+    if (statsActive) return;
+
+    stats = (profiler_stats_t*)malloc(sizeof(profiler_stats_t));
+    mem_zero(stats);
+
+    stats->numFrames        = numFrames;
+    stats->historyInclusive = (float*)   malloc(MAX_PROFILER_IDS * numFrames * sizeof(float));
+    stats->historyExclusive = (float*)   malloc(MAX_PROFILER_IDS * numFrames * sizeof(float));
+    stats->historyCalls     = (uint16_t*)malloc(MAX_PROFILER_IDS * numFrames * sizeof(uint16_t));
+    stats->sortBuffer       = (float*)   malloc(numFrames * sizeof(float));
+
+    // Ids that appear later have no samples for earlier frames of the window
+    mem_zero(stats->historyInclusive, MAX_PROFILER_IDS * numFrames);
+    mem_zero(stats->historyExclusive, MAX_PROFILER_IDS * numFrames);
+    mem_zero(stats->historyCalls,     MAX_PROFILER_IDS * numFrames);
+
+    // Start with events recorded from now on
+    uint32_t numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+    for (uint32_t t = 0; t < numThreads; ++t)
+    {
+        if (threadEvents[t]) stats->threads[t].cursor = threadEvents[t]->head;
+    }
+
+    stats->running = TRUE;
+    stats->thread  = SDL_CreateThread(profilerStatsThread, "ProfilerStats", 0);
+
+    statsActive = TRUE;
+}
+
+void profilerStopStats()
+{
+    if (!statsActive) return;
+
+    statsActive    = FALSE;
+    stats->running = FALSE;
+    SDL_WaitThread(stats->thread, 0);
+
+    free(stats->historyInclusive);
+    free(stats->historyExclusive);
+    free(stats->historyCalls);
+    free(stats->sortBuffer);
+    free(stats);
+
+    stats = 0;
+}
+
+int profilerIsStatsActive()
+{
+    return statsActive;
+}
+
+uint32_t profilerGetStats(profiler_scope_stats_t* result, uint32_t maxCount)
+{
+    if (!statsActive) return 0;
+
+    atomicLock(&stats->tableLock);
+    uint32_t count = core::min(stats->tableSize, maxCount);
+    memcpy(result, stats->table, count * sizeof(profiler_scope_stats_t));
+    atomicUnlock(&stats->tableLock);
+
+    return count;
+}
+
 void profilerStartSyncPoint()
 {
-    doCapture = captureActive;
+    profilerRecording = captureActive || flightRecorderActive || statsActive;
+
+    // Rings hold only last events of every thread, long captures are drained every frame
+    if (captureActive)
+    {
+        profilerDrainCaptureEvents();
+    }
+
+    // Drop frame boundary if statistics thread is too far behind, two frames are merged then
+    if (statsActive && stats->frameHead - stats->frameTail < STATS_FRAME_RING_SIZE)
+    {
+        uint32_t head = stats->frameHead;
+        stats->frameStarts[head & (STATS_FRAME_RING_SIZE-1)] = __rdtsc();
+        _ReadWriteBarrier();
+        stats->frameHead = head + 1;
+    }
 }
 
 void profilerStopSyncPoint()
 {
-    if (!captureActive)
+    if (!captureActive && !flightRecorderActive && !statsActive)
     {
-        doCapture = FALSE;
+        profilerRecording = FALSE;
     }
 }
 
 void profilerAddCPUEvent(uint16_t id, EventPhase eventPhase)
 {
     assert(id < lastId);
-    if (!doCapture) return;
+    if (!profilerRecording) return;
 
-    SDL_threadID  tid = SDL_ThreadID();
-    //TODO: Quick hack! Works on win32
-    assert(tid<=65535);
+    profiler_thread_events_t* buffer = localEvents;
+    if (!buffer && !(buffer = profilerRegisterThread())) return;
+
+    uint32_t              head = buffer->head;
+    profiler_raw_event_t& evt  = buffer->events[head & (PROFILER_THREAD_EVENTS-1)];
+
+    evt.timestamp = __rdtsc();
+    evt.id        = id;
+    evt.phase     = (uint16_t)eventPhase;
 
-    event_capture_add(&capture, (uint16_t)tid, id, eventPhase, SDL_GetPerformanceCounter());
+    _ReadWriteBarrier();
+    buffer->head = head + 1;
 }
 
 uint16_t profilerGenerateId()
@@ -113,14 +835,107 @@ void profilerAddDesc(uint16_t id, const char* name)
     idNames[id] = name;
 }
 
+void profilerRegisterScope(profiler_scope_desc_t* desc)
+{
+    atomicLock(&scopeLock);
+
+    if (desc->id == PROFILER_INVALID_ID)
+    {
+        uint16_t id = profilerGenerateId();
+
+        profilerAddDesc(id, desc->name);
+        idScopes[id] = desc;
+
+        _ReadWriteBarrier();
+        desc->id = id;
+    }
+
+    atomicUnlock(&scopeLock);
+}
+
+const profiler_scope_desc_t* profilerGetScopeDesc(uint16_t id)
+{
+    assert(id<lastId);
+    return idScopes[id];
+}
+
+void profilerSetThreadName(const char* name)
+{
+    profiler_thread_events_t* buffer = localEvents;
+    if (!buffer && !(buffer = profilerRegisterThread())) return;
+
+    cstr_copy(buffer->name, name);
+}
+
 event_capture_t* profilerGetData()
 {
-    assert(!captureActive && !doCapture);
+    assert(!captureActive);
+
+    if (!captureMerged)
+    {
+        if (captureFromRings)
+        {
+            profilerMergeThreadEvents(captureStartTSC, captureEndTSC);
+        }
+        else
+        {
+            profilerMergeCaptureEvents(captureStartTSC, captureEndTSC);
+        }
+        captureMerged = true;
+    }
+
     return &capture;
 }
 
 const char** profilerGetNames()
 {
-    assert(!captureActive && !doCapture);
+    assert(!captureActive);
     return idNames;
 }
+
+bool profilerSaveCapture(const char* path)
+{
+    event_capture_t* data = profilerGetData();
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    profiler_capture_header_t header;
+
+    header.magic      = PROFILER_CAPTURE_MAGIC;
+    header.version    = PROFILER_CAPTURE_VERSION;
+    header.freq       = data->freq;
+    header.quantShift = data->quantShift;
+    header.endTime    = data->endTime;
+    header.numEvents  = data->numEvents;
+    header.numThreads = core::min<uint32_t>(numThreadEvents, MAX_PROFILER_THREADS);
+    header.numNames   = lastId;
+    header.numDropped = data->numDropped;
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (uint32_t i = 0; success && i < header.numThreads; ++i)
+    {
+        profiler_capture_thread_t thread;
+        mem_zero(&thread);
+
+        thread.tid = captureThreads[i].tid;
+        cstr_copy(thread.name, captureThreads[i].name);
+
+        success = fwrite(&thread, sizeof(thread), 1, file) == 1;
+    }
+
+    for (uint32_t i = 0; success && i < header.numNames; ++i)
+    {
+        uint16_t length = idNames[i] ? (uint16_t)cstr_len(idNames[i], 0xFFFF) : 0;
+
+        success = fwrite(&length, sizeof(length), 1, file) == 1 &&
+                  fwrite(idNames[i], 1, length, file) == length;
+    }
+
+    success = success && fwrite(data->events, sizeof(profiler_event_t), data->numEvents, file) == data->numEvents;
+
+    fclose(file);
+
+    return success;
+}
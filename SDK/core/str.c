@@ -1,5 +1,9 @@
 #include <core/str.h>
+#include <float.h>
 #include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 /*
 ------------------------------------------------------------------------------------------------------------------------
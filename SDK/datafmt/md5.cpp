@@ -1,6 +1,7 @@
 #include "datafmt/md5.h"
 
-const char endl[] = "\r\n";
+// Parentheses around vectors are parsed as white space
+static const char md5Delims[] = " \t()";
 
 void build_w_quat( ml::quat& quat )
 {
@@ -15,237 +16,452 @@ void build_w_quat( ml::quat& quat )
     }
 }
 
-bool md5meshConvertToBinary(blob32_t inText, blob32_t outBinary)
+// Next non blank line without leading white space
+static bool md5NextLine(text_reader_t* reader, str_view_t* line)
+{
+    while (text_reader_line(reader, line))
+    {
+        while (line->size && (line->str[0] == ' ' || line->str[0] == '\t'))
+        {
+            ++line->str;
+            --line->size;
+        }
+
+        if (line->size) return true;
+    }
+
+    return false;
+}
+
+static bool md5ParseInt(str_view_t* line, int* value)
+{
+    str_view_t token;
+    intmax_t   res;
+
+    if (!str_next_token(line, &token, md5Delims) || cstr_toimax(token.str, token.size, 10, 0, &res) != EOK)
+        return false;
+
+    *value = (int)res;
+
+    return true;
+}
+
+static bool md5ParseFloats(str_view_t* line, float* values, size_t count)
+{
+    str_view_t token;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!str_next_token(line, &token, md5Delims) || cstr_tofloat(token.str, token.size, 0, &values[i]) != EOK)
+            return false;
+    }
+
+    return true;
+}
+
+// Quoted string, could contain spaces
+static bool md5ParseString(str_view_t* line, char* str, size_t size)
+{
+    const char* end   = line->str + line->size;
+    const char* first = (const char*)memchr(line->str, '"', line->size);
+
+    if (!first || first + 1 == end) return false;
+
+    ++first;
+
+    const char* last = (const char*)memchr(first, '"', end - first);
+
+    if (!last) last = end;
+
+    size_t len = core::min<size_t>(last - first, size - 1);
+
+    mem_copy(str, first, len);
+    str[len] = 0;
+
+    return true;
+}
+
+// Output is sized by caller, conversion fails instead of overflowing it
+template <typename type>
+static type* md5AllocArray(blob32_t outBinary, size_t count, size_t& write_offset)
+{
+    if (write_offset > outBinary->size || count > (outBinary->size - write_offset) / sizeof(type))
+        return 0;
+
+    return mem_as_array_advance<type>(blob32_data(outBinary), count, write_offset);
+}
+
+static bool md5meshConvert(text_reader_t* reader, blob32_t outBinary)
 {
     size_t write_offset = 0;
     uint8_t* outData = blob32_data(outBinary);
-    md5_model_t* model = mem_as_ptr_advance<md5_model_t>(outData, write_offset);
+    md5_model_t* model = md5AllocArray<md5_model_t>(outBinary, 1, write_offset);
+
+    if (!model) return false;
 
     mem_set(outData, outBinary->size, 0);
 
-    const char* str = (const char*)blob32_data(inText);
-    rsize_t     str_size = inText->size;
-    const char* line = NULL;
-    rsize_t     line_size = 0;
-    cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+    str_view_t line;
+    str_view_t token;
 
     int int_val = 0;
-    int ind;
 
     unsigned int mesh_index = 0;
 
-    while (line)
+    while (md5NextLine(reader, &line))
     {
-        if (cstr_scanf(line, line_size, "MD5Version %d", &int_val) == 1)
+        if (!str_next_token(&line, &token, md5Delims))
+            continue;
+
+        if (str_equal(token, "MD5Version") && md5ParseInt(&line, &int_val))
         {
             if (int_val != 10) return false;
 
             model->version = int_val;
         }
 
-        else if (cstr_scanf(line, line_size, "numJoints %d", &int_val) == 1)
+        else if (str_equal(token, "numJoints") && md5ParseInt(&line, &int_val))
         {
             model->numJoints = int_val;
-            model->joints    = mem_as_array_advance<md5_joint_t>(outData, model->numJoints, write_offset);
+            model->joints    = md5AllocArray<md5_joint_t>(outBinary, model->numJoints, write_offset);
+
+            if (!model->joints) return false;
         }
 
-        else if(cstr_scanf(line, line_size, "numMeshes %d", &int_val) == 1)
+        else if (str_equal(token, "numMeshes") && md5ParseInt(&line, &int_val))
         {
             model->numMeshes = int_val;
-            model->meshes    = mem_as_array_advance<md5_mesh_t>(outData, model->numMeshes, write_offset);
+            model->meshes    = md5AllocArray<md5_mesh_t>(outBinary, model->numMeshes, write_offset);
+
+            if (!model->meshes) return false;
         }
 
-        else if (cstr_compare(line, 8, "joints {", &ind) == EOK && ind == 0)
+        else if (str_equal(token, "joints"))
         {
-            char name[64];
             unsigned int i      =  0;
             int          parent = -1;
+            float        values[6];
 
-            cstr_tokenize(endl, &str, &str_size, &line, &line_size);
-
-            while (line_size && line[ 0 ] != '}')
+            while (md5NextLine(reader, &line) && line.str[0] != '}')
             {
-                ml::quat      rotation;
-                ml::vec3      location;
-
-                if (cstr_scanf(line, line_size,
-                    "%s %d ( %f %f %f ) ( %f %f %f )",
-                    name, ARRAY_SIZE(name), &parent,
-                    &location.x, &location.y, &location.z,
-                    &rotation.x, &rotation.y, &rotation.z) == 8)
-                {
-                    build_w_quat(rotation);
+                str_view_t name;
 
+                // Name is stored as is, with quotes
+                if (i < model->numJoints &&
+                    str_next_token(&line, &name) &&
+                    md5ParseInt(&line, &parent) &&
+                    md5ParseFloats(&line, values, 6))
+                {
                     md5_joint_t* joint = model->joints+i;
 
-                    mem_copy(joint->name, name, 64);
-                    joint->parent   = parent;
-                    joint->location = location;
-                    joint->rotation = rotation;
+                    size_t len = core::min<size_t>(name.size, ARRAY_SIZE(joint->name) - 1);
+
+                    mem_copy(joint->name, name.str, len);
+                    joint->parent     = parent;
+                    joint->location.x = values[0];
+                    joint->location.y = values[1];
+                    joint->location.z = values[2];
+                    joint->rotation.x = values[3];
+                    joint->rotation.y = values[4];
+                    joint->rotation.z = values[5];
+
+                    build_w_quat(joint->rotation);
 
                     ++i;
                 }
-
-                cstr_tokenize(endl, &str, &str_size, &line, &line_size);
             }
         }
 
-        else if (cstr_compare(line, 6, "mesh {", &ind) == EOK && ind == 0)
+        else if (str_equal(token, "mesh") && mesh_index < model->numMeshes)
         {
             md5_vertex_t    md5vertex;
             md5_weight_t    md5weight;
-            uint16_t        md5triangle[3];
-            char            shader[128];
-
-            cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+            int             md5triangle[3];
+            int             index;
+            float           values[3];
 
             md5_mesh_t* mesh = model->meshes+mesh_index;
 
-            while (line_size && line[ 0 ] != '}')
+            while (md5NextLine(reader, &line) && line.str[0] != '}')
             {
-                if (cstr_scanf(line, line_size, " shader \"%[^\"]", shader, ARRAY_SIZE(shader)) == 1)
+                if (!str_next_token(&line, &token, md5Delims))
+                    continue;
+
+                if (str_equal(token, "shader"))
                 {
-                    mem_copy(mesh->shader, shader, 128);
+                    md5ParseString(&line, mesh->shader, ARRAY_SIZE(mesh->shader));
                 }
 
-                else if (cstr_scanf(line, line_size, " numverts %d", &int_val) == 1)
+                else if (str_equal(token, "numverts") && md5ParseInt(&line, &int_val))
                 {
                     mesh->numVertices = int_val;
-                    mesh->vertices    = mem_as_array_advance<md5_vertex_t>(outData, mesh->numVertices, write_offset);
+                    mesh->vertices    = md5AllocArray<md5_vertex_t>(outBinary, mesh->numVertices, write_offset);
+
+                    if (!mesh->vertices) return false;
                 }
 
-                else if (cstr_scanf(line, line_size, " vert %d ( %f %f ) %d %d",
-                                &int_val,
-                                &md5vertex.u, &md5vertex.v,
-                                &md5vertex.start,
-                                &md5vertex.count) == 5)
+                else if (str_equal(token, "vert") &&
+                         md5ParseInt(&line, &index) && (uint32_t)index < mesh->numVertices &&
+                         md5ParseFloats(&line, &md5vertex.u, 1) &&
+                         md5ParseFloats(&line, &md5vertex.v, 1) &&
+                         md5ParseInt(&line, (int*)&md5vertex.start) &&
+                         md5ParseInt(&line, (int*)&md5vertex.count))
                 {
-                    mem_copy(&mesh->vertices[int_val], &md5vertex, sizeof(md5vertex));
+                    mem_copy(&mesh->vertices[index], &md5vertex, sizeof(md5vertex));
                 }
 
-                else if (cstr_scanf(line, line_size, " numtris %d", &int_val) == 1)
+                else if (str_equal(token, "numtris") && md5ParseInt(&line, &int_val))
                 {
                     mesh->numIndices = int_val * 3;
-                    mesh->indices    = mem_as_array_advance<uint16_t>(outData, mesh->numIndices, write_offset);
+                    mesh->indices    = md5AllocArray<uint16_t>(outBinary, mesh->numIndices, write_offset);
+
+                    if (!mesh->indices) return false;
                 }
 
-                else if (cstr_scanf(line, line_size, " tri %d %hu %hu %hu",
-                    &int_val,
-                    &md5triangle[ 0 ],
-                    &md5triangle[ 1 ],
-                    &md5triangle[ 2 ]) == 4)
+                else if (str_equal(token, "tri") &&
+                         md5ParseInt(&line, &index) && (uint32_t)index * 3 < mesh->numIndices &&
+                         md5ParseInt(&line, &md5triangle[0]) &&
+                         md5ParseInt(&line, &md5triangle[1]) &&
+                         md5ParseInt(&line, &md5triangle[2]))
                 {
-                    mem_copy(&mesh->indices[int_val*3], md5triangle, sizeof(md5triangle));
+                    mesh->indices[index*3+0] = (uint16_t)md5triangle[0];
+                    mesh->indices[index*3+1] = (uint16_t)md5triangle[1];
+                    mesh->indices[index*3+2] = (uint16_t)md5triangle[2];
                 }
 
-                else if (cstr_scanf(line, line_size, " numweights %d", &int_val) == 1)
+                else if (str_equal(token, "numweights") && md5ParseInt(&line, &int_val))
                 {
                     mesh->numWeights = int_val;
-                    mesh->weights    = mem_as_array_advance<md5_weight_t>(outData, mesh->numWeights, write_offset);
-                }
+                    mesh->weights    = md5AllocArray<md5_weight_t>(outBinary, mesh->numWeights, write_offset);
 
-                else if (cstr_scanf(line, line_size, " weight %d %d %f ( %f %f %f )",
-                    &int_val,
-                    &md5weight.joint,
-                    &md5weight.bias,
-                    &md5weight.location.x,
-                    &md5weight.location.y,
-                    &md5weight.location.z) == 6)
+                    if (!mesh->weights) return false;
+                }
 
+                else if (str_equal(token, "weight") &&
+                         md5ParseInt(&line, &index) && (uint32_t)index < mesh->numWeights &&
+                         md5ParseInt(&line, &md5weight.joint) &&
+                         md5ParseFloats(&line, &md5weight.bias, 1) &&
+                         md5ParseFloats(&line, values, 3))
                 {
-                    mem_copy(&mesh->weights[int_val], &md5weight, sizeof(md5weight));
-                }
+                    md5weight.location.x = values[0];
+                    md5weight.location.y = values[1];
+                    md5weight.location.z = values[2];
 
-                cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+                    mem_copy(&mesh->weights[index], &md5weight, sizeof(md5weight));
+                }
             }
 
             ++mesh_index;
         }
+    }
+
+    return true;
+}
+
+enum
+{
+    MD5_FRAME_GRAIN_SIZE = 4,
+};
+
+struct md5_frames_job_t
+{
+    const char*       text;
+    size_t            size;
+    const size_t*     offsets;  // start of first joint line of each frame
+    md5_anim_data_t*  frameData;
+    uint32_t          numJoints;
+};
+
+// Frame is bulk of the file: one joint per line, no parentheses
+static void md5ParseFrame(text_reader_t* reader, md5_anim_data_t* data, uint32_t numJoints)
+{
+    str_view_t line;
 
-        cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+    for (uint32_t i = 0; i != numJoints && md5NextLine(reader, &line); ++i)
+    {
+        float values[6];
+
+        if (cstr_tofloats(line.str, line.size, 0, values, 6) == 6)
+        {
+            data[i].location.x = values[0];
+            data[i].location.y = values[1];
+            data[i].location.z = values[2];
+            data[i].rotation.x = values[3];
+            data[i].rotation.y = values[4];
+            data[i].rotation.z = values[5];
+
+            build_w_quat(data[i].rotation);
+        }
     }
+}
 
-    assert(write_offset < outBinary->size);
+static void md5ParseFramesJob(uint32_t begin, uint32_t end, void* arg)
+{
+    md5_frames_job_t* job = (md5_frames_job_t*)arg;
 
-    return true;
+    for (uint32_t f = begin; f < end; ++f)
+    {
+        text_reader_t reader;
+
+        text_reader_init(&reader, job->text + job->offsets[f], job->size - job->offsets[f]);
+        md5ParseFrame(&reader, job->frameData + f * job->numJoints, job->numJoints);
+    }
 }
 
-bool md5animConvertToBinary(blob32_t inText, blob32_t outBinary)
+// Text should be in memory as a whole: header is parsed and frame blocks are indexed
+// in one pass that only splits lines, then frames are parsed in parallel directly
+// into preallocated output
+static bool md5animConvert(const char* text, size_t size, blob32_t outBinary)
 {
+    PROFILER_CPU_TIMESLICE("md5animConvert");
+
     size_t write_offset = 0;
     uint8_t* outData = blob32_data(outBinary);
-    md5_anim_t* anim = mem_as_ptr_advance<md5_anim_t>(outData, write_offset);
+    md5_anim_t* anim = md5AllocArray<md5_anim_t>(outBinary, 1, write_offset);
+
+    if (!anim) return false;
 
     mem_set(outData, outBinary->size, 0);
 
-    const char* str = (const char*)blob32_data(inText);
-    rsize_t     str_size = inText->size;
-    const char* line = NULL;
-    rsize_t     line_size = 0;
-    cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+    text_reader_t reader;
+    str_view_t    line;
+    str_view_t    token;
 
     int int_val = 0;
 
-    while (line)
+    size_t*  offsets   = 0;
+    uint32_t numFrames = 0;
+
+    text_reader_init(&reader, text, size);
+
+    while (md5NextLine(&reader, &line))
     {
-        if (cstr_scanf(line, line_size, "MD5Version %d", &int_val) == 1)
+        if (!str_next_token(&line, &token, md5Delims))
+            continue;
+
+        if (str_equal(token, "MD5Version") && md5ParseInt(&line, &int_val))
         {
-            if (int_val != 10) return false;
+            if (int_val != 10) break;
 
             anim->version = int_val;
         }
 
-        else if (cstr_scanf(line, line_size, "numFrames %d", &int_val) == 1)
+        else if (str_equal(token, "numFrames") && md5ParseInt(&line, &int_val) && !offsets)
         {
             anim->numFrames = int_val;
         }
 
-        else if (cstr_scanf(line, line_size, "numJoints %d", &int_val) == 1)
+        else if (str_equal(token, "numJoints") && md5ParseInt(&line, &int_val) && !offsets)
         {
             anim->numJoints = int_val;
-            anim->frameData = mem_as_ptr<md5_anim_data_t>(outData, write_offset); // get current pointer without incrementing allocated size
         }
 
-        else if (cstr_scanf(line, line_size, "frameRate %d", &int_val) == 1)
-        { 
+        else if (str_equal(token, "frameRate") && md5ParseInt(&line, &int_val))
+        {
             anim->frameRate = int_val;
         }
 
-        else if (cstr_scanf(line, line_size, "frame %d", &int_val))
+        else if (str_equal(token, "frame") && md5ParseInt(&line, &int_val))
         {
-            md5_anim_data_t* data = mem_as_array_advance<md5_anim_data_t>(outData, anim->numJoints, write_offset);
+            if (!offsets)
+            {
+                offsets = (size_t*)malloc(sizeof(size_t) * core::max(anim->numFrames, 1u));
+                if (!offsets) break;
+            }
 
-            cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+            // Frames are stored in file order like before, extra ones are skipped
+            if (numFrames < anim->numFrames)
+            {
+                offsets[numFrames++] = reader.cur - text;
+            }
 
-            unsigned int i = 0;
+            for (uint32_t i = 0; i != anim->numJoints && md5NextLine(&reader, &line); ++i) ;
+        }
+    }
 
-            while (i != anim->numJoints)
-            {
-                ml::quat rotation;
-                ml::vec3 location;
+    if (anim->version != 10)
+    {
+        free(offsets);
+        return false;
+    }
 
-                if (cstr_scanf(line, line_size,
-                    " %f %f %f %f %f %f",
-                    &location.x, &location.y, &location.z,
-                    &rotation.x, &rotation.y, &rotation.z) == 6)
-                {
-                    build_w_quat(rotation);
+    anim->frameData = md5AllocArray<md5_anim_data_t>(outBinary, (size_t)anim->numFrames * anim->numJoints, write_offset);
 
-                    data[i].location = location;
-                    data[i].rotation = rotation;
-                }
+    if (!anim->frameData)
+    {
+        free(offsets);
+        return false;
+    }
 
-                cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+    if (numFrames)
+    {
+        PROFILER_CPU_TIMESLICE("md5animParseFrames");
 
-                ++i;
-            }
-        }
+        md5_frames_job_t job = { text, size, offsets, anim->frameData, anim->numJoints };
 
-        cstr_tokenize(endl, &str, &str_size, &line, &line_size);
+        mt::jobWait(mt::parallelFor(md5ParseFramesJob, &job, numFrames, MD5_FRAME_GRAIN_SIZE));
     }
 
-    assert(write_offset < outBinary->size);
+    free(offsets);
 
     return true;
 }
 
+bool md5meshConvertToBinary(blob32_t inText, blob32_t outBinary)
+{
+    text_reader_t reader;
+
+    text_reader_init(&reader, (const char*)blob32_data(inText), inText->size);
+
+    return md5meshConvert(&reader, outBinary);
+}
+
+bool md5animConvertToBinary(blob32_t inText, blob32_t outBinary)
+{
+    return md5animConvert((const char*)blob32_data(inText), inText->size, outBinary);
+}
+
+bool md5meshConvertToBinary(const char* name, blob32_t outBinary)
+{
+    text_reader_t reader;
+
+    if (!text_reader_open(&reader, name)) return false;
+
+    bool result = md5meshConvert(&reader, outBinary);
+
+    text_reader_close(&reader);
+
+    return result;
+}
+
+// Frames are indexed by offset, so text is needed as a whole:
+// mapped file is used directly, otherwise file is read into memory
+bool md5animConvertToBinary(const char* name, blob32_t outBinary)
+{
+    text_reader_t reader;
+
+    if (!text_reader_open(&reader, name)) return false;
+
+    bool result;
+
+    if (reader.data)
+    {
+        result = md5animConvert((const char*)reader.data, reader.size, outBinary);
+    }
+    else
+    {
+        memory_t mem;
+
+        text_reader_close(&reader);
+
+        if (!mem_file(&mem, name)) return false;
+
+        result = md5animConvert((const char*)mem.buffer, mem.size, outBinary);
+
+        mem_free(&mem);
+    }
+
+    text_reader_close(&reader);
+
+    return result;
+}
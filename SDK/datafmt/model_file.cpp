@@ -0,0 +1,988 @@
+#include "datafmt/model_file.h"
+#include "datafmt/md5.h"
+
+static inline uint64_t modelFileAlign(uint64_t offset)
+{
+    return (offset + MODEL_FILE_ALIGNMENT - 1) & ~(uint64_t)(MODEL_FILE_ALIGNMENT - 1);
+}
+
+static const model_file_chunk_t* modelFileChunkTable(const model_file_header_t* header)
+{
+    return (const model_file_chunk_t*)(header + 1);
+}
+
+static const model_file_header_t* modelFileValidate(const uint8_t* data, size_t size)
+{
+    const model_file_header_t* header = (const model_file_header_t*)data;
+
+    if (size < sizeof(model_file_header_t) || ((uintptr_t)data & (MODEL_FILE_ALIGNMENT - 1)))
+        return 0;
+
+    if (header->magic != MODEL_FILE_MAGIC || header->version != MODEL_FILE_VERSION || header->size != size)
+        return 0;
+
+    uint64_t tableEnd = sizeof(model_file_header_t) + (uint64_t)header->numChunks * sizeof(model_file_chunk_t);
+
+    if (tableEnd > size) return 0;
+
+    const model_file_chunk_t* chunks = modelFileChunkTable(header);
+
+    for (uint32_t i = 0; i < header->numChunks; ++i)
+    {
+        const model_file_chunk_t& chunk = chunks[i];
+
+        if (chunk.offset % MODEL_FILE_ALIGNMENT || chunk.offset < tableEnd || chunk.offset > size)
+            return 0;
+
+        if ((uint64_t)chunk.stride * chunk.count > size - chunk.offset)
+            return 0;
+    }
+
+    return header;
+}
+
+bool modelFileOpen(model_file_t* model, const char* name)
+{
+    mem_zero(model);
+
+    if (!mapped_file_open(&model->file, name)) return false;
+
+    model->header = modelFileValidate(model->file.data, model->file.size);
+
+    if (!model->header)
+    {
+        modelFileClose(model);
+        return false;
+    }
+
+    return true;
+}
+
+void modelFileClose(model_file_t* model)
+{
+    mapped_file_close(&model->file);
+    mem_zero(model);
+}
+
+const void* modelFileChunk(const model_file_t* model, uint32_t id, uint32_t stride, uint32_t* count)
+{
+    const model_file_chunk_t* chunks = modelFileChunkTable(model->header);
+
+    *count = 0;
+
+    for (uint32_t i = 0; i < model->header->numChunks; ++i)
+    {
+        if (chunks[i].id == id)
+        {
+            if (chunks[i].stride != stride) return 0;
+
+            *count = chunks[i].count;
+
+            return model->file.data + chunks[i].offset;
+        }
+    }
+
+    return 0;
+}
+
+bool modelFileSave(const model_file_t* model, const char* path)
+{
+    PHYSFS_File* dst = PHYSFS_openWrite(path);
+
+    if (!dst) return false;
+
+    // Interrupted write leaves file that fails validation
+    bool result = PHYSFS_write(dst, model->file.data, (PHYSFS_uint32)model->header->size, 1) == 1;
+
+    PHYSFS_close(dst);
+
+    return result;
+}
+
+//--------------------------------------------------------------------------
+
+struct model_chunk_desc_t
+{
+    uint32_t    id;
+    uint32_t    stride;
+    uint32_t    count;
+    const void* data;
+};
+
+// Lays out chunks into container in memory, empty chunks are omitted
+static bool modelFileBuild(model_file_t* model, const model_chunk_desc_t* chunks, uint32_t numChunks)
+{
+    uint32_t numUsed = 0;
+
+    for (uint32_t i = 0; i < numChunks; ++i)
+    {
+        if (chunks[i].count) ++numUsed;
+    }
+
+    uint64_t size = modelFileAlign(sizeof(model_file_header_t) + numUsed * sizeof(model_file_chunk_t));
+
+    for (uint32_t i = 0; i < numChunks; ++i)
+    {
+        if (chunks[i].count) size = modelFileAlign(size + (uint64_t)chunks[i].stride * chunks[i].count);
+    }
+
+    mem_zero(model);
+
+    if (size > UINT32_MAX) return false;
+
+    uint8_t* data = (uint8_t*)_aligned_malloc((size_t)size, MODEL_FILE_ALIGNMENT);
+
+    if (!data) return false;
+
+    mem_set(data, (size_t)size, 0);
+
+    model_file_header_t* header = (model_file_header_t*)data;
+    model_file_chunk_t*  table  = (model_file_chunk_t*)(header + 1);
+
+    header->magic     = MODEL_FILE_MAGIC;
+    header->version   = MODEL_FILE_VERSION;
+    header->numChunks = numUsed;
+    header->size      = size;
+
+    uint64_t offset = modelFileAlign(sizeof(model_file_header_t) + numUsed * sizeof(model_file_chunk_t));
+
+    for (uint32_t i = 0; i < numChunks; ++i)
+    {
+        if (!chunks[i].count) continue;
+
+        table->id     = chunks[i].id;
+        table->stride = chunks[i].stride;
+        table->count  = chunks[i].count;
+        table->offset = offset;
+
+        mem_copy(data + offset, chunks[i].data, (size_t)chunks[i].stride * chunks[i].count);
+
+        offset = modelFileAlign(offset + (uint64_t)chunks[i].stride * chunks[i].count);
+        ++table;
+    }
+
+    // Same as memory read from file, freed by modelFileClose
+    model->file.data = data;
+    model->file.size = (size_t)size;
+    model->header    = header;
+
+    return true;
+}
+
+static void copyName(char* dst, size_t size, const char* src)
+{
+    size_t len = core::min(strlen(src), size - 1);
+
+    mem_copy(dst, src, len);
+    dst[len] = 0;
+}
+
+//--------------------------------------------------------------------------
+
+static ml::quat md5ToYUp = {-0.7071067812f, 0.0f, 0.0f, 0.7071067812f};
+
+enum
+{
+    MD5_FRAME_GRAIN_SIZE = 8,
+};
+
+static void storeJointGroups(model_file_joint_group_t* dst, const ml::dual_quat* src, uint32_t numJoints, uint32_t numGroups)
+{
+    ml::dual_quat identity;
+    ml::set_identity_dual_quat(&identity);
+
+    for (uint32_t i = 0; i < numGroups*4; ++i)
+    {
+        const float* in = &(i < numJoints ? src[i] : identity).real.x;
+
+        for (uint32_t c = 0; c < 8; ++c)
+        {
+            dst[i/4].soa[c][i%4] = in[c];
+        }
+    }
+}
+
+// Output blob is sized by text, it grows up to the worst case size if conversion fails
+static blob32_t md5Convert(const char* name, bool (*convert)(const char*, blob32_t))
+{
+    PHYSFS_File* src = PHYSFS_openRead(name);
+
+    if (!src) return 0;
+
+    PHYSFS_sint64 size = PHYSFS_fileLength(src);
+
+    PHYSFS_close(src);
+
+    if (size < 0 || size > UINT32_MAX / 32) return 0;
+
+    for (size_t capacity = (size_t)size * 2 + 65536; capacity <= (size_t)size * 16 + 65536; capacity *= 2)
+    {
+        blob32_t blob = (blob32_t)malloc(sizeof(blob32_data_t) + capacity);
+
+        if (!blob) return 0;
+
+        blob->size = (uint32_t)capacity;
+
+        if (convert(name, blob)) return blob;
+
+        free(blob);
+    }
+
+    return 0;
+}
+
+struct md5_skeleton_t
+{
+    uint32_t                  numJoints;
+    uint32_t                  numGroups;
+    model_file_name_t*        names;
+    int32_t*                  parents;
+    ml::dual_quat*            bindPose;
+    ml::dual_quat*            invBindPose;
+    model_file_joint_group_t* bindPoseSoA;
+    model_file_joint_group_t* invBindPoseSoA;
+};
+
+struct md5_geometry_t
+{
+    uint32_t                     numMeshes;
+    uint32_t                     numVertices;
+    uint32_t                     numIndices;
+    model_file_mesh_t*           meshes;
+    model_file_material_t*       materials;
+    model_file_skinned_vertex_t* vertices;
+    uint16_t*                    indices;
+};
+
+struct md5_clips_t
+{
+    uint32_t                  numClips;
+    uint32_t                  numGroups;
+    model_file_clip_t*        clips;
+    model_file_joint_group_t* poses;
+};
+
+static bool md5ConvertSkeleton(md5_skeleton_t* skel, md5_model_t* md5Model)
+{
+    uint32_t numJoints = md5Model->numJoints;
+
+    skel->numJoints      = numJoints;
+    skel->numGroups      = (numJoints + 3) / 4;
+    skel->names          = (model_file_name_t*)       malloc(numJoints * sizeof(model_file_name_t));
+    skel->parents        = (int32_t*)                 malloc(numJoints * sizeof(int32_t));
+    skel->bindPose       = (ml::dual_quat*)           malloc(numJoints * sizeof(ml::dual_quat));
+    skel->invBindPose    = (ml::dual_quat*)           malloc(numJoints * sizeof(ml::dual_quat));
+    skel->bindPoseSoA    = (model_file_joint_group_t*)malloc(skel->numGroups * sizeof(model_file_joint_group_t));
+    skel->invBindPoseSoA = (model_file_joint_group_t*)malloc(skel->numGroups * sizeof(model_file_joint_group_t));
+
+    if (!skel->names || !skel->parents || !skel->bindPose || !skel->invBindPose || !skel->bindPoseSoA || !skel->invBindPoseSoA)
+        return false;
+
+    for (uint32_t i = 0; i < numJoints; ++i)
+    {
+        md5_joint_t*   joint    = &md5Model->joints[i];
+        ml::dual_quat* bindPose = &skel->bindPose[i];
+
+        // Poses are computed in joint order
+        if (joint->parent >= (int32_t)i) return false;
+
+        copyName(skel->names[i].str, ARRAY_SIZE(skel->names[i].str), joint->name);
+        skel->parents[i] = joint->parent < 0 ? -1 : joint->parent;
+
+        ml::make_dual_quat     (bindPose, &joint->rotation, &joint->location);
+        ml::mul_quat           (&bindPose->real, &md5ToYUp, &bindPose->real);
+        ml::mul_quat           (&bindPose->dual, &md5ToYUp, &bindPose->dual);
+        ml::conjugate_dual_quat(&skel->invBindPose[i], bindPose);
+    }
+
+    storeJointGroups(skel->bindPoseSoA,    skel->bindPose,    numJoints, skel->numGroups);
+    storeJointGroups(skel->invBindPoseSoA, skel->invBindPose, numJoints, skel->numGroups);
+
+    return true;
+}
+
+static bool md5ConvertMesh(md5_geometry_t* geom, uint32_t index, md5_mesh_t* md5Mesh, const md5_skeleton_t* skel)
+{
+    model_file_mesh_t*           mesh     = &geom->meshes[index];
+    model_file_skinned_vertex_t* vertices = geom->vertices + geom->numVertices;
+    uint16_t*                    indices  = geom->indices  + geom->numIndices;
+
+    mesh->firstVertex = geom->numVertices;
+    mesh->numVertices = md5Mesh->numVertices;
+    mesh->firstIndex  = geom->numIndices;
+    mesh->numIndices  = md5Mesh->numIndices;
+    mesh->material    = index;
+
+    copyName(geom->materials[index].name, ARRAY_SIZE(geom->materials[index].name), md5Mesh->shader);
+
+    mem_set(vertices, md5Mesh->numVertices * sizeof(model_file_skinned_vertex_t), 0);
+
+    for (uint32_t i = 0; i < md5Mesh->numVertices; ++i)
+    {
+        model_file_skinned_vertex_t& vert        = vertices[i];
+        uint32_t                     weightCount = md5Mesh->vertices[i].count;
+        uint32_t                     startWeight = md5Mesh->vertices[i].start;
+
+        if (weightCount > 4 || startWeight > md5Mesh->numWeights || weightCount > md5Mesh->numWeights - startWeight)
+            return false;
+
+        v128 pos = vi_set_zero();
+
+        // Sum the position of the weights
+        for (uint32_t j = 0; j < weightCount; ++j)
+        {
+            md5_weight_t& weight = md5Mesh->weights[startWeight + j];
+
+            if ((uint32_t)weight.joint >= skel->numJoints || weight.joint > 255)
+                return false;
+
+            const ml::dual_quat& joint = skel->bindPose[weight.joint];
+
+            v128 r, d, v, t;
+
+            r = vi_loadu_v4(&joint.real);
+            d = vi_loadu_v4(&joint.dual);
+            v = vi_load_v3(&weight.location);
+
+            v = ml::rotate_vec3_quat(r, v);
+            t = ml::translation_dual_quat(r, d);
+            t = vi_add(v, t);
+
+            pos = vi_mad(t, vi_set_all(weight.bias), pos);
+
+            vert.b[j] = (uint8_t)weight.joint;
+            vert.w[j] = weight.bias;
+        }
+
+        vi_store_v3(&vert.px, pos);
+
+        vert.u = md5Mesh->vertices[i].u;
+        vert.v = md5Mesh->vertices[i].v;
+    }
+
+    for (uint32_t i = 0; i < md5Mesh->numIndices; ++i)
+    {
+        if (md5Mesh->indices[i] >= md5Mesh->numVertices) return false;
+
+        indices[i] = md5Mesh->indices[i];
+    }
+
+    // Vertex normal is sum of normals of adjacent triangles
+    for (uint32_t i = 0; i < md5Mesh->numIndices/3; ++i)
+    {
+        model_file_skinned_vertex_t& v0 = vertices[indices[i*3+0]];
+        model_file_skinned_vertex_t& v1 = vertices[indices[i*3+1]];
+        model_file_skinned_vertex_t& v2 = vertices[indices[i*3+2]];
+
+        v128 p0 = vi_load_v3(&v0.px);
+        v128 p1 = vi_load_v3(&v1.px);
+        v128 p2 = vi_load_v3(&v2.px);
+
+        v128 n = vi_cross3(vi_sub(p2, p0), vi_sub(p1, p0));
+
+        vi_store_v3(&v0.nx, vi_add(vi_load_v3(&v0.nx), n));
+        vi_store_v3(&v1.nx, vi_add(vi_load_v3(&v1.nx), n));
+        vi_store_v3(&v2.nx, vi_add(vi_load_v3(&v2.nx), n));
+    }
+
+    mesh->boundsMin.x = mesh->boundsMin.y = mesh->boundsMin.z =  FLT_MAX;
+    mesh->boundsMax.x = mesh->boundsMax.y = mesh->boundsMax.z = -FLT_MAX;
+
+    for (uint32_t i = 0; i < md5Mesh->numVertices; ++i)
+    {
+        model_file_skinned_vertex_t& vert = vertices[i];
+
+        vi_store_v3(&vert.nx, ml::normalize(vi_load_v3(&vert.nx)));
+
+        mesh->boundsMin.x = core::min(mesh->boundsMin.x, vert.px);
+        mesh->boundsMin.y = core::min(mesh->boundsMin.y, vert.py);
+        mesh->boundsMin.z = core::min(mesh->boundsMin.z, vert.pz);
+        mesh->boundsMax.x = core::max(mesh->boundsMax.x, vert.px);
+        mesh->boundsMax.y = core::max(mesh->boundsMax.y, vert.py);
+        mesh->boundsMax.z = core::max(mesh->boundsMax.z, vert.pz);
+    }
+
+    geom->numVertices += md5Mesh->numVertices;
+    geom->numIndices  += md5Mesh->numIndices;
+
+    return true;
+}
+
+static bool md5ConvertGeometry(md5_geometry_t* geom, md5_model_t* md5Model, const md5_skeleton_t* skel)
+{
+    uint64_t numVertices = 0;
+    uint64_t numIndices  = 0;
+
+    for (uint32_t i = 0; i < md5Model->numMeshes; ++i)
+    {
+        numVertices += md5Model->meshes[i].numVertices;
+        numIndices  += md5Model->meshes[i].numIndices;
+    }
+
+    if (numVertices > UINT32_MAX / sizeof(model_file_skinned_vertex_t) || numIndices > UINT32_MAX / sizeof(uint16_t))
+        return false;
+
+    geom->numMeshes = md5Model->numMeshes;
+    geom->meshes    = (model_file_mesh_t*)          malloc(geom->numMeshes * sizeof(model_file_mesh_t));
+    geom->materials = (model_file_material_t*)      malloc(geom->numMeshes * sizeof(model_file_material_t));
+    geom->vertices  = (model_file_skinned_vertex_t*)malloc((size_t)numVertices * sizeof(model_file_skinned_vertex_t));
+    geom->indices   = (uint16_t*)                   malloc((size_t)numIndices  * sizeof(uint16_t));
+
+    if (!geom->meshes || !geom->materials || !geom->vertices || !geom->indices)
+        return false;
+
+    for (uint32_t i = 0; i < md5Model->numMeshes; ++i)
+    {
+        if (!md5ConvertMesh(geom, i, &md5Model->meshes[i], skel)) return false;
+    }
+
+    return true;
+}
+
+struct md5_frames_args_t
+{
+    md5_anim_t*               md5Anim;
+    const md5_skeleton_t*     skel;
+    model_file_joint_group_t* poses;
+};
+
+// Frames are independent, each chunk uses its own scratch for hierarchy
+static void md5ConvertFramesJob(uint32_t begin, uint32_t end, void* arg)
+{
+    PROFILER_CPU_TIMESLICE("md5ConvertFrames");
+
+    md5_frames_args_t*    args = (md5_frames_args_t*)arg;
+    const md5_skeleton_t* skel = args->skel;
+
+    md5_anim_data_t*          animData   = args->md5Anim->frameData + begin * skel->numJoints;
+    ml::dual_quat*            framePoses = (ml::dual_quat*)malloc(skel->numJoints * sizeof(ml::dual_quat));
+    model_file_joint_group_t* frameSoA   = args->poses + begin * skel->numGroups;
+
+    for (uint32_t f = begin; f < end; ++f)
+    {
+        for (uint32_t i = 0; i < skel->numJoints; ++i)
+        {
+            ml::make_dual_quat(&framePoses[i], &animData[i].rotation, &animData[i].location);
+
+            int32_t parent = skel->parents[i];
+            if (parent > -1)
+            {
+                ml::mul_dual_quat(&framePoses[i], &framePoses[parent], &framePoses[i]);
+            }
+            else
+            {
+                ml::mul_quat(&framePoses[i].real, &md5ToYUp, &framePoses[i].real);
+                ml::mul_quat(&framePoses[i].dual, &md5ToYUp, &framePoses[i].dual);
+            }
+        }
+
+        storeJointGroups(frameSoA, framePoses, skel->numJoints, skel->numGroups);
+
+        frameSoA += skel->numGroups;
+        animData += skel->numJoints;
+    }
+
+    free(framePoses);
+}
+
+static bool md5ConvertClips(md5_clips_t* clips, const char* const* animNames, uint32_t numAnims, const md5_skeleton_t* skel)
+{
+    static bool (*const convert)(const char*, blob32_t) = md5animConvertToBinary;
+
+    if (!numAnims) return true;
+
+    blob32_t* anims = (blob32_t*)malloc(numAnims * sizeof(blob32_t));
+
+    if (!anims) return false;
+
+    mem_set(anims, numAnims * sizeof(blob32_t), 0);
+
+    uint64_t numFrames = 0;
+    bool     result    = true;
+
+    for (uint32_t i = 0; i < numAnims && result; ++i)
+    {
+        anims[i] = md5Convert(animNames[i], convert);
+
+        md5_anim_t* md5Anim = anims[i] ? mem_as_ptr<md5_anim_t>(blob32_data(anims[i]), 0) : 0;
+
+        result     = md5Anim && md5Anim->numJoints == skel->numJoints;
+        numFrames += result ? md5Anim->numFrames : 0;
+    }
+
+    result = result && numFrames * skel->numGroups <= UINT32_MAX / sizeof(model_file_joint_group_t);
+
+    if (result)
+    {
+        clips->numClips  = numAnims;
+        clips->numGroups = (uint32_t)numFrames * skel->numGroups;
+        clips->clips     = (model_file_clip_t*)       malloc(numAnims * sizeof(model_file_clip_t));
+        clips->poses     = (model_file_joint_group_t*)malloc(clips->numGroups * sizeof(model_file_joint_group_t));
+
+        result = clips->clips && clips->poses;
+    }
+
+    uint32_t firstFrame = 0;
+
+    for (uint32_t i = 0; i < numAnims && result; ++i)
+    {
+        md5_anim_t*        md5Anim = mem_as_ptr<md5_anim_t>(blob32_data(anims[i]), 0);
+        model_file_clip_t* clip    = &clips->clips[i];
+
+        mem_zero(clip);
+        copyName(clip->name.str, ARRAY_SIZE(clip->name.str), animNames[i]);
+        clip->numFrames  = md5Anim->numFrames;
+        clip->frameRate  = md5Anim->frameRate;
+        clip->firstFrame = firstFrame;
+
+        md5_frames_args_t args = {md5Anim, skel, clips->poses + firstFrame * skel->numGroups};
+
+        mt::jobWait(mt::parallelFor(md5ConvertFramesJob, &args, md5Anim->numFrames, MD5_FRAME_GRAIN_SIZE));
+
+        firstFrame += md5Anim->numFrames;
+    }
+
+    for (uint32_t i = 0; i < numAnims; ++i)
+    {
+        free(anims[i]);
+    }
+
+    free(anims);
+
+    return result;
+}
+
+bool modelFileConvertMD5(model_file_t* model, const char* meshName, const char* const* animNames, uint32_t numAnims)
+{
+    PROFILER_CPU_TIMESLICE("modelFileConvertMD5");
+
+    static bool (*const convert)(const char*, blob32_t) = md5meshConvertToBinary;
+
+    md5_skeleton_t skel;
+    md5_geometry_t geom;
+    md5_clips_t    clips;
+
+    mem_zero(model);
+    mem_zero(&skel);
+    mem_zero(&geom);
+    mem_zero(&clips);
+
+    blob32_t     mesh     = md5Convert(meshName, convert);
+    md5_model_t* md5Model = mesh ? mem_as_ptr<md5_model_t>(blob32_data(mesh), 0) : 0;
+
+    bool result = md5Model &&
+                  md5ConvertSkeleton(&skel, md5Model) &&
+                  md5ConvertGeometry(&geom, md5Model, &skel) &&
+                  md5ConvertClips(&clips, animNames, numAnims, &skel);
+
+    if (result)
+    {
+        model_chunk_desc_t chunks[] = {
+            {MODEL_CHUNK_MESHES,            sizeof(model_file_mesh_t),           geom.numMeshes,   geom.meshes        },
+            {MODEL_CHUNK_MATERIALS,         sizeof(model_file_material_t),       geom.numMeshes,   geom.materials     },
+            {MODEL_CHUNK_SKINNED_VERTICES,  sizeof(model_file_skinned_vertex_t), geom.numVertices, geom.vertices      },
+            {MODEL_CHUNK_INDICES16,         sizeof(uint16_t),                    geom.numIndices,  geom.indices       },
+            {MODEL_CHUNK_JOINT_NAMES,       sizeof(model_file_name_t),           skel.numJoints,   skel.names         },
+            {MODEL_CHUNK_JOINT_PARENTS,     sizeof(int32_t),                     skel.numJoints,   skel.parents       },
+            {MODEL_CHUNK_BIND_POSE,         sizeof(ml::dual_quat),               skel.numJoints,   skel.bindPose      },
+            {MODEL_CHUNK_INV_BIND_POSE,     sizeof(ml::dual_quat),               skel.numJoints,   skel.invBindPose   },
+            {MODEL_CHUNK_BIND_POSE_SOA,     sizeof(model_file_joint_group_t),    skel.numGroups,   skel.bindPoseSoA   },
+            {MODEL_CHUNK_INV_BIND_POSE_SOA, sizeof(model_file_joint_group_t),    skel.numGroups,   skel.invBindPoseSoA},
+            {MODEL_CHUNK_CLIPS,             sizeof(model_file_clip_t),           clips.numClips,   clips.clips        },
+            {MODEL_CHUNK_CLIP_POSES,        sizeof(model_file_joint_group_t),    clips.numGroups,  clips.poses        },
+        };
+
+        result = modelFileBuild(model, chunks, ARRAY_SIZE(chunks));
+    }
+
+    free(mesh);
+
+    free(skel.names);
+    free(skel.parents);
+    free(skel.bindPose);
+    free(skel.invBindPose);
+    free(skel.bindPoseSoA);
+    free(skel.invBindPoseSoA);
+
+    free(geom.meshes);
+    free(geom.materials);
+    free(geom.vertices);
+    free(geom.indices);
+
+    free(clips.clips);
+    free(clips.poses);
+
+    return result;
+}
+
+//--------------------------------------------------------------------------
+
+static const uint32_t OBJ_NONE = 0xFFFFFFFF;
+
+// Corner of the face: position, texture coordinate and normal indices
+struct obj_corner_t
+{
+    uint32_t p, t, n;
+};
+
+struct obj_data_t
+{
+    uint32_t          numPositions;
+    uint32_t          numTexCoords;
+    uint32_t          numNormals;
+    uint32_t          numTriangles;
+    uint32_t          numMaterials;
+
+    ml::vec3*         positions;
+    ml::vec2*         texCoords;
+    ml::vec3*         normals;
+    obj_corner_t*     corners;        // 3 per triangle
+    uint32_t*         triMaterials;
+    str_view_t*       materials;
+};
+
+static bool objNextLine(text_reader_t* reader, str_view_t* line, str_view_t* token)
+{
+    while (text_reader_line(reader, line))
+    {
+        if (str_next_token(line, token) && token->str[0] != '#') return true;
+    }
+
+    return false;
+}
+
+// OBJ indices are 1 based, negative ones are relative to the end of the list
+static uint32_t objIndex(intmax_t index, uint32_t count)
+{
+    if (index < 0) index += count;
+    else           index -= 1;
+
+    return index >= 0 && index < (intmax_t)count ? (uint32_t)index : OBJ_NONE;
+}
+
+// Vertex is "v", "v/vt", "v//vn" or "v/vt/vn"
+static bool objParseCorner(str_view_t token, const obj_data_t* obj, obj_corner_t* corner)
+{
+    const char* s = token.str;
+    const char* e = token.str + token.size;
+    intmax_t    index;
+
+    corner->t = corner->n = OBJ_NONE;
+
+    if (cstr_toimax(s, e - s, 10, &s, &index) != EOK) return false;
+
+    corner->p = objIndex(index, obj->numPositions);
+
+    if (s < e && *s == '/')
+    {
+        if (++s < e && *s != '/' && cstr_toimax(s, e - s, 10, &s, &index) == EOK)
+            corner->t = objIndex(index, obj->numTexCoords);
+
+        if (s < e && *s == '/' && cstr_toimax(s + 1, e - s - 1, 10, &s, &index) == EOK)
+            corner->n = objIndex(index, obj->numNormals);
+    }
+
+    return corner->p != OBJ_NONE;
+}
+
+static uint32_t objFindMaterial(obj_data_t* obj, str_view_t name)
+{
+    for (uint32_t i = 0; i < obj->numMaterials; ++i)
+    {
+        if (obj->materials[i].size == name.size && memcmp(obj->materials[i].str, name.str, name.size) == 0)
+            return i;
+    }
+
+    obj->materials[obj->numMaterials] = name;
+
+    return obj->numMaterials++;
+}
+
+// First pass counts elements, second one fills arrays
+static bool objParse(obj_data_t* obj, const char* text, size_t size, bool count)
+{
+    text_reader_t reader;
+    str_view_t    line;
+    str_view_t    token;
+    uint32_t      material = 0;
+
+    text_reader_init(&reader, text, size);
+
+    obj->numPositions = obj->numTexCoords = obj->numNormals = obj->numTriangles = 0;
+
+    if (!count)
+    {
+        // Faces without material use default one
+        str_view_t noMaterial = {"", 0};
+
+        obj->numMaterials = 0;
+        objFindMaterial(obj, noMaterial);
+    }
+
+    while (objNextLine(&reader, &line, &token))
+    {
+        if (str_equal(token, "v"))
+        {
+            if (!count && cstr_tofloats(line.str, line.size, 0, &obj->positions[obj->numPositions].x, 3) != 3)
+                return false;
+
+            ++obj->numPositions;
+        }
+
+        else if (str_equal(token, "vt"))
+        {
+            if (!count && cstr_tofloats(line.str, line.size, 0, &obj->texCoords[obj->numTexCoords].x, 2) != 2)
+                return false;
+
+            ++obj->numTexCoords;
+        }
+
+        else if (str_equal(token, "vn"))
+        {
+            if (!count && cstr_tofloats(line.str, line.size, 0, &obj->normals[obj->numNormals].x, 3) != 3)
+                return false;
+
+            ++obj->numNormals;
+        }
+
+        else if (str_equal(token, "usemtl"))
+        {
+            if (count)
+            {
+                ++obj->numMaterials;
+            }
+            else
+            {
+                str_next_token(&line, &token);
+                material = objFindMaterial(obj, token);
+            }
+        }
+
+        else if (str_equal(token, "f"))
+        {
+            // Polygon is triangulated as fan
+            obj_corner_t first  = {OBJ_NONE, OBJ_NONE, OBJ_NONE};
+            obj_corner_t prev   = first;
+            obj_corner_t corner = first;
+            uint32_t     numCorners = 0;
+
+            while (str_next_token(&line, &token))
+            {
+                if (!count && !objParseCorner(token, obj, &corner)) return false;
+
+                if (numCorners >= 2)
+                {
+                    if (!count)
+                    {
+                        obj_corner_t* tri = &obj->corners[obj->numTriangles * 3];
+
+                        tri[0] = first;
+                        tri[1] = prev;
+                        tri[2] = corner;
+
+                        obj->triMaterials[obj->numTriangles] = material;
+                    }
+
+                    ++obj->numTriangles;
+                }
+
+                if (numCorners == 0) first = corner;
+
+                prev = corner;
+                ++numCorners;
+            }
+        }
+    }
+
+    return true;
+}
+
+static inline uint32_t objHashCorner(const obj_corner_t& c)
+{
+    return (c.p * 73856093u) ^ (c.t * 19349663u) ^ (c.n * 83492791u);
+}
+
+static bool objConvert(model_file_t* model, obj_data_t* obj, float scale)
+{
+    uint32_t numCorners = obj->numTriangles * 3;
+    uint32_t tableSize  = 1;
+
+    while (tableSize < numCorners * 2) tableSize *= 2;
+
+    // Worst case every corner is unique vertex
+    model_file_mesh_t*          meshes    = (model_file_mesh_t*)         malloc(obj->numMaterials * sizeof(model_file_mesh_t));
+    model_file_material_t*      materials = (model_file_material_t*)     malloc(obj->numMaterials * sizeof(model_file_material_t));
+    model_file_static_vertex_t* vertices  = (model_file_static_vertex_t*)malloc(numCorners * sizeof(model_file_static_vertex_t));
+    obj_corner_t*               keys      = (obj_corner_t*)              malloc(numCorners * sizeof(obj_corner_t));
+    uint32_t*                   indices   = (uint32_t*)                  malloc(numCorners * sizeof(uint32_t));
+    uint32_t*                   table     = (uint32_t*)                  malloc(tableSize  * sizeof(uint32_t));
+
+    bool     result      = meshes && materials && vertices && keys && indices && table;
+    uint32_t numMeshes   = 0;
+    uint32_t numVertices = 0;
+    uint32_t numIndices  = 0;
+
+    for (uint32_t m = 0; m < obj->numMaterials && result; ++m)
+    {
+        model_file_mesh_t* mesh = &meshes[numMeshes];
+
+        mem_zero(mesh);
+        mesh->firstVertex = numVertices;
+        mesh->firstIndex  = numIndices;
+        mesh->material    = numMeshes;
+
+        // Vertices are shared only inside of mesh
+        mem_set(table, tableSize * sizeof(uint32_t), 0xFF);
+
+        for (uint32_t i = 0; i < numCorners; ++i)
+        {
+            if (obj->triMaterials[i/3] != m) continue;
+
+            const obj_corner_t& c = obj->corners[i];
+
+            uint32_t slot = objHashCorner(c) & (tableSize - 1);
+
+            while (table[slot] != OBJ_NONE)
+            {
+                const obj_corner_t& k = keys[table[slot]];
+
+                if (k.p == c.p && k.t == c.t && k.n == c.n) break;
+
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] == OBJ_NONE)
+            {
+                model_file_static_vertex_t& v = vertices[numVertices];
+                const ml::vec3&             p = obj->positions[c.p];
+
+                v.px = p.x * scale;
+                v.py = p.y * scale;
+                v.pz = p.z * scale;
+                v.nx = c.n != OBJ_NONE ? obj->normals[c.n].x : 0.0f;
+                v.ny = c.n != OBJ_NONE ? obj->normals[c.n].y : 0.0f;
+                v.nz = c.n != OBJ_NONE ? obj->normals[c.n].z : 0.0f;
+                v.u  = c.t != OBJ_NONE ?        obj->texCoords[c.t].x : 0.0f;
+                v.v  = c.t != OBJ_NONE ? 1.0f - obj->texCoords[c.t].y : 0.0f;
+
+                keys[numVertices] = c;
+                table[slot]       = numVertices++;
+            }
+
+            indices[numIndices++] = table[slot] - mesh->firstVertex;
+        }
+
+        mesh->numVertices = numVertices - mesh->firstVertex;
+        mesh->numIndices  = numIndices  - mesh->firstIndex;
+
+        if (!mesh->numIndices) continue;
+
+        model_file_static_vertex_t* meshVertices = vertices + mesh->firstVertex;
+        uint32_t*                   meshIndices  = indices  + mesh->firstIndex;
+
+        // Vertices without normal get sum of normals of adjacent triangles
+        for (uint32_t i = 0; i < mesh->numIndices; i += 3)
+        {
+            model_file_static_vertex_t* tri[3] = {&meshVertices[meshIndices[i]], &meshVertices[meshIndices[i+1]], &meshVertices[meshIndices[i+2]]};
+
+            v128 n = vi_cross3(vi_sub(vi_load_v3(&tri[1]->px), vi_load_v3(&tri[0]->px)),
+                               vi_sub(vi_load_v3(&tri[2]->px), vi_load_v3(&tri[0]->px)));
+
+            for (uint32_t j = 0; j < 3; ++j)
+            {
+                if (keys[tri[j] - vertices].n == OBJ_NONE)
+                    vi_store_v3(&tri[j]->nx, vi_add(vi_load_v3(&tri[j]->nx), n));
+            }
+        }
+
+        mesh->boundsMin.x = mesh->boundsMin.y = mesh->boundsMin.z =  FLT_MAX;
+        mesh->boundsMax.x = mesh->boundsMax.y = mesh->boundsMax.z = -FLT_MAX;
+
+        for (uint32_t i = 0; i < mesh->numVertices; ++i)
+        {
+            model_file_static_vertex_t& v = meshVertices[i];
+
+            if (keys[mesh->firstVertex + i].n == OBJ_NONE)
+                vi_store_v3(&v.nx, ml::normalize(vi_load_v3(&v.nx)));
+
+            mesh->boundsMin.x = core::min(mesh->boundsMin.x, v.px);
+            mesh->boundsMin.y = core::min(mesh->boundsMin.y, v.py);
+            mesh->boundsMin.z = core::min(mesh->boundsMin.z, v.pz);
+            mesh->boundsMax.x = core::max(mesh->boundsMax.x, v.px);
+            mesh->boundsMax.y = core::max(mesh->boundsMax.y, v.py);
+            mesh->boundsMax.z = core::max(mesh->boundsMax.z, v.pz);
+        }
+
+        str_view_t name = obj->materials[m];
+
+        mem_zero(&materials[numMeshes]);
+        mem_copy(materials[numMeshes].name, name.str, core::min<size_t>(name.size, ARRAY_SIZE(materials[numMeshes].name) - 1));
+
+        ++numMeshes;
+    }
+
+    if (result)
+    {
+        model_chunk_desc_t chunks[] = {
+            {MODEL_CHUNK_MESHES,          sizeof(model_file_mesh_t),          numMeshes,   meshes   },
+            {MODEL_CHUNK_MATERIALS,       sizeof(model_file_material_t),      numMeshes,   materials},
+            {MODEL_CHUNK_STATIC_VERTICES, sizeof(model_file_static_vertex_t), numVertices, vertices },
+            {MODEL_CHUNK_INDICES32,       sizeof(uint32_t),                   numIndices,  indices  },
+        };
+
+        result = modelFileBuild(model, chunks, ARRAY_SIZE(chunks));
+    }
+
+    free(meshes);
+    free(materials);
+    free(vertices);
+    free(keys);
+    free(indices);
+    free(table);
+
+    return result;
+}
+
+bool modelFileConvertOBJ(model_file_t* model, const char* name, float scale)
+{
+    PROFILER_CPU_TIMESLICE("modelFileConvertOBJ");
+
+    mapped_file_t file;
+    obj_data_t    obj;
+
+    mem_zero(model);
+    mem_zero(&obj);
+
+    if (!mapped_file_open(&file, name)) return false;
+
+    const char* text = (const char*)file.data;
+
+    bool result = objParse(&obj, text, file.size, true) &&
+                  obj.numTriangles && obj.numTriangles <= UINT32_MAX / 3 / sizeof(model_file_static_vertex_t);
+
+    if (result)
+    {
+        obj.positions    = (ml::vec3*)    malloc(obj.numPositions * sizeof(ml::vec3));
+        obj.texCoords    = (ml::vec2*)    malloc(obj.numTexCoords * sizeof(ml::vec2));
+        obj.normals      = (ml::vec3*)    malloc(obj.numNormals   * sizeof(ml::vec3));
+        obj.corners      = (obj_corner_t*)malloc(obj.numTriangles * 3 * sizeof(obj_corner_t));
+        obj.triMaterials = (uint32_t*)    malloc(obj.numTriangles * sizeof(uint32_t));
+        obj.materials    = (str_view_t*)  malloc((obj.numMaterials + 1) * sizeof(str_view_t));
+
+        result = obj.positions && obj.corners && obj.triMaterials && obj.materials &&
+                 (obj.texCoords || !obj.numTexCoords) && (obj.normals || !obj.numNormals) &&
+                 objParse(&obj, text, file.size, false) &&
+                 objConvert(model, &obj, scale);
+    }
+
+    free(obj.positions);
+    free(obj.texCoords);
+    free(obj.normals);
+    free(obj.corners);
+    free(obj.triMaterials);
+    free(obj.materials);
+
+    mapped_file_close(&file);
+
+    return result;
+}
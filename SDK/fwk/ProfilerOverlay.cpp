@@ -21,6 +21,7 @@ void ProfilerOverlay::init()
     sx = sy =  1.0f;
     dx = 0.0f;
     mDoDrag = false;
+    numDropped = 0;
     ui::mouseAbsOffset(&mbx, &mby);
 }
 
@@ -35,7 +36,8 @@ void ProfilerOverlay::layoutUI(int w, int h)
     rect_t mainArea = {overlayPadding, overlayPadding, w - 2.0f * overlayPadding, h - 2.0f * overlayPadding};
     graphArea = {mainArea.x+viewMargin, mainArea.y+viewMargin, mainArea.w - 300 - 4*viewMargin, mainArea.h - 2*viewMargin};
     helpArea  = {graphArea.x + graphArea.w + 2*viewMargin, mainArea.y+viewMargin, 300, 100};
-    statArea  = {graphArea.x + graphArea.w + 2*viewMargin, helpArea.y + helpArea.h + 2*viewMargin, 300, mainArea.h - helpArea.h - 4*viewMargin};
+    statArea  = {graphArea.x + graphArea.w + 2*viewMargin, helpArea.y + helpArea.h + 2*viewMargin, 300, 200};
+    tableArea = {statArea.x, statArea.y + statArea.h + 2*viewMargin, 300, mainArea.h - helpArea.h - statArea.h - 6*viewMargin};
 }
 
 void ProfilerOverlay::fini()
@@ -44,7 +46,7 @@ void ProfilerOverlay::fini()
 }
 
 void ProfilerOverlay::addInterval(
-    const char* name, uint32_t colorID, 
+    const char* name, uint32_t color, 
     uint16_t trackID, uint32_t start, 
     uint32_t duration, int depth
 )
@@ -52,7 +54,6 @@ void ProfilerOverlay::addInterval(
     float xstart   = (float)start;
     float ystart   = depth + 0.1f + trackID * (MAX_STACK_DEPTH + 2) + firstThreadRow;
 
-    uint32_t color = ui::rainbowTableL[colorID];
     colors.push_back(color);
 
     rectData.emplace_back(rect_t{xstart, ystart, (float)duration, 0.9f});
@@ -67,6 +68,15 @@ void ProfilerOverlay::addInterval(
     intervals.push_back(inter);
 }
 
+// Color from scope descriptor or next one from rainbow table
+template<size_t N>
+inline uint32_t intervalColor(core::index_t<uint16_t, N>* colorMap, uint16_t id)
+{
+    const profiler_scope_desc_t* desc = profilerGetScopeDesc(id);
+
+    return desc && desc->color ? desc->color : ui::rainbowTableL[core::index_lookup_or_add(colorMap, id)];
+}
+
 inline uint32_t convertToMs(uint64_t ms, uint64_t freq, int quantShift)
 {
     return (uint32_t)(ms * (1ull<<quantShift) * 1000000 / freq);
@@ -97,6 +107,7 @@ void ProfilerOverlay::loadProfilerData()
     colors.clear();
 
     numThreads = 0;
+    numDropped = capture->numDropped;
 
     minTime = convertToMs(events[0].timestamp, capture->freq, capture->quantShift);
     maxTime = convertToMs(events[0].timestamp, capture->freq, capture->quantShift);
@@ -132,9 +143,9 @@ void ProfilerOverlay::loadProfilerData()
                 continue;
 
             //remove item from stack and add entry
-            uint32_t colorID = core::index_lookup_or_add(&colorMap, event.id);
-            uint32_t start   = stack[threadIdx][top].sliceBegin;
-            addInterval(names[event.id], colorID, threadIdx, start, ts - start, top);
+            uint32_t color = intervalColor(&colorMap, event.id);
+            uint32_t start = stack[threadIdx][top].sliceBegin;
+            addInterval(names[event.id], color, threadIdx, start, ts - start, top);
 
             --top;
         }
@@ -148,9 +159,9 @@ void ProfilerOverlay::loadProfilerData()
         for (;top>=0; --top)
         {
             uint16_t id      = stack[i][top].id;
-            uint32_t colorID = core::index_lookup_or_add(&colorMap, id);
-            uint32_t start   = stack[i][top].sliceBegin;
-            addInterval(names[id], colorID, i, start, endTime - start, top);
+            uint32_t color = intervalColor(&colorMap, id);
+            uint32_t start = stack[i][top].sliceBegin;
+            addInterval(names[id], color, i, start, endTime - start, top);
         }
     }
 
@@ -315,6 +326,7 @@ void ProfilerOverlay::renderFullscreen()
 
     if (rectData.empty())
     {
+        renderStatsTable();
         nvgEndFrame(vg::ctx);
         return;
     }
@@ -422,6 +434,15 @@ void ProfilerOverlay::renderFullscreen()
     nvgTextAlign(vg::ctx, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
     nvgTextBox(vg::ctx, helpArea.x+20, helpArea.y+20, FLT_MAX, buffer, buffer+cstr_len(buffer));
 
+    if (numDropped)
+    {
+        sprintf_s(strBuf, "%u events were dropped", numDropped);
+        nvgFillColor(vg::ctx, nvgRGB(255, 64, 64));
+        nvgTextAlign(vg::ctx, NVG_ALIGN_LEFT|NVG_ALIGN_BOTTOM);
+        nvgText(vg::ctx, helpArea.x+20, helpArea.y+helpArea.h-20, strBuf, 0);
+        nvgTextAlign(vg::ctx, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+    }
+
     //Tooltip rendering
     if (showTooltip)
     {
@@ -503,5 +524,71 @@ void ProfilerOverlay::renderFullscreen()
     }
     nvgResetScissor(vg::ctx);
 
+    renderStatsTable();
+
     nvgEndFrame(vg::ctx);
 }
+
+static int compareStatsP99(const void* a, const void* b)
+{
+    float pa = ((const profiler_scope_stats_t*)a)->p99;
+    float pb = ((const profiler_scope_stats_t*)b)->p99;
+
+    return (pa < pb) - (pa > pb);
+}
+
+void ProfilerOverlay::renderStatsTable()
+{
+    static const float columnX[] = {10.0f, 150.0f, 200.0f, 250.0f};
+
+    nvgFillColor(vg::ctx, nvgRGB(16, 16, 16));
+    nvguRect(vg::ctx, tableArea.x, tableArea.y, tableArea.w, tableArea.h);
+
+    nvgFontSize(vg::ctx, 14.0f);
+    nvgFontFace(vg::ctx, "default");
+    nvgTextAlign(vg::ctx, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+    nvgFillColor(vg::ctx, nvgRGB(255, 255, 255));
+
+    if (!profilerIsStatsActive())
+    {
+        nvgText(vg::ctx, tableArea.x+columnX[0], tableArea.y+10, "~+S - start scope statistics", 0);
+        return;
+    }
+
+    static profiler_scope_stats_t stats[MAX_PROFILER_IDS];
+
+    const char** names = profilerGetNames();
+    uint32_t     count = profilerGetStats(stats, ARRAY_SIZE(stats));
+
+    // Worst tail latency first
+    qsort(stats, count, sizeof(profiler_scope_stats_t), compareStatsP99);
+
+    static const float lineH = 16.0f;
+
+    float y = tableArea.y + 10;
+
+    nvgText(vg::ctx, tableArea.x+columnX[0], y, "scope(us)", 0);
+    nvgText(vg::ctx, tableArea.x+columnX[1], y, "p50", 0);
+    nvgText(vg::ctx, tableArea.x+columnX[2], y, "p95", 0);
+    nvgText(vg::ctx, tableArea.x+columnX[3], y, "p99", 0);
+
+    nvgScissor(vg::ctx, tableArea.x, tableArea.y, tableArea.w, tableArea.h);
+    for (uint32_t i = 0; i < count && y + 2*lineH < tableArea.y + tableArea.h; ++i)
+    {
+        char strBuf[32];
+
+        y += lineH;
+
+        nvgScissor(vg::ctx, tableArea.x, tableArea.y, columnX[1]-5, tableArea.h);
+        nvgText(vg::ctx, tableArea.x+columnX[0], y, names[stats[i].id], 0);
+        nvgScissor(vg::ctx, tableArea.x, tableArea.y, tableArea.w, tableArea.h);
+
+        sprintf_s(strBuf, "%.0f", stats[i].p50);
+        nvgText(vg::ctx, tableArea.x+columnX[1], y, strBuf, 0);
+        sprintf_s(strBuf, "%.0f", stats[i].p95);
+        nvgText(vg::ctx, tableArea.x+columnX[2], y, strBuf, 0);
+        sprintf_s(strBuf, "%.0f", stats[i].p99);
+        nvgText(vg::ctx, tableArea.x+columnX[3], y, strBuf, 0);
+    }
+    nvgResetScissor(vg::ctx);
+}
@@ -27,6 +27,7 @@ public:
 
 private:
     void   layoutUI(int w, int h);
+    void   renderStatsTable();
     size_t elementUnderCursor(int x, int y);
     void   addInterval(
         const char* name, uint32_t color,
@@ -35,7 +36,8 @@ private:
     );
 
 private:
-    size_t numThreads;
+    size_t   numThreads;
+    uint32_t numDropped;
     std::vector<rect_t>   rectData;
     std::vector<Interval> intervals;
     std::vector<uint32_t> colors;
@@ -48,6 +50,7 @@ private:
     rect_t graphArea;
     rect_t helpArea;
     rect_t statArea;
+    rect_t tableArea;
 
     uint32_t    startInterval, endInterval, interval;
     uint32_t    minTime, maxTime;
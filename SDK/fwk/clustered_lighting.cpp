@@ -0,0 +1,560 @@
+#include <fwk/clustered_lighting.h>
+#include <math.h>
+
+enum light_grid_private
+{
+    MAX_GRID_WORKERS    = 64,
+    LIGHT_GRAIN_SIZE    = 32,
+    CLUSTER_BLOCK_SIZE  = 1024,
+    MAX_CLUSTER_BLOCKS  = 1024,
+    SIMD_WIDTH          = 4,
+    MIN_BIN_CAPACITY    = 4096,
+};
+
+// Per worker light bin, (cluster, light) pairs in the order they were found
+struct CORE_ALIGN(CORE_CACHE_LINE_SIZE) light_grid_bin_t
+{
+    uint32_t* clusters;
+    uint16_t* lights;
+    uint32_t  size;
+    uint32_t  capacity;
+
+    // Number of pairs per cluster, after prefix sum - write position of this bin per cluster
+    int32_t*  counts;
+    uint32_t  countsCapacity;
+
+    // Bin is reset lazily by the first job of the frame executed by the worker
+    uint32_t  frame;
+};
+
+struct light_grid_builder_data_t
+{
+    light_grid_bin_t  bins[MAX_GRID_WORKERS];
+    uint32_t          usedBins[MAX_GRID_WORKERS];
+    uint32_t          numUsedBins;
+    uint32_t          frame;
+
+    uint32_t          maxLights;
+    float*            viewX;
+    float*            viewY;
+    float*            viewZ;
+    float*            range;
+
+    // Cluster geometry: view space bounds of tiles for every slice, x bounds are padded to SIMD width
+    uint32_t          geometryCapacity;
+    float*            geometry;
+    uint32_t          strideX;
+    float*            tileMinX;
+    float*            tileMaxX;
+    float*            tileMinY;
+    float*            tileMaxY;
+    float*            sliceMinDist;
+    float*            sliceMaxDist;
+
+    // Projection parameters: ndc = (view / dist) * projScale - projOffset
+    float             projScaleX, projScaleY;
+    float             projOffsetX, projOffsetY;
+
+    uint32_t          clustersCapacity;
+    int32_t*          clusterData;
+    int32_t*          offsets;
+    int32_t*          counts;
+
+    uint32_t          lightListCapacity;
+    uint16_t*         lightList;
+
+    int32_t           blockOffsets[MAX_CLUSTER_BLOCKS];
+
+    light_grid_desc_t desc;
+    light_grid_t      grid;
+};
+
+// Grows buffer, old content is discarded
+template<typename T>
+static void ensureCapacity(T*& ptr, uint32_t& capacity, uint32_t required)
+{
+    if (required > capacity)
+    {
+        capacity = core::max<uint32_t>(required, capacity * 2);
+        _aligned_free(ptr);
+        ptr = (T*)_aligned_malloc(sizeof(T) * capacity, 16);
+    }
+}
+
+light_grid_builder_t lightGridCreateBuilder(uint32_t maxLights)
+{
+    assert(maxLights <= 0xFFFF);
+
+    light_grid_builder_t builder = (light_grid_builder_t)_aligned_malloc(sizeof(light_grid_builder_data_t), _alignof(light_grid_builder_data_t));
+    memset(builder, 0, sizeof(light_grid_builder_data_t));
+
+    uint32_t paddedLights = (uint32_t)bit_align_up(maxLights, SIMD_WIDTH);
+
+    builder->maxLights = maxLights;
+    builder->viewX = (float*)_aligned_malloc(sizeof(float) * paddedLights, 16);
+    builder->viewY = (float*)_aligned_malloc(sizeof(float) * paddedLights, 16);
+    builder->viewZ = (float*)_aligned_malloc(sizeof(float) * paddedLights, 16);
+    builder->range = (float*)_aligned_malloc(sizeof(float) * paddedLights, 16);
+
+    return builder;
+}
+
+void lightGridDestroyBuilder(light_grid_builder_t builder)
+{
+    for (uint32_t i = 0; i < MAX_GRID_WORKERS; ++i)
+    {
+        light_grid_bin_t& bin = builder->bins[i];
+
+        _aligned_free(bin.clusters);
+        _aligned_free(bin.lights);
+        _aligned_free(bin.counts);
+    }
+
+    _aligned_free(builder->viewX);
+    _aligned_free(builder->viewY);
+    _aligned_free(builder->viewZ);
+    _aligned_free(builder->range);
+
+    _aligned_free(builder->geometry);
+    _aligned_free(builder->clusterData);
+    _aligned_free(builder->lightList);
+
+    _aligned_free(builder);
+}
+
+static void transformLights(light_grid_builder_t builder, v128 modelView[4], const light_soa_t& lights)
+{
+    PROFILER_CPU_TIMESLICE("TransformLights");
+
+    CORE_ALIGN(16) float mv[16];
+    for (int i = 0; i < 4; ++i)
+    {
+        vi_store_v4(mv + 4 * i, modelView[i]);
+    }
+
+    v128 m00 = vi_set_all(mv[0]), m01 = vi_set_all(mv[4]), m02 = vi_set_all(mv[ 8]), m03 = vi_set_all(mv[12]);
+    v128 m10 = vi_set_all(mv[1]), m11 = vi_set_all(mv[5]), m12 = vi_set_all(mv[ 9]), m13 = vi_set_all(mv[13]);
+    v128 m20 = vi_set_all(mv[2]), m21 = vi_set_all(mv[6]), m22 = vi_set_all(mv[10]), m23 = vi_set_all(mv[14]);
+
+    uint32_t count = lights.count;
+    uint32_t i     = 0;
+
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        v128 x = vi_loadu_v4(lights.x + i);
+        v128 y = vi_loadu_v4(lights.y + i);
+        v128 z = vi_loadu_v4(lights.z + i);
+
+        vi_store_v4(builder->viewX + i, vi_mad(m00, x, vi_mad(m01, y, vi_mad(m02, z, m03))));
+        vi_store_v4(builder->viewY + i, vi_mad(m10, x, vi_mad(m11, y, vi_mad(m12, z, m13))));
+        vi_store_v4(builder->viewZ + i, vi_mad(m20, x, vi_mad(m21, y, vi_mad(m22, z, m23))));
+        vi_store_v4(builder->range + i, vi_loadu_v4(lights.range + i));
+    }
+
+    for (; i < count; ++i)
+    {
+        float x = lights.x[i], y = lights.y[i], z = lights.z[i];
+
+        builder->viewX[i] = mv[0] * x + mv[4] * y + mv[ 8] * z + mv[12];
+        builder->viewY[i] = mv[1] * x + mv[5] * y + mv[ 9] * z + mv[13];
+        builder->viewZ[i] = mv[2] * x + mv[6] * y + mv[10] * z + mv[14];
+        builder->range[i] = lights.range[i];
+    }
+}
+
+static void buildClusterGeometry(light_grid_builder_t builder, v128 proj[4])
+{
+    PROFILER_CPU_TIMESLICE("BuildClusterGeometry");
+
+    const light_grid_desc_t& desc = builder->desc;
+    const light_grid_t&      grid = builder->grid;
+
+    CORE_ALIGN(16) float p[16];
+    for (int i = 0; i < 4; ++i)
+    {
+        vi_store_v4(p + 4 * i, proj[i]);
+    }
+
+    // clip.x = p[0] * x + p[8] * z, clip.w = -z = dist  =>  x = dist * (ndc + p[8]) / p[0]
+    builder->projScaleX  = p[0];
+    builder->projScaleY  = p[5];
+    builder->projOffsetX = p[8];
+    builder->projOffsetY = p[9];
+
+    uint32_t strideX   = (uint32_t)bit_align_up(grid.dimX, SIMD_WIDTH);
+    uint32_t sizeX     = strideX   * grid.dimZ;
+    uint32_t sizeY     = grid.dimY * grid.dimZ;
+    uint32_t sizeSlice = (uint32_t)bit_align_up(grid.dimZ, SIMD_WIDTH);
+
+    ensureCapacity(builder->geometry, builder->geometryCapacity, 2 * (sizeX + sizeY + sizeSlice));
+
+    builder->strideX      = strideX;
+    builder->tileMinX     = builder->geometry;
+    builder->tileMaxX     = builder->tileMinX + sizeX;
+    builder->tileMinY     = builder->tileMaxX + sizeX;
+    builder->tileMaxY     = builder->tileMinY + sizeY;
+    builder->sliceMinDist = builder->tileMaxY + sizeY;
+    builder->sliceMaxDist = builder->sliceMinDist + sizeSlice;
+
+    float sliceDistScale = desc.sliceScale / (desc.sliceBase - 1.0f);
+    float sliceStart     = 1.0f;
+
+    for (uint32_t z = 0; z < grid.dimZ; ++z)
+    {
+        float dn = (sliceStart - 1.0f) * sliceDistScale;
+        sliceStart *= desc.sliceBase;
+        float df = (sliceStart - 1.0f) * sliceDistScale;
+
+        builder->sliceMinDist[z] = dn;
+        builder->sliceMaxDist[z] = df;
+
+        float* minX = builder->tileMinX + z * strideX;
+        float* maxX = builder->tileMaxX + z * strideX;
+        for (uint32_t x = 0; x < strideX; ++x)
+        {
+            if (x < grid.dimX)
+            {
+                float ndcL = 2.0f * float( x      * desc.tileDimX) / float(desc.width) - 1.0f;
+                float ndcR = 2.0f * float((x + 1) * desc.tileDimX) / float(desc.width) - 1.0f;
+                float sL   = (ndcL + builder->projOffsetX) / builder->projScaleX;
+                float sR   = (ndcR + builder->projOffsetX) / builder->projScaleX;
+
+                minX[x] = core::min(sL * dn, sL * df);
+                maxX[x] = core::max(sR * dn, sR * df);
+            }
+            else
+            {
+                // Padding never intersects
+                minX[x] =  FLT_MAX;
+                maxX[x] = -FLT_MAX;
+            }
+        }
+
+        float* minY = builder->tileMinY + z * grid.dimY;
+        float* maxY = builder->tileMaxY + z * grid.dimY;
+        for (uint32_t y = 0; y < grid.dimY; ++y)
+        {
+            float ndcB = 2.0f * float( y      * desc.tileDimY) / float(desc.height) - 1.0f;
+            float ndcT = 2.0f * float((y + 1) * desc.tileDimY) / float(desc.height) - 1.0f;
+            float sB   = (ndcB + builder->projOffsetY) / builder->projScaleY;
+            float sT   = (ndcT + builder->projOffsetY) / builder->projScaleY;
+
+            minY[y] = core::min(sB * dn, sB * df);
+            maxY[y] = core::max(sT * dn, sT * df);
+        }
+    }
+}
+
+static __forceinline int32_t sliceFromDist(const light_grid_t& grid, float dist)
+{
+    return (int32_t)floorf(logf(dist * -grid.zScale + grid.zOffset) * grid.zLogScale);
+}
+
+static __forceinline int32_t tileFromSlope(float slope, float projScale, float projOffset, uint32_t size, uint32_t tileDim)
+{
+    float ndc   = slope * projScale - projOffset;
+    float pixel = (ndc * 0.5f + 0.5f) * float(size);
+
+    // Slopes from tiny dmin overflow int32, clamp before cast
+    pixel = ml::clamp(pixel, 0.0f, float(size));
+
+    return (int32_t)floorf(pixel / float(tileDim));
+}
+
+static void binAppend(light_grid_bin_t* bin, uint32_t cluster, uint16_t light)
+{
+    if (bin->size == bin->capacity)
+    {
+        uint32_t capacity = core::max<uint32_t>(MIN_BIN_CAPACITY, bin->capacity * 2);
+
+        uint32_t* clusters = (uint32_t*)_aligned_malloc(sizeof(uint32_t) * capacity, 16);
+        uint16_t* lights   = (uint16_t*)_aligned_malloc(sizeof(uint16_t) * capacity, 16);
+
+        memcpy(clusters, bin->clusters, sizeof(uint32_t) * bin->size);
+        memcpy(lights,   bin->lights,   sizeof(uint16_t) * bin->size);
+
+        _aligned_free(bin->clusters);
+        _aligned_free(bin->lights);
+
+        bin->clusters = clusters;
+        bin->lights   = lights;
+        bin->capacity = capacity;
+    }
+
+    bin->clusters[bin->size] = cluster;
+    bin->lights  [bin->size] = light;
+    ++bin->size;
+    ++bin->counts[cluster];
+}
+
+static void binLight(light_grid_builder_t builder, light_grid_bin_t* bin, uint32_t light)
+{
+    const light_grid_desc_t& desc = builder->desc;
+    const light_grid_t&      grid = builder->grid;
+
+    float cx   = builder->viewX[light];
+    float cy   = builder->viewY[light];
+    float dist = -builder->viewZ[light];
+    float r    = builder->range[light];
+    float r2   = r * r;
+
+    float dmin = dist - r;
+    float dmax = dist + r;
+
+    if (dmax <= 0.0f)
+    {
+        return;
+    }
+
+    int32_t z0 = core::max(0, sliceFromDist(grid, core::max(0.0f, dmin)));
+    int32_t z1 = core::min((int32_t)grid.dimZ - 1, sliceFromDist(grid, dmax));
+
+    int32_t x0 = 0, x1 = grid.dimX - 1;
+    int32_t y0 = 0, y1 = grid.dimY - 1;
+
+    // View space box of the sphere projects inside extreme slopes of its corners
+    if (dmin > 0.0f)
+    {
+        float sxMin = core::min((cx - r) / dmin, (cx - r) / dmax);
+        float sxMax = core::max((cx + r) / dmin, (cx + r) / dmax);
+        float syMin = core::min((cy - r) / dmin, (cy - r) / dmax);
+        float syMax = core::max((cy + r) / dmin, (cy + r) / dmax);
+
+        x0 = core::max(x0, tileFromSlope(sxMin, builder->projScaleX, builder->projOffsetX, desc.width,  desc.tileDimX));
+        x1 = core::min(x1, tileFromSlope(sxMax, builder->projScaleX, builder->projOffsetX, desc.width,  desc.tileDimX));
+        y0 = core::max(y0, tileFromSlope(syMin, builder->projScaleY, builder->projOffsetY, desc.height, desc.tileDimY));
+        y1 = core::min(y1, tileFromSlope(syMax, builder->projScaleY, builder->projOffsetY, desc.height, desc.tileDimY));
+    }
+
+    if (x0 > x1 || y0 > y1)
+    {
+        return;
+    }
+
+    const v128 vzero = vi_set_zero();
+    const v128 vcx   = vi_set_all(cx);
+
+    int32_t xStart = x0 & ~(SIMD_WIDTH - 1);
+
+    for (int32_t z = z0; z <= z1; ++z)
+    {
+        float dz  = core::max(0.0f, core::max(builder->sliceMinDist[z] - dist, dist - builder->sliceMaxDist[z]));
+        float dz2 = dz * dz;
+
+        if (dz2 > r2) continue;
+
+        const float* minX = builder->tileMinX + z * builder->strideX;
+        const float* maxX = builder->tileMaxX + z * builder->strideX;
+        const float* minY = builder->tileMinY + z * grid.dimY;
+        const float* maxY = builder->tileMaxY + z * grid.dimY;
+
+        for (int32_t y = y0; y <= y1; ++y)
+        {
+            float dy   = core::max(0.0f, core::max(minY[y] - cy, cy - maxY[y]));
+            float dyz2 = dy * dy + dz2;
+
+            if (dyz2 > r2) continue;
+
+            v128     vrem = vi_set_all(r2 - dyz2);
+            uint32_t row  = (z * grid.dimY + y) * grid.dimX;
+
+            for (int32_t x = xStart; x <= x1; x += SIMD_WIDTH)
+            {
+                v128 dx = vi_max(vzero, vi_max(vi_sub(vi_load_v4(minX + x), vcx), vi_sub(vcx, vi_load_v4(maxX + x))));
+
+                uint32_t mask = (uint32_t)_mm_movemask_ps(vi_cmp_le(vi_mul(dx, dx), vrem));
+
+                // Clip lanes outside of [x0, x1]
+                if (x < x0)                  mask &= 0xF << (x0 - x);
+                if (x + SIMD_WIDTH - 1 > x1) mask &= 0xF >> (x + SIMD_WIDTH - 1 - x1);
+
+                while (mask)
+                {
+                    int lane = bit_ffs(mask);
+                    binAppend(bin, row + x + lane, (uint16_t)light);
+                    mask &= mask - 1;
+                }
+            }
+        }
+    }
+}
+
+static void binLightsJob(uint32_t begin, uint32_t end, void* arg)
+{
+    light_grid_builder_t builder = (light_grid_builder_t)arg;
+
+    uint32_t          worker = mt::workerIndex();
+    light_grid_bin_t* bin    = &builder->bins[worker];
+
+    assert(worker < MAX_GRID_WORKERS);
+
+    if (bin->frame != builder->frame)
+    {
+        bin->frame = builder->frame;
+        bin->size  = 0;
+
+        ensureCapacity(bin->counts, bin->countsCapacity, builder->grid.numClusters);
+        memset(bin->counts, 0, sizeof(int32_t) * builder->grid.numClusters);
+    }
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        binLight(builder, bin, i);
+    }
+}
+
+// Prefix sum pass 1: total count per cluster and per block of clusters
+static void sumCountsJob(uint32_t begin, uint32_t end, void* arg)
+{
+    light_grid_builder_t builder = (light_grid_builder_t)arg;
+
+    for (uint32_t block = begin; block < end; ++block)
+    {
+        uint32_t first = block * CLUSTER_BLOCK_SIZE;
+        uint32_t last  = core::min(first + CLUSTER_BLOCK_SIZE, builder->grid.numClusters);
+        int32_t  sum   = 0;
+
+        for (uint32_t c = first; c < last; ++c)
+        {
+            int32_t count = 0;
+            for (uint32_t i = 0; i < builder->numUsedBins; ++i)
+            {
+                count += builder->bins[builder->usedBins[i]].counts[c];
+            }
+
+            builder->counts[c] = count;
+            sum += count;
+        }
+
+        builder->blockOffsets[block] = sum;
+    }
+}
+
+// Prefix sum pass 2: cluster offsets and write position of every bin inside cluster
+static void computeOffsetsJob(uint32_t begin, uint32_t end, void* arg)
+{
+    light_grid_builder_t builder = (light_grid_builder_t)arg;
+
+    for (uint32_t block = begin; block < end; ++block)
+    {
+        uint32_t first  = block * CLUSTER_BLOCK_SIZE;
+        uint32_t last   = core::min(first + CLUSTER_BLOCK_SIZE, builder->grid.numClusters);
+        int32_t  offset = builder->blockOffsets[block];
+
+        for (uint32_t c = first; c < last; ++c)
+        {
+            builder->offsets[c] = offset;
+
+            for (uint32_t i = 0; i < builder->numUsedBins; ++i)
+            {
+                int32_t* counts = builder->bins[builder->usedBins[i]].counts;
+                int32_t  count  = counts[c];
+
+                counts[c] = offset;
+                offset   += count;
+            }
+        }
+    }
+}
+
+static void scatterBinsJob(uint32_t begin, uint32_t end, void* arg)
+{
+    light_grid_builder_t builder = (light_grid_builder_t)arg;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        light_grid_bin_t* bin = &builder->bins[builder->usedBins[i]];
+
+        for (uint32_t p = 0; p < bin->size; ++p)
+        {
+            builder->lightList[bin->counts[bin->clusters[p]]++] = bin->lights[p];
+        }
+    }
+}
+
+const light_grid_t* lightGridBuild(light_grid_builder_t builder, const light_grid_desc_t& desc,
+                                   v128 modelView[4], v128 proj[4], const light_soa_t& lights)
+{
+    PROFILER_CPU_TIMESLICE("LightGridBuild");
+
+    assert(lights.count <= builder->maxLights);
+    assert(desc.sliceBase > 1.0f && desc.sliceScale > 0.0f);
+
+    light_grid_t& grid = builder->grid;
+
+    builder->desc = desc;
+    ++builder->frame;
+
+    grid.dimX        = (desc.width  + desc.tileDimX - 1) / desc.tileDimX;
+    grid.dimY        = (desc.height + desc.tileDimY - 1) / desc.tileDimY;
+    grid.dimZ        = desc.dimZ;
+    grid.numClusters = grid.dimX * grid.dimY * grid.dimZ;
+    grid.zLogScale   = 1.0f / logf(desc.sliceBase);
+    grid.zScale      = -(desc.sliceBase - 1.0f) / desc.sliceScale;
+    grid.zOffset     = 1.0f;
+
+    assert(grid.numClusters <= CLUSTER_BLOCK_SIZE * MAX_CLUSTER_BLOCKS);
+
+    ensureCapacity(builder->clusterData, builder->clustersCapacity, 2 * grid.numClusters);
+    builder->offsets = builder->clusterData;
+    builder->counts  = builder->clusterData + grid.numClusters;
+
+    transformLights(builder, modelView, lights);
+    buildClusterGeometry(builder, proj);
+
+    {
+        PROFILER_CPU_TIMESLICE("BinLights");
+        mt::jobWait(mt::parallelFor(binLightsJob, builder, lights.count, LIGHT_GRAIN_SIZE));
+    }
+
+    builder->numUsedBins = 0;
+    for (uint32_t i = 0; i < MAX_GRID_WORKERS; ++i)
+    {
+        if (builder->bins[i].frame == builder->frame)
+        {
+            builder->usedBins[builder->numUsedBins++] = i;
+        }
+    }
+
+    uint32_t numBlocks  = (grid.numClusters + CLUSTER_BLOCK_SIZE - 1) / CLUSTER_BLOCK_SIZE;
+    uint32_t totalCount = 0;
+
+    if (builder->numUsedBins == 0)
+    {
+        memset(builder->offsets, 0, sizeof(int32_t) * grid.numClusters);
+        memset(builder->counts,  0, sizeof(int32_t) * grid.numClusters);
+    }
+    else
+    {
+        PROFILER_CPU_TIMESLICE("PrefixSum");
+
+        mt::jobWait(mt::parallelFor(sumCountsJob, builder, numBlocks, 1));
+
+        for (uint32_t block = 0; block < numBlocks; ++block)
+        {
+            uint32_t sum = builder->blockOffsets[block];
+            builder->blockOffsets[block] = totalCount;
+            totalCount += sum;
+        }
+
+        mt::jobWait(mt::parallelFor(computeOffsetsJob, builder, numBlocks, 1));
+    }
+
+    ensureCapacity(builder->lightList, builder->lightListCapacity, core::max(totalCount, 1u));
+
+    if (builder->numUsedBins)
+    {
+        PROFILER_CPU_TIMESLICE("ScatterBins");
+        mt::jobWait(mt::parallelFor(scatterBinsJob, builder, builder->numUsedBins, 1));
+    }
+
+    grid.offsets       = builder->offsets;
+    grid.counts        = builder->counts;
+    grid.lightList     = builder->lightList;
+    grid.lightListSize = totalCount;
+    grid.viewX         = builder->viewX;
+    grid.viewY         = builder->viewY;
+    grid.viewZ         = builder->viewZ;
+
+    return &grid;
+}
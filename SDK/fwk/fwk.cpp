@@ -34,6 +34,10 @@ namespace fwk
         PHYSFS_mount("../AppData",    0, 1);
         PHYSFS_mount("../../AppData", 0, 1);
 
+        // Precompiled data(e.g. mjson blobs) is saved next to the sources
+        if (!PHYSFS_setWriteDir("AppData") && !PHYSFS_setWriteDir("../AppData"))
+            PHYSFS_setWriteDir("../../AppData");
+
         if(SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER)<0)
         {
             fprintf(stderr, "Unable to open SDL: %s\n", SDL_GetError());
@@ -106,6 +110,7 @@ namespace fwk
         while (runLoop)
         {
             profilerStartSyncPoint();
+            PROFILER_CPU_MARKER("Frame start");
             {
                 PROFILER_CPU_TIMESLICE("Frame");
 
@@ -9,6 +9,7 @@ extern "C"
 #include <libswresample/swresample.h>
 }
 
+#include <SDL2/SDL.h>
 #include <gfx/gfx.h>
 
 #define PACKET_BUFFER_SIZE    64
@@ -31,10 +32,12 @@ struct media_player_data_t
     PixelFormat      srcFormat;
     AVRational       frameDuration;
     int              playback;
-    int              streamEnd;
+    volatile int     streamEnd;
+    volatile int     stopDemux;
 
-    core::ring_buffer_t<AVPacket, PACKET_BUFFER_SIZE> aPackets;
-    core::ring_buffer_t<AVPacket, PACKET_BUFFER_SIZE> vPackets;
+    // Filled by demux thread, drained by decoding
+    core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE> aPackets;
+    core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE> vPackets;
 
     uint64_t baseTime, timeShift, timeOfNextFrame, frameTime;
 
@@ -56,8 +59,9 @@ struct media_player_data_t
     
     ALuint bufferToUpdate;
 
-    uint32_t eventID;
-    bool     taskStarted;
+    uint32_t     eventID;
+    SDL_Thread*  demuxThread;
+    bool         taskStarted;
 };
 
 typedef struct media_player_data_t* media_player_t;
@@ -189,74 +193,139 @@ static void closeVideoStream(media_player_t player)
     }
 }
 
-static void streamMediaData(media_player_t player)
+static bool pushPacket(media_player_t player, core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE>& packets, AVPacket& packet)
 {
-    PROFILER_CPU_TIMESLICE("streamMediaData");
+    for (uint32_t spin = 0; !core::spsc_ring_push(packets, packet); core::ring_wait_backoff(spin))
+    {
+        if (player->stopDemux)
+        {
+            av_free_packet(&packet);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Producer: reads packets ahead while decoding runs concurrently.
+// Blocks on full rings for the whole stream, so it runs on own thread
+// instead of job system: worker stealing it would stop issuing decode jobs.
+static void demuxPackets(media_player_t player)
+{
+    PROFILER_CPU_TIMESLICE("demuxPackets");
 
     AVPacket packet;
 
-    if (!player->streamEnd && av_read_frame(player->formatContext, &packet)>=0)
+    while (!player->stopDemux && av_read_frame(player->formatContext, &packet)>=0)
     {
         if (packet.stream_index==player->audioStream)
         {
-            *core::ring_buffer_alloc(player->aPackets) = packet;
+            if (!pushPacket(player, player->aPackets, packet)) return;
         }
         else if (packet.stream_index==player->videoStream)
         {
-            *core::ring_buffer_alloc(player->vPackets) = packet;
+            if (!pushPacket(player, player->vPackets, packet)) return;
+        }
+        else
+        {
+            av_free_packet(&packet);
         }
     }
-    else if (!player->streamEnd)
+
+    if (!player->stopDemux)
     {
-        player->streamEnd = true;
+        // Empty packet flushes frames buffered in video decoder
+        av_init_packet(&packet);
         packet.data = 0;
         packet.size = 0;
-        *core::ring_buffer_alloc(player->vPackets) = packet;
+        if (!pushPacket(player, player->vPackets, packet)) return;
+    }
+
+    _ReadWriteBarrier();
+    player->streamEnd = true;
+}
+
+static int SDLCALL demuxThreadProc(void* arg)
+{
+    core::thread_data_init();
+    profilerSetThreadName("Demux");
+
+    demuxPackets((media_player_t)arg);
+
+    core::thread_data_fini();
+
+    return 0;
+}
+
+static void stopDemuxThread(media_player_t player)
+{
+    if (player->demuxThread)
+    {
+        player->stopDemux = true;
+        SDL_WaitThread(player->demuxThread, 0);
+        player->demuxThread = 0;
+    }
+}
+
+// Consumer: wait for packet unless stream is over, demuxer is stopped or blocked on the other full ring
+static bool popPacket(media_player_t player,
+                      core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE>& packets,
+                      core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE>& otherPackets,
+                      AVPacket* packet)
+{
+    for (uint32_t spin = 0; !core::spsc_ring_pop(packets, packet); core::ring_wait_backoff(spin))
+    {
+        if (player->streamEnd)
+        {
+            return core::spsc_ring_pop(packets, packet);
+        }
+
+        if (player->stopDemux)
+        {
+            return false;
+        }
+
+        if (core::spsc_ring_used(otherPackets) == PACKET_BUFFER_SIZE)
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
 static void decodeAudio(media_player_t player)
 {
     PROFILER_CPU_TIMESLICE("decodeAudio");
 
-    int audioDataAva;
-    
-    audioDataAva    = 1;
+    AVPacket packet;
+
     player->aBufferUsed = 0;
     player->aSamplesUsed = 0;
 
-    while((player->aSamplesUsed < player->aSamplesCount) && audioDataAva)
+    while((player->aSamplesUsed < player->aSamplesCount) && popPacket(player, player->aPackets, player->vPackets, &packet))
     {
-        if (core::ring_buffer_used(player->aPackets)>0)
-        {
-            AVPacket* pkt       = core::ring_buffer_back(player->aPackets);
-            int       frameDone = 0;
+        int frameDone = 0;
 
-            avcodec_decode_audio4(player->audioContext, player->pAFrame, &frameDone, pkt);
+        avcodec_decode_audio4(player->audioContext, player->pAFrame, &frameDone, &packet);
 
-            av_free_packet(pkt);
-            core::ring_buffer_pop(player->aPackets);
+        av_free_packet(&packet);
 
-            if(frameDone)
-            {
-                int srcNSamples = player->pAFrame->nb_samples;
-                int dstNSamples = player->aSamplesCount-player->aSamplesUsed;
+        if(frameDone)
+        {
+            int srcNSamples = player->pAFrame->nb_samples;
+            int dstNSamples = player->aSamplesCount-player->aSamplesUsed;
 
-                uint8_t**  src = player->pAFrame->extended_data;
-                uint8_t*   dst = player->aBuffer+player->aBufferUsed;
-                dstNSamples = swr_convert(player->resamplerContext, &dst, dstNSamples, (const uint8_t**)src, srcNSamples);
+            uint8_t**  src = player->pAFrame->extended_data;
+            uint8_t*   dst = player->aBuffer+player->aBufferUsed;
+            dstNSamples = swr_convert(player->resamplerContext, &dst, dstNSamples, (const uint8_t**)src, srcNSamples);
 
-                int bufSizeAva = dstNSamples*2/*channels*/*2/*sizeof(int16_t)*/; //NOTE: hardcode!!!
-                assert(bufSizeAva>=0);
+            int bufSizeAva = dstNSamples*2/*channels*/*2/*sizeof(int16_t)*/; //NOTE: hardcode!!!
+            assert(bufSizeAva>=0);
 
-                player->aBufferUsed  += bufSizeAva;
-                player->aSamplesUsed += dstNSamples;
-            }
+            player->aBufferUsed  += bufSizeAva;
+            player->aSamplesUsed += dstNSamples;
         }
-        else
-            streamMediaData(player);
-
-        audioDataAva = !player->streamEnd || core::ring_buffer_used(player->aPackets)>0;
     }
 }
 
@@ -264,30 +333,32 @@ static void decodeVideo(media_player_t player)
 {
     PROFILER_CPU_TIMESLICE("decodeVideo");
 
-    int videoDataAva = 1;
+    AVPacket packet;
 
-    while(videoDataAva)
+    while(popPacket(player, player->vPackets, player->aPackets, &packet))
     {
-        if (core::ring_buffer_used(player->vPackets)>0)
-        {
-            AVPacket* pkt       = core::ring_buffer_back(player->vPackets);
-            int       frameDone = 0;
+        int frameDone = 0;
 
-            avcodec_decode_video2(player->videoContext, player->pVFrame, &frameDone, pkt);
+        avcodec_decode_video2(player->videoContext, player->pVFrame, &frameDone, &packet);
 
-            av_free_packet(pkt);
-            core::ring_buffer_pop(player->vPackets);
+        int64_t dts = packet.dts;
+        av_free_packet(&packet);
 
-            if(frameDone)
-            {
-                player->frameTime = player->frameDuration.num*pkt->dts*1000000/player->frameDuration.den;
-                break;
-            }
+        if(frameDone)
+        {
+            player->frameTime = player->frameDuration.num*dts*1000000/player->frameDuration.den;
+            break;
         }
-        else
-            streamMediaData(player);
+    }
+}
+
+static void flushPackets(core::spsc_ring_t<AVPacket, PACKET_BUFFER_SIZE>& packets)
+{
+    AVPacket packet;
 
-        videoDataAva = !player->streamEnd || core::ring_buffer_used(player->vPackets)>0;
+    while (core::spsc_ring_pop(packets, &packet))
+    {
+        av_free_packet(&packet);
     }
 }
 
@@ -380,22 +451,27 @@ media_player_t mediaCreatePlayer(const char* source)
 
     player->taskStarted = false;
     player->eventID     = mt::INVALID_HANDLE;
+    player->demuxThread = 0;
 
-    core::ring_buffer_reset(player->aPackets);
-    core::ring_buffer_reset(player->vPackets);
+    core::spsc_ring_reset(player->aPackets);
+    core::spsc_ring_reset(player->vPackets);
 
     return player;
 }
 
 void mediaDestroyPlayer(media_player_t player)
 {
+    player->stopDemux = true;
+
     if (player->taskStarted)
     {
         mt::syncAndReleaseEvent(player->eventID);
     }
 
-    core::ring_buffer_reset(player->aPackets);
-    core::ring_buffer_reset(player->vPackets);
+    stopDemuxThread(player);
+
+    flushPackets(player->aPackets);
+    flushPackets(player->vPackets);
 
     closeAudioStream(player);
     closeVideoStream(player);
@@ -431,10 +507,47 @@ static void decodeTask(void* arg)
     doDecode(player);
 }
 
+static void rewindPlayback(media_player_t player)
+{
+    // Decoding task consumes rings, finish it before demuxer is stopped
+    if (player->taskStarted)
+    {
+        mt::syncAndReleaseEvent(player->eventID);
+        player->taskStarted = false;
+    }
+
+    stopDemuxThread(player);
+
+    flushPackets(player->aPackets);
+    flushPackets(player->vPackets);
+
+    av_seek_frame(player->formatContext, -1, 0, AVSEEK_FLAG_BACKWARD);
+    if (player->audioContext) avcodec_flush_buffers(player->audioContext);
+    if (player->videoContext) avcodec_flush_buffers(player->videoContext);
+
+    // Unqueues all buffers so they can be filled again
+    alSourceStop(player->audioSource);
+    alSourcei(player->audioSource, AL_BUFFER, 0);
+
+    player->playback = FALSE;
+}
+
 void mediaStartPlayback(media_player_t player)
 {
+    if (player->playback || player->taskStarted || player->demuxThread)
+    {
+        rewindPlayback(player);
+    }
+
     player->timeOfNextFrame = 0;
     player->streamEnd       = FALSE;
+    player->stopDemux       = FALSE;
+
+    player->demuxThread = SDL_CreateThread(demuxThreadProc, "Demux", player);
+    if (!player->demuxThread)
+    {
+        return;
+    }
 
     player->subTasks = MEDIA_DECODE_VIDEO|MEDIA_DECODE_AUDIO;
     doDecode(player);
@@ -464,10 +577,16 @@ void mediaPlayerUpdate(media_player_t player)
 
     ALuint buffer;
 
-    player->playback = !player->streamEnd || core::ring_buffer_used(player->aPackets)>0 || core::ring_buffer_used(player->vPackets)>0;
+    player->playback = !player->streamEnd || core::spsc_ring_used(player->aPackets)>0 || core::spsc_ring_used(player->vPackets)>0;
 
     if (player->taskStarted)
     {
+        // Do not block on decoding, keep presenting current data until task is done
+        if (!mt::eventIsSignaled(player->eventID))
+        {
+            return;
+        }
+
         mt::syncAndReleaseEvent(player->eventID);
 
         if (player->subTasks&MEDIA_DECODE_VIDEO)
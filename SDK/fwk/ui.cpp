@@ -52,6 +52,9 @@ namespace ui
         PROF_STATE_DATA_RETRIEVAL
     };
 
+    static const uint32_t FLIGHT_RECORDER_WINDOW_MS = 250;
+    static const uint32_t STATS_WINDOW_FRAMES       = 300;
+
     size_t uiState;
     size_t profilerState;
 
@@ -186,6 +189,38 @@ namespace ui
             profilerState = PROF_STATE_FRAME_CAPTURE;
             profilerStartCapture();
         }
+        else if (
+            profilerState==PROF_STATE_NO_CAPTURE &&
+            ui::keyIsPressed(SDL_SCANCODE_GRAVE) &&
+            ui::keyWasReleased(SDL_SCANCODE_R)
+        )
+        {
+            // First press starts flight recorder, next ones show last recorded frames
+            if (profilerIsFlightRecorderActive())
+            {
+                profilerState = PROF_STATE_DATA_RETRIEVAL;
+                profilerSnapshotFlightRecorder();
+            }
+            else
+            {
+                profilerStartFlightRecorder(FLIGHT_RECORDER_WINDOW_MS);
+            }
+        }
+        else if (
+            profilerState==PROF_STATE_NO_CAPTURE &&
+            ui::keyIsPressed(SDL_SCANCODE_GRAVE) &&
+            ui::keyWasReleased(SDL_SCANCODE_S)
+        )
+        {
+            if (profilerIsStatsActive())
+            {
+                profilerStopStats();
+            }
+            else
+            {
+                profilerStartStats(STATS_WINDOW_FRAMES);
+            }
+        }
         else if (
             profilerState!=PROF_STATE_NO_CAPTURE &&
             profilerState!=PROF_STATE_TIMESLICE_CAPTURE
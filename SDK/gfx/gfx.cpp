@@ -192,6 +192,8 @@ namespace gfx
         frameSync[frameID] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
         
         frameID = (frameID + 1) % NUM_FRAMES_DELAY;
+
+        core::frame_alloc_swap();
     }
 
     GLuint createVAO(GLuint numEntries, const vertex_element_t* entries, GLuint numStreams, GLuint* streamDivisors)
@@ -224,7 +224,7 @@ namespace gfx_res
 
         vaoRect = gfx::createVAO(2, ve, 2, divs);
 
-        vgGArena = etlsf_create(VG_BUFFER_SIZE, GFX_MAX_ALLOCS);
+        vgGArena = etlsf_create_ex(VG_BUFFER_SIZE, GFX_MAX_ALLOCS, ETLSF_THREAD_SAFE);
         glCreateBuffers(1, &buffer);
         glNamedBufferStorage(buffer, VG_BUFFER_SIZE, 0, GL_MAP_WRITE_BIT);
 
@@ -92,12 +92,13 @@ struct GLNVGfragUniforms {
 };
 typedef struct GLNVGfragUniforms GLNVGfragUniforms;
 
+static const uint32_t ID_TYPE_NVG_TEXTURE = 3;
+static const uint32_t NVG_TEXTURE_PAGE_SIZE = 64;
+static const uint32_t NVG_MAX_TEXTURES = 4096;
+
 struct GLNVGcontext {
-    GLNVGtexture* textures;
+    core::handle_table_t<GLNVGtexture> textures;
     float view[2];
-    int ntextures;
-    int ctextures;
-    int textureId;
     int flags;
 
     // Per frame buffers
@@ -115,53 +116,31 @@ typedef struct GLNVGcontext GLNVGcontext;
 static GLNVGtexture* glnvg__allocTexture(GLNVGcontext* gl)
 {
     GLNVGtexture* tex = NULL;
-    int i;
+    uint32_t id = core::handle_table_alloc(gl->textures, &tex);
 
-    for (i = 0; i < gl->ntextures; i++) {
-        if (gl->textures[i].id == 0) {
-            tex = &gl->textures[i];
-            break;
-        }
-    }
-    if (tex == NULL) {
-        if (gl->ntextures + 1 > gl->ctextures) {
-            GLNVGtexture* textures;
-            int ctextures = core::max(gl->ntextures + 1, 4) + gl->ctextures / 2; // 1.5x Overallocate
-            textures = (GLNVGtexture*)realloc(gl->textures, sizeof(GLNVGtexture)*ctextures);
-            if (textures == NULL) return NULL;
-            gl->textures = textures;
-            gl->ctextures = ctextures;
-        }
-        tex = &gl->textures[gl->ntextures++];
-    }
+    if (id == core::HANDLE_INVALID) return NULL;
 
-    mem_zero(tex);
-    tex->id = ++gl->textureId;
+    // Image ids are handles, type bits keep them non zero
+    tex->id = (int)id;
 
     return tex;
 }
 
 static GLNVGtexture* glnvg__findTexture(GLNVGcontext* gl, int id)
 {
-    int i;
-    for (i = 0; i < gl->ntextures; i++)
-        if (gl->textures[i].id == id)
-            return &gl->textures[i];
-    return NULL;
+    return core::handle_table_get(gl->textures, (uint32_t)id);
 }
 
 static int glnvg__deleteTexture(GLNVGcontext* gl, int id)
 {
-    int i;
-    for (i = 0; i < gl->ntextures; i++) {
-        if (gl->textures[i].id == id) {
-            if (gl->textures[i].tex != 0 && (gl->textures[i].flags & NVGL_TEXTURE_NODELETE) == 0)
-                glDeleteTextures(1, &gl->textures[i].tex);
-            mem_zero(&gl->textures[i]);
-            return 1;
-        }
-    }
-    return 0;
+    GLNVGtexture* tex = glnvg__findTexture(gl, id);
+
+    if (tex == NULL) return 0;
+
+    if (tex->tex != 0 && (tex->flags & NVGL_TEXTURE_NODELETE) == 0)
+        glDeleteTextures(1, &tex->tex);
+
+    return core::handle_table_free(gl->textures, (uint32_t)id);
 }
 
 static int glnvg__renderCreate(void* uptr)
@@ -773,11 +752,11 @@ static void glnvg__renderDelete(void* uptr)
     int i;
     if (gl == NULL) return;
 
-    for (i = 0; i < gl->ntextures; i++) {
-        if (gl->textures[i].tex != 0 && (gl->textures[i].flags & NVGL_TEXTURE_NODELETE) == 0)
-            glDeleteTextures(1, &gl->textures[i].tex);
+    for (i = 0; i < (int)core::handle_table_size(gl->textures); i++) {
+        if (gl->textures.items[i].tex != 0 && (gl->textures.items[i].flags & NVGL_TEXTURE_NODELETE) == 0)
+            glDeleteTextures(1, &gl->textures.items[i].tex);
     }
-    free(gl->textures);
+    core::handle_table_fini(gl->textures);
 
     free(gl->paths);
     free(gl->calls);
@@ -793,6 +772,7 @@ NVGcontext* nvgCreateGL3(int flags)
     GLNVGcontext* gl = (GLNVGcontext*)malloc(sizeof(GLNVGcontext));
     if (gl == NULL) goto error;
     mem_zero(gl);
+    core::handle_table_init(gl->textures, ID_TYPE_NVG_TEXTURE, NVG_TEXTURE_PAGE_SIZE, NVG_MAX_TEXTURES);
 
     mem_zero(&params);
     params.renderCreate = glnvg__renderCreate;
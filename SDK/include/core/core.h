@@ -2,15 +2,34 @@
 
 #include <stdint.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
 
 #include <physfs/physfs.h>
+#include <mjson.h>
 
 #ifndef _NDEBUG
 #   define CORE_ENABLE_ASSERT
 #endif
 
+#ifndef CORE_DISABLE_PROFILER
+#   define CORE_ENABLE_PROFILER
+#endif
+
 typedef volatile long atomic_t;
 
+#define CORE_CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER)
+#   define CORE_THREAD_LOCAL __declspec(thread)
+#   define CORE_ALIGN(n)     __declspec(align(n))
+#else
+#   define CORE_THREAD_LOCAL __thread
+#   define CORE_ALIGN(n)     __attribute__((aligned(n)))
+#endif
+
 #include <core/debug.h>
 #include <core/bits.h>
 #include <core/mt.h>
@@ -36,19 +55,30 @@ typedef unsigned long ulong;
 
 struct ProfilerCPUAutoTimeslice 
 {
-    uint16_t mid;
+    profiler_scope_desc_t* desc;
 
-     ProfilerCPUAutoTimeslice(uint16_t id)
+     ProfilerCPUAutoTimeslice(profiler_scope_desc_t* scope)
      {
-         mid = id;
-         profilerAddCPUEvent( mid, PROF_EVENT_PHASE_BEGIN );
+         desc = scope;
+#if !defined(_MSC_VER)
+         if (desc->id == PROFILER_INVALID_ID) profilerRegisterScope(desc);
+#endif
+         if (profilerRecording) profilerAddCPUEvent( desc->id, PROF_EVENT_PHASE_BEGIN );
      }
     ~ProfilerCPUAutoTimeslice()
     {
-        profilerAddCPUEvent( mid, PROF_EVENT_PHASE_END );
+        if (profilerRecording) profilerAddCPUEvent( desc->id, PROF_EVENT_PHASE_END );
     }
 };
 
+inline void ProfilerCPUAutoMarker(profiler_scope_desc_t* desc)
+{
+#if !defined(_MSC_VER)
+    if (desc->id == PROFILER_INVALID_ID) profilerRegisterScope(desc);
+#endif
+    if (profilerRecording) profilerAddCPUEvent( desc->id, PROF_EVENT_PHASE_MARKER );
+}
+
 namespace core
 {
     void abort();
@@ -57,29 +87,34 @@ namespace core
 inline void atomicLock  (atomic_t* lock) { while (_InterlockedExchange(lock, 1) == 1); }
 inline void atomicUnlock(atomic_t* lock) { _InterlockedExchange(lock, 0); }
 
-// TODO : remove all usages 
-// NOTE: hack for fast profiling and quick integration;
-//       profiler_scope_initialized and profiler_scope_initialized
-//       add around 8-16Kb per 1K events + a lot of code;
-#define PROFILER_CPU_TIMESLICE(name)                                \
-    static uint16_t scope_id = 0;                                   \
-    {                                                               \
-        static volatile atomic_t profiler_scope_initialized = 0;    \
-        static volatile atomic_t profiler_scope_spinlock = 0;       \
-        if (profiler_scope_initialized == 0)                        \
-        {                                                           \
-            atomicLock(&profiler_scope_spinlock);                   \
-            if (profiler_scope_initialized == 0)                    \
-            {                                                       \
-                scope_id = profilerGenerateId();                    \
-                profilerAddDesc(scope_id, name);                    \
-                profiler_scope_initialized = 1;                     \
-            }                                                       \
-            atomicUnlock(&profiler_scope_spinlock);                 \
-        }                                                           \
-    }                                                               \
-    ProfilerCPUAutoTimeslice profiler_autoscope(scope_id)           \
+// Scope descriptors are placed into dedicated section and get ids in profilerInit,
+// so scope costs a branch on profilerRecording when profiler is not recording.
+// Define CORE_DISABLE_PROFILER to compile scopes out.
+#ifdef CORE_ENABLE_PROFILER
+
+#define PROFILER_CPU_SCOPE_DESC(var, name, color)                                                   \
+    PROFILER_SCOPE_SECTION static profiler_scope_desc_t var = {                                     \
+        name, __FILE__, __LINE__, color, PROFILER_INVALID_ID                                        \
+    }                                                                                               \
+
+#define PROFILER_CPU_TIMESLICE_COLOR(name, color)                                                   \
+    PROFILER_CPU_SCOPE_DESC(CORE_UNIQUE_NAME(profiler_scope_), name, color);                        \
+    ProfilerCPUAutoTimeslice CORE_UNIQUE_NAME(profiler_autoscope_)(&CORE_UNIQUE_NAME(profiler_scope_))
 
+#define PROFILER_CPU_MARKER(name)                                                                   \
+    {                                                                                               \
+        PROFILER_CPU_SCOPE_DESC(profiler_scope, name, 0);                                           \
+        ProfilerCPUAutoMarker(&profiler_scope);                                                     \
+    }                                                                                               \
+
+#else
+
+#define PROFILER_CPU_TIMESLICE_COLOR(name, color)
+#define PROFILER_CPU_MARKER(name)
+
+#endif
+
+#define PROFILER_CPU_TIMESLICE(name) PROFILER_CPU_TIMESLICE_COLOR(name, 0)
 
 char* cpToUTF8(int cp, char* str);
 
@@ -127,6 +162,79 @@ void mem_free(memory_t* mem);
 
 //--------------------------------------------------------------------------
 
+// mjson document: memory mapped precompiled blob or storage of just parsed text,
+// data always starts with mjson_blob_header_t
+struct mjson_file_t
+{
+    mjson_element_t top;
+    uint8_t*        data;
+    size_t          size;
+    void*           mapping;
+};
+
+// Loads json text through PhysFS. Precompiled "<name>.bjson" is mapped instead of parsing
+// if it is up to date: has same source size and modification time, or same content hash.
+// Otherwise text is parsed and blob is saved, if PhysFS write directory is set.
+bool mjson_file_load(mjson_file_t* file, const char* name);
+void mjson_file_free(mjson_file_t* file);
+
+//--------------------------------------------------------------------------
+
+// Read only contents of whole file: mapped if file is in real directory,
+// otherwise read through PhysFS into memory aligned to MAPPED_FILE_ALIGNMENT
+enum
+{
+    MAPPED_FILE_ALIGNMENT = 16
+};
+
+struct mapped_file_t
+{
+    uint8_t* data;
+    size_t   size;
+    void*    mapping;
+};
+
+bool mapped_file_open (mapped_file_t* file, const char* name);
+void mapped_file_close(mapped_file_t* file);
+
+//--------------------------------------------------------------------------
+
+// Not NULL terminated view into text owned by someone else
+struct str_view_t
+{
+    const char* str;
+    size_t      size;
+};
+
+// Splits token separated by any of delims from the front of text,
+// returns false if there are no more tokens
+bool str_next_token(str_view_t* text, str_view_t* token, const char* delims = " \t");
+bool str_equal(str_view_t str, const char* literal);
+
+// Streaming line reader, lines are returned as views without copying and
+// without line breaks. File is mapped if possible, otherwise it is read
+// through PhysFS in chunks, so view is valid only until next text_reader_line.
+struct text_reader_t
+{
+    const char*  cur;
+    const char*  end;
+
+    char*        buffer;
+    size_t       capacity;
+    PHYSFS_File* file;
+
+    uint8_t*     data;
+    size_t       size;
+    void*        mapping;
+};
+
+bool text_reader_open (text_reader_t* reader, const char* name);
+void text_reader_init (text_reader_t* reader, const char* text, size_t size);
+void text_reader_close(text_reader_t* reader);
+bool text_reader_line (text_reader_t* reader, str_view_t* line);
+
+//--------------------------------------------------------------------------
+
 struct blob32_data_t
 {
     uint32_t size;
@@ -393,21 +501,83 @@ void  stack_mem_init(stack_mem_t* stack, void* mem, size_t size);
 void* stack_mem_alloc(stack_mem_t stack, size_t size, size_t align = 0);
 void  stack_mem_reset(stack_mem_t stack, void* ptr);
 
+size_t stack_mem_marker(stack_mem_t stack);
+void   stack_mem_rewind(stack_mem_t stack, size_t marker);
+size_t stack_mem_high_water(stack_mem_t stack);
+
 template<typename T>
 T* stack_mem_alloc(stack_mem_t stack, size_t count, size_t align = 0)
 {
     return (T*)stack_mem_alloc(stack, count*sizeof(T), align);
 }
 
+// Rewinds stack to the state at construction time
+struct stack_mem_scope_t
+{
+    stack_mem_t stack;
+    size_t      marker;
+
+     stack_mem_scope_t(stack_mem_t s): stack(s), marker(stack_mem_marker(s)) {}
+    ~stack_mem_scope_t() { stack_mem_rewind(stack, marker); }
+};
+
+#define THREAD_STACK_SCOPE() stack_mem_scope_t CORE_UNIQUE_NAME(thread_stack_scope)(core::get_thread_data_stack())
+
 namespace core
 {
     void init();
     void fini();
 
-    //TODO: make mt!!!!!
+    enum
+    {
+        CPU_FEATURE_SSE41 = 1<<0,
+        CPU_FEATURE_AVX   = 1<<1,
+        CPU_FEATURE_AVX2  = 1<<2,
+        CPU_FEATURE_FMA   = 1<<3,
+    };
+
+    // Instruction set extensions supported by both CPU and OS, use to select code paths at runtime
+    uint32_t cpu_features();
+
+    // Returns implementation for the widest instruction set supported,
+    // usually instantiations of the same kernel with vi_scalar_t, vi_sse41_t and vi_avx2_t
+    template <typename func_t>
+    inline func_t cpu_select(func_t scalar, func_t sse41, func_t avx2)
+    {
+        uint32_t features = cpu_features();
+
+        if (features & CPU_FEATURE_AVX2)
+        {
+            return avx2;
+        }
+
+        return (features & CPU_FEATURE_SSE41) ? sse41 : scalar;
+    }
+
+    // Every thread using thread stack should call init/fini,
+    // mt workers and main thread(in core::init) do it automatically
+    void thread_data_init();
+    void thread_data_fini();
+
     stack_mem_t get_thread_data_stack();
     void* thread_stack_alloc(size_t size, size_t align = 0);
     void  thread_stack_reset(void* ptr);
+    // Max high water mark among stacks of live threads(first 64 registered), safe to call while threads exit
+    size_t thread_stack_high_water();
+
+    // Thread safe linear allocator, memory stays valid during current and next frame.
+    // Buffers are swapped in frame_alloc_swap called from gfx::endFrame, allocation
+    // from worker racing with swap is served from buffer of ending frame and stays
+    // valid only until next swap. Returns 0 when buffer of current frame is exhausted.
+    void*  frame_alloc(size_t size, size_t align = 0);
+    void   frame_alloc_swap();
+    size_t frame_alloc_high_water();
+
+    template<typename T>
+    inline T* frame_alloc(size_t count)
+    {
+        return (T*)frame_alloc(count*sizeof(T), _alignof(T));
+    }
 
     template<typename T>
     inline T min(T x, T y)
@@ -447,6 +617,314 @@ namespace core
         return offset + adjust;
     }
 
+/*------------------ Handles -----------------------*/
+    // 32 bit generational handle: 4 bits of type, 8 bits of generation, 20 bits of index
+    static const uint32_t HANDLE_TYPE_BITS  =  4;
+    static const uint32_t HANDLE_GEN_BITS   =  8;
+    static const uint32_t HANDLE_INDEX_BITS = 20;
+
+    static const uint32_t HANDLE_TYPE_OFFSET  = HANDLE_INDEX_BITS + HANDLE_GEN_BITS;
+    static const uint32_t HANDLE_GEN_OFFSET   = HANDLE_INDEX_BITS;
+    static const uint32_t HANDLE_INDEX_OFFSET = 0;
+
+    static const uint32_t HANDLE_TYPE_MASK  = ((1 << HANDLE_TYPE_BITS ) - 1) << HANDLE_TYPE_OFFSET;
+    static const uint32_t HANDLE_GEN_MASK   = ((1 << HANDLE_GEN_BITS  ) - 1) << HANDLE_GEN_OFFSET;
+    static const uint32_t HANDLE_INDEX_MASK = ((1 << HANDLE_INDEX_BITS) - 1) << HANDLE_INDEX_OFFSET;
+
+    static const uint32_t HANDLE_INVALID_TYPE = 0x0F;
+    static const uint32_t HANDLE_INVALID      = 0xFFFFFFFF;
+
+    inline uint32_t handle_construct(uint32_t type, uint32_t gen, uint32_t index)
+    {
+        assert( type != HANDLE_INVALID_TYPE );
+
+        assert( type  < (1<<(HANDLE_TYPE_BITS )) );
+        assert( gen   < (1<<(HANDLE_GEN_BITS  )) );
+        assert( index < (1<<(HANDLE_INDEX_BITS)) );
+
+        return (type  << HANDLE_TYPE_OFFSET ) |
+               (gen   << HANDLE_GEN_OFFSET  ) |
+               (index << HANDLE_INDEX_OFFSET);
+    }
+
+    inline uint32_t handle_inc_gen(uint32_t handle)
+    {
+        return (handle & ~HANDLE_GEN_MASK) | ((handle + (1 << HANDLE_GEN_OFFSET)) & HANDLE_GEN_MASK);
+    }
+
+    inline uint32_t handle_type(uint32_t handle)
+    {
+        return (handle & HANDLE_TYPE_MASK) >> HANDLE_TYPE_OFFSET;
+    }
+
+    inline uint32_t handle_index(uint32_t handle)
+    {
+        return (handle & HANDLE_INDEX_MASK) >> HANDLE_INDEX_OFFSET;
+    }
+
+/*------------------ Object pool--------------------*/
+    // Pointer stable pool of fixed size objects, grows by pages up to maxPages.
+    // Free objects are linked through their own storage, alloc and free are O(1).
+    template<typename T>
+    struct pool_t
+    {
+        union item_t
+        {
+            item_t* next;
+            uint8_t storage[sizeof(T)];
+        };
+
+        item_t** pages;
+        item_t*  freeList;
+        uint32_t numPages;
+        uint32_t maxPages;
+        uint32_t pageSize;
+        uint32_t count;
+    };
+
+    template<typename T>
+    void pool_init(pool_t<T>& pool, uint32_t pageSize, uint32_t maxPages)
+    {
+        assert(pageSize > 0 && maxPages > 0);
+
+        pool.pages    = (typename pool_t<T>::item_t**)malloc(sizeof(typename pool_t<T>::item_t*) * maxPages);
+        pool.freeList = 0;
+        pool.numPages = 0;
+        pool.maxPages = maxPages;
+        pool.pageSize = pageSize;
+        pool.count    = 0;
+    }
+
+    template<typename T>
+    void pool_fini(pool_t<T>& pool)
+    {
+        for (uint32_t i = 0; i < pool.numPages; ++i)
+        {
+            _aligned_free(pool.pages[i]);
+        }
+        free(pool.pages);
+
+        pool.pages    = 0;
+        pool.freeList = 0;
+        pool.numPages = 0;
+        pool.count    = 0;
+    }
+
+    // Returns uninitialized storage or 0 if pool is exhausted
+    template<typename T>
+    T* pool_alloc(pool_t<T>& pool)
+    {
+        typedef typename pool_t<T>::item_t item_t;
+
+        if (!pool.freeList)
+        {
+            if (pool.numPages == pool.maxPages)
+            {
+                return 0;
+            }
+
+            item_t* page = (item_t*)_aligned_malloc(sizeof(item_t) * pool.pageSize, _alignof(T) > _alignof(item_t) ? _alignof(T) : _alignof(item_t));
+            if (!page)
+            {
+                return 0;
+            }
+
+            // Link in address order so fresh page is consumed front to back
+            for (uint32_t i = 0; i < pool.pageSize - 1; ++i)
+            {
+                page[i].next = &page[i + 1];
+            }
+            page[pool.pageSize - 1].next = 0;
+
+            pool.pages[pool.numPages++] = page;
+            pool.freeList = page;
+        }
+
+        item_t* item  = pool.freeList;
+        pool.freeList = item->next;
+        ++pool.count;
+
+        return (T*)item->storage;
+    }
+
+    template<typename T>
+    void pool_free(pool_t<T>& pool, T* ptr)
+    {
+        typedef typename pool_t<T>::item_t item_t;
+
+        assert(pool.count > 0);
+
+        item_t* item  = (item_t*)ptr;
+        item->next    = pool.freeList;
+        pool.freeList = item;
+        --pool.count;
+    }
+
+/*------------------ Handle table ------------------*/
+    // Objects addressed by generational handles and kept densely packed for iteration.
+    // Freeing moves the last object into the hole, so pointers are valid only until next free,
+    // handles stay valid until the object is freed. Storage grows by pageSize objects.
+    template<typename T>
+    struct handle_table_t
+    {
+        T*        items;        // dense, [0, count)
+        uint32_t* denseHandles; // handle of every dense item
+        uint32_t* slotHandles;  // current handle of every slot
+        uint32_t* slotDense;    // dense index of live slot or next free slot with SLOT_FREE_BIT
+        uint32_t  count;
+        uint32_t  capacity;
+        uint32_t  maxCapacity;
+        uint32_t  pageSize;
+        uint32_t  freeHead;
+        uint32_t  type;
+    };
+
+    static const uint32_t HANDLE_TABLE_SLOT_FREE_BIT = 0x80000000;
+
+    template<typename T>
+    void handle_table_init(handle_table_t<T>& table, uint32_t type, uint32_t pageSize, uint32_t maxCapacity)
+    {
+        assert(pageSize > 0 && pageSize <= maxCapacity);
+        assert(maxCapacity <= (1 << HANDLE_INDEX_BITS));
+
+        table.items        = 0;
+        table.denseHandles = 0;
+        table.slotHandles  = 0;
+        table.slotDense    = 0;
+        table.count        = 0;
+        table.capacity     = 0;
+        table.maxCapacity  = maxCapacity;
+        table.pageSize     = pageSize;
+        table.freeHead     = HANDLE_INVALID;
+        table.type         = type;
+    }
+
+    template<typename T>
+    void handle_table_fini(handle_table_t<T>& table)
+    {
+        free(table.items);
+        free(table.denseHandles);
+        free(table.slotHandles);
+        free(table.slotDense);
+
+        handle_table_init(table, table.type, table.pageSize, table.maxCapacity);
+    }
+
+    template<typename T>
+    bool handle_table_grow(handle_table_t<T>& table)
+    {
+        uint32_t capacity = table.capacity + table.pageSize;
+        if (capacity > table.maxCapacity)
+        {
+            return false;
+        }
+
+        T*        items        = (T*)realloc(table.items, sizeof(T) * capacity);
+        uint32_t* denseHandles = (uint32_t*)realloc(table.denseHandles, sizeof(uint32_t) * capacity);
+        uint32_t* slotHandles  = (uint32_t*)realloc(table.slotHandles, sizeof(uint32_t) * capacity);
+        uint32_t* slotDense    = (uint32_t*)realloc(table.slotDense, sizeof(uint32_t) * capacity);
+
+        if (items)        table.items        = items;
+        if (denseHandles) table.denseHandles = denseHandles;
+        if (slotHandles)  table.slotHandles  = slotHandles;
+        if (slotDense)    table.slotDense    = slotDense;
+
+        if (!items || !denseHandles || !slotHandles || !slotDense)
+        {
+            return false;
+        }
+
+        // New slots are pushed to free list in reverse, so lower indices are used first
+        for (uint32_t i = capacity; i > table.capacity; --i)
+        {
+            uint32_t slot = i - 1;
+            table.slotHandles[slot] = handle_construct(table.type, 0, slot);
+            table.slotDense[slot]   = HANDLE_TABLE_SLOT_FREE_BIT | table.freeHead;
+            table.freeHead          = slot;
+        }
+        table.capacity = capacity;
+
+        return true;
+    }
+
+    // Returns HANDLE_INVALID if table is full, new item is zero initialized
+    template<typename T>
+    uint32_t handle_table_alloc(handle_table_t<T>& table, T** item = 0)
+    {
+        if (table.freeHead == HANDLE_INVALID && !handle_table_grow(table))
+        {
+            return HANDLE_INVALID;
+        }
+
+        uint32_t slot   = table.freeHead;
+        uint32_t next   = table.slotDense[slot] & ~HANDLE_TABLE_SLOT_FREE_BIT;
+        uint32_t handle = table.slotHandles[slot];
+        uint32_t dense  = table.count++;
+
+        table.freeHead           = next == (HANDLE_INVALID & ~HANDLE_TABLE_SLOT_FREE_BIT) ? HANDLE_INVALID : next;
+        table.slotDense[slot]    = dense;
+        table.denseHandles[dense] = handle;
+
+        memset(&table.items[dense], 0, sizeof(T));
+        if (item)
+        {
+            *item = &table.items[dense];
+        }
+
+        return handle;
+    }
+
+    template<typename T>
+    bool handle_table_valid(const handle_table_t<T>& table, uint32_t handle)
+    {
+        uint32_t slot = handle_index(handle);
+
+        return handle != HANDLE_INVALID &&
+               slot < table.capacity &&
+               table.slotHandles[slot] == handle &&
+               (table.slotDense[slot] & HANDLE_TABLE_SLOT_FREE_BIT) == 0;
+    }
+
+    // Returns 0 for stale or invalid handle
+    template<typename T>
+    T* handle_table_get(handle_table_t<T>& table, uint32_t handle)
+    {
+        return handle_table_valid(table, handle) ? &table.items[table.slotDense[handle_index(handle)]] : 0;
+    }
+
+    template<typename T>
+    bool handle_table_free(handle_table_t<T>& table, uint32_t handle)
+    {
+        if (!handle_table_valid(table, handle))
+        {
+            return false;
+        }
+
+        uint32_t slot  = handle_index(handle);
+        uint32_t dense = table.slotDense[slot];
+        uint32_t last  = --table.count;
+
+        if (dense != last)
+        {
+            table.items[dense]        = table.items[last];
+            table.denseHandles[dense] = table.denseHandles[last];
+            table.slotDense[handle_index(table.denseHandles[dense])] = dense;
+        }
+
+        table.slotHandles[slot] = handle_inc_gen(handle);
+        table.slotDense[slot]   = HANDLE_TABLE_SLOT_FREE_BIT | table.freeHead;
+        table.freeHead          = slot;
+
+        return true;
+    }
+
+    // Dense iteration: items[i] for i in [0, count), handle of item is denseHandles[i]
+    template<typename T>
+    uint32_t handle_table_size(const handle_table_t<T>& table)
+    {
+        return table.count;
+    }
+
 /*------------------ Ring buffer--------------------*/
     template<typename T, size_t N>
     struct ring_buffer_t
@@ -490,12 +968,353 @@ namespace core
         assert(ring_buffer_used(rb) > 0);
         ++rb.tail;
     }
+
+/*------------------ Concurrent ring buffers -------*/
+    // Bounded lock-free rings, N should be power of 2. Producer and consumer indices
+    // live on separate cache lines. Wait variants spin and then give up time slice via mt::yield.
+    static const uint32_t RING_SPIN_COUNT = 64;
+
+    inline void ring_wait_backoff(uint32_t& spin)
+    {
+        if (spin++ < RING_SPIN_COUNT)
+        {
+            _mm_pause();
+        }
+        else
+        {
+            mt::yield();
+        }
+    }
+
+    // Single producer, single consumer
+    template<typename T, size_t N>
+    struct spsc_ring_t
+    {
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) volatile size_t head; // written by producer
+        size_t tailCache;                                      // producer copy of tail
+
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) volatile size_t tail; // written by consumer
+        size_t headCache;                                      // consumer copy of head
+
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) T storage[N];
+    };
+
+    template<typename T, size_t N>
+    void spsc_ring_reset(spsc_ring_t<T, N>& rb)
+    {
+        static_assert((N & (N-1)) == 0, "N is not power of 2");
+        rb.head = rb.tail = 0;
+        rb.headCache = rb.tailCache = 0;
+    }
+
+    // Approximate if called concurrently with push or pop
+    template<typename T, size_t N>
+    size_t spsc_ring_used(spsc_ring_t<T, N>& rb)
+    {
+        return rb.head - rb.tail;
+    }
+
+    // @return number of pushed elements
+    template<typename T, size_t N>
+    size_t spsc_ring_push_batch(spsc_ring_t<T, N>& rb, const T* values, size_t count)
+    {
+        size_t head = rb.head;
+
+        if (head - rb.tailCache + count > N)
+        {
+            rb.tailCache = rb.tail;
+            _ReadWriteBarrier();
+        }
+
+        size_t available = N - (head - rb.tailCache);
+        count = count < available ? count : available;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            rb.storage[(head + i) & (N-1)] = values[i];
+        }
+
+        _ReadWriteBarrier();
+        rb.head = head + count;
+
+        return count;
+    }
+
+    // @return number of popped elements
+    template<typename T, size_t N>
+    size_t spsc_ring_pop_batch(spsc_ring_t<T, N>& rb, T* values, size_t count)
+    {
+        size_t tail = rb.tail;
+
+        if (rb.headCache - tail < count)
+        {
+            rb.headCache = rb.head;
+            _ReadWriteBarrier();
+        }
+
+        size_t available = rb.headCache - tail;
+        count = count < available ? count : available;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            values[i] = rb.storage[(tail + i) & (N-1)];
+        }
+
+        _ReadWriteBarrier();
+        rb.tail = tail + count;
+
+        return count;
+    }
+
+    template<typename T, size_t N>
+    bool spsc_ring_push(spsc_ring_t<T, N>& rb, const T& value)
+    {
+        return spsc_ring_push_batch(rb, &value, 1) == 1;
+    }
+
+    template<typename T, size_t N>
+    bool spsc_ring_pop(spsc_ring_t<T, N>& rb, T* value)
+    {
+        return spsc_ring_pop_batch(rb, value, 1) == 1;
+    }
+
+    template<typename T, size_t N>
+    void spsc_ring_push_wait(spsc_ring_t<T, N>& rb, const T& value)
+    {
+        for (uint32_t spin = 0; !spsc_ring_push(rb, value); ring_wait_backoff(spin));
+    }
+
+    template<typename T, size_t N>
+    void spsc_ring_pop_wait(spsc_ring_t<T, N>& rb, T* value)
+    {
+        for (uint32_t spin = 0; !spsc_ring_pop(rb, value); ring_wait_backoff(spin));
+    }
+
+    // Multiple producers, multiple consumers(bounded queue with per cell sequence numbers)
+    template<typename T, size_t N>
+    struct mpmc_ring_t
+    {
+        struct cell_t
+        {
+            atomic_t sequence;
+            T        value;
+        };
+
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) atomic_t head;
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) atomic_t tail;
+        CORE_ALIGN(CORE_CACHE_LINE_SIZE) cell_t   cells[N];
+    };
+
+    template<typename T, size_t N>
+    void mpmc_ring_reset(mpmc_ring_t<T, N>& rb)
+    {
+        static_assert((N & (N-1)) == 0, "N is not power of 2");
+        static_assert(N <= 0x40000000, "N is too big for 32 bit sequence numbers");
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            rb.cells[i].sequence = (long)i;
+        }
+        rb.head = rb.tail = 0;
+    }
+
+    // Approximate if called concurrently with push or pop
+    template<typename T, size_t N>
+    size_t mpmc_ring_used(mpmc_ring_t<T, N>& rb)
+    {
+        return (uint32_t)rb.head - (uint32_t)rb.tail;
+    }
+
+    template<typename T, size_t N>
+    bool mpmc_ring_push(mpmc_ring_t<T, N>& rb, const T& value)
+    {
+        typename mpmc_ring_t<T, N>::cell_t* cell;
+
+        uint32_t pos = (uint32_t)rb.head;
+        for (;;)
+        {
+            cell = &rb.cells[pos & (N-1)];
+
+            int32_t diff = (int32_t)((uint32_t)cell->sequence - pos);
+            if (diff == 0)
+            {
+                uint32_t prev = (uint32_t)_InterlockedCompareExchange(&rb.head, (long)(pos + 1), (long)pos);
+                if (prev == pos) break;
+                pos = prev;
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = (uint32_t)rb.head;
+            }
+        }
+
+        cell->value = value;
+        _ReadWriteBarrier();
+        cell->sequence = (long)(pos + 1);
+
+        return true;
+    }
+
+    template<typename T, size_t N>
+    bool mpmc_ring_pop(mpmc_ring_t<T, N>& rb, T* value)
+    {
+        typename mpmc_ring_t<T, N>::cell_t* cell;
+
+        uint32_t pos = (uint32_t)rb.tail;
+        for (;;)
+        {
+            cell = &rb.cells[pos & (N-1)];
+
+            int32_t diff = (int32_t)((uint32_t)cell->sequence - (pos + 1));
+            if (diff == 0)
+            {
+                uint32_t prev = (uint32_t)_InterlockedCompareExchange(&rb.tail, (long)(pos + 1), (long)pos);
+                if (prev == pos) break;
+                pos = prev;
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = (uint32_t)rb.tail;
+            }
+        }
+
+        *value = cell->value;
+        _ReadWriteBarrier();
+        cell->sequence = (long)(pos + N);
+
+        return true;
+    }
+
+    // Batches are not atomic: elements of concurrent batches can interleave
+    template<typename T, size_t N>
+    size_t mpmc_ring_push_batch(mpmc_ring_t<T, N>& rb, const T* values, size_t count)
+    {
+        size_t i = 0;
+        while (i < count && mpmc_ring_push(rb, values[i])) ++i;
+
+        return i;
+    }
+
+    template<typename T, size_t N>
+    size_t mpmc_ring_pop_batch(mpmc_ring_t<T, N>& rb, T* values, size_t count)
+    {
+        size_t i = 0;
+        while (i < count && mpmc_ring_pop(rb, &values[i])) ++i;
+
+        return i;
+    }
+
+    template<typename T, size_t N>
+    void mpmc_ring_push_wait(mpmc_ring_t<T, N>& rb, const T& value)
+    {
+        for (uint32_t spin = 0; !mpmc_ring_push(rb, value); ring_wait_backoff(spin));
+    }
+
+    template<typename T, size_t N>
+    void mpmc_ring_pop_wait(mpmc_ring_t<T, N>& rb, T* value)
+    {
+        for (uint32_t spin = 0; !mpmc_ring_pop(rb, value); ring_wait_backoff(spin));
+    }
+
+    // Multiple producers, single consumer: producers as in mpmc_ring_t,
+    // consumer owns tail and does not need interlocked operations
+    template<typename T, size_t N>
+    struct mpsc_ring_t : mpmc_ring_t<T, N>
+    {
+    };
+
+    template<typename T, size_t N>
+    void mpsc_ring_reset(mpsc_ring_t<T, N>& rb)
+    {
+        mpmc_ring_reset<T, N>(rb);
+    }
+
+    template<typename T, size_t N>
+    size_t mpsc_ring_used(mpsc_ring_t<T, N>& rb)
+    {
+        return mpmc_ring_used<T, N>(rb);
+    }
+
+    template<typename T, size_t N>
+    bool mpsc_ring_push(mpsc_ring_t<T, N>& rb, const T& value)
+    {
+        return mpmc_ring_push<T, N>(rb, value);
+    }
+
+    template<typename T, size_t N>
+    size_t mpsc_ring_push_batch(mpsc_ring_t<T, N>& rb, const T* values, size_t count)
+    {
+        return mpmc_ring_push_batch<T, N>(rb, values, count);
+    }
+
+    template<typename T, size_t N>
+    void mpsc_ring_push_wait(mpsc_ring_t<T, N>& rb, const T& value)
+    {
+        mpmc_ring_push_wait<T, N>(rb, value);
+    }
+
+    template<typename T, size_t N>
+    size_t mpsc_ring_pop_batch(mpsc_ring_t<T, N>& rb, T* values, size_t count)
+    {
+        uint32_t tail = (uint32_t)rb.tail;
+        size_t   i    = 0;
+
+        for (; i < count; ++i)
+        {
+            typename mpmc_ring_t<T, N>::cell_t* cell = &rb.cells[(tail + i) & (N-1)];
+
+            if ((uint32_t)cell->sequence != tail + i + 1)
+            {
+                break;
+            }
+
+            values[i] = cell->value;
+            _ReadWriteBarrier();
+            cell->sequence = (long)(tail + i + N);
+        }
+
+        rb.tail = (long)(tail + i);
+
+        return i;
+    }
+
+    template<typename T, size_t N>
+    bool mpsc_ring_pop(mpsc_ring_t<T, N>& rb, T* value)
+    {
+        return mpsc_ring_pop_batch(rb, value, 1) == 1;
+    }
+
+    template<typename T, size_t N>
+    void mpsc_ring_pop_wait(mpsc_ring_t<T, N>& rb, T* value)
+    {
+        for (uint32_t spin = 0; !mpsc_ring_pop(rb, value); ring_wait_backoff(spin));
+    }
 };
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+enum mem_utils_impl_t
+{
+    MEM_UTILS_SSE2,
+    MEM_UTILS_AVX,
+};
+
+// Selects implementation of mem_set/mem_move/mem_copy families and returns previous one.
+// SSE2 is used until core::init switches to AVX when CPU supports it.
+int  mem_utils_select(int impl);
+
+// Lengths of typed versions are in elements. Copies handle overlapping ranges like moves,
+// ones of 4MB and bigger use non-temporal stores(e.g. uploads to mapped GL buffers).
 void mem_set(void *dest, size_t len, uint8_t value);
 void mem_set8(uint8_t *dp, size_t len, uint8_t value);
 void mem_set16(uint16_t *dp, size_t len, uint16_t value);
@@ -14,6 +14,9 @@ extern "C"
     void* mem_realloc(mspace_t mspace, void* ptr, size_t size, size_t alignment);
 
     void  mem_free(mspace_t mspace, void* ptr);
+
+    // Release thread allocation caches of calling thread, call before thread exit
+    void  mem_thread_fini();
 #ifdef __cplusplus
 }
 
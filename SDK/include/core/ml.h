@@ -65,6 +65,42 @@ namespace ml
         v128 min, max;
     };
 
+    // Clip planes of frustum in SOA form, every component is replicated in all lanes.
+    // Point p is inside plane i if nx[i]*p.x + ny[i]*p.y + nz[i]*p.z + d[i] >= 0,
+    // plane normals are normalized, so the expression is a signed distance
+    struct frustum_planes
+    {
+        v128 nx[6], ny[6], nz[6], d[6];
+    };
+
+    // SoA streams, every component is a separate array of floats
+    struct vec3_soa
+    {
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    struct quat_soa
+    {
+        float* x;
+        float* y;
+        float* z;
+        float* w;
+    };
+
+    struct dual_quat_soa
+    {
+        quat_soa real;
+        quat_soa dual;
+    };
+
+    // m[column][row], same element order as v128 m[4] matrices
+    struct mat4_soa
+    {
+        float* m[4][4];
+    };
+
     // quaternions
     void mul_quat        (quat* result, quat* a, quat* b); // multiplies 2 quaternions, returns pointer to result
     void conjugate_quat  (quat* result, quat* q);
@@ -119,6 +155,37 @@ namespace ml
     void transformPointsSOA4(v128* dest, v128 xxxx, v128 yyyy, v128 zzzz, /*vec4 wwww,*/ const mat4x4* matrix);
     int  intersectionTest(const aabb* bbox, const mat4x4* frustum);
 
+    void extractFrustumPlanes(frustum_planes* planes, const mat4x4* frustum);
+    // Tests 4 AABBs at once, box i is [minX[i], maxX[i]]x[minY[i], maxY[i]]x[minZ[i], maxZ[i]].
+    // Classification matches intersectionTest: result[i] is IT_INSIDE, IT_OUTSIDE or IT_INTERSECT
+    void intersectionTestSOA4(int result[4], const frustum_planes* planes,
+                              v128 minX, v128 minY, v128 minZ,
+                              v128 maxX, v128 maxY, v128 maxZ);
+
+    // Batch frustum culling, bounds are passed as arrays of components.
+    // Indices of primitives inside or intersecting frustum are written to visible in increasing order,
+    // visible should have space for count indices. Returns number of visible primitives.
+    // AVX path is selected at runtime if supported, otherwise SSE path is used.
+    size_t cullAABBs  (uint32_t* visible, const frustum_planes* planes, size_t count,
+                       const float* minX, const float* minY, const float* minZ,
+                       const float* maxX, const float* maxY, const float* maxZ);
+    size_t cullSpheres(uint32_t* visible, const frustum_planes* planes, size_t count,
+                       const float* x, const float* y, const float* z, const float* radius);
+
+    // Batch transforms of count elements in SoA streams, results are the same as from per element
+    // functions(quatToMat4x3SoA is within few ulp of quat_to_mat4x3). Destination streams may be
+    // the same as source ones. Widest of AVX2, SSE4.1 or scalar path is selected at runtime.
+    // transformPointsSoA uses w = 1, transformVectorsSoA uses w = 0(for normals m should be inverse transpose),
+    // only x, y and z of result are stored
+    void transformPointsSoA (vec3_soa* dst, const v128* m/*[4]*/, const vec3_soa* src, size_t count);
+    void transformVectorsSoA(vec3_soa* dst, const v128* m/*[4]*/, const vec3_soa* src, size_t count);
+    // r = a * b, same as mul_mat4
+    void mulMat4SoA         (mat4_soa* r, const mat4_soa* a, const mat4_soa* b, size_t count);
+    // r = dq0 * dq1, same as mul_dual_quat
+    void mulDualQuatSoA     (dual_quat_soa* r, const dual_quat_soa* dq0, const dual_quat_soa* dq1, size_t count);
+    // Writes columns 0-2 like quat_to_mat4x3, their row 3 is 0, column 3 is not touched
+    void quatToMat4x3SoA    (mat4_soa* m, const quat_soa* q, size_t count);
+
 }
 
 namespace ml
@@ -273,6 +340,7 @@ namespace ml
 
     float pow  (float x, float y);
     float exp  (float x);
+    float exp2 (float x);
     float ln   (float x);
     float lg2  (float x);
     float lg10 (float x);
@@ -289,3 +357,40 @@ namespace ml
 
     float mod(float x, float y);
 }
+
+// Vector math functions, polynomial approximations.
+// Max error is measured against double precision libm:
+//   sin, cos, sincos  1.5 ulp for |x| <= pi, absolute error 8e-8 for |x| <= 8192, grows with |x| beyond that
+//   exp, ln           1 ulp
+//   exp2, lg2         1.5 ulp
+//   pow               exp2(y*lg2(x)), 2 + 1.25*|y*lg2(x)| ulp, x < 0 gives NaN and -0 is treated as +0
+//   atan2             3.5 ulp
+//   rsqrt             CPU estimate refined with Newton step, 4 ulp
+// Other special values(inf, NaN, +-0) give the same results as libm, denormals are supported
+// as long as FTZ/DAZ are off.
+// Array forms process count floats, dst may be the same as source. Widest of AVX2, SSE4.1
+// or scalar path is selected at runtime, all of them give the same results.
+namespace ml
+{
+    v128 sin   (v128 x);
+    v128 cos   (v128 x);
+    void sincos(v128* s, v128* c, v128 x);
+    v128 exp   (v128 x);
+    v128 exp2  (v128 x);
+    v128 ln    (v128 x);
+    v128 lg2   (v128 x);
+    v128 pow   (v128 x, v128 y);
+    v128 atan2 (v128 y, v128 x);
+    v128 rsqrt (v128 x);
+
+    void sinArray   (float* dst, const float* x, size_t count);
+    void cosArray   (float* dst, const float* x, size_t count);
+    void sincosArray(float* s, float* c, const float* x, size_t count);
+    void expArray   (float* dst, const float* x, size_t count);
+    void exp2Array  (float* dst, const float* x, size_t count);
+    void lnArray    (float* dst, const float* x, size_t count);
+    void lg2Array   (float* dst, const float* x, size_t count);
+    void powArray   (float* dst, const float* x, const float* y, size_t count);
+    void atan2Array (float* dst, const float* y, const float* x, size_t count);
+    void rsqrtArray (float* dst, const float* x, size_t count);
+}
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
-// Implementation is based on Mathias Brossard threadpool (https://github.com/mbrossard/threadpool).
+// Job system with per-thread work stealing queues (Chase-Lev deque).
+// Main thread participates in execution as worker 0 while it waits for jobs.
+// Threads outside of job system can create and run jobs too, they are published
+// through shared queue and executed by workers.
 
 namespace mt
 {
@@ -18,22 +22,83 @@ namespace mt
     } error_t;
 
     /**
-     * @param thread_count Number of worker threads.
-     * @param queue_size   Size of the queue.
-     * @param flags        Unused parameter.
+     * @param threadCount    Number of worker threads, 0 or negative - use number of cores minus main thread.
+     * @param jobsPerThread  Capacity of per-thread job ring and work queue, should be power of 2.
      */
-    void init(int threadCount, int queueSize);
+    void init(int threadCount, int jobsPerThread);
     void fini();
 
+    // Number of threads executing jobs including main thread
+    uint32_t workerCount();
+    // Index of calling thread in range [0, workerCount()), 0 is main thread
+    uint32_t workerIndex();
+
+    typedef void (*job_func_t)(uint32_t job, void* arg);
+
+    /**
+     * @brief create job, job is not scheduled until jobRun is called
+     * @return handle of the job, INVALID_HANDLE if all job slots of the thread are in flight
+     */
+    uint32_t jobCreate(job_func_t func, void* arg);
+
+    /**
+     * @brief create job as a child of parent, parent is not finished until all children are finished.
+     *        Parent should not be finished at the moment of call(call from parent job or before jobRun(parent)).
+     */
+    uint32_t jobCreateChild(uint32_t parent, job_func_t func, void* arg);
+
+    /**
+     * @brief schedule continuation to run after ancestor and all its children are finished.
+     *        Should be called before jobRun(ancestor), continuation should not be run manually.
+     * @return false if continuation limit per job is reached
+     */
+    bool jobAddContinuation(uint32_t ancestor, uint32_t continuation);
+
+    void jobRun(uint32_t job);
+    // Execute other jobs until job and all its children are finished, INVALID_HANDLE is finished
+    void jobWait(uint32_t job);
+    bool jobIsFinished(uint32_t job);
+
+    // Give up the rest of time slice, use in spin loops waiting for other threads.
+    // Unlike jobWait it does not execute jobs: a job picked up while waiting could
+    // wait for the caller itself(e.g. producer blocked on a ring drained by the caller).
+    void yield();
+
+    typedef void (*range_func_t)(uint32_t begin, uint32_t end, void* arg);
+
+    /**
+     * @brief recursively split range [0, count) into chunks of up to grainSize elements and
+     *        process them in parallel. Job is already running when function returns.
+     *        If there are no free job slots range is processed in place.
+     * @return handle of the root job to wait for
+     */
+    uint32_t parallelFor(range_func_t func, void* arg, uint32_t count, uint32_t grainSize);
+
+    /**
+     * Events are thread safe generational handles allocated from growable lock-free table.
+     * Waiting spins(executing pending jobs) before parking the thread, so signaling
+     * costs a couple of atomics unless somebody is actually parked on the event.
+     * Released or stale handles are treated as signaled.
+     */
+    uint32_t eventCreate();
+    void     eventRelease(uint32_t event);
+    void     eventSignal(uint32_t event);
+    bool     eventIsSignaled(uint32_t event);
+    void     eventWait(uint32_t event);
+    // @return index of the first signaled event
+    size_t   eventWaitAny(const uint32_t* events, size_t count);
+    void     eventWaitAll(const uint32_t* events, size_t count);
+
     /**
      * @brief add a new task in the queue of a thread pool
      * @param taskFunc Pointer to the function that will perform the task.
      * @param arg      Argument to be passed to the function.
-     * @param flags    Unused parameter.
+     * @param handle   Event signaled on task completion, release with syncAndReleaseEvent or eventRelease, can be 0.
      * @return 0 if all goes well, negative values in case of error (@see error_t for codes).
      */
     int addAsyncTask(void (*taskFunc)(void *), void *arg, uint32_t* handle);
 
+    // Wait for event and release it
     void syncAndReleaseEvent(uint32_t handle);
 
     inline int addAsyncTask(void (*taskFunc)(void *), void *arg)
@@ -11,6 +11,9 @@ enum EventPhase
 #define TIME_BITS  30
 #define PHASE_BITS  2
 #define MAX_PROFILER_EVENTS     1*1024*1024
+#define MAX_PROFILER_IDS        2048
+#define MAX_PROFILER_THREADS    64
+#define PROFILER_THREAD_EVENTS  64*1024     // Size of per thread event ring, power of 2
 
 static_assert(TIME_BITS+PHASE_BITS <= 32, "Check that phase and timestamps use up to 32 bits");
 
@@ -24,15 +27,45 @@ struct profiler_event_t
 
 static_assert(sizeof(profiler_event_t)==8, "Fix packing in profiler_event_t in order ro maintain smaller event size");
 
+#define PROFILER_INVALID_ID     0xFFFF
+
+// Descriptors of PROFILER_CPU_* scopes are emitted into prfscope section and
+// registered by profilerInit, section start and end are marked by profiler.cpp.
+// Linker can pad section contributions with zeros, hence fixed size and alignment.
+struct CORE_ALIGN(32) profiler_scope_desc_t
+{
+    const char* name;
+    const char* file;
+    uint32_t    line;
+    uint32_t    color;    // RGBA8, 0 - pick color automatically
+    uint16_t    id;
+};
+
+static_assert(sizeof(profiler_scope_desc_t)==32, "Scope descriptors are iterated with fixed stride");
+
+#if defined(_MSC_VER)
+#   pragma section("prfscope$a", read, write)
+#   pragma section("prfscope$m", read, write)
+#   pragma section("prfscope$z", read, write)
+#   define PROFILER_SCOPE_SECTION __declspec(allocate("prfscope$m"))
+#else
+// No section support, scopes are registered on first use
+#   define PROFILER_SCOPE_SECTION
+#endif
+
+// Non zero while events are recorded, checked inline by scopes
+extern atomic_t profilerRecording;
+
 struct event_capture_t
 {
     uint64_t  maxPeriod;      //Max timespan for capture
     uint64_t  freq;
     uint64_t  startTime;
-    atomic_t  numEvents;
+    uint32_t  numEvents;
     uint32_t  endTime;
     uint32_t  quantShift;     //Precision shift for timestamp
     uint32_t  maxEvents;
+    uint32_t  numDropped;     //Events lost because of ring overflow or full capture
     profiler_event_t  events[MAX_PROFILER_EVENTS];
 };
 
@@ -46,12 +79,30 @@ void event_capture_add(
 );
 
 // CPU capture interface
+//
+// Every thread records events with TSC timestamps into its own ring without atomics.
+// Ring keeps only last PROFILER_THREAD_EVENTS events of a thread, older ones are overwritten,
+// so during capture rings are drained by profilerStartSyncPoint and profilerStopCapture
+// and merged into single capture on data retrieval. Capture holds up to MAX_PROFILER_EVENTS,
+// events overwritten between drains or exceeding capacity are counted in numDropped.
 void profilerInit();
+void profilerFini();
+
+// Hands ring of calling thread over to thread registered later, events already recorded
+// stay in ring and keep track of the slot. Called by core::thread_data_fini.
+void profilerThreadFini();
 
 void profilerStartCapture   ();
 void profilerStopCapture    ();
 int  profilerIsCaptureActive();
 
+// Flight recorder records events continuously without capture trigger,
+// snapshot merges events of last windowMs milliseconds into capture data.
+void profilerStartFlightRecorder   (uint32_t windowMs);
+void profilerStopFlightRecorder    ();
+int  profilerIsFlightRecorderActive();
+void profilerSnapshotFlightRecorder();
+
 void profilerStartSyncPoint();
 void profilerStopSyncPoint ();
 
@@ -61,5 +112,74 @@ uint16_t profilerGenerateId();
 
 // NOTE: name should be compile time(preferred) or has entire program lifetime
 void profilerAddDesc(uint16_t id, const char* name);
+
+// Assigns id to scope descriptor unless it has one, thread safe
+void profilerRegisterScope(profiler_scope_desc_t* desc);
+// @return descriptor of scope or 0 for ids created with profilerGenerateId
+const profiler_scope_desc_t* profilerGetScopeDesc(uint16_t id);
+
+// Name is copied, call from thread being named
+void profilerSetThreadName(const char* name);
 event_capture_t* profilerGetData();
 const char** profilerGetNames();
+
+// Rolling statistics of scopes over last numFrames frames, frames are delimited by
+// profilerStartSyncPoint. Background thread consumes per thread event rings incrementally,
+// so statistics do not depend on captures. Times are in microseconds, percentiles and
+// min/max are taken over per frame inclusive time of frames where scope was called.
+#define MAX_PROFILER_STATS_FRAMES 1024
+
+struct profiler_scope_stats_t
+{
+    uint16_t id;
+    uint16_t parentId;        // Enclosing scope when last seen, PROFILER_INVALID_ID for root scopes
+    uint32_t numFrames;       // Number of frames in window where scope was called
+    float    callsPerFrame;
+    float    inclusiveMin;
+    float    inclusiveAvg;
+    float    inclusiveMax;
+    float    exclusiveAvg;
+    float    p50;
+    float    p95;
+    float    p99;
+};
+
+void     profilerStartStats   (uint32_t numFrames);
+void     profilerStopStats    ();
+int      profilerIsStatsActive();
+
+// Copies statistics of scopes called in window, table is updated after every frame
+// @return number of written entries
+uint32_t profilerGetStats(profiler_scope_stats_t* stats, uint32_t maxCount);
+
+// Capture file layout:
+//     profiler_capture_header_t
+//     numThreads x profiler_capture_thread_t
+//     numNames   x (uint16_t length, name characters without terminator), index of name is event id
+//     numEvents  x profiler_event_t
+// Timestamp of event in seconds is (timestamp << quantShift) / freq.
+// Tools/profcapture2trace.py converts capture file to Chrome trace event JSON.
+#define PROFILER_CAPTURE_MAGIC      0x46525049 // "IPRF"
+#define PROFILER_CAPTURE_VERSION    1
+
+struct profiler_capture_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t freq;
+    uint32_t quantShift;
+    uint32_t endTime;
+    uint32_t numEvents;
+    uint32_t numThreads;
+    uint32_t numNames;
+    uint32_t numDropped;
+};
+
+struct profiler_capture_thread_t
+{
+    uint16_t tid;
+    char     name[30];
+};
+
+// Saves data of the last capture, same restrictions as for profilerGetData
+bool profilerSaveCapture(const char* path);
@@ -45,6 +45,8 @@ errno_t cstr_comparen(const char *str1, const char *str2, rsize_t cmax, int *ind
 errno_t cstr_toimax(const char * str, rsize_t size, int base, const char** end, intmax_t* res);
 errno_t cstr_toumax(const char * str, rsize_t size, int base, const char** end, uintmax_t* res);
 errno_t cstr_todouble(const char* str, rsize_t size, const char** end, double* res);
+errno_t cstr_tofloat(const char* str, rsize_t size, const char** end, float* res);
+rsize_t cstr_tofloats(const char* str, rsize_t size, const char** end, float* res, rsize_t count);
 
 errno_t cstr_tokenize(
     const char* delims, rsize_t delim_size,
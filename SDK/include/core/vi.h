@@ -5,8 +5,11 @@
 #include <tmmintrin.h>
 #include <emmintrin.h>
 #include <smmintrin.h>
+#include <immintrin.h>
 
 typedef __m128  v128;
+typedef __m256  v256;
+typedef __m256i v256i;
 
 enum {
 	VI_X = 0x00,
@@ -126,6 +129,8 @@ v128 vi_andnot(v128 a, v128 b);
 //logical result functions
 bool vi_all(v128 a);
 bool vi_any(v128 a);
+// Sign bits of components packed into bits 0-3
+int  vi_mask(v128 a);
 
 
 
@@ -134,3 +139,103 @@ v128 vi_cvt_u8x4_to_v128(uint32_t ub4);
 v128 vi_cvt_v128_to_u8x4(uint32_t ub4);
 
 #include <core/vi_sse.h>
+
+
+
+// 8 wide vectors, vi8_* functions mirror vi_* ones with the same semantics lane by lane.
+// Code using them must only run if core::cpu_features() reports AVX2(and FMA for vi8_fma),
+// and should call vi8_zeroupper() before returning to code using SSE.
+
+// Component rearrange functions, within each 128 bit half
+template<int c0, int c1, int c2, int c3>
+v256 vi8_swizzle(v256 a);
+// Rearrange components within each 128 bit half, c0 and c1 are from a, c2 and c3 from b
+template<int c0, int c1, int c2, int c3>
+v256 vi8_shuffle(v256 a, v256 b);
+// Rearrange components across whole vector, result[i] = a[indices[i]]
+v256 vi8_permute(v256 a, v256i indices);
+v256 vi8_select (v256 a, v256 b, v256 mask);
+
+
+
+// Load/store functions
+v256  vi8_set     (float x0, float x1, float x2, float x3, float x4, float x5, float x6, float x7);
+v256  vi8_set_all (float x);
+v256  vi8_seti_all(int x);
+v256  vi8_set_zero();
+v256  vi8_combine (v128 lo, v128 hi);
+v128  vi8_get_lo  (v256 v);
+v128  vi8_get_hi  (v256 v);
+float vi8_get_x   (v256 v);
+
+v256  vi8_load    (const void* m256);
+v256  vi8_loadu   (const void* m256);
+// result[i] = base[indices[i]]
+v256  vi8_gather  (const float* base, v256i indices);
+void  vi8_store   (void* m256, v256 v);
+void  vi8_storeu  (void* m256, v256 v);
+// Stores with non temporal hint, m256 should be 32 byte aligned
+void  vi8_stream  (void* m256, v256 v);
+
+void  vi8_zeroupper();
+
+
+
+//math functions
+v256 vi8_mad  (v256 a, v256 b, v256 c); // a*b+c, rounded twice
+v256 vi8_fma  (v256 a, v256 b, v256 c); // a*b+c, rounded once, needs FMA
+v256 vi8_mul  (v256 a, v256 b);
+v256 vi8_div  (v256 a, v256 b);
+v256 vi8_add  (v256 a, v256 b);
+v256 vi8_sub  (v256 a, v256 b);
+v256 vi8_rcp  (v256 a);
+v256 vi8_rsqrt(v256 a);
+v256 vi8_sqrt (v256 a);
+v256 vi8_neg  (v256 a);
+v256 vi8_abs  (v256 a);
+v256 vi8_max  (v256 a, v256 b);
+v256 vi8_min  (v256 a, v256 b);
+v256 vi8_clamp(v256 value, v256 lower, v256 upper);
+v256 vi8_sat  (v256 value);
+v256 vi8_round(v256 a); // to nearest even
+v256 vi8_floor(v256 a);
+v256 vi8_ceil (v256 a);
+// Horizontal sum of all components
+float vi8_hadd(v256 a);
+
+
+
+//vector compare functions
+v256 vi8_cmp_gt(v256 a, v256 b);
+v256 vi8_cmp_ge(v256 a, v256 b);
+v256 vi8_cmp_lt(v256 a, v256 b);
+v256 vi8_cmp_le(v256 a, v256 b);
+v256 vi8_cmp_eq(v256 a, v256 b);
+v256 vi8_cmp_ne(v256 a, v256 b);
+
+
+
+//logical op functions
+v256 vi8_xor   (v256 a, v256 b);
+v256 vi8_or    (v256 a, v256 b);
+v256 vi8_and   (v256 a, v256 b);
+v256 vi8_andnot(v256 a, v256 b);
+
+
+
+//logical result functions
+bool vi8_all (v256 a);
+bool vi8_any (v256 a);
+// Sign bits of components packed into bits 0-7
+int  vi8_mask(v256 a);
+
+
+
+//integer functions
+v256i vi8_cvt_to_int  (v256 a); // rounds to nearest even
+v256  vi8_cvt_to_float(v256i a);
+v256i vi8_as_int      (v256 a);
+v256  vi8_as_float    (v256i a);
+
+#include <core/vi_avx.h>
+#include <core/vi_wide.h>
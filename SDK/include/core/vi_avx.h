@@ -0,0 +1,300 @@
+// x86/x64 AVX/AVX2, only call when core::cpu_features() reports CPU_FEATURE_AVX2
+
+template<int c0, int c1, int c2, int c3>
+VI_INLINE v256 vi8_swizzle(v256 a)
+{
+    static_assert(c0 >= 0, "c0 template parameter out of range");
+    static_assert(c1 >= 0, "c1 template parameter out of range");
+    static_assert(c2 >= 0, "c2 template parameter out of range");
+    static_assert(c3 >= 0, "c3 template parameter out of range");
+    static_assert(c0 <= 3, "c0 template parameter out of range");
+    static_assert(c1 <= 3, "c1 template parameter out of range");
+    static_assert(c2 <= 3, "c2 template parameter out of range");
+    static_assert(c3 <= 3, "c3 template parameter out of range");
+
+    return _mm256_permute_ps(a, _MM_SHUFFLE(c3, c2, c1, c0));
+}
+
+template<int c0, int c1, int c2, int c3>
+VI_INLINE v256 vi8_shuffle(v256 a, v256 b)
+{
+    static_assert(c0 >= 0, "c0 template parameter out of range");
+    static_assert(c1 >= 0, "c1 template parameter out of range");
+    static_assert(c2 >= 0, "c2 template parameter out of range");
+    static_assert(c3 >= 0, "c3 template parameter out of range");
+    static_assert(c0 <= 3, "c0 template parameter out of range");
+    static_assert(c1 <= 3, "c1 template parameter out of range");
+    static_assert(c2 <= 3, "c2 template parameter out of range");
+    static_assert(c3 <= 3, "c3 template parameter out of range");
+
+    return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(c3, c2, c1, c0));
+}
+
+VI_INLINE v256 vi8_permute(v256 a, v256i indices)
+{
+    return _mm256_permutevar8x32_ps(a, indices);
+}
+
+VI_INLINE v256 vi8_select(v256 a, v256 b, v256 mask)
+{
+    return _mm256_blendv_ps(a, b, mask);
+}
+
+VI_INLINE v256 vi8_set(float x0, float x1, float x2, float x3, float x4, float x5, float x6, float x7)
+{
+    return _mm256_set_ps(x7, x6, x5, x4, x3, x2, x1, x0);
+}
+
+VI_INLINE v256 vi8_set_all(float x)
+{
+    return _mm256_set1_ps(x);
+}
+
+VI_INLINE v256 vi8_seti_all(int x)
+{
+    return _mm256_castsi256_ps(_mm256_set1_epi32(x));
+}
+
+VI_INLINE v256 vi8_set_zero()
+{
+    return _mm256_setzero_ps();
+}
+
+VI_INLINE v256 vi8_combine(v128 lo, v128 hi)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+VI_INLINE v128 vi8_get_lo(v256 v)
+{
+    return _mm256_castps256_ps128(v);
+}
+
+VI_INLINE v128 vi8_get_hi(v256 v)
+{
+    return _mm256_extractf128_ps(v, 1);
+}
+
+VI_INLINE float vi8_get_x(v256 v)
+{
+    return _mm256_cvtss_f32(v);
+}
+
+VI_INLINE v256 vi8_load(const void* m256)
+{
+    return _mm256_load_ps((const float*)m256);
+}
+
+VI_INLINE v256 vi8_loadu(const void* m256)
+{
+    return _mm256_loadu_ps((const float*)m256);
+}
+
+VI_INLINE v256 vi8_gather(const float* base, v256i indices)
+{
+    return _mm256_i32gather_ps(base, indices, 4);
+}
+
+VI_INLINE void vi8_store(void* m256, v256 v)
+{
+    _mm256_store_ps((float*)m256, v);
+}
+
+VI_INLINE void vi8_storeu(void* m256, v256 v)
+{
+    _mm256_storeu_ps((float*)m256, v);
+}
+
+VI_INLINE void vi8_stream(void* m256, v256 v)
+{
+    _mm256_stream_ps((float*)m256, v);
+}
+
+VI_INLINE void vi8_zeroupper()
+{
+    _mm256_zeroupper();
+}
+
+VI_INLINE v256 vi8_mad(v256 a, v256 b, v256 c)
+{
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+}
+
+VI_INLINE v256 vi8_fma(v256 a, v256 b, v256 c)
+{
+    return _mm256_fmadd_ps(a, b, c);
+}
+
+VI_INLINE v256 vi8_mul(v256 a, v256 b)
+{
+    return _mm256_mul_ps(a, b);
+}
+
+VI_INLINE v256 vi8_div(v256 a, v256 b)
+{
+    return _mm256_div_ps(a, b);
+}
+
+VI_INLINE v256 vi8_add(v256 a, v256 b)
+{
+    return _mm256_add_ps(a, b);
+}
+
+VI_INLINE v256 vi8_sub(v256 a, v256 b)
+{
+    return _mm256_sub_ps(a, b);
+}
+
+VI_INLINE v256 vi8_rcp(v256 a)
+{
+    return _mm256_rcp_ps(a);
+}
+
+VI_INLINE v256 vi8_rsqrt(v256 a)
+{
+    return _mm256_rsqrt_ps(a);
+}
+
+VI_INLINE v256 vi8_sqrt(v256 a)
+{
+    return _mm256_sqrt_ps(a);
+}
+
+VI_INLINE v256 vi8_neg(v256 a)
+{
+    return _mm256_xor_ps(a, vi8_seti_all(VI_SIGN_MASK));
+}
+
+VI_INLINE v256 vi8_abs(v256 a)
+{
+    return _mm256_and_ps(a, vi8_seti_all(0x7FFFFFFF));
+}
+
+VI_INLINE v256 vi8_max(v256 a, v256 b)
+{
+    return _mm256_max_ps(a, b);
+}
+
+VI_INLINE v256 vi8_min(v256 a, v256 b)
+{
+    return _mm256_min_ps(a, b);
+}
+
+VI_INLINE v256 vi8_clamp(v256 value, v256 lower, v256 upper)
+{
+    return _mm256_max_ps(_mm256_min_ps(value, upper), lower);
+}
+
+VI_INLINE v256 vi8_sat(v256 value)
+{
+    return _mm256_max_ps(_mm256_min_ps(value, vi8_seti_all(VI_ONE_ASINT)), _mm256_setzero_ps());
+}
+
+VI_INLINE v256 vi8_round(v256 a)
+{
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+VI_INLINE v256 vi8_floor(v256 a)
+{
+    return _mm256_floor_ps(a);
+}
+
+VI_INLINE v256 vi8_ceil(v256 a)
+{
+    return _mm256_ceil_ps(a);
+}
+
+VI_INLINE float vi8_hadd(v256 a)
+{
+    v128 sum   = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    v128 shuff = _mm_movehdup_ps(sum);
+    sum = _mm_add_ps(sum, shuff);
+    shuff = _mm_movehl_ps(shuff, sum);
+    return _mm_cvtss_f32(_mm_add_ss(sum, shuff));
+}
+
+VI_INLINE v256 vi8_cmp_gt(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+
+VI_INLINE v256 vi8_cmp_ge(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+
+VI_INLINE v256 vi8_cmp_lt(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+
+VI_INLINE v256 vi8_cmp_le(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+
+VI_INLINE v256 vi8_cmp_eq(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+
+VI_INLINE v256 vi8_cmp_ne(v256 a, v256 b)
+{
+    return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ);
+}
+
+VI_INLINE v256 vi8_xor(v256 a, v256 b)
+{
+    return _mm256_xor_ps(a, b);
+}
+
+VI_INLINE v256 vi8_or(v256 a, v256 b)
+{
+    return _mm256_or_ps(a, b);
+}
+
+VI_INLINE v256 vi8_and(v256 a, v256 b)
+{
+    return _mm256_and_ps(a, b);
+}
+
+VI_INLINE v256 vi8_andnot(v256 a, v256 b)
+{
+    return _mm256_andnot_ps(b, a);
+}
+
+VI_INLINE bool vi8_all(v256 a)
+{
+    return _mm256_movemask_ps(a) == 0xFF;
+}
+
+VI_INLINE bool vi8_any(v256 a)
+{
+    return _mm256_movemask_ps(a) != 0x00;
+}
+
+VI_INLINE int vi8_mask(v256 a)
+{
+    return _mm256_movemask_ps(a);
+}
+
+VI_INLINE v256i vi8_cvt_to_int(v256 a)
+{
+    return _mm256_cvtps_epi32(a);
+}
+
+VI_INLINE v256 vi8_cvt_to_float(v256i a)
+{
+    return _mm256_cvtepi32_ps(a);
+}
+
+VI_INLINE v256i vi8_as_int(v256 a)
+{
+    return _mm256_castps_si256(a);
+}
+
+VI_INLINE v256 vi8_as_float(v256i a)
+{
+    return _mm256_castsi256_ps(a);
+}
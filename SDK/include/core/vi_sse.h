@@ -391,6 +391,11 @@ VI_INLINE bool vi_any(v128 a)
     return _mm_movemask_ps(a) != 0x00;
 }
 
+VI_INLINE int vi_mask(v128 a)
+{
+    return _mm_movemask_ps(a);
+}
+
 VI_INLINE v128 vi_cvt_u8x4_to_v128(uint32_t ub4)
 {
     __m128i tmp, zero;
@@ -0,0 +1,227 @@
+// Width generic layer, kernels are written once as templates over instruction set traits
+// and instantiated for every width, implementation is selected at runtime with core::cpu_select.
+//
+//     template <typename simd>
+//     typename simd::vf kernel(typename simd::vf x) { return simd::mad(x, x, simd::set(1.0f)); }
+//
+// All traits perform the same IEEE operations in the same order, so kernel gives bitwise
+// identical results for every width. Because of this mad is multiply and add rounded twice.
+// Masks are all bits set/cleared per component, select picks b where sign bit of mask is set.
+// Traits need: vi_scalar_t - nothing, vi_sse41_t - SSE4.1, vi_avx2_t - AVX2.
+
+struct vi_scalar_t
+{
+    typedef float   vf;
+    typedef int32_t vi;
+
+    enum { width = 1 };
+
+    static VI_INLINE vi as_int(vf a)
+    {
+        union { float f; int32_t i; } u;
+        u.f = a;
+        return u.i;
+    }
+
+    static VI_INLINE vf as_float(vi a)
+    {
+        union { int32_t i; float f; } u;
+        u.i = a;
+        return u.f;
+    }
+
+    static VI_INLINE vf mask(bool b) { return as_float(b ? (int32_t)VI_CMP_TRUE : 0); }
+
+    static VI_INLINE vf   set (float x)  { return x; }
+    static VI_INLINE vf   seti(int x)    { return as_float(x); }
+    static VI_INLINE vf   zero()         { return 0.0f; }
+    static VI_INLINE vf   load (const float* m)  { return *m; }
+    static VI_INLINE void store(float* m, vf v)  { *m = v; }
+    static VI_INLINE vf   gather(const float* base, vi indices) { return base[indices]; }
+    static VI_INLINE void finish() {}
+
+    static VI_INLINE vf add(vf a, vf b)       { return a + b; }
+    static VI_INLINE vf sub(vf a, vf b)       { return a - b; }
+    static VI_INLINE vf mul(vf a, vf b)       { return a * b; }
+    static VI_INLINE vf div(vf a, vf b)       { return a / b; }
+    static VI_INLINE vf mad(vf a, vf b, vf c) { return a * b + c; }
+    // Same operand order as minps/maxps, second operand is returned for NaN
+    static VI_INLINE vf min(vf a, vf b)       { return a < b ? a : b; }
+    static VI_INLINE vf max(vf a, vf b)       { return a > b ? a : b; }
+    static VI_INLINE vf abs(vf a)             { return as_float(as_int(a) & 0x7FFFFFFF); }
+    static VI_INLINE vf neg(vf a)             { return as_float(as_int(a) ^ (int32_t)VI_SIGN_MASK); }
+    static VI_INLINE vf sqrt(vf a)            { return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(a))); }
+    // Same estimate as vector version
+    static VI_INLINE vf rsqrt(vf a)           { return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(a))); }
+
+    // To nearest even, keeps sign of zero
+    static VI_INLINE vf round(vf a)
+    {
+        if (!(abs(a) < 8388608.0f))
+        {
+            return a;
+        }
+
+        vf r = (float)_mm_cvtss_si32(_mm_set_ss(a));
+        return as_float(as_int(r) | (as_int(a) & (int32_t)VI_SIGN_MASK));
+    }
+
+    static VI_INLINE vf cmp_lt   (vf a, vf b) { return mask(a <  b); }
+    static VI_INLINE vf cmp_le   (vf a, vf b) { return mask(a <= b); }
+    static VI_INLINE vf cmp_gt   (vf a, vf b) { return mask(a >  b); }
+    static VI_INLINE vf cmp_ge   (vf a, vf b) { return mask(a >= b); }
+    static VI_INLINE vf cmp_eq   (vf a, vf b) { return mask(a == b); }
+    static VI_INLINE vf cmp_unord(vf a, vf b) { return mask(a != a || b != b); }
+
+    static VI_INLINE vf bit_and   (vf a, vf b) { return as_float(as_int(a) &  as_int(b)); }
+    static VI_INLINE vf bit_or    (vf a, vf b) { return as_float(as_int(a) |  as_int(b)); }
+    static VI_INLINE vf bit_xor   (vf a, vf b) { return as_float(as_int(a) ^  as_int(b)); }
+    static VI_INLINE vf bit_andnot(vf a, vf b) { return as_float(as_int(a) & ~as_int(b)); }
+    static VI_INLINE vf select(vf a, vf b, vf mask) { return as_int(mask) < 0 ? b : a; }
+
+    static VI_INLINE int  movemask(vf a) { return as_int(a) < 0 ? 1 : 0; }
+    static VI_INLINE bool any(vf a)      { return movemask(a) != 0; }
+    static VI_INLINE bool all(vf a)      { return movemask(a) != 0; }
+
+    // Rounds to nearest even, out of range values give 0x80000000
+    static VI_INLINE vi cvt_to_int  (vf a) { return _mm_cvtss_si32(_mm_set_ss(a)); }
+    static VI_INLINE vf cvt_to_float(vi a) { return (float)a; }
+
+    static VI_INLINE vi iset   (int x)      { return x; }
+    static VI_INLINE vi iadd   (vi a, vi b) { return (int32_t)((uint32_t)a + (uint32_t)b); }
+    static VI_INLINE vi isub   (vi a, vi b) { return (int32_t)((uint32_t)a - (uint32_t)b); }
+    static VI_INLINE vi iand   (vi a, vi b) { return a & b; }
+    static VI_INLINE vi ior    (vi a, vi b) { return a | b; }
+    static VI_INLINE vi icmp_eq(vi a, vi b) { return a == b ? (int32_t)VI_CMP_TRUE : 0; }
+    template <int n> static VI_INLINE vi isll(vi a) { return (int32_t)((uint32_t)a << n); }
+    template <int n> static VI_INLINE vi isrl(vi a) { return (int32_t)((uint32_t)a >> n); }
+    template <int n> static VI_INLINE vi isra(vi a) { return a < 0 ? ~(~a >> n) : a >> n; }
+};
+
+struct vi_sse41_t
+{
+    typedef v128    vf;
+    typedef __m128i vi;
+
+    enum { width = 4 };
+
+    static VI_INLINE vf   set (float x)  { return _mm_set1_ps(x); }
+    static VI_INLINE vf   seti(int x)    { return _mm_castsi128_ps(_mm_set1_epi32(x)); }
+    static VI_INLINE vf   zero()         { return _mm_setzero_ps(); }
+    static VI_INLINE vf   load (const float* m)  { return _mm_loadu_ps(m); }
+    static VI_INLINE void store(float* m, vf v)  { _mm_storeu_ps(m, v); }
+    static VI_INLINE void finish() {}
+
+    static VI_INLINE vf gather(const float* base, vi indices)
+    {
+        return _mm_setr_ps(base[_mm_cvtsi128_si32(indices)],   base[_mm_extract_epi32(indices, 1)],
+                           base[_mm_extract_epi32(indices, 2)], base[_mm_extract_epi32(indices, 3)]);
+    }
+
+    static VI_INLINE vf add(vf a, vf b)       { return _mm_add_ps(a, b); }
+    static VI_INLINE vf sub(vf a, vf b)       { return _mm_sub_ps(a, b); }
+    static VI_INLINE vf mul(vf a, vf b)       { return _mm_mul_ps(a, b); }
+    static VI_INLINE vf div(vf a, vf b)       { return _mm_div_ps(a, b); }
+    static VI_INLINE vf mad(vf a, vf b, vf c) { return vi_mad(a, b, c); }
+    static VI_INLINE vf min(vf a, vf b)       { return _mm_min_ps(a, b); }
+    static VI_INLINE vf max(vf a, vf b)       { return _mm_max_ps(a, b); }
+    static VI_INLINE vf abs(vf a)             { return vi_abs(a); }
+    static VI_INLINE vf neg(vf a)             { return vi_neg(a); }
+    static VI_INLINE vf sqrt(vf a)            { return _mm_sqrt_ps(a); }
+    static VI_INLINE vf rsqrt(vf a)           { return _mm_rsqrt_ps(a); }
+    static VI_INLINE vf round(vf a)           { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+    static VI_INLINE vf cmp_lt   (vf a, vf b) { return _mm_cmplt_ps(a, b); }
+    static VI_INLINE vf cmp_le   (vf a, vf b) { return _mm_cmple_ps(a, b); }
+    static VI_INLINE vf cmp_gt   (vf a, vf b) { return _mm_cmpgt_ps(a, b); }
+    static VI_INLINE vf cmp_ge   (vf a, vf b) { return _mm_cmpge_ps(a, b); }
+    static VI_INLINE vf cmp_eq   (vf a, vf b) { return _mm_cmpeq_ps(a, b); }
+    static VI_INLINE vf cmp_unord(vf a, vf b) { return _mm_cmpunord_ps(a, b); }
+
+    static VI_INLINE vf bit_and   (vf a, vf b) { return _mm_and_ps(a, b); }
+    static VI_INLINE vf bit_or    (vf a, vf b) { return _mm_or_ps(a, b); }
+    static VI_INLINE vf bit_xor   (vf a, vf b) { return _mm_xor_ps(a, b); }
+    static VI_INLINE vf bit_andnot(vf a, vf b) { return _mm_andnot_ps(b, a); }
+    static VI_INLINE vf select(vf a, vf b, vf mask) { return _mm_blendv_ps(a, b, mask); }
+
+    static VI_INLINE int  movemask(vf a) { return _mm_movemask_ps(a); }
+    static VI_INLINE bool any(vf a)      { return _mm_movemask_ps(a) != 0x0; }
+    static VI_INLINE bool all(vf a)      { return _mm_movemask_ps(a) == 0xF; }
+
+    static VI_INLINE vi as_int      (vf a) { return _mm_castps_si128(a); }
+    static VI_INLINE vf as_float    (vi a) { return _mm_castsi128_ps(a); }
+    static VI_INLINE vi cvt_to_int  (vf a) { return _mm_cvtps_epi32(a); }
+    static VI_INLINE vf cvt_to_float(vi a) { return _mm_cvtepi32_ps(a); }
+
+    static VI_INLINE vi iset   (int x)      { return _mm_set1_epi32(x); }
+    static VI_INLINE vi iadd   (vi a, vi b) { return _mm_add_epi32(a, b); }
+    static VI_INLINE vi isub   (vi a, vi b) { return _mm_sub_epi32(a, b); }
+    static VI_INLINE vi iand   (vi a, vi b) { return _mm_and_si128(a, b); }
+    static VI_INLINE vi ior    (vi a, vi b) { return _mm_or_si128(a, b); }
+    static VI_INLINE vi icmp_eq(vi a, vi b) { return _mm_cmpeq_epi32(a, b); }
+    template <int n> static VI_INLINE vi isll(vi a) { return _mm_slli_epi32(a, n); }
+    template <int n> static VI_INLINE vi isrl(vi a) { return _mm_srli_epi32(a, n); }
+    template <int n> static VI_INLINE vi isra(vi a) { return _mm_srai_epi32(a, n); }
+};
+
+// Functions using these traits should end with finish() to avoid AVX-SSE transition penalty
+struct vi_avx2_t
+{
+    typedef v256  vf;
+    typedef v256i vi;
+
+    enum { width = 8 };
+
+    static VI_INLINE vf   set (float x)  { return vi8_set_all(x); }
+    static VI_INLINE vf   seti(int x)    { return vi8_seti_all(x); }
+    static VI_INLINE vf   zero()         { return vi8_set_zero(); }
+    static VI_INLINE vf   load (const float* m)  { return vi8_loadu(m); }
+    static VI_INLINE void store(float* m, vf v)  { vi8_storeu(m, v); }
+    static VI_INLINE vf   gather(const float* base, vi indices) { return vi8_gather(base, indices); }
+    static VI_INLINE void finish() { vi8_zeroupper(); }
+
+    static VI_INLINE vf add(vf a, vf b)       { return vi8_add(a, b); }
+    static VI_INLINE vf sub(vf a, vf b)       { return vi8_sub(a, b); }
+    static VI_INLINE vf mul(vf a, vf b)       { return vi8_mul(a, b); }
+    static VI_INLINE vf div(vf a, vf b)       { return vi8_div(a, b); }
+    static VI_INLINE vf mad(vf a, vf b, vf c) { return vi8_mad(a, b, c); }
+    static VI_INLINE vf min(vf a, vf b)       { return vi8_min(a, b); }
+    static VI_INLINE vf max(vf a, vf b)       { return vi8_max(a, b); }
+    static VI_INLINE vf abs(vf a)             { return vi8_abs(a); }
+    static VI_INLINE vf neg(vf a)             { return vi8_neg(a); }
+    static VI_INLINE vf sqrt(vf a)            { return vi8_sqrt(a); }
+    static VI_INLINE vf rsqrt(vf a)           { return vi8_rsqrt(a); }
+    static VI_INLINE vf round(vf a)           { return vi8_round(a); }
+
+    static VI_INLINE vf cmp_lt   (vf a, vf b) { return vi8_cmp_lt(a, b); }
+    static VI_INLINE vf cmp_le   (vf a, vf b) { return vi8_cmp_le(a, b); }
+    static VI_INLINE vf cmp_gt   (vf a, vf b) { return vi8_cmp_gt(a, b); }
+    static VI_INLINE vf cmp_ge   (vf a, vf b) { return vi8_cmp_ge(a, b); }
+    static VI_INLINE vf cmp_eq   (vf a, vf b) { return vi8_cmp_eq(a, b); }
+    static VI_INLINE vf cmp_unord(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_UNORD_Q); }
+
+    static VI_INLINE vf bit_and   (vf a, vf b) { return vi8_and(a, b); }
+    static VI_INLINE vf bit_or    (vf a, vf b) { return vi8_or(a, b); }
+    static VI_INLINE vf bit_xor   (vf a, vf b) { return vi8_xor(a, b); }
+    static VI_INLINE vf bit_andnot(vf a, vf b) { return vi8_andnot(a, b); }
+    static VI_INLINE vf select(vf a, vf b, vf mask) { return vi8_select(a, b, mask); }
+
+    static VI_INLINE int  movemask(vf a) { return vi8_mask(a); }
+    static VI_INLINE bool any(vf a)      { return vi8_any(a); }
+    static VI_INLINE bool all(vf a)      { return vi8_all(a); }
+
+    static VI_INLINE vi as_int      (vf a) { return vi8_as_int(a); }
+    static VI_INLINE vf as_float    (vi a) { return vi8_as_float(a); }
+    static VI_INLINE vi cvt_to_int  (vf a) { return vi8_cvt_to_int(a); }
+    static VI_INLINE vf cvt_to_float(vi a) { return vi8_cvt_to_float(a); }
+
+    static VI_INLINE vi iset   (int x)      { return _mm256_set1_epi32(x); }
+    static VI_INLINE vi iadd   (vi a, vi b) { return _mm256_add_epi32(a, b); }
+    static VI_INLINE vi isub   (vi a, vi b) { return _mm256_sub_epi32(a, b); }
+    static VI_INLINE vi iand   (vi a, vi b) { return _mm256_and_si256(a, b); }
+    static VI_INLINE vi ior    (vi a, vi b) { return _mm256_or_si256(a, b); }
+    static VI_INLINE vi icmp_eq(vi a, vi b) { return _mm256_cmpeq_epi32(a, b); }
+    template <int n> static VI_INLINE vi isll(vi a) { return _mm256_slli_epi32(a, n); }
+    template <int n> static VI_INLINE vi isrl(vi a) { return _mm256_srli_epi32(a, n); }
+    template <int n> static VI_INLINE vi isra(vi a) { return _mm256_srai_epi32(a, n); }
+};
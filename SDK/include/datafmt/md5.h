@@ -66,5 +66,10 @@ struct md5_anim_data_t
     ml::vec3  location;
 };
 
+// Conversion fails if outBinary is too small
 bool md5meshConvertToBinary(blob32_t inText, blob32_t outBinary);
 bool md5animConvertToBinary(blob32_t inText, blob32_t outBinary);
+
+// Stream text from file instead of reading it into memory first
+bool md5meshConvertToBinary(const char* name, blob32_t outBinary);
+bool md5animConvertToBinary(const char* name, blob32_t outBinary);
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <core/core.h>
+
+// Chunked binary container for meshes, skeleton, animation clips and materials.
+// Chunk is an array of fixed size records starting at MODEL_FILE_ALIGNMENT boundary,
+// records are laid out exactly like runtime uses them, so file can be mapped and
+// chunks handed to GL upload or animation code as is. There are no pointers, all
+// references are indices into other chunks.
+//
+// Unknown chunks are skipped by readers. Any change of record layout should bump
+// MODEL_FILE_VERSION, stride stored with chunk is checked on access as well.
+
+#define MODEL_FILE_MAGIC     'LDOM'
+#define MODEL_FILE_VERSION   1
+#define MODEL_FILE_ALIGNMENT 16
+
+enum model_chunk_id_t
+{
+    MODEL_CHUNK_MESHES,               // model_file_mesh_t
+    MODEL_CHUNK_MATERIALS,            // model_file_material_t
+    MODEL_CHUNK_STATIC_VERTICES,      // model_file_static_vertex_t
+    MODEL_CHUNK_SKINNED_VERTICES,     // model_file_skinned_vertex_t
+    MODEL_CHUNK_INDICES16,            // uint16_t
+    MODEL_CHUNK_INDICES32,            // uint32_t
+    MODEL_CHUNK_JOINT_NAMES,          // model_file_name_t
+    MODEL_CHUNK_JOINT_PARENTS,        // int32_t, -1 for root, parent always precedes child
+    MODEL_CHUNK_BIND_POSE,            // ml::dual_quat per joint, model space
+    MODEL_CHUNK_INV_BIND_POSE,        // ml::dual_quat per joint
+    MODEL_CHUNK_BIND_POSE_SOA,        // model_file_joint_group_t
+    MODEL_CHUNK_INV_BIND_POSE_SOA,    // model_file_joint_group_t
+    MODEL_CHUNK_CLIPS,                // model_file_clip_t
+    MODEL_CHUNK_CLIP_POSES,           // model_file_joint_group_t, model space poses of all frames of all clips
+};
+
+struct model_file_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numChunks;
+    uint32_t reserved;
+    uint64_t size;                    // whole file including header
+};
+
+// Chunk table follows header
+struct model_file_chunk_t
+{
+    uint32_t id;
+    uint32_t stride;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t offset;                  // from the start of file
+};
+
+struct model_file_name_t
+{
+    char     str[64];
+};
+
+struct model_file_material_t
+{
+    char     name[128];               // resolved by runtime, e.g. md5 shader or OBJ material name
+};
+
+struct model_file_mesh_t
+{
+    uint32_t firstVertex;             // in vertex chunk
+    uint32_t numVertices;
+    uint32_t firstIndex;              // in index chunk, indices are relative to firstVertex
+    uint32_t numIndices;
+    uint32_t material;
+    ml::vec3 boundsMin;
+    ml::vec3 boundsMax;
+};
+
+// Same layout as vf::static_geom_t
+struct model_file_static_vertex_t
+{
+    float    px, py, pz;
+    float    nx, ny, nz;
+    float    u, v;
+};
+
+// Same layout as vf::skinned_geom_t, positions and normals are in bind pose
+struct model_file_skinned_vertex_t
+{
+    float    px, py, pz;
+    float    nx, ny, nz;
+    float    u, v;
+    float    w[4];
+    uint8_t  b[4];
+};
+
+// 4 joints in SoA: real.x, real.y, real.z, real.w, dual.x, dual.y, dual.z, dual.w,
+// tail of the last group is padded with identity
+struct model_file_joint_group_t
+{
+    float    soa[8][4];
+};
+
+struct model_file_clip_t
+{
+    model_file_name_t name;
+    uint32_t          numFrames;
+    uint32_t          frameRate;
+    uint32_t          firstFrame;     // in clip poses, each frame is (numJoints+3)/4 groups
+    uint32_t          reserved;
+};
+
+static_assert(sizeof(model_file_header_t)         == 24,  "Header layout is part of file format");
+static_assert(sizeof(model_file_chunk_t)          == 24,  "Chunk table layout is part of file format");
+static_assert(sizeof(model_file_mesh_t)           == 44,  "Mesh layout is part of file format");
+static_assert(sizeof(model_file_skinned_vertex_t) == 52,  "Vertex layout is part of file format");
+static_assert(sizeof(model_file_joint_group_t)    == 128, "Joint group is 8 v128");
+static_assert(sizeof(model_file_clip_t)           == 80,  "Clip layout is part of file format");
+
+// Data is either mapped file or memory owned by file(aligned to MODEL_FILE_ALIGNMENT)
+struct model_file_t
+{
+    const model_file_header_t* header;
+    mapped_file_t              file;
+};
+
+// Opens and validates container: header, chunk bounds and alignment
+bool modelFileOpen (model_file_t* model, const char* name);
+void modelFileClose(model_file_t* model);
+
+// Returns chunk data or 0 if chunk is missing or has different record size
+const void* modelFileChunk(const model_file_t* model, uint32_t id, uint32_t stride, uint32_t* count);
+
+template <typename type>
+static inline const type* modelFileArray(const model_file_t* model, uint32_t id, uint32_t* count)
+{
+    return (const type*)modelFileChunk(model, id, sizeof(type), count);
+}
+
+bool modelFileSave(const model_file_t* model, const char* path);
+
+// Converters used by offline tool and as fallback when there is no container,
+// result is container in memory, same as read from file.
+// md5 is Z up, it is rotated to Y up. Animations should be for the same skeleton as mesh.
+bool modelFileConvertMD5(model_file_t* model, const char* meshName, const char* const* animNames, uint32_t numAnims);
+// Each material of OBJ file becomes a mesh, texture coordinates are flipped vertically
+bool modelFileConvertOBJ(model_file_t* model, const char* name, float scale);
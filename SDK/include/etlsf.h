@@ -7,11 +7,11 @@
 
 #include <stdint.h>
 
-//Allocator is not threadsafe
+//Allocator is threadsafe only when created with ETLSF_THREAD_SAFE flag
 //Supports spaces up to 2^30
 //Supports arbitrary alignments up to 256
-//Supports up to 65535 allocation max
-//Uses 16 bytes per possible allocation
+//Supports up to 2^32-2 allocation max
+//Uses 20 bytes per possible allocation
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,12 +19,32 @@ extern "C" {
 
 struct etlsf_private_t;
 typedef struct etlsf_private_t*  etlsf_t;
-typedef struct { uint16_t value; } etlsf_alloc_t;
+typedef struct { uint32_t value; } etlsf_alloc_t;
 
 static const etlsf_alloc_t ETLSF_INVALID_ID = { 0 };
 
-etlsf_t  etlsf_create (uint32_t size, uint16_t max_allocs);
-void     etlsf_destroy(etlsf_t arena);
+enum etlsf_flags
+{
+    /*
+    ** Allocations are serialized with spin lock, frees never wait:
+    ** when arena is locked by other thread range is pushed to lock-free
+    ** list and released by next allocation or defragmentation.
+    ** Queries of live allocation do not lock, see etlsf_defragment_begin.
+    */
+    ETLSF_THREAD_SAFE = 1,
+};
+
+typedef struct
+{
+    etlsf_alloc_t id;
+    uint32_t      src_offset;
+    uint32_t      dst_offset;
+    uint32_t      size;
+} etlsf_relocation_t;
+
+etlsf_t  etlsf_create   (uint32_t size, uint32_t max_allocs);
+etlsf_t  etlsf_create_ex(uint32_t size, uint32_t max_allocs, uint32_t flags);
+void     etlsf_destroy  (etlsf_t arena);
 
 // All allocations are always aligned up to 256 bytes
 etlsf_alloc_t etlsf_alloc_range(etlsf_t arena, uint32_t size);
@@ -36,6 +56,26 @@ uint32_t etlsf_alloc_offset(etlsf_t arena, etlsf_alloc_t id);
 
 int etlsf_alloc_is_valid(etlsf_t arena, etlsf_alloc_t id);
 
+/*
+** Moves allocations towards offset 0 until all free space is merged at the end
+** of arena or max_relocations moves are made, returns number of moves written.
+** Ids stay the same, only offsets change. Source and destination of a move can
+** overlap, caller should copy data with memmove semantic in returned order.
+** Call again while it returns max_relocations to continue compaction.
+**
+** Sources of moves are free as soon as relocations are returned, so with
+** ETLSF_THREAD_SAFE arena stays locked from etlsf_defragment_begin until
+** etlsf_defragment_end: caller copies data in between, allocations from other
+** threads wait and frees are deferred. Every begin must be paired with end,
+** even when it returns 0. etlsf_defragment is begin immediately followed by
+** end and must not run concurrently with allocations.
+** Unlocked queries (etlsf_alloc_offset, etlsf_alloc_size) race with relocation,
+** offsets read by other threads before end are stale.
+*/
+uint32_t etlsf_defragment      (etlsf_t arena, etlsf_relocation_t* relocations, uint32_t max_relocations);
+uint32_t etlsf_defragment_begin(etlsf_t arena, etlsf_relocation_t* relocations, uint32_t max_relocations);
+void     etlsf_defragment_end  (etlsf_t arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <core/core.h>
+
+// Clustered light assignment on CPU.
+//
+// View frustum is split into screen tiles and exponentially distributed depth slices,
+// every light sphere is tested against view space AABBs of the clusters it can touch(4 clusters at once).
+// Lights are binned in parallel by job system workers into per-thread lists, offsets are
+// computed with parallel prefix sum over clusters, then per-thread lists are scattered
+// into the final light index list without atomics.
+//
+// Slice k covers view distances [(q^k - 1) * b / (q - 1), (q^(k+1) - 1) * b / (q - 1)),
+// cluster of a view point is
+//     z = log(viewZ * zScale + zOffset) * zLogScale
+//     x = fragCoord.x / tileDimX, y = fragCoord.y / tileDimY
+
+struct light_grid_desc_t
+{
+    uint32_t width;       // viewport size in pixels
+    uint32_t height;
+    uint32_t tileDimX;    // tile size in pixels
+    uint32_t tileDimY;
+    uint32_t dimZ;        // number of depth slices
+    float    sliceBase;   // q, ratio of consecutive slice depths
+    float    sliceScale;  // b, depth of the first slice
+};
+
+// Light spheres in world space, structure of arrays
+struct light_soa_t
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* range;
+    uint32_t     count;
+};
+
+struct light_grid_t
+{
+    uint32_t dimX;
+    uint32_t dimY;
+    uint32_t dimZ;
+    uint32_t numClusters;
+
+    float    zScale;
+    float    zOffset;
+    float    zLogScale;
+
+    // Light indices of cluster c are lightList[offsets[c]], ..., lightList[offsets[c] + counts[c] - 1],
+    // cluster index is (z * dimY + y) * dimX + x
+    const int32_t*  offsets;
+    const int32_t*  counts;
+    const uint16_t* lightList;
+    uint32_t        lightListSize;
+
+    // View space light positions, same order as input
+    const float*    viewX;
+    const float*    viewY;
+    const float*    viewZ;
+};
+
+struct light_grid_builder_data_t;
+
+typedef struct light_grid_builder_data_t* light_grid_builder_t;
+
+light_grid_builder_t lightGridCreateBuilder(uint32_t maxLights);
+void                 lightGridDestroyBuilder(light_grid_builder_t builder);
+
+/**
+ * @brief assign lights to clusters using all workers of job system, call from main thread.
+ * @return results owned by builder, valid until next build or builder destruction
+ */
+const light_grid_t* lightGridBuild(light_grid_builder_t builder, const light_grid_desc_t& desc,
+                                   v128 modelView[4], v128 proj[4], const light_soa_t& lights);
@@ -15,6 +15,7 @@
 #ifndef __MJSON_H_INCLUDED__
 #define __MJSON_H_INCLUDED__
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -60,7 +61,41 @@ enum mjson_element_id_t
 
 int mjson_parse(const char *json_data, size_t json_data_size, void* storage_buf, size_t storage_buf_size, mjson_element_t* top_element);
 
-mjson_element_t   mjson_get_top_element(void* storage_buf, size_t storage_buf_size);
+mjson_element_t   mjson_get_top_element(const void* storage_buf, size_t storage_buf_size);
+
+/**
+ * Number of storage bytes used by parsed document
+ */
+size_t            mjson_get_storage_size(mjson_element_t top_element);
+
+/**
+ * Precompiled blob: header followed by storage written by mjson_parse.
+ * Storage is position independent, blob can be saved to disk as is and
+ * later used directly from memory(e.g. mapped file) without parsing.
+ */
+#define MJSON_BLOB_MAGIC   0x424E534A /* "JSNB" */
+#define MJSON_BLOB_VERSION 1
+
+typedef struct _mjson_blob_header_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t storage_size;
+    uint32_t storage_hash;
+    uint32_t source_size;  // json text blob was compiled from
+    uint32_t source_hash;
+    uint64_t source_time;  // modification time of json text, format is up to caller
+} mjson_blob_header_t;
+
+uint32_t          mjson_hash(const void* data, size_t size);
+
+void              mjson_blob_init_header(mjson_blob_header_t* header, mjson_element_t top_element,
+                                         const char* json_data, size_t json_data_size, uint64_t source_time);
+/**
+ * Validates header, storage bounds and optionally storage hash,
+ * returns top element or NULL if blob is corrupted or has different version
+ */
+mjson_element_t   mjson_blob_get_top_element(const void* blob, size_t blob_size, int check_hash);
 
 mjson_element_t   mjson_get_element_first(mjson_element_t array);
 mjson_element_t   mjson_get_element_next (mjson_element_t array, mjson_element_t current_value);
@@ -70,6 +105,25 @@ mjson_element_t   mjson_get_member_first(mjson_element_t dictionary, mjson_eleme
 mjson_element_t   mjson_get_member_next (mjson_element_t dictionary, mjson_element_t current_key, mjson_element_t* next_value);
 mjson_element_t   mjson_get_member      (mjson_element_t dictionary, const char* name);
 
+/**
+ * Optional hash index of dictionary keys for O(1) member lookup in big dictionaries,
+ * built in caller provided memory of at least mjson_index_size(dictionary) bytes.
+ * Index references dictionary storage, it is valid while storage is not freed or moved.
+ */
+struct _mjson_index_t;
+
+typedef const struct _mjson_index_t* mjson_index_t;
+
+size_t            mjson_index_size (mjson_element_t dictionary);
+mjson_index_t     mjson_index_build(mjson_element_t dictionary, void* storage_buf, size_t storage_buf_size);
+mjson_element_t   mjson_index_get_member(mjson_index_t index, const char* name);
+
+/**
+ * Whitespace and string spans are scanned 16 bytes at once with SSE2,
+ * returns previous state, scalar lexer is used when disabled(for benchmarking)
+ */
+int mjson_enable_simd(int enable);
+
 int mjson_get_type(mjson_element_t element);
 
 const char* mjson_get_string(mjson_element_t element, const char* fallback);
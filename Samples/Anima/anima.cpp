@@ -17,13 +17,16 @@ ml::vec3 shPoly_v3[10] = {
 
 namespace app
 {
+    const int CROWD_DIM  = 16;
+    const int NUM_POSES  = CROWD_DIM * CROWD_DIM;
+
     SpectatorCamera     camera;
     v128                proj[4];
 
     Model::model_t      model;
     Model::skeleton_t   skel;
-    Model::animation_t  anim;
-    Model::pose_t       pose;
+    Model::animation_t* anim;
+    Model::pose_t       poses[NUM_POSES];
     bool                mHasAnimation;
 
 
@@ -34,10 +37,40 @@ namespace app
     {
         Model::init();
 
-        Model::loadModel("boblampclean.md5mesh", &model, &skel);
-        mHasAnimation = Model::loadAnimation("boblampclean.md5anim", &anim, &skel);
-
-        Model::createPose(&pose, &skel);
+        if (!Model::loadModel("boblampclean.mdl", &model, &skel))
+        {
+            const char* anims[] = {"boblampclean.md5anim"};
+            Model::loadModelMD5("boblampclean.md5mesh", anims, 1, &model, &skel);
+        }
+
+        mHasAnimation = model.numAnimations > 0;
+        anim          = model.animations;
+
+        for (int i = 0; i < NUM_POSES; ++i)
+        {
+            Model::pose_t* pose = &poses[i];
+
+            Model::createPose(pose, &skel);
+
+            ml::quat orientation = {0.0f, 0.0f, 0.0f, 1.0f};
+            ml::vec3 location    = {
+                ((float)(i % CROWD_DIM) - 0.5f * (CROWD_DIM - 1)) * 60.0f,
+                0.0f,
+                ((float)(i / CROWD_DIM) - 0.5f * (CROWD_DIM - 1)) * 60.0f
+            };
+            ml::make_dual_quat(&pose->root, &orientation, &location);
+
+            if (mHasAnimation)
+            {
+                // Two phase shifted copies of the clip blended together, so every character moves differently
+                Model::addAnimationLayer(pose, anim, 1.0f);
+                Model::addAnimationLayer(pose, anim, (float)(i % 3) * 0.25f);
+
+                pose->layers[0].time  = (float)(i * 7 % anim->numFrames);
+                pose->layers[0].speed = 0.75f + 0.5f * (float)(i % 5) / 4.0f;
+                pose->layers[1].time  = (float)(i * 13 % anim->numFrames);
+            }
+        }
 
         camera.acceleration.x = camera.acceleration.y = camera.acceleration.z = 150;
         camera.maxVelocity.x  = camera.maxVelocity.y  = camera.maxVelocity.z  =  60;
@@ -54,10 +87,12 @@ namespace app
     {
         gfx::gpu_timer_fini(&gpuTimer);
 
-        Model::destroyModel    (&model);
-        Model::destroyAnimation(&anim);
         Model::destroySkeleton (&skel);
-        Model::destroyPose     (&pose);
+        Model::destroyModel    (&model);
+        for (int i = 0; i < NUM_POSES; ++i)
+        {
+            Model::destroyPose(&poses[i]);
+        }
 
         Model::fini();
     }
@@ -80,7 +115,7 @@ namespace app
         gfx::drawXZGrid(-500.0f, -500.0f, 500.0f, 500.0f, 40, vi_set(0.0f, 1.0f, 1.0f, 1.0f));
 
         gpu_timer_start(&gpuTimer);
-        Model::render(&model, &skel, &pose);
+        Model::render(&model, poses, NUM_POSES);
         gpu_timer_stop(&gpuTimer);
 
         gfx::set2DStates();
@@ -98,7 +133,7 @@ namespace app
         static const float maxTimeStep = 0.03333f;
 
         cpu_timer_start(&cpuTimer);
-        Model::update(core::min(dt, maxTimeStep), &anim, &skel, &pose);
+        Model::update(core::min(dt, maxTimeStep), poses, NUM_POSES);
         cpu_timer_stop(&cpuTimer);
 
         ui::processCameraInput(&camera, dt);
@@ -1,10 +1,12 @@
 #include "model.h"
 
-#include "datafmt/md5.h"
+#include "datafmt/model_file.h"
 #include "mjson.h"
 
 #define MAX_BONES 128
 
+#define POSE_GRAIN_SIZE 8
+
 #define UNI_GLOBAL   0
 #define UNI_BONES    1
 #define UNI_LIGHTING 2
@@ -21,8 +23,6 @@ namespace Model
 
     const size_t STATIC_BUFFER_SIZE = 2 * (1<<20);
 
-    mspace_t loadingArena;
-
     gfx_stack_alloc32_t staticAlloc = {STATIC_BUFFER_SIZE, 0};
     GLuint              staticBuffer;
 
@@ -42,8 +42,6 @@ namespace Model
 
     void init()
     {
-        loadingArena = mem_create_space(20 * 1024 * 1024);
-
         prgDefault = res::createProgramFromFiles("MESH.Wireframe.Skinning4.vert", "MESH.Wireframe.geom", "MESH.Wireframe.SHLighting.frag");
 
         mWireframe = (material_t*)malloc(sizeof(material_t));
@@ -92,131 +90,154 @@ namespace Model
         gfx::destroyUBODesc(ubufGlobal);
 
         free(mWireframe);
-
-        mem_destroy_space(loadingArena);
     }
 
-    static ml::quat rotx = {-0.7071067812f, 0.0f, 0.0f, 0.7071067812f};
+    // Number of vectors in SoA group of 4 dual quaternions
+    static const uint32_t DQ_SOA_SIZE = 8;
 
-    void md5CreateSkeleton(skeleton_t* skel, int numJoints, md5_joint_t* joints)
+    static void storeJointsAoS(ml::dual_quat* dst, v128* src)
     {
-        skel->numJoints     = numJoints;
-        skel->boneHierarchy = (int*)          malloc(skel->numJoints*sizeof(int));
-        skel->bindPose      = (ml::dual_quat*)malloc(skel->numJoints*sizeof(ml::dual_quat));
-        skel->invBindPose   = (ml::dual_quat*)malloc(skel->numJoints*sizeof(ml::dual_quat));
+        v128 r[4], d[4];
 
-        int*            hierarchy   = skel->boneHierarchy;
-        ml::dual_quat*  bindPose    = skel->bindPose;
-        ml::dual_quat*  invBindPose = skel->invBindPose;
+        ml::transpose_mat4(r, src);
+        ml::transpose_mat4(d, src+4);
 
-        while (numJoints--)
+        for (int i = 0; i < 4; ++i)
         {
-            *hierarchy = joints->parent;
+            vi_storeu_v4(&dst[i].real, r[i]);
+            vi_storeu_v4(&dst[i].dual, d[i]);
+        }
+    }
 
-            ml::make_dual_quat   (bindPose, &joints->rotation, &joints->location);
+    static v128 dotQuatSoA(const v128* a, const v128* b)
+    {
+        v128 r;
 
-            ml::mul_quat           (&bindPose->real, &rotx, &bindPose->real);
-            ml::mul_quat           (&bindPose->dual, &rotx, &bindPose->dual);
-            ml::conjugate_dual_quat(invBindPose, bindPose);
+        r = vi_mul(a[0], b[0]);
+        r = vi_mad(a[1], b[1], r);
+        r = vi_mad(a[2], b[2], r);
+        r = vi_mad(a[3], b[3], r);
 
-            ++joints;
-            ++bindPose;
-            ++invBindPose;
-            ++hierarchy;
-        }
+        return r;
     }
 
-    void md5CreateMesh(gfx_geometry_t* mesh, md5_mesh_t* md5Mesh, skeleton_t* skel)
+    static void mulQuatSoA(v128* r, const v128* a, const v128* b)
     {
-        vf::skinned_geom_t* vertices;
+        v128 x, y, z, w;
 
-        GLuint verticesSize = sizeof(vf::skinned_geom_t) * md5Mesh->numVertices;
-        GLuint indicesSize  = sizeof(uint16_t) * md5Mesh->numIndices;
+        x = vi_mul(a[3], b[0]);
+        x = vi_mad(a[0], b[3], x);
+        x = vi_mad(a[1], b[2], x);
+        x = vi_sub(x, vi_mul(a[2], b[1]));
 
-        vertices = (vf::skinned_geom_t*)malloc(verticesSize);
-        mem_set(vertices, verticesSize, 0);
+        y = vi_mul(a[3], b[1]);
+        y = vi_mad(a[1], b[3], y);
+        y = vi_mad(a[2], b[0], y);
+        y = vi_sub(y, vi_mul(a[0], b[2]));
 
-        for ( uint32_t i = 0; i < md5Mesh->numVertices; ++i )
-        {
-            vf::skinned_geom_t& vert        = vertices[i];
-            int                 weightCount = md5Mesh->vertices[i].count;
-            int                 startWeight = md5Mesh->vertices[i].start;
+        z = vi_mul(a[3], b[2]);
+        z = vi_mad(a[2], b[3], z);
+        z = vi_mad(a[0], b[1], z);
+        z = vi_sub(z, vi_mul(a[1], b[0]));
 
-            assert( weightCount <= 4 );
+        w = vi_mul(a[3], b[3]);
+        w = vi_sub(w, vi_mul(a[0], b[0]));
+        w = vi_sub(w, vi_mul(a[1], b[1]));
+        w = vi_sub(w, vi_mul(a[2], b[2]));
 
-            v128 pos;
+        r[0] = x; r[1] = y; r[2] = z; r[3] = w;
+    }
 
-            pos = vi_set_zero();
+    static void mulDualQuatSoA(v128* r, const v128* a, const v128* b)
+    {
+        v128 t0[4], t1[4];
 
-            // Sum the position of the weights
-            for ( int j = 0; j < weightCount; ++j )
-            {
-                md5_weight_t&  weight = md5Mesh->weights[startWeight + j];
-                ml::dual_quat& joint  = skel->bindPose[weight.joint];
+        mulQuatSoA(r,  a,   b);
+        mulQuatSoA(t0, a+4, b);
+        mulQuatSoA(t1, a,   b+4);
 
-                v128 r, d, v, t;
+        r[4] = vi_add(t0[0], t1[0]);
+        r[5] = vi_add(t0[1], t1[1]);
+        r[6] = vi_add(t0[2], t1[2]);
+        r[7] = vi_add(t0[3], t1[3]);
+    }
 
-                r = vi_loadu_v4(&joint.real);
-                d = vi_loadu_v4(&joint.dual);
-                v = vi_load_v3(&weight.location);
+    static_assert(sizeof(model_file_skinned_vertex_t) == sizeof(vf::skinned_geom_t), "Container vertices are uploaded as is");
 
-                v = ml::rotate_vec3_quat(r, v);
-                t = ml::translation_dual_quat(r, d);
-                t = vi_add(v, t);
+    static bool createSkeleton(skeleton_t* skel, const model_file_t* file)
+    {
+        uint32_t numParents, numBindPose, numInvBindPose, numBindGroups, numInvBindGroups;
 
-                pos = vi_mad(t, vi_set_all(weight.bias), pos);
+        skel->boneHierarchy  = (int32_t*)      modelFileArray<int32_t>                 (file, MODEL_CHUNK_JOINT_PARENTS,     &numParents);
+        skel->bindPose       = (ml::dual_quat*)modelFileArray<ml::dual_quat>           (file, MODEL_CHUNK_BIND_POSE,         &numBindPose);
+        skel->invBindPose    = (ml::dual_quat*)modelFileArray<ml::dual_quat>           (file, MODEL_CHUNK_INV_BIND_POSE,     &numInvBindPose);
+        skel->bindPoseSoA    = (v128*)         modelFileArray<model_file_joint_group_t>(file, MODEL_CHUNK_BIND_POSE_SOA,     &numBindGroups);
+        skel->invBindPoseSoA = (v128*)         modelFileArray<model_file_joint_group_t>(file, MODEL_CHUNK_INV_BIND_POSE_SOA, &numInvBindGroups);
 
-                assert(weight.joint<256);
+        skel->numJoints      = numParents;
+        skel->numJointGroups = (numParents + 3) / 4;
 
-                vert.b[j] = (uint8_t)weight.joint;
-                vert.w[j] = weight.bias;
-            }
+        return skel->boneHierarchy && skel->bindPose && skel->invBindPose && skel->bindPoseSoA && skel->invBindPoseSoA &&
+               numBindPose   == numParents      && numInvBindPose   == numParents &&
+               numBindGroups == skel->numJointGroups && numInvBindGroups == skel->numJointGroups;
+    }
 
-            vi_store_v3(&vert.px, pos);
-        }
+    static bool createAnimations(model_t* model, const skeleton_t* skel)
+    {
+        uint32_t numClips, numGroups;
 
-        // Loop through all triangles and calculate the normal of each triangle
-        for ( uint32_t i = 0; i < md5Mesh->numIndices/3; ++i )
-        {
-            v128 v0, v1, v2;
-            v128 n0, n1, n2;
-            v128 n;
+        const model_file_clip_t*        clips = modelFileArray<model_file_clip_t>       (&model->file, MODEL_CHUNK_CLIPS,      &numClips);
+        const model_file_joint_group_t* poses = modelFileArray<model_file_joint_group_t>(&model->file, MODEL_CHUNK_CLIP_POSES, &numGroups);
 
-            v0 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+0] ].px);
-            v1 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+1] ].px);
-            v2 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+2] ].px);
+        if (!clips || !poses) return true;
 
-            n = vi_cross3(vi_sub(v2, v0), vi_sub(v1, v0));
+        model->numAnimations = numClips;
+        model->animations    = (animation_t*)malloc(numClips*sizeof(animation_t));
 
-            n0 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+0] ].nx);
-            n1 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+1] ].nx);
-            n2 = vi_load_v3(&vertices[ md5Mesh->indices[i*3+2] ].nx);
+        for (uint32_t i = 0; i < numClips; ++i)
+        {
+            uint64_t lastGroup = ((uint64_t)clips[i].firstFrame + clips[i].numFrames) * skel->numJointGroups;
 
-            n0 = vi_add(n0, n);
-            n1 = vi_add(n1, n);
-            n2 = vi_add(n2, n);
+            if (lastGroup > numGroups) return false;
 
-            vi_store_v3(&vertices[ md5Mesh->indices[i*3+0] ].nx, n0);
-            vi_store_v3(&vertices[ md5Mesh->indices[i*3+1] ].nx, n1);
-            vi_store_v3(&vertices[ md5Mesh->indices[i*3+2] ].nx, n2);
+            model->animations[i].numFrames  = clips[i].numFrames;
+            model->animations[i].frameRate  = clips[i].frameRate;
+            model->animations[i].numJoints  = skel->numJoints;
+            model->animations[i].framePoses = (v128*)(poses + clips[i].firstFrame * skel->numJointGroups);
         }
 
-        // Now normalize all the normals
-        for ( uint32_t i = 0; i < md5Mesh->numVertices; ++i )
-        {
-            v128                n;
-            vf::skinned_geom_t& vert = vertices[i];
+        return true;
+    }
 
-            n = vi_load_v3(&vert.nx);
-            n = ml::normalize(n);
-            vi_store_v3(&vert.nx, n);
+    // All meshes share one allocation in static buffer, chunks are uploaded as is
+    static bool createMeshes(model_t* model)
+    {
+        uint32_t numMeshes, numMaterials, numVertices, numIndices;
+        uint32_t indexSize = sizeof(uint16_t);
+        GLenum   idxFormat = GL_UNSIGNED_SHORT;
+
+        const model_file_mesh_t*           meshes    = modelFileArray<model_file_mesh_t>          (&model->file, MODEL_CHUNK_MESHES,           &numMeshes);
+        const model_file_material_t*       materials = modelFileArray<model_file_material_t>      (&model->file, MODEL_CHUNK_MATERIALS,        &numMaterials);
+        const model_file_skinned_vertex_t* vertices  = modelFileArray<model_file_skinned_vertex_t>(&model->file, MODEL_CHUNK_SKINNED_VERTICES, &numVertices);
+        const void*                        indices   = modelFileArray<uint16_t>                   (&model->file, MODEL_CHUNK_INDICES16,        &numIndices);
+
+        if (!indices)
+        {
+            indices   = modelFileArray<uint32_t>(&model->file, MODEL_CHUNK_INDICES32, &numIndices);
+            indexSize = sizeof(uint32_t);
+            idxFormat = GL_UNSIGNED_INT;
         }
 
-        // Copy texture coordinates
-        for ( uint32_t i = 0; i < md5Mesh->numVertices; ++i )
+        if (!meshes || !materials || !vertices || !indices) return false;
+
+        for (uint32_t i = 0; i < numMeshes; ++i)
         {
-            vertices[i].u = md5Mesh->vertices[i].u;
-            vertices[i].v = md5Mesh->vertices[i].v;
+            if ((uint64_t)meshes[i].firstVertex + meshes[i].numVertices > numVertices ||
+                (uint64_t)meshes[i].firstIndex  + meshes[i].numIndices  > numIndices  ||
+                meshes[i].material >= numMaterials)
+            {
+                return false;
+            }
         }
 
         GLuint    totalSize;
@@ -225,193 +246,207 @@ namespace Model
 
         gfx_alloc_geom(
             &staticAlloc,
-            sizeof(vf::skinned_geom_t), md5Mesh->numVertices,
-            sizeof(uint16_t), md5Mesh->numIndices,
+            sizeof(vf::skinned_geom_t), numVertices,
+            indexSize, numIndices,
             &vertexOffset, &indexOffset, &totalSize
         );
 
         assert(vertexOffset % sizeof(vf::skinned_geom_t) == 0);
-        assert(indexOffset % sizeof(uint16_t) == 0);
+        assert(indexOffset % indexSize == 0);
 
         uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-        mem_copy(ptr, vertices, verticesSize);
-        mem_copy(ptr+(indexOffset-vertexOffset),  md5Mesh->indices,  indicesSize);
+        mem_copy(ptr, vertices, numVertices * sizeof(vf::skinned_geom_t));
+        mem_copy(ptr+(indexOffset-vertexOffset), indices, numIndices * indexSize);
         glUnmapNamedBuffer(staticBuffer);
 
-        mesh->numIndices  = md5Mesh->numIndices;
-        mesh->idxFormat   = GL_UNSIGNED_SHORT;
-        mesh->idxOffset   = indexOffset;
-        mesh->firstVertex = vertexOffset / sizeof(vf::skinned_geom_t);
-        free(vertices);
-    }
+        model->numMeshes = numMeshes;
+        model->meshes    = (gfx_geometry_t*)malloc(numMeshes*sizeof(gfx_geometry_t));
+        model->materials = (material_t*)malloc(numMeshes*sizeof(material_t));
 
-    void md5CreateAnimation( animation_t* anim, md5_anim_t* md5Anim, skeleton_t* skel )
-    {
-        anim->numFrames = md5Anim->numFrames;
-        anim->frameRate = md5Anim->frameRate;
+        for (uint32_t i = 0; i < numMeshes; ++i)
+        {
+            gfx_geometry_t* mesh = &model->meshes[i];
 
-        anim->framePoses = (ml::dual_quat*)malloc(md5Anim->numFrames * skel->numJoints * sizeof(ml::dual_quat));
+            mesh->numIndices  = meshes[i].numIndices;
+            mesh->idxFormat   = idxFormat;
+            mesh->idxOffset   = indexOffset + meshes[i].firstIndex * indexSize;
+            mesh->firstVertex = vertexOffset / sizeof(vf::skinned_geom_t) + meshes[i].firstVertex;
 
-        int              numFrames  = md5Anim->numFrames;
-        int*             hierarchy  = skel->boneHierarchy;
-        md5_anim_data_t* animData   = md5Anim->frameData;
-        ml::dual_quat*   framePoses = anim->framePoses;
+            model->materials[i] = *mWireframe;
+            loadMaterial(&model->materials[i], materials[meshes[i].material].name);
+            if (model->materials[i].diffuse && model->materials[i].normal) model->materials[i].program = prgLighting;
+        }
 
-        while(numFrames--)
-        {
-            for (uint32_t i=0; i<skel->numJoints; ++i)
-            {
-                ml::make_dual_quat(&framePoses[i], &animData[i].rotation, &animData[i].location);
+        return true;
+    }
 
-                int parent = hierarchy[i];
-                if( parent > -1 )
-                {
-                    ml::mul_dual_quat(&framePoses[i], &framePoses[parent], &framePoses[i]);
-                }
-                else
-                {
-                    ml::mul_quat(&framePoses[i].real, &rotx, &framePoses[i].real);
-                    ml::mul_quat(&framePoses[i].dual, &rotx, &framePoses[i].dual);
-                }
-            }
+    // Skeleton and animations reference container data, it is kept until model is destroyed
+    static bool createModel(model_t* model, skeleton_t* skel)
+    {
+        bool created = createSkeleton(skel, &model->file) && createAnimations(model, skel) && createMeshes(model);
 
-            framePoses += skel->numJoints;
-            animData   += skel->numJoints;
+        if (!created)
+        {
+            destroyModel(model);
+            destroySkeleton(skel);
         }
+
+        return created;
     }
-    
+
     bool loadModel(const char* name, model_t* model, skeleton_t* skel)
     {
-        blob32_t inText    = {0};
-        blob32_t outBinary = {0};
-
         mem_zero(model);
         mem_zero(skel);
 
-        bool data_read = 
-            (inText = read_file_to_blob32(loadingArena, name, 0xFFFF)) &&
-            (outBinary = blob32_alloc(loadingArena, 4 * 1024 * 1024)) &&
-            md5meshConvertToBinary(inText, outBinary);
-
-        mem_free(loadingArena, inText);
-
-        if (data_read)
-        {
-            uint8_t* outData = blob32_data(outBinary);
-            md5_model_t* md5Model = mem_as_ptr<md5_model_t>(outData, 0);
-
-            model->numMeshes = md5Model->numMeshes;
-            model->meshes    = (gfx_geometry_t*)malloc(model->numMeshes*sizeof(gfx_geometry_t));
-            model->materials = (material_t*)malloc(model->numMeshes*sizeof(material_t));
+        return modelFileOpen(&model->file, name) && createModel(model, skel);
+    }
 
-            md5CreateSkeleton(skel, md5Model->numJoints, md5Model->joints);
+    bool loadModelMD5(const char* meshName, const char* const* animNames, uint32_t numAnims, model_t* model, skeleton_t* skel)
+    {
+        mem_zero(model);
+        mem_zero(skel);
 
-            md5_mesh_t* md5Mesh = md5Model->meshes;
-            for (uint32_t i=0; i<model->numMeshes; ++i)
-            {
-                md5CreateMesh(&model->meshes[i], md5Mesh, skel);
+        return modelFileConvertMD5(&model->file, meshName, animNames, numAnims) && createModel(model, skel);
+    }
 
-                model->materials[i] = *mWireframe;
-                loadMaterial(&model->materials[i], md5Mesh->shader);
-                if (model->materials[i].diffuse && model->materials[i].normal) model->materials[i].program = prgLighting;
+    struct layer_sample_t
+    {
+        const v128* frame0;
+        const v128* frame1;
+        float       lerpK;
+        float       weight;
+    };
 
-                ++md5Mesh;
-            }
-        }
+    static void updatePose(pose_t* pose, float fDeltaTime)
+    {
+        skeleton_t*    skel      = pose->skel;
+        uint32_t       numGroups = skel->numJointGroups;
+        layer_sample_t samples[MAX_ANIM_LAYERS];
+        uint32_t       numSamples  = 0;
+        float          totalWeight = 0.0f;
 
-        mem_free(loadingArena, outBinary);
+        for (uint32_t i = 0; i < pose->numLayers; ++i)
+        {
+            anim_layer_t* layer = &pose->layers[i];
+            animation_t*  anim  = layer->anim;
 
-        return data_read;
-    }
+            if (anim->numFrames == 0) continue;
 
-    bool loadAnimation(const char *name, animation_t* anim, skeleton_t* skel)
-    {
-        blob32_t inText = {0};
-        blob32_t outBinary = {0};
+            layer->time += fDeltaTime * (float)anim->frameRate * layer->speed;
+            layer->time  = ml::mod(layer->time, (float)anim->numFrames);
+            if (layer->time < 0.0f) layer->time += (float)anim->numFrames;
 
-        mem_zero(anim);
+            if (layer->weight <= 0.0f) continue;
 
-        bool data_read = 
-            (inText = read_file_to_blob32(loadingArena, name, 0xFFFF)) &&
-            (outBinary = blob32_alloc(loadingArena, 4 * 1024 * 1024)) &&
-            md5animConvertToBinary(inText, outBinary);
+            uint32_t frame0 = (uint32_t)ml::floor(layer->time) % anim->numFrames;
+            uint32_t frame1 = (frame0 + 1) % anim->numFrames;
 
-        mem_free(loadingArena, inText);
+            layer_sample_t& sample = samples[numSamples++];
+            sample.frame0 = anim->framePoses + frame0 * numGroups * DQ_SOA_SIZE;
+            sample.frame1 = anim->framePoses + frame1 * numGroups * DQ_SOA_SIZE;
+            sample.lerpK  = layer->time - ml::floor(layer->time);
+            sample.weight = layer->weight;
 
-        uint8_t* outData = blob32_data(outBinary);
-        md5_anim_t* md5Anim = mem_as_ptr<md5_anim_t>(outData, 0);
-        data_read = data_read && (skel->numJoints == md5Anim->numJoints);
+            totalWeight += layer->weight;
+        }
 
-        if (data_read)
+        if (numSamples == 0)
         {
-            md5CreateAnimation(anim, md5Anim, skel);
+            // No animation. Just use bind pose for each bone.
+            samples[0].frame0 = skel->bindPoseSoA;
+            samples[0].frame1 = skel->bindPoseSoA;
+            samples[0].lerpK  = 0.0f;
+            samples[0].weight = 1.0f;
+
+            numSamples  = 1;
+            totalWeight = 1.0f;
         }
 
-        mem_free(loadingArena, outBinary);
+        const float* rootData = &pose->root.real.x;
+        v128         root[DQ_SOA_SIZE];
+        for (uint32_t c = 0; c < DQ_SOA_SIZE; ++c)
+        {
+            root[c] = vi_set_all(rootData[c]);
+        }
 
-        return data_read;
-    }
+        v128 zero     = vi_set_zero();
+        v128 one      = vi_set_all(1.0f);
+        v128 signMask = vi_seti_all(VI_SIGN_MASK);
 
-    void update(float fDeltaTime, animation_t* anim, skeleton_t* skel, pose_t* pose)
-    {
-        if ( anim->numFrames > 1)
+        for (uint32_t g = 0; g < numGroups; ++g)
         {
-            int   frame0, frame1;
-            float lerpK;
+            v128 acc[DQ_SOA_SIZE], q[DQ_SOA_SIZE];
 
-            pose->animTime += fDeltaTime * (float)anim->frameRate;
-            pose->animTime  = ml::mod(pose->animTime, (float)anim->numFrames);
-
-            frame0 = (int)ml::floor( pose->animTime );
-            frame0 = frame0 % anim->numFrames;
-            frame1 = frame0 + 1;
-            frame1 = frame1 % anim->numFrames;
+            for (uint32_t c = 0; c < DQ_SOA_SIZE; ++c)
+            {
+                acc[c] = zero;
+            }
 
-            lerpK  = pose->animTime - ml::floor(pose->animTime);
+            for (uint32_t i = 0; i < numSamples; ++i)
+            {
+                const v128* f0 = samples[i].frame0 + g * DQ_SOA_SIZE;
+                const v128* f1 = samples[i].frame1 + g * DQ_SOA_SIZE;
 
-            // I assume there is no zero quaternions in orientation data
-            // so I do not check whether real quaternion norm is zero
-            v128 qr0, qd0, qr1, qd1, r, n;
+                // Interpolate along the shortest arc.
+                // I assume there is no zero quaternions in orientation data
+                // so I do not check whether real quaternion norm is zero
+                v128 flip = vi_and(vi_cmp_lt(dotQuatSoA(f0, f1), zero), signMask);
 
-            ml::dual_quat* frame0Data = anim->framePoses + frame0*skel->numJoints; 
-            ml::dual_quat* frame1Data = anim->framePoses + frame1*skel->numJoints; 
+                for (uint32_t c = 0; c < DQ_SOA_SIZE; ++c)
+                {
+                    q[c] = vi_lerp(f0[c], vi_xor(f1[c], flip), samples[i].lerpK);
+                }
 
-            for ( uint32_t i = 0; i < skel->numJoints; ++i )
-            {
-                qr0 = vi_loadu_v4(&frame0Data[i].real);
-                qd0 = vi_loadu_v4(&frame0Data[i].dual);
-                qr1 = vi_loadu_v4(&frame1Data[i].real);
-                qd1 = vi_loadu_v4(&frame1Data[i].dual);
+                // Keep layers in the same hemisphere as already accumulated ones
+                v128 w = vi_set_all(samples[i].weight / totalWeight);
+                w = vi_xor(w, vi_and(vi_cmp_lt(dotQuatSoA(acc, q), zero), signMask));
 
-                if (vi_dot4(qr0, qr1) < 0.0f)
+                for (uint32_t c = 0; c < DQ_SOA_SIZE; ++c)
                 {
-                    qr1 = vi_neg(qr1);
-                    qd1 = vi_neg(qd1);
+                    acc[c] = vi_mad(q[c], w, acc[c]);
                 }
+            }
 
-                r  = vi_lerp(qr0, qr1, lerpK);
-                n  = ml::length_quat(r);
-                r  = vi_div(r, n);
-                vi_storeu_v4(&pose->pose[i].real, r);
+            v128 invLength = vi_div(one, vi_sqrt(dotQuatSoA(acc, acc)));
+            for (uint32_t c = 0; c < DQ_SOA_SIZE; ++c)
+            {
+                acc[c] = vi_mul(acc[c], invLength);
+            }
 
-                r  = vi_lerp(qd0, qd1, lerpK);
-                r  = vi_div(r, n);
-                vi_storeu_v4(&pose->pose[i].dual, r);
+            mulDualQuatSoA(q, root, acc);
+            storeJointsAoS(&pose->pose[g*4], q);
 
-                ml::mul_dual_quat(&pose->boneTransforms[i], &pose->pose[i], &skel->invBindPose[i]);
-            }
+            mulDualQuatSoA(acc, q, skel->invBindPoseSoA + g * DQ_SOA_SIZE);
+            storeJointsAoS(&pose->boneTransforms[g*4], acc);
         }
-        else
+    }
+
+    struct update_args_t
+    {
+        pose_t* poses;
+        float   fDeltaTime;
+    };
+
+    static void updatePosesJob(uint32_t begin, uint32_t end, void* arg)
+    {
+        PROFILER_CPU_TIMESLICE("updatePoses");
+
+        update_args_t* args = (update_args_t*)arg;
+
+        for (uint32_t i = begin; i < end; ++i)
         {
-            // No animation. Just use identity quaternions for each bone.
-            ml::dual_quat* bone = pose->boneTransforms;
-            for (uint32_t i = 0; i < skel->numJoints; ++i, ++bone)
-            {
-                ml::set_identity_dual_quat(bone);
-            }
+            updatePose(&args->poses[i], args->fDeltaTime);
         }
     }
 
+    void update(float fDeltaTime, pose_t* poses, uint32_t count)
+    {
+        update_args_t args = {poses, fDeltaTime};
+
+        mt::jobWait(mt::parallelFor(updatePosesJob, &args, count, POSE_GRAIN_SIZE));
+    }
+
     void renderMesh(gfx_geometry_t* mesh, material_t* material)
     {
         glUseProgram(material->program);
@@ -463,40 +498,71 @@ namespace Model
         glEnable(GL_DEPTH_TEST);
     }
 
-    void render(model_t* model, skeleton_t* skel, pose_t* pose)
+    void render(model_t* model, pose_t* poses, uint32_t count)
     {
-        GLuint offsetGlobal, offsetBones, offsetLighting;
+        GLuint offsetGlobal, offsetLighting;
         
         GLsizeiptr sizeGlobal   = 20*sizeof(float);
         GLsizeiptr sizeLighting = 10*sizeof(v128);
-        GLsizeiptr sizeBones    = skel->numJoints*sizeof(ml::dual_quat);
 
         void* memGlobal   = gfx::dynbufAllocMem(sizeGlobal,   gfx::caps.uboAlignment,  &offsetGlobal);
         void* memLighting = gfx::dynbufAllocMem(sizeLighting, gfx::caps.uboAlignment,  &offsetLighting);
-        void* memBones    = gfx::dynbufAllocMem(sizeBones,    gfx::caps.ssboAlignment, &offsetBones);
 
-        mem_copy(memBones, &pose->boneTransforms[0].real.x, sizeBones);
         gfx::updateUBO(ubufGlobal,   memGlobal,   sizeGlobal);
         gfx::updateUBO(ubufLighting, memLighting, sizeLighting);
 
-        glBindBufferRange(GL_UNIFORM_BUFFER,        UNI_GLOBAL,   gfx::dynBuffer, offsetGlobal,   sizeGlobal);
-        glBindBufferRange(GL_UNIFORM_BUFFER,        UNI_LIGHTING, gfx::dynBuffer, offsetLighting, sizeLighting);
-        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, UNI_BONES,    gfx::dynBuffer, offsetBones,    sizeBones);
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNI_GLOBAL,   gfx::dynBuffer, offsetGlobal,   sizeGlobal);
+        glBindBufferRange(GL_UNIFORM_BUFFER, UNI_LIGHTING, gfx::dynBuffer, offsetLighting, sizeLighting);
 
-        for (uint32_t i=0; i<model->numMeshes; ++i)
+        for (uint32_t p=0; p<count; ++p)
         {
-            renderMesh( &model->meshes[i], &model->materials[i] );
-        }
+            pose_t*     pose = &poses[p];
+            skeleton_t* skel = pose->skel;
+
+            GLuint     offsetBones;
+            GLsizeiptr sizeBones = skel->numJoints*sizeof(ml::dual_quat);
+            void*      memBones  = gfx::dynbufAllocMem(sizeBones, gfx::caps.ssboAlignment, &offsetBones);
+
+            mem_copy(memBones, &pose->boneTransforms[0].real.x, sizeBones);
 
-        renderSkeleton(skel->numJoints, skel->boneHierarchy, pose->pose);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, UNI_BONES, gfx::dynBuffer, offsetBones, sizeBones);
+
+            for (uint32_t i=0; i<model->numMeshes; ++i)
+            {
+                renderMesh( &model->meshes[i], &model->materials[i] );
+            }
+
+            renderSkeleton(skel->numJoints, skel->boneHierarchy, pose->pose);
+        }
     }
 
     void createPose(pose_t* pose, skeleton_t* skel)
     {
         mem_zero(pose);
 
-        pose->boneTransforms = (ml::dual_quat*) malloc(skel->numJoints * sizeof(ml::dual_quat));
-        pose->pose           = (ml::dual_quat*) malloc(skel->numJoints * sizeof(ml::dual_quat));
+        pose->skel = skel;
+        ml::set_identity_dual_quat(&pose->root);
+
+        // Poses are written by whole SoA groups, so keep room for padding joints
+        pose->boneTransforms = (ml::dual_quat*) malloc(skel->numJointGroups * 4 * sizeof(ml::dual_quat));
+        pose->pose           = (ml::dual_quat*) malloc(skel->numJointGroups * 4 * sizeof(ml::dual_quat));
+    }
+
+    bool addAnimationLayer(pose_t* pose, animation_t* anim, float weight)
+    {
+        if (pose->numLayers >= MAX_ANIM_LAYERS || anim->numJoints != pose->skel->numJoints)
+        {
+            return false;
+        }
+
+        anim_layer_t* layer = &pose->layers[pose->numLayers++];
+
+        layer->anim   = anim;
+        layer->time   = 0.0f;
+        layer->speed  = 1.0f;
+        layer->weight = weight;
+
+        return true;
     }
 
     bool loadMaterial(material_t* mat, const char* name)
@@ -579,28 +645,20 @@ namespace Model
             destroyMaterial(&model->materials[i]);
         }
 
-        if (model->meshes   ) free(model->meshes   );
-        if (model->materials) free(model->materials);
+        if (model->meshes    ) free(model->meshes    );
+        if (model->materials ) free(model->materials );
+        if (model->animations) free(model->animations);
+
+        modelFileClose(&model->file);
 
         mem_zero(model);
     }
 
     void destroySkeleton(skeleton_t* skel)
     {
-        if (skel->boneHierarchy) free(skel->boneHierarchy);
-        if (skel->bindPose     ) free(skel->bindPose     );
-        if (skel->invBindPose  ) free(skel->invBindPose  );
-
         mem_zero(skel);
     }
 
-    void destroyAnimation(animation_t* anim)
-    {
-        if (anim->framePoses) free(anim->framePoses);
-
-        mem_zero(anim);
-    }
-
     void destroyPose(pose_t* pose)
     {
         if (pose->boneTransforms) free(pose->boneTransforms);
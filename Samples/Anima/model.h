@@ -1,36 +1,64 @@
 #pragma once;
 
 #include <gfx/gfx.h>
+#include <datafmt/model_file.h>
 
 namespace Model
 {
     struct material_t;
+    struct animation_t;
     
     struct model_t
     {
+        model_file_t       file;
         uint32_t           numMeshes;
         gfx_geometry_t*    meshes;
         material_t*        materials;
+        uint32_t           numAnimations;
+        animation_t*       animations;
     };
 
+    // Joints are also stored in SoA groups of 4: real.x, real.y, real.z, real.w, dual.x, dual.y, dual.z, dual.w,
+    // 8 vectors per group. Tail of the last group is padded with identity.
+    // Skeleton and animations point into model container and are valid until model is destroyed.
     struct skeleton_t
     {
         uint32_t       numJoints;
+        uint32_t       numJointGroups;
         int32_t*       boneHierarchy;
         ml::dual_quat* bindPose;
         ml::dual_quat* invBindPose;
+        v128*          bindPoseSoA;
+        v128*          invBindPoseSoA;
     };
     
     struct animation_t
     {
         uint32_t       numFrames;
         uint32_t       frameRate;
-        ml::dual_quat* framePoses;
+        uint32_t       numJoints;
+        v128*          framePoses;        // numJointGroups SoA groups per frame
+    };
+
+    struct anim_layer_t
+    {
+        animation_t*   anim;
+        float          time;              // Animation time converted to frames
+        float          speed;             // Playback rate multiplier
+        float          weight;            // Relative blend weight, layers are blended with normalized weights
+    };
+
+    enum
+    {
+        MAX_ANIM_LAYERS = 4
     };
 
     struct pose_t
     {
-        float          animTime;          // Animation time converted to frames
+        skeleton_t*    skel;
+        ml::dual_quat  root;              // Placement of the character in world
+        uint32_t       numLayers;
+        anim_layer_t   layers[MAX_ANIM_LAYERS];
         ml::dual_quat* boneTransforms;
         ml::dual_quat* pose;              // Current pose, atm used to visualize skeleton
     };
@@ -38,16 +66,20 @@ namespace Model
     void init();
     void fini();
 
-    bool loadModel    (const char* name, model_t*     model, skeleton_t* skel);
-    bool loadAnimation(const char* name, animation_t* anim,  skeleton_t* skel);
+    // Loads container produced by ModelConverter
+    bool loadModel   (const char* name, model_t* model, skeleton_t* skel);
+    // Converts md5 mesh and animations in memory, slow path for models without container
+    bool loadModelMD5(const char* meshName, const char* const* animNames, uint32_t numAnims, model_t* model, skeleton_t* skel);
 
     void createPose(pose_t* pose, skeleton_t* skel);
+    bool addAnimationLayer(pose_t* pose, animation_t* anim, float weight);
 
     void destroyModel    (model_t*     model);
     void destroySkeleton (skeleton_t*  skel );
-    void destroyAnimation(animation_t* anim );
     void destroyPose     (pose_t*      pose );
 
-    void update(float fDeltaTime, animation_t* anim, skeleton_t* skel, pose_t* pose);
-    void render(model_t* model, skeleton_t* skel, pose_t* pose);
+    // Advances layers and computes bone transforms of all poses in parallel using job system, call from main thread.
+    // Pose without layers(or with zero total weight) is set to bind pose.
+    void update(float fDeltaTime, pose_t* poses, uint32_t count);
+    void render(model_t* model, pose_t* poses, uint32_t count);
 };
\ No newline at end of file
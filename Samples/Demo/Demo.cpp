@@ -1,4 +1,6 @@
 #include <fwk/fwk.h>
+#include <fwk/clustered_lighting.h>
+#include <datafmt/model_file.h>
 
 #include "tiny_obj_loader.h"
 
@@ -16,22 +18,6 @@
 #define LIGHT_GRID_MAX_DIM_Y ((1080 + LIGHT_GRID_TILE_DIM_Y - 1) / LIGHT_GRID_TILE_DIM_Y)
 #define LIGHT_GRID_MAX_DIM_Z 256 
 
-struct mesh_header_v0
-{
-    uint32_t magic;
-    uint32_t version;
-    uint32_t numVertices;
-    uint32_t numIndices;
-
-    float minx, miny, minz;
-    float maxx, maxy, maxz;
-
-    uint32_t numSubsets;
-    uint32_t meshSubsets[16*2];
-};
-
-#define MESH_FILE_MAGIC 'HSEM'
-
 struct material_t
 {
     GLuint  program;
@@ -102,9 +88,13 @@ namespace app
 
     mspace_t appArena;
 
-    size_t numViewLights;
-    light_t  lights[MAX_LIGHTS];
-    light_t  lightsView[MAX_LIGHTS];
+    light_grid_builder_t lightGridBuilder;
+
+    float    lightPosX [MAX_LIGHTS];
+    float    lightPosY [MAX_LIGHTS];
+    float    lightPosZ [MAX_LIGHTS];
+    float    lightRange[MAX_LIGHTS];
+    ml::vec3 lightColor[MAX_LIGHTS];
 
     ml::vec3 scene_min = {0.0f, 0.0f, 0.0f};
     ml::vec3 scene_max = {0.0f, 0.0f, 0.0f};
@@ -214,6 +204,7 @@ namespace app
         loadMaterials();
         loadModels();
 
+        lightGridBuilder = lightGridCreateBuilder(MAX_LIGHTS);
         generateLights(MAX_LIGHTS);
 
         camera.acceleration.x = camera.acceleration.y = camera.acceleration.z = 150;
@@ -230,6 +221,8 @@ namespace app
         glDeleteBuffers(1, &staticBuffer);
         glDeleteBuffers(1, &materialUBO);
 
+        lightGridDestroyBuilder(lightGridBuilder);
+
         glDeleteTextures(1, &texLightData);
         glDeleteTextures(1, &texLightListData);
         glDeleteTextures(1, &texClusterData);
@@ -245,13 +238,6 @@ namespace app
         mem_destroy_space(appArena);
     }
 
-    int32_t gridDimX;
-    int32_t gridDimY;
-    int32_t gridDimZ;
-    int32_t numClusters;
-    float zLogScale;
-    float zscale, zoffset;
-
     float fov   = 30.0f * FLT_DEG_TO_RAD_SCALE;
     float znear = 0.1f;
     float zfar  = 1000.0f;
@@ -312,10 +298,20 @@ namespace app
     model_t          models       [MAX_MODELS];
     gfx_geometry_t   meshes       [MAX_MESHES];
     material_t*      materialRefs [MAX_MESHES];
+
+    // Mesh bounds in SOA form for batch frustum culling
+    float            meshMinX     [MAX_MESHES];
+    float            meshMinY     [MAX_MESHES];
+    float            meshMinZ     [MAX_MESHES];
+    float            meshMaxX     [MAX_MESHES];
+    float            meshMaxY     [MAX_MESHES];
+    float            meshMaxZ     [MAX_MESHES];
+
     material_t       materials    [MAX_MATERIALS];
     const char*      materialNames[MAX_MATERIALS];
 
     void loadMesh(const char* name);
+    material_t* lookupMaterial(const char* name);
     material_t* findMaterial(const char* name);
 
     void loadModels()
@@ -323,16 +319,13 @@ namespace app
         numModels = 0;
         numMeshes = 0;
 
-        memory_t        inText = {0, 0, 0};
-        memory_t        bjson  = {0, 0, 0};
-        mjson_element_t root = 0;
+        mjson_file_t doc;
 
-        if (mem_file(&inText, "models/sponza/sponza.models"))
+        if (mjson_file_load(&doc, "models/sponza/sponza.models"))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
+            mjson_element_t root = doc.top;
 
-            assert(result && mjson_get_type(root) == MJSON_ID_ARRAY32);
+            assert(mjson_get_type(root) == MJSON_ID_ARRAY32);
 
             mjson_element_t matList, mat;
 
@@ -343,7 +336,8 @@ namespace app
             )
             {
                 const char* model = 0;
-                const char* material = 0;
+
+                matList = 0;
 
                 assert(mjson_get_type(modelDesc) == MJSON_ID_DICT32);
 
@@ -372,16 +366,16 @@ namespace app
                 loadMesh(model);
                 end = numMeshes;
 
-                mat = mjson_get_element_first(matList);
-                for (int i = start; i<end; ++i)
+                // Materials stored in model are overridden by scene
+                mat = matList ? mjson_get_element_first(matList) : 0;
+                for (int i = start; i<end && mat; ++i)
                 {
                     materialRefs[i] = findMaterial(mjson_get_string(mat, ""));
                     mat = mjson_get_element_next(matList, mat);
                 }
             }
 
-            mem_free(&inText);
-            mem_free(&bjson);
+            mjson_file_free(&doc);
         }
     }
 
@@ -399,16 +393,13 @@ namespace app
     {
         numMaterials = 0;
 
-        memory_t        inText = {0, 0, 0};
-        memory_t        bjson  = {0, 0, 0};
-        mjson_element_t root = 0;
+        mjson_file_t doc;
 
-        if (mem_file(&inText, "models/sponza/sponza.mtllib"))
+        if (mjson_file_load(&doc, "models/sponza/sponza.mtllib"))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
+            mjson_element_t root = doc.top;
 
-            assert(result && mjson_get_type(root) == MJSON_ID_DICT32);
+            assert(mjson_get_type(root) == MJSON_ID_DICT32);
 
             mjson_element_t material, dict, key, value;
 
@@ -533,8 +524,7 @@ namespace app
 
             assert(matOffset<=matBufferSize);
 
-            mem_free(&inText);
-            mem_free(&bjson);
+            mjson_file_free(&doc);
         }
     }
 
@@ -607,17 +597,23 @@ namespace app
             vi_store_v3(&col, vi_mul(hueToRGB(randomUnitFloat()), vi_set_all(randomRange(0.4f, 0.7f))));
             const float ind =  rad / 8.0f;
             ml::vec3 pos = { randomRange(scene_min.x + ind, scene_max.x - ind), randomRange(scene_min.y + ind, scene_max.y - ind), randomRange(scene_min.z + ind, scene_max.z - ind) };
-            light_t l = { pos, rad, col };
-            lights[numLights++] = l;
+            lightPosX [numLights] = pos.x;
+            lightPosY [numLights] = pos.y;
+            lightPosZ [numLights] = pos.z;
+            lightRange[numLights] = rad;
+            lightColor[numLights] = col;
+            ++numLights;
         }
         //numLights = 0;
         //for (size_t i=0; i<=20; ++i)
         //{
-        //    lights[numLights].pos = ml::make_vec3(-100.0f+ i*10, 20.0f, 0.0f);;
-        //    lights[numLights].range = 50;
+        //    lightPosX [numLights] = -100.0f+ i*10;
+        //    lightPosY [numLights] = 20.0f;
+        //    lightPosZ [numLights] = 0.0f;
+        //    lightRange[numLights] = 50;
         //    ml::vec3 col;
         //    vi_store_v3(&col, vi_mul(hueToRGB(randomUnitFloat()), vi_set_ffff(randomRange(0.4f, 0.7f))));
-        //    lights[numLights].color = col;
+        //    lightColor[numLights] = col;
         //    ++numLights;
         //}
     }
@@ -647,12 +643,39 @@ namespace app
         glBindVertexBuffer(0, staticBuffer, 0, sizeof(vf::static_geom_t));
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, staticBuffer);
 
+        uint32_t* visibleMeshes    = core::frame_alloc<uint32_t>(numMeshes);
+        uint32_t* stackMeshes      = 0;
+        size_t    numVisibleMeshes = 0;
+
+        // Frame allocator is exhausted, use thread stack for this frame
+        if (!visibleMeshes)
+        {
+            stackMeshes   = (uint32_t*)core::thread_stack_alloc(numMeshes * sizeof(uint32_t), _alignof(uint32_t));
+            visibleMeshes = stackMeshes;
+        }
+
+        {
+            PROFILER_CPU_TIMESLICE("cullMeshes");
+
+            ml::mat4x4 frustum = {gfx::autoVars.matMVP[0], gfx::autoVars.matMVP[1], gfx::autoVars.matMVP[2], gfx::autoVars.matMVP[3]};
+
+            ml::frustum_planes planes;
+            ml::extractFrustumPlanes(&planes, &frustum);
+
+            numVisibleMeshes = ml::cullAABBs(
+                visibleMeshes, &planes, numMeshes,
+                meshMinX, meshMinY, meshMinZ,
+                meshMaxX, meshMaxY, meshMaxZ
+            );
+        }
+
         GLuint      currentPrg = 0;
         material_t* currentMat = 0;
 
-        for (size_t i=0; i<numMeshes; ++i)
+        for (size_t j=0; j<numVisibleMeshes; ++j)
         {
             PROFILER_CPU_TIMESLICE("drawMesh");
+            size_t      i   = visibleMeshes[j];
             material_t* mat = materialRefs[i];
             if (currentMat!=mat)
             {
@@ -681,87 +704,121 @@ namespace app
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
         glDisable(GL_CULL_FACE);
+
+        if (stackMeshes)
+        {
+            core::thread_stack_reset(stackMeshes);
+        }
     }
 
     material_t* findMaterial(const char* name)
+    {
+        material_t* mat = lookupMaterial(name);
+        assert(mat);
+        return mat;
+    }
+
+    material_t* lookupMaterial(const char* name)
     {
         for (size_t i=0; i<numMaterials; ++i)
         {
             if (strcmp(name, materialNames[i])==0)
                 return &materials[i];
         }
-        assert(0);
         return 0;
     }
 
     void loadMesh(const char* name)
     {
-        memory_t  data = {0, 0, 0};
+        model_file_t file;
+
+        if (!modelFileOpen(&file, name)) return;
+
+        uint32_t numSubmeshes, numFileMaterials, numVertices, numIndices;
+
+        const model_file_mesh_t*          submeshes     = modelFileArray<model_file_mesh_t>         (&file, MODEL_CHUNK_MESHES,          &numSubmeshes);
+        const model_file_material_t*      fileMaterials = modelFileArray<model_file_material_t>     (&file, MODEL_CHUNK_MATERIALS,       &numFileMaterials);
+        const model_file_static_vertex_t* fvertices     = modelFileArray<model_file_static_vertex_t>(&file, MODEL_CHUNK_STATIC_VERTICES, &numVertices);
+        const uint32_t*                   findices      = modelFileArray<uint32_t>                  (&file, MODEL_CHUNK_INDICES32,       &numIndices);
+
+        bool validated = submeshes && fileMaterials && fvertices && findices &&
+                         numModels < MAX_MODELS && numMeshes + numSubmeshes <= MAX_MESHES;
 
+        for (uint32_t i = 0; validated && i < numSubmeshes; ++i)
+        {
+            validated = (uint64_t)submeshes[i].firstVertex + submeshes[i].numVertices <= numVertices &&
+                        (uint64_t)submeshes[i].firstIndex  + submeshes[i].numIndices  <= numIndices  &&
+                        submeshes[i].material < numFileMaterials;
+        }
 
-        if (mem_file(&data, name))
+        if (!validated)
         {
-            mesh_header_v0*    header = mem_as_ptr_advance<mesh_header_v0>(data.buffer, data.allocated);
-            vf::static_geom_t* fvertices = mem_as_array_advance<vf::static_geom_t>(data.buffer, header->numVertices, data.allocated);
-            uint32_t*          findices = mem_as_array_advance<uint32_t>(data.buffer, header->numIndices, data.allocated);
+            modelFileClose(&file);
+            return;
+        }
 
-            if (!numModels)
-            {
-                scene_min.x = header->minx;
-                scene_min.y = header->miny;
-                scene_min.z = header->minz;
-                scene_max.x = header->maxx;
-                scene_max.y = header->maxy;
-                scene_max.z = header->maxz;
-            }
-            else
-            {
-                scene_min.x = core::min(scene_min.x, header->minx);
-                scene_min.y = core::min(scene_min.y, header->miny);
-                scene_min.z = core::min(scene_min.z, header->minz);
-                scene_max.x = core::max(scene_max.x, header->maxx);
-                scene_max.y = core::max(scene_max.y, header->maxy);
-                scene_max.z = core::max(scene_max.z, header->maxz);
-            }
+        GLuint totalSize;
 
-            GLuint verticesSize = sizeof(vf::static_geom_t) * header->numVertices;
-            GLuint indicesSize  = sizeof(uint32_t) * header->numIndices;
+        uint32_t vertexOffset;
+        uint32_t indexOffset;
 
-            GLuint totalSize;
+        gfx_alloc_geom(
+            &staticAlloc,
+            sizeof(vf::static_geom_t), numVertices,
+            sizeof(uint32_t), numIndices,
+            &vertexOffset, &indexOffset, &totalSize
+        );
 
-            uint32_t vertexOffset;
-            uint32_t indexOffset;
+        assert(vertexOffset % sizeof(vf::static_geom_t) == 0);
+        assert(indexOffset % sizeof(uint32_t) == 0);
 
-            gfx_alloc_geom(
-                &staticAlloc,
-                sizeof(vf::static_geom_t), header->numVertices,
-                sizeof(uint32_t), header->numIndices,
-                &vertexOffset, &indexOffset, &totalSize
-            );
+        uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
+        mem_copy(ptr, fvertices, sizeof(vf::static_geom_t) * numVertices);
+        mem_copy(ptr+(indexOffset-vertexOffset), findices, sizeof(uint32_t) * numIndices);
+        glUnmapNamedBuffer(staticBuffer);
 
-            assert(vertexOffset % sizeof(vf::static_geom_t) == 0);
-            assert(indexOffset % sizeof(uint32_t) == 0);
+        models[numModels].numSubmeshes = numSubmeshes;
 
-            uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-            mem_copy(ptr, fvertices, verticesSize);
-            mem_copy(ptr+(indexOffset-vertexOffset),  findices,  indicesSize);
-            glUnmapNamedBuffer(staticBuffer);
+        for (uint32_t i = 0; i < numSubmeshes; ++i)
+        {
+            const model_file_mesh_t& submesh = submeshes[i];
 
-            models[numModels].numSubmeshes = header->numSubsets;
+            // Indices are relative to first vertex of submesh
+            meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t) + submesh.firstVertex;
+            meshes[numMeshes].idxFormat   = GL_UNSIGNED_INT;
+            meshes[numMeshes].idxOffset   = indexOffset + submesh.firstIndex*sizeof(uint32_t);
+            meshes[numMeshes].numIndices  = submesh.numIndices;
 
-            for (size_t i = 0; i < header->numSubsets; ++i)
-            {
-                meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t);
-                meshes[numMeshes].idxFormat   = GL_UNSIGNED_INT;
-                meshes[numMeshes].idxOffset   = indexOffset + header->meshSubsets[i*2]*sizeof(uint32_t);
-                meshes[numMeshes].numIndices  = header->meshSubsets[i*2+1];
+            meshMinX[numMeshes] = submesh.boundsMin.x;
+            meshMinY[numMeshes] = submesh.boundsMin.y;
+            meshMinZ[numMeshes] = submesh.boundsMin.z;
+            meshMaxX[numMeshes] = submesh.boundsMax.x;
+            meshMaxY[numMeshes] = submesh.boundsMax.y;
+            meshMaxZ[numMeshes] = submesh.boundsMax.z;
 
-                ++numMeshes;
+            material_t* mat = lookupMaterial(fileMaterials[submesh.material].name);
+            materialRefs[numMeshes] = mat ? mat : &materials[0];
+
+            if (!numModels && !i)
+            {
+                scene_min = submesh.boundsMin;
+                scene_max = submesh.boundsMax;
+            }
+            else
+            {
+                scene_min.x = core::min(scene_min.x, submesh.boundsMin.x);
+                scene_min.y = core::min(scene_min.y, submesh.boundsMin.y);
+                scene_min.z = core::min(scene_min.z, submesh.boundsMin.z);
+                scene_max.x = core::max(scene_max.x, submesh.boundsMax.x);
+                scene_max.y = core::max(scene_max.y, submesh.boundsMax.y);
+                scene_max.z = core::max(scene_max.z, submesh.boundsMax.z);
             }
 
-            ++numModels;
-            mem_free(&data);
+            ++numMeshes;
         }
+
+        ++numModels;
+        modelFileClose(&file);
     }
 
     void convertOBJ()
@@ -772,78 +829,17 @@ namespace app
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
 
-        std::string res = tinyobj::LoadObj(shapes, materials, filename, mtl_basepath);
-
-        for (size_t i = 0; i < shapes.size(); ++i)
+        // Geometry goes to single container with submesh per material, tinyobj is used for material library only
+        model_file_t model;
+        if (modelFileConvertOBJ(&model, filename, scale))
         {
-            tinyobj::shape_t& s=shapes[i];
-
-            FILE* f = fopen(("D:\\projects\\graphics\\Infinity\\AppData\\models\\sponza\\"+s.name+".mesh").c_str(), "wb");
-            assert(f);
-
-            assert(s.mesh.positions.size() > 0);
-            assert(s.mesh.normals.size()   > 0);
-            assert(s.mesh.texcoords.size() > 0);
-
-            size_t nv = s.mesh.positions.size()/3;
-            size_t ni = s.mesh.indices.size();
-
-            float* p  = &s.mesh.positions[0];
-            float* n  = &s.mesh.normals[0];
-            float* uv = &s.mesh.texcoords[0];
-
-            float minx, miny, minz;
-            float maxx, maxy, maxz;
-
-            minx = maxx = s.mesh.positions[0];
-            miny = maxy = s.mesh.positions[1];
-            minz = maxz = s.mesh.positions[2];
-
-            for (size_t v = 0; v < nv; ++v)
-            {
-                minx = core::min(minx, p[v*3+0]);
-                miny = core::min(miny, p[v*3+1]);
-                minz = core::min(minz, p[v*3+2]);
-
-                maxx = core::max(maxx, p[v*3+0]);
-                maxy = core::max(maxy, p[v*3+1]);
-                maxz = core::max(maxz, p[v*3+2]);
-            }
-
-            mesh_header_v0 h = {MESH_FILE_MAGIC, 0, nv, ni, minx*scale, miny*scale, minz*scale, maxx*scale, maxy*scale, maxz*scale, s.submeshes.size()};
-
-            for (size_t i = 0; i < h.numSubsets; ++i)
-            {
-                h.meshSubsets[i*2  ] = s.submeshes[i].first;
-                h.meshSubsets[i*2+1] = s.submeshes[i].second;
-                assert(s.submeshes[i].second%3==0);
-                assert(s.submeshes[i].first+s.submeshes[i].second<=ni);
-            }
-
-            assert(s.mesh.positions.size()==s.mesh.normals.size());
-            assert(s.mesh.positions.size()/3==s.mesh.texcoords.size()/2);
-
-            fwrite(&h, sizeof(h), 1, f);
-            for (size_t v = 0; v < nv; ++v)
-            {
-                float vp3[3] = {p[v*3]*scale, p[v*3+1]*scale, p[v*3+2]*scale};
-                float uv2[2] = {uv[v*2], 1.0f-uv[v*2+1]};
-                fwrite(vp3, sizeof(float), 3, f);
-                fwrite(n  + v*3, sizeof(float), 3, f);
-                fwrite(uv2, sizeof(float), 2, f);
-            }
-
-            for (size_t idx = 0; idx < ni; ++idx)
-            {
-                assert(s.mesh.indices[idx]<nv);
-            }
-
-            assert(ni%3==0);
-
-            fwrite(&s.mesh.indices[0], sizeof(uint32_t), ni, f);
-            fclose(f);
+            bool saved = modelFileSave(&model, "D:\\projects\\graphics\\Infinity\\AppData\\models\\sponza\\sponza.mdl");
+            assert(saved);
+            modelFileClose(&model);
         }
 
+        std::string res = tinyobj::LoadObj(shapes, materials, filename, mtl_basepath);
+
         FILE* f = fopen("D:\\projects\\graphics\\Infinity\\AppData\\models\\sponza\\sponza.mtllib", "w");
         fprintf(f, "{\n");
 
@@ -883,319 +879,51 @@ namespace app
 
         f = fopen("D:\\projects\\graphics\\Infinity\\AppData\\models\\sponza\\sponza.models", "w");
         fprintf(f, "[\n");
-        for (size_t i = 0; i < shapes.size(); ++i)
-        {
-            tinyobj::shape_t& s=shapes[i];
-            fprintf(f, "    {\n");
-            fprintf(f, "        model    = \"models/sponza/%s.mesh\"\n", s.name.c_str());
-            fprintf(f, "        materials = [\n");
-            for (size_t j=0; j<s.submeshes.size(); ++j)
-            {
-                const char* name = "";
-                if (s.materials[j]!=-1)
-                {
-                    name = materials[s.materials[j]].name.c_str();
-                }
-                fprintf(f, "            \"%s\"\n", name);
-            }
-            fprintf(f, "        ]\n");
-            fprintf(f, "    }\n");
-        }
+        fprintf(f, "    {\n");
+        fprintf(f, "        model = \"models/sponza/sponza.mdl\"\n");
+        fprintf(f, "    }\n");
         fprintf(f, "]\n");
         fclose(f);
     }
 
-    struct ScreenRect3D
-    {
-        int minx, miny, minz;
-        int maxx, maxy, maxz;
-        uint16_t index;
-    };
-
-    float calcClusterZ(float viewSpaceZ)
-    {
-        float gridLocZ = logf(viewSpaceZ * zscale + zoffset) * zLogScale;
-
-        return gridLocZ;
-    }
-
-    //--------------------------------------------------------------------------------------
-    // Bounds computation utilities, similar to PointLightBounds.cpp
-    void updateClipRegionRoot(float nc,          // Tangent plane x/y normal coordinate (view space)
-        float lc,          // Light x/y coordinate (view space)
-        float lz,          // Light z coordinate (view space)
-        float lightRadius,
-        float cameraScale, // Project scale for coordinate (_11 or _22 for x/y respectively)
-        float &clipMin,
-        float &clipMax)
-    {
-        float nz = (lightRadius - nc * lc) / lz;
-        float pz = (lc * lc + lz * lz - lightRadius * lightRadius) / (lz - (nz / nc) * lc);
-
-        if (pz < 0.0f) 
-        {
-            float c = -nz * cameraScale / nc;
-            if (nc < 0.0f) 
-            {        
-                // Left side boundary
-                clipMin = core::max(clipMin, c);
-            } 
-            else 
-            {                          // Right side boundary
-				clipMax = core::min(clipMax, c);
-            }
-        }
-    }
-
-    void updateClipRegion(float lc,          // Light x/y coordinate (view space)
-        float lz,          // Light z coordinate (view space)
-        float lightRadius,
-        float cameraScale, // Project scale for coordinate (_11 or _22 for x/y respectively)
-        float &clipMin,
-        float &clipMax)
-    {
-        float rSq = lightRadius * lightRadius;
-        float lcSqPluslzSq = lc * lc + lz * lz;
-        float d = rSq * lc * lc - lcSqPluslzSq * (rSq - lz * lz);
-
-        if (d >= 0.0f) 
-        {
-            float a = lightRadius * lc;
-            float b = sqrt(d);
-            float nx0 = (a + b) / lcSqPluslzSq;
-            float nx1 = (a - b) / lcSqPluslzSq;
-
-            updateClipRegionRoot(nx0, lc, lz, lightRadius, cameraScale, clipMin, clipMax);
-            updateClipRegionRoot(nx1, lc, lz, lightRadius, cameraScale, clipMin, clipMax);
-        }
-    }
-
-    // Returns bounding box [min.xy, max.xy] in clip [-1, 1] space.
-    void computeClipRegion(
-        const ml::vec3& lightPosView, float lightRadius, float cameraNear, v128 proj[4],
-        float& minx, float& miny, float& maxx, float& maxy
-    )
-    {
-        minx = 1.0f; miny = 1.0f; maxx = -1.0f; maxy = -1.0f;
-        // Early out with empty rectangle if the light is too far behind the view frustum
-        if (lightPosView.z - lightRadius <= -cameraNear) 
-        {
-            minx = -1.0f; miny = -1.0f; maxx = 1.0f; maxy = 1.0f;
-
-            updateClipRegion(lightPosView.x, lightPosView.z, lightRadius, proj[0].m128_f32[0], minx, maxx);
-            updateClipRegion(lightPosView.y, lightPosView.z, lightRadius, proj[1].m128_f32[1], miny, maxy);
-        }
-    }
-
-    void findScreenSpaceBounds(
-        v128 proj[4], const ml::vec3& pt, float rad,
-        int width, int height, float near,
-        int& minx, int& miny, int& maxx, int& maxy
-    )
-    {
-        float fminx=1.0f, fminy=1.0f, fmaxx=-1.0f, fmaxy=-1.0f;
-        computeClipRegion(pt, rad, near, proj, fminx, fminy, fmaxx, fmaxy);
-
-        fminx = -fminx;
-        fminy = -fminy;
-        fmaxx = -fmaxx;
-        fmaxy = -fmaxy;
-
-        core::swap(fminx, fmaxx);
-        core::swap(fminy, fmaxy);
-
-        fminx = 0.5f * fminx + 0.5f;
-        fminy = 0.5f * fminy + 0.5f;
-        fmaxx = 0.5f * fmaxx + 0.5f;
-        fmaxy = 0.5f * fmaxy + 0.5f;
-
-        minx = int(fminx * float(width));
-        miny = int(fminy * float(height));
-        maxx = int(fmaxx * float(width));
-        maxy = int(fmaxy * float(height));
-
-        minx = core::max(0, core::min(width,  minx));
-        miny = core::max(0, core::min(height, miny));
-        maxx = core::max(0, core::min(width,  maxx));
-        maxy = core::max(0, core::min(height, maxy));
-    }
-
-    static void buildRects3D(v128 matMV[4], v128 matP[4], uint32_t maxRects, uint32_t& numRects, ScreenRect3D* rects)
-    {
-        PROFILER_CPU_TIMESLICE("BuildRects");
-
-        assert(numViewLights<(1<<16));
-
-        numRects = 0;
-        for (uint16_t i = 0; i < numViewLights; ++i)
-        {
-            const light_t &l = lightsView[i];
-            int minx=0, miny=0, maxx=0, maxy=0;
-            findScreenSpaceBounds(matP, l.pos, l.range, gfx::width, gfx::height, znear, minx, miny, maxx, maxy);
-
-            if (minx < maxx && miny < maxy)
-            {
-                ScreenRect3D& r3 = rects[numRects++];
-
-                r3.index = i;
-                
-                r3.minx = minx / LIGHT_GRID_TILE_DIM_X;
-                r3.miny = miny / LIGHT_GRID_TILE_DIM_Y;
-                r3.minz = uint32_t(core::max(0.0f, calcClusterZ(l.pos.z + l.range)));;
-
-                r3.maxx = (maxx + LIGHT_GRID_TILE_DIM_X - 1) / LIGHT_GRID_TILE_DIM_X;
-                r3.maxy = (maxy + LIGHT_GRID_TILE_DIM_Y - 1) / LIGHT_GRID_TILE_DIM_Y;
-                r3.maxz = uint32_t(core::max(0.0f, ceilf(calcClusterZ(l.pos.z - l.range)) + 0.5f));
-            }
-        }
-        assert(numRects<=maxRects);
-    }
-
-#define BACKWARD_STORE_LIGHT_INDICES
-
     static void assignLightsToClustersCpu(v128 modelView[4], v128 proj[4])
     {
-        PROFILER_CPU_TIMESLICE("LightGridBuild");
-
-        numViewLights = 0;
-        for (size_t i=0; i < numLights; ++i)
-        {
-            light_t& l = lightsView[i];
-
-            l = lights[i];
-
-            v128 vlp = ml::mul_mat4_vec4(modelView, vi_set(l.pos.x, l.pos.y, l.pos.z, 1.0f));
-            vi_store_v3(&l.pos, vlp);
-            ++numViewLights;
-        }
-
-        lightOffset = 0;
-        lightSize   = sizeof(light_t)* core::max(4U, numViewLights);
-
-        light_t* data = (light_t*)gfx::dynbufAllocMem(lightSize, gfx::caps.tboAlignment, &lightOffset);
-        memcpy(data, lightsView, numViewLights*sizeof(light_t));
-        glTextureBufferRange(texLightData, GL_RGBA32F, gfx::dynBuffer, lightOffset, lightSize);
-
-        assert(lightSize % (sizeof(float)*8) == 0);
-
-        gridDimX = (gfx::width  + LIGHT_GRID_TILE_DIM_X - 1) / LIGHT_GRID_TILE_DIM_X;
-        gridDimY = (gfx::height + LIGHT_GRID_TILE_DIM_Y - 1) / LIGHT_GRID_TILE_DIM_Y;
-        gridDimZ = 64;//32;//128;
-
-        numClusters = gridDimX * gridDimY * gridDimZ;
-
-        float b = 4.0f;
-        float q = 1.03805f;//1.116;//1.0098;
-        zLogScale = 1.0f / logf(q);
-        zscale  = -(q-1)/b;
-        zoffset = 1.0f;
+        light_grid_desc_t desc = {
+            (uint32_t)gfx::width, (uint32_t)gfx::height,
+            LIGHT_GRID_TILE_DIM_X, LIGHT_GRID_TILE_DIM_Y,
+            64,                 // depth slices
+            1.03805f, 4.0f      // slice depth ratio, first slice depth
+        };
+        light_soa_t soa = { lightPosX, lightPosY, lightPosZ, lightRange, (uint32_t)numLights };
 
-        uint32_t numRects;
-        ScreenRect3D* rects = mem::alloc_array<ScreenRect3D>(appArena, MAX_LIGHTS);
-        int32_t* offsets = mem::alloc_array<int32_t>(appArena, numClusters);
-        int32_t* counts  = mem::alloc_array<int32_t>(appArena, numClusters);
+        const light_grid_t* grid = lightGridBuild(lightGridBuilder, desc, modelView, proj, soa);
 
-        buildRects3D(modelView, proj, MAX_LIGHTS, numRects, rects);
+        {
+            PROFILER_CPU_TIMESLICE("copyGridFromHost");
 
-        memset(counts, 0,  sizeof(int32_t)*numClusters);
-        memset(offsets, 0, sizeof(int32_t)*numClusters);
+            lightOffset = 0;
+            lightSize   = sizeof(light_t) * core::max<size_t>(4, numLights);
 
-        int32_t totalus = 0;
-        {  
-            PROFILER_CPU_TIMESLICE("Pass1");
-            for (size_t i = 0; i < numRects; ++i)
+            light_t* lightData = (light_t*)gfx::dynbufAllocMem(lightSize, gfx::caps.tboAlignment, &lightOffset);
+            for (size_t i = 0; i < numLights; ++i)
             {
-                ScreenRect3D r = rects[i];
-
-                uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
-                uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
-                uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
-
-                uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
-                uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
-                uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
+                light_t& l = lightData[i];
 
-                for (uint32_t z = lz; z < uz; ++z)
-                {
-                    for (uint32_t y = ly; y < uy; ++y)
-                    {
-                        for (uint32_t x = lx; x < ux; ++x)
-                        {
-                            uint32_t idx = (z * gridDimY + y) * gridDimX + x;
-                            ++counts[idx];
-                            ++totalus;
-                        }
-                    }
-                }
+                l.pos   = ml::make_vec3(grid->viewX[i], grid->viewY[i], grid->viewZ[i]);
+                l.range = lightRange[i];
+                l.color = lightColor[i];
+                l.pad   = 0;
             }
-        }
+            glTextureBufferRange(texLightData, GL_RGBA32F, gfx::dynBuffer, lightOffset, lightSize);
 
-        uint32_t offset = 0;
-        {  
-            PROFILER_CPU_TIMESLICE("BuildOffsets");
-            for (int32_t idx = 0; idx < numClusters; ++idx)
-            {
-#ifdef BACKWARD_STORE_LIGHT_INDICES
-                offset += counts[idx];
-                offsets[idx] = offset;
-#else
-                offsets[idx] = offset;
-                offset += counts[idx];
-#endif
-            }
-        }
-
-#ifndef BACKWARD_STORE_LIGHT_INDICES
-        memset(counts, 0,  sizeof(uint32_t)*numClusters);
-#endif
-
-        {
-            PROFILER_CPU_TIMESLICE("Pass2");
+            assert(lightSize % (sizeof(float)*8) == 0);
 
             lightListOffset = 0;
-            lightListSize   = core::max(4, totalus) * sizeof(uint16_t);
-
-            int16_t* data = (int16_t*)gfx::dynbufAllocMem(lightListSize, gfx::caps.tboAlignment, &lightListOffset);
-
-            for (size_t i = 0; i < numRects; ++i)
-            {
-                ScreenRect3D r = rects[i];
+            lightListSize   = core::max(4U, grid->lightListSize) * sizeof(uint16_t);
 
-                uint32_t lx = core::max(0, core::min<int>(gridDimX, r.minx));
-                uint32_t ly = core::max(0, core::min<int>(gridDimY, r.miny));
-                uint32_t lz = core::max(0, core::min<int>(gridDimZ, r.minz));
-
-                uint32_t ux = core::max(0, core::min<int>(gridDimX, r.maxx));
-                uint32_t uy = core::max(0, core::min<int>(gridDimY, r.maxy));
-                uint32_t uz = core::max(0, core::min<int>(gridDimZ, r.maxz));
-
-                assert(r.index<numViewLights);
-
-                for (uint32_t z = lz; z < uz; ++z)
-                {
-                    for (uint32_t y = ly; y < uy; ++y)
-                    {
-                        for (uint32_t x = lx; x < ux; ++x)
-                        {
-                            uint32_t idx = (z * gridDimY + y) * gridDimX + x;
-
-#ifdef BACKWARD_STORE_LIGHT_INDICES
-                            int32_t offset = --offsets[idx];
-#else
-                            int32_t count = counts[idx];
-                            ++counts[idx];
-                            int32_t offset = offsets[idx] + count;
-#endif
-
-                            data[offset] = r.index;
-                        }
-                    }
-                }
-            }
+            uint16_t* lightListData = (uint16_t*)gfx::dynbufAllocMem(lightListSize, gfx::caps.tboAlignment, &lightListOffset);
+            memcpy(lightListData, grid->lightList, grid->lightListSize * sizeof(uint16_t));
             glTextureBufferRange(texLightListData, GL_R16I, gfx::dynBuffer, lightListOffset, lightListSize);
-        }
-        {
-            PROFILER_CPU_TIMESLICE("copyGridFromHost");
 
             clusterListOffset = 0;
             clusterListSize   = sizeof(gpu_clustered_lighting_t);
@@ -1205,30 +933,27 @@ namespace app
             data->uAmbientGlobal = { 0.02f, 0.02f, 0.02f };
             data->uGridTileX = LIGHT_GRID_TILE_DIM_X;
             data->uGridTileY = LIGHT_GRID_TILE_DIM_Y;
-            data->uGridDimX  = gridDimX;
-            data->uGridDimY  = gridDimY;
-            data->uZScale    = zscale;
-            data->uZOffset   = zoffset;
-            data->uLogScale  = zLogScale;
+            data->uGridDimX  = grid->dimX;
+            data->uGridDimY  = grid->dimY;
+            data->uZScale    = grid->zScale;
+            data->uZOffset   = grid->zOffset;
+            data->uLogScale  = grid->zLogScale;
 #ifdef DEBUG_SHADER
-            data->uDebugMaxClusters  = numClusters;
-            data->uDebugMaxLightList = totalus;
-            data->uDebugMaxLights    = numViewLights;
+            data->uDebugMaxClusters  = grid->numClusters;
+            data->uDebugMaxLightList = grid->lightListSize;
+            data->uDebugMaxLights    = numLights;
 #endif
 
-            uint32_t clusterDataSize   = 2*sizeof(uint32_t)*numClusters;
+            uint32_t clusterDataSize   = 2*sizeof(uint32_t)*grid->numClusters;
             uint32_t clusterDataOffset = 0;
             int32_t* clusterData = (int32_t*)gfx::dynbufAllocMem(clusterDataSize, gfx::caps.tboAlignment, &clusterDataOffset);
-            for (int32_t i = 0; i < numClusters; ++i)
+            for (uint32_t i = 0; i < grid->numClusters; ++i)
             {
-                clusterData[2*i]   = offsets[i];
-                clusterData[2*i+1] = counts [i];
-                assert(offsets[i]+counts [i]<=totalus);
+                clusterData[2*i]   = grid->offsets[i];
+                clusterData[2*i+1] = grid->counts [i];
+                assert(grid->offsets[i]+grid->counts[i]<=(int32_t)grid->lightListSize);
             }
             glTextureBufferRange(texClusterData, GL_RG32I, gfx::dynBuffer, clusterDataOffset, clusterDataSize);
         }
-        mem::free(appArena, offsets);
-        mem::free(appArena, counts);
-        mem::free(appArena, rects);
     }
 }
@@ -1,5 +1,6 @@
 #include <fwk/fwk.h>
 #include <datafmt/md5.h>
+#include <datafmt/model_file.h>
 #include <Remotery.h>
 #include "imgui.h"
 #include "imguiRenderNVG.h"
@@ -38,22 +39,6 @@ struct ssz_mesh_header_t
     uint32_t  indexOffset;
 };
 
-struct mesh_header_v0
-{
-    uint32_t magic;
-    uint32_t version;
-    uint32_t numVertices;
-    uint32_t numIndices;
-
-    float minx, miny, minz;
-    float maxx, maxy, maxz;
-
-    uint32_t numSubsets;
-    uint32_t meshSubsets[16*2];
-};
-
-#define MESH_FILE_MAGIC 'HSEM'
-
 struct material_t
 {
     GLuint  program;
@@ -136,9 +121,10 @@ namespace app
     material_t      materials    [MAX_MATERIALS];
     const char*     materialNames[MAX_MATERIALS];
 
-    bool loadMesh(blob32_t dataBlob);
+    bool loadMesh(const char* path);
     bool loadMeshSSZ(blob32_t dataBlob);
     bool loadModelMD5(blob32_t dataBlob);
+    material_t* lookupMaterial(const char* name);
     material_t* findMaterial(const char* name);
 
 
@@ -454,10 +440,13 @@ namespace app
         int start, end;
         start = numMeshes;
 
-        bool loaded = false;
-        blob32_t data = read_file_to_blob32(appArena, path, 0);
-        loaded = data && (loadModelMD5(data) || loadMesh(data) || loadMeshSSZ(data));
-        mem_free(appArena, data);
+        bool loaded = loadMesh(path);
+        if (!loaded)
+        {
+            blob32_t data = read_file_to_blob32(appArena, path, 0);
+            loaded = data && (loadModelMD5(data) || loadMeshSSZ(data));
+            mem_free(appArena, data);
+        }
 
         end = numMeshes;
 
@@ -596,16 +585,13 @@ namespace app
         numModels = 0;
         numMeshes = 0;
 
-        memory_t        inText = {0, 0, 0};
-        memory_t        bjson  = {0, 0, 0};
-        mjson_element_t root = 0;
+        mjson_file_t doc;
 
-        if (mem_file(&inText, "models/sponza/sponza.models"))
+        if (mjson_file_load(&doc, "models/sponza/sponza.models"))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
+            mjson_element_t root = doc.top;
 
-            assert(result && mjson_get_type(root) == MJSON_ID_ARRAY32);
+            assert(mjson_get_type(root) == MJSON_ID_ARRAY32);
 
             mjson_element_t modelDesc, key, value;
             mjson_element_t matList, mat;
@@ -614,7 +600,8 @@ namespace app
             while (modelDesc)
             {
                 const char* model = 0;
-                const char* material = 0;
+
+                matList = 0;
 
                 assert(mjson_get_type(modelDesc) == MJSON_ID_DICT32);
 
@@ -638,13 +625,12 @@ namespace app
                 int start, end;
 
                 start = numMeshes;
-                blob32_t data = read_file_to_blob32(appArena, model, 0);
-                loadMesh(data);
-                mem_free(appArena, data);
+                loadMesh(model);
                 end = numMeshes;
 
-                mat = mjson_get_element_first(matList);
-                for (int i = start; i<end; ++i)
+                // Materials stored in model are overridden by scene
+                mat = matList ? mjson_get_element_first(matList) : 0;
+                for (int i = start; i<end && mat; ++i)
                 {
                     materialRefs[i] = findMaterial(mjson_get_string(mat, ""));
                     mat = mjson_get_element_next(matList, mat);
@@ -653,8 +639,7 @@ namespace app
                 modelDesc = mjson_get_element_next(root, modelDesc);
             }
 
-            mem_free(&inText);
-            mem_free(&bjson);
+            mjson_file_free(&doc);
         }
     }
 
@@ -672,16 +657,13 @@ namespace app
     {
         numMaterials = 0;
 
-        memory_t        inText = {0, 0, 0};
-        memory_t        bjson  = {0, 0, 0};
-        mjson_element_t root = 0;
+        mjson_file_t doc;
 
-        if (mem_file(&inText, "models/sponza/sponza.mtllib"))
+        if (mjson_file_load(&doc, "models/sponza/sponza.mtllib"))
         {
-            mem_area(&bjson, 100*1024);
-            int result = mjson_parse((const char*)inText.buffer, inText.size, bjson.buffer, bjson.size, &root);
+            mjson_element_t root = doc.top;
 
-            assert(result && mjson_get_type(root) == MJSON_ID_DICT32);
+            assert(mjson_get_type(root) == MJSON_ID_DICT32);
 
             mjson_element_t material, dict, key, value;
 
@@ -806,8 +788,7 @@ namespace app
 
             assert(matOffset<=matBufferSize);
 
-            mem_free(&inText);
-            mem_free(&bjson);
+            mjson_file_free(&doc);
         }
     }
 
@@ -949,13 +930,19 @@ namespace app
     }
 
     material_t* findMaterial(const char* name)
+    {
+        material_t* mat = lookupMaterial(name);
+        assert(mat);
+        return mat;
+    }
+
+    material_t* lookupMaterial(const char* name)
     {
         for (size_t i=0; i<numMaterials; ++i)
         {
             if (strcmp(name, materialNames[i])==0)
                 return &materials[i];
         }
-        assert(0);
         return 0;
     }
 
@@ -1109,67 +1096,39 @@ namespace app
         return true;
     }
 
-    bool  loadMesh(blob32_t dataBlob)
+    bool  loadMesh(const char* path)
     {
-        if (!dataBlob)
-        {
-            return false;
-        }
+        model_file_t file;
 
-        size_t size = dataBlob->size;
-        if (size < sizeof(mesh_header_v0))
+        if (!modelFileOpen(&file, path))
         {
-            //Not enough data
             return false;
         }
 
-        uint8_t* data = blob32_data(dataBlob);
-        size_t read_offset = 0;
-        mesh_header_v0* header = mem_as_ptr_advance<mesh_header_v0>(data, read_offset);
+        uint32_t numSubmeshes, numFileMaterials, numVertices, numIndices;
 
-        if (header->magic != MESH_FILE_MAGIC || header->version != 0)
-        {
-            return false;
-        }
-
-        GLuint verticesSize = sizeof(vf::static_geom_t) * header->numVertices;
-        GLuint indicesSize = sizeof(uint32_t) * header->numIndices;
+        const model_file_mesh_t*          submeshes     = modelFileArray<model_file_mesh_t>         (&file, MODEL_CHUNK_MESHES,          &numSubmeshes);
+        const model_file_material_t*      fileMaterials = modelFileArray<model_file_material_t>     (&file, MODEL_CHUNK_MATERIALS,       &numFileMaterials);
+        const model_file_static_vertex_t* fvertices     = modelFileArray<model_file_static_vertex_t>(&file, MODEL_CHUNK_STATIC_VERTICES, &numVertices);
+        const uint32_t*                   findices      = modelFileArray<uint32_t>                  (&file, MODEL_CHUNK_INDICES32,       &numIndices);
 
-        bool validated = size == sizeof(mesh_header_v0) + indicesSize + verticesSize;
+        bool validated = submeshes && fileMaterials && fvertices && findices &&
+                         numModels < MAX_MODELS && numMeshes + numSubmeshes <= MAX_MESHES;
 
-        for (size_t i = 0, count = header->numSubsets; i < count; ++i)
+        for (uint32_t i = 0; validated && i < numSubmeshes; ++i)
         {
-            validated &= header->meshSubsets[2 * i] + header->meshSubsets[2 * i + 1] <= header->numIndices;
+            validated = (uint64_t)submeshes[i].firstVertex + submeshes[i].numVertices <= numVertices &&
+                        (uint64_t)submeshes[i].firstIndex  + submeshes[i].numIndices  <= numIndices  &&
+                        submeshes[i].material < numFileMaterials;
         }
 
         if (!validated)
         {
             //failed validation
+            modelFileClose(&file);
             return false;
         }
 
-        vf::static_geom_t* fvertices = mem_as_array_advance<vf::static_geom_t>(data, header->numVertices, read_offset);
-        uint32_t*          findices = mem_as_array_advance<uint32_t>(data, header->numIndices, read_offset);
-
-        if (!numModels)
-        {
-            scene_min.x = header->minx;
-            scene_min.y = header->miny;
-            scene_min.z = header->minz;
-            scene_max.x = header->maxx;
-            scene_max.y = header->maxy;
-            scene_max.z = header->maxz;
-        }
-        else
-        {
-            scene_min.x = core::min(scene_min.x, header->minx);
-            scene_min.y = core::min(scene_min.y, header->miny);
-            scene_min.z = core::min(scene_min.z, header->minz);
-            scene_max.x = core::max(scene_max.x, header->maxx);
-            scene_max.y = core::max(scene_max.y, header->maxy);
-            scene_max.z = core::max(scene_max.z, header->maxz);
-        }
-
         GLuint totalSize;
 
         uint32_t vertexOffset;
@@ -1177,8 +1136,8 @@ namespace app
 
         gfx_alloc_geom(
             &staticAlloc,
-            sizeof(vf::static_geom_t), header->numVertices,
-            sizeof(uint32_t), header->numIndices,
+            sizeof(vf::static_geom_t), numVertices,
+            sizeof(uint32_t), numIndices,
             &vertexOffset, &indexOffset, &totalSize
         );
 
@@ -1186,26 +1145,44 @@ namespace app
         assert(indexOffset % sizeof(uint32_t) == 0);
 
         uint8_t* ptr = (uint8_t*)glMapNamedBufferRange(staticBuffer, vertexOffset, totalSize, GL_MAP_WRITE_BIT);
-        mem_copy(ptr, fvertices, verticesSize);
-        mem_copy(ptr + (indexOffset - vertexOffset), findices, indicesSize);
+        mem_copy(ptr, fvertices, sizeof(vf::static_geom_t) * numVertices);
+        mem_copy(ptr + (indexOffset - vertexOffset), findices, sizeof(uint32_t) * numIndices);
         glUnmapNamedBuffer(staticBuffer);
 
-        models[numModels].numSubmeshes = header->numSubsets;
+        models[numModels].numSubmeshes = numSubmeshes;
 
-        for (size_t i = 0; i < header->numSubsets; ++i)
+        for (uint32_t i = 0; i < numSubmeshes; ++i)
         {
+            const model_file_mesh_t& submesh = submeshes[i];
+
             meshes[numMeshes].vao = vf::static_geom_t::vao;
             meshes[numMeshes].stride = sizeof(vf::static_geom_t);
 
-            meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t);
+            // Indices are relative to first vertex of submesh
+            meshes[numMeshes].firstVertex = vertexOffset / sizeof(vf::static_geom_t) + submesh.firstVertex;
             meshes[numMeshes].idxFormat = GL_UNSIGNED_INT;
-            meshes[numMeshes].idxOffset = indexOffset + header->meshSubsets[i * 2] * sizeof(uint32_t);
-            meshes[numMeshes].numIndices = header->meshSubsets[i * 2 + 1];
+            meshes[numMeshes].idxOffset = indexOffset + submesh.firstIndex * sizeof(uint32_t);
+            meshes[numMeshes].numIndices = submesh.numIndices;
+
+            material_t* mat = lookupMaterial(fileMaterials[submesh.material].name);
+            materialRefs[numMeshes] = mat ? mat : &materials[0];
+
+            if (!numModels && !i)
+            {
+                scene_min = submesh.boundsMin;
+                scene_max = submesh.boundsMax;
+            }
+            else
+            {
+                scene_min = ml::min(scene_min, submesh.boundsMin);
+                scene_max = ml::max(scene_max, submesh.boundsMax);
+            }
 
             ++numMeshes;
         }
 
         ++numModels;
+        modelFileClose(&file);
 
         return true;
     }
@@ -1,5 +1,7 @@
 #include "CDLODTerrain.h"
 
+#include <stdlib.h>
+
 struct PatchData
 {
     float baseX, baseZ;
@@ -7,6 +9,41 @@ struct PatchData
     float padding;
 };
 
+// Patches selected by one worker, every root chunk occupies contiguous range
+struct CORE_ALIGN(CORE_CACHE_LINE_SIZE) PatchList
+{
+    PatchData* data;
+    size_t     size;
+    size_t     capacity;
+};
+
+struct SelectionRoot
+{
+    float    bx, bz;
+    float    dist2;   //squared distance from chunk center to view point, sort key
+    uint32_t flags;
+    size_t   list;    //index of worker list and range of patches selected for chunk
+    size_t   offset;
+    size_t   count;
+};
+
+enum
+{
+    NODE_INSIDE    = 1, //node is entirely inside frustum, children skip frustum test
+    NODE_SUBDIVIDE = 2, //node is in range of its LOD and will be split into children
+};
+
+struct SelectionNode
+{
+    float    bx, bz;
+    float    size;
+    uint32_t level;
+    uint32_t flags;
+};
+
+#define SELECT_STACK_SIZE (4*CDLODTerrain::MAX_LOD_COUNT)
+#define ROOT_GRAIN_SIZE   4
+
 struct TerrainData
 {
     v128 uAABB;
@@ -93,6 +130,17 @@ void CDLODTerrain::initialize()
 
     ubufView = gfx::createUBODesc(prgTerrain, "uniView");
 
+    selectLists = (PatchList*)_aligned_malloc(sizeof(PatchList)*MAX_SELECT_WORKERS, _alignof(PatchList));
+    memset(selectLists, 0, sizeof(PatchList)*MAX_SELECT_WORKERS);
+
+    roots            = 0;
+    visibleRoots     = 0;
+    rootCount        = 0;
+    visibleRootCount = 0;
+
+    selectedPatchCount = 0;
+    droppedPatchCount  = 0;
+
     gfx::gpu_timer_init(&gpuTimer);
 }
 
@@ -112,6 +160,14 @@ void CDLODTerrain::cleanup()
     glDeleteTextures(1, &mipTexture);
 
     gfx::destroyUBODesc(ubufView);
+
+    for (size_t i=0; i<MAX_SELECT_WORKERS; ++i)
+    {
+        _aligned_free(selectLists[i].data);
+    }
+    _aligned_free(selectLists);
+    free(visibleRoots);
+    free(roots);
 }
 
 void CDLODTerrain::setSelectMatrix(v128 m[4])
@@ -121,67 +177,240 @@ void CDLODTerrain::setSelectMatrix(v128 m[4])
     selectionMVP.r1 = m[2];
     selectionMVP.r2 = m[1];
     selectionMVP.r3 = m[3];
+
+    ml::extractFrustumPlanes(&selectionPlanes, &selectionMVP);
 }
 
-inline bool patchIntersectsCircle(v128 vmin, v128 vmax, v128 vcenter, float radius)
+// Classifies 4 quads of the same size and level at once: culls them against frustum,
+// checks whether quad is in LOD range and computes distance to view point for sorting.
+// Returns mask of visible quads.
+static uint32_t classifyQuads4(const CDLODTerrain* terrain, const float bx[4], const float bz[4],
+                               float size, size_t level, uint32_t validMask, bool inside,
+                               uint32_t flags[4], float dist2[4])
 {
-    v128  vdist;
-    float d2;
+    v128 vbx   = vi_loadu_v4(bx);
+    v128 vbz   = vi_loadu_v4(bz);
+    v128 vsize = vi_set_all(size);
+    v128 vmaxX = vi_min(vi_add(vbx, vsize), vi_set_all(terrain->maxX));
+    v128 vmaxZ = vi_min(vi_add(vbz, vsize), vi_set_all(terrain->maxZ));
+
+    uint32_t visibleMask = validMask;
+    uint32_t insideMask  = inside ? 0xF : 0x0;
+
+    if (!inside)
+    {
+        int result[4];
+
+        ml::intersectionTestSOA4(
+            result, &terrain->selectionPlanes,
+            vbx,   vbz,   vi_set_all(terrain->minY),
+            vmaxX, vmaxZ, vi_set_all(terrain->maxY)
+        );
+
+        for (uint32_t i=0; i<4; ++i)
+        {
+            if (result[i]==ml::IT_OUTSIDE) visibleMask &= ~(1<<i);
+            if (result[i]==ml::IT_INSIDE)  insideMask  |=  (1<<i);
+        }
+    }
 
-    vdist = ml::distanceToAABB(vmin, vmax, vcenter);
-    d2 = vi_dot2(vdist, vdist);
+    v128 px = vi_set_all(terrain->viewPoint.x);
+    v128 pz = vi_set_all(terrain->viewPoint.z);
 
-    return d2<=radius*radius;
+    uint32_t subdivideMask = 0;
+    if (level!=terrain->maxLevel)
+    {
+        //Squared distance from view point to quad in XZ plane
+        v128 dx = vi_max(vi_max(vi_sub(vbx, px), vi_sub(px, vmaxX)), vi_set_zero());
+        v128 dz = vi_max(vi_max(vi_sub(vbz, pz), vi_sub(pz, vmaxZ)), vi_set_zero());
+        v128 d2 = vi_mad(dx, dx, vi_mul(dz, dz));
+
+        float range = terrain->LODRange[level];
+        subdivideMask = vi_mask(vi_cmp_le(d2, vi_set_all(range*range)));
+    }
+
+    v128 half = vi_set_all(0.5f);
+    v128 cx   = vi_sub(vi_mul(vi_add(vbx, vmaxX), half), px);
+    v128 cz   = vi_sub(vi_mul(vi_add(vbz, vmaxZ), half), pz);
+    vi_storeu_v4(dist2, vi_mad(cx, cx, vi_mul(cz, cz)));
+
+    for (uint32_t i=0; i<4; ++i)
+    {
+        flags[i] = ((insideMask   >>i)&1) ? NODE_INSIDE    : 0;
+        flags[i]|= ((subdivideMask>>i)&1) ? NODE_SUBDIVIDE : 0;
+    }
+
+    return visibleMask;
 }
 
-void CDLODTerrain::selectQuadsForDrawing(size_t level, float bx, float bz, float patchSize, bool skipFrustumTest)
+static void appendPatch(PatchList* list, float bx, float bz, uint32_t level)
 {
-    if (bx>=maxX || bz>=maxZ) return;
+    if (list->size==list->capacity)
+    {
+        size_t     capacity = core::max<size_t>(list->capacity*2, CDLODTerrain::MAX_PATCH_COUNT);
+        PatchData* data     = (PatchData*)_aligned_malloc(sizeof(PatchData)*capacity, _alignof(PatchData));
 
-    if (patchCount>=MAX_PATCH_COUNT) return;
+        memcpy(data, list->data, sizeof(PatchData)*list->size);
+        _aligned_free(list->data);
 
-    ml::aabb AABB;
+        list->data     = data;
+        list->capacity = capacity;
+    }
 
-    v128 vp = vi_set(viewPoint.x, viewPoint.z, 0.0f, 0.0f);
+    PatchData& patch = list->data[list->size++];
 
-    float sizeX = core::min(patchSize, maxX-bx);
-    float sizeZ = core::min(patchSize, maxZ-bz);
+    patch.baseX   = bx;
+    patch.baseZ   = bz;
+    patch.level   = level;
+    patch.padding = 0.0f;
+}
 
-    float minX = bx;
-    float minZ = bz;
-    float maxX = minX+sizeX;
-    float maxZ = minZ+sizeZ;
+// Iterative depth first traversal, children are visited front to back
+static void selectQuads(const CDLODTerrain* terrain, PatchList* list, const SelectionNode& root)
+{
+    SelectionNode stack[SELECT_STACK_SIZE];
+    size_t        top = 0;
 
-    AABB.min = vi_set(minX, minZ, minY, 1.0f);
-    AABB.max = vi_set(maxX, maxZ, maxY, 1.0f);
+    stack[top++] = root;
 
-    if (!skipFrustumTest)
+    while (top)
     {
-        //Check whether AABB intersects frustum
-        int result = ml::intersectionTest(&AABB, &selectionMVP);
+        SelectionNode node = stack[--top];
+
+        if (!(node.flags&NODE_SUBDIVIDE))
+        {
+            appendPatch(list, node.bx, node.bz, node.level);
+            continue;
+        }
+
+        float    size  = node.size*0.5f;
+        uint32_t level = node.level-1;
+
+        float bx[4] = {node.bx, node.bx+size, node.bx,      node.bx+size};
+        float bz[4] = {node.bz, node.bz,      node.bz+size, node.bz+size};
+
+        uint32_t validMask = 0;
+        for (uint32_t i=0; i<4; ++i)
+        {
+            validMask |= (bx[i]<terrain->maxX && bz[i]<terrain->maxZ) ? (1<<i) : 0;
+        }
+
+        uint32_t flags[4];
+        float    dist2[4];
+        uint32_t visibleMask = classifyQuads4(terrain, bx, bz, size, level, validMask, (node.flags&NODE_INSIDE)!=0, flags, dist2);
+
+        //Sort children by distance, farthest is pushed first and popped last
+        uint32_t order[4] = {0, 1, 2, 3};
+        for (uint32_t i=1; i<4; ++i)
+        {
+            uint32_t idx = order[i];
+            uint32_t j   = i;
+            for (; j>0 && dist2[order[j-1]]<dist2[idx]; --j)
+            {
+                order[j] = order[j-1];
+            }
+            order[j] = idx;
+        }
+
+        for (uint32_t i=0; i<4; ++i)
+        {
+            uint32_t idx = order[i];
+            if (!(visibleMask&(1<<idx))) continue;
 
-        if (result==ml::IT_OUTSIDE) return;
-        skipFrustumTest = result==ml::IT_INSIDE;
+            assert(top<SELECT_STACK_SIZE);
+            SelectionNode& child = stack[top++];
+
+            child.bx    = bx[idx];
+            child.bz    = bz[idx];
+            child.size  = size;
+            child.level = level;
+            child.flags = flags[idx];
+        }
+    }
+}
+
+static void selectRootsJob(uint32_t begin, uint32_t end, void* arg)
+{
+    CDLODTerrain* terrain = (CDLODTerrain*)arg;
+
+    size_t     worker = mt::workerIndex();
+    PatchList* list   = &terrain->selectLists[worker];
+
+    assert(worker<CDLODTerrain::MAX_SELECT_WORKERS);
+
+    for (uint32_t i=begin; i<end; ++i)
+    {
+        SelectionRoot& root = terrain->visibleRoots[i];
+
+        root.list   = worker;
+        root.offset = list->size;
+
+        SelectionNode node = {root.bx, root.bz, terrain->chunkSize, (uint32_t)terrain->LODCount-1, root.flags};
+        selectQuads(terrain, list, node);
+
+        root.count = list->size-root.offset;
     }
+}
 
-    if (level==maxLevel || !patchIntersectsCircle(AABB.min, AABB.max, vp, LODRange[level]))
+static int compareRootDistance(const void* a, const void* b)
+{
+    float da = ((const SelectionRoot*)a)->dist2;
+    float db = ((const SelectionRoot*)b)->dist2;
+
+    return (da>db)-(da<db);
+}
+
+void CDLODTerrain::selectQuadsForDrawing()
+{
     {
-        instData->baseX = bx;
-        instData->baseZ = bz;
-        instData->level = level;
+        PROFILER_CPU_TIMESLICE("CullRoots");
+
+        size_t level = LODCount-1;
+
+        visibleRootCount = 0;
+        for (size_t i=0; i<rootCount; i+=4)
+        {
+            size_t count = core::min<size_t>(4, rootCount-i);
+
+            float bx[4], bz[4];
+            for (size_t j=0; j<4; ++j)
+            {
+                const SelectionRoot& root = roots[i+core::min(j, count-1)];
+                bx[j] = root.bx;
+                bz[j] = root.bz;
+            }
+
+            uint32_t flags[4];
+            float    dist2[4];
+            uint32_t visibleMask = classifyQuads4(this, bx, bz, chunkSize, level, (1<<count)-1, false, flags, dist2);
+
+            for (size_t j=0; j<count; ++j)
+            {
+                if (!(visibleMask&(1<<j))) continue;
+
+                SelectionRoot& root = visibleRoots[visibleRootCount++];
+
+                root.bx    = bx[j];
+                root.bz    = bz[j];
+                root.dist2 = dist2[j];
+                root.flags = flags[j];
+            }
+        }
+
+        qsort(visibleRoots, visibleRootCount, sizeof(SelectionRoot), compareRootDistance);
+    }
 
-        ++instData;
-        ++patchCount;
+    for (size_t i=0; i<MAX_SELECT_WORKERS; ++i)
+    {
+        selectLists[i].size = 0;
     }
-    else
+
+    mt::jobWait(mt::parallelFor(selectRootsJob, this, visibleRootCount, ROOT_GRAIN_SIZE));
+
+    selectedPatchCount = 0;
+    for (size_t i=0; i<visibleRootCount; ++i)
     {
-        //TODO: add front to back sorting to minimize overdraw(optimization)
-        size_t levelNext = level-1;
-        float  offset    = patchSize/2;
-        selectQuadsForDrawing(levelNext, bx,        bz,        offset, skipFrustumTest);
-        selectQuadsForDrawing(levelNext, bx+offset, bz,        offset, skipFrustumTest);
-        selectQuadsForDrawing(levelNext, bx,        bz+offset, offset, skipFrustumTest);
-        selectQuadsForDrawing(levelNext, bx+offset, bz+offset, offset, skipFrustumTest);
+        selectedPatchCount += visibleRoots[i].count;
     }
 }
 
@@ -247,8 +476,6 @@ void CDLODTerrain::drawTerrain()
 
     GLuint baseInstance;
 
-    instData = gfx::frameAllocVertices<PatchData>(MAX_PATCH_COUNT, &baseInstance);
-
     vertDistToTerrain = core::max(viewPoint.y-maxY, minY-viewPoint.y);
     vertDistToTerrain = core::max(vertDistToTerrain, 0.0f);
 
@@ -260,14 +487,30 @@ void CDLODTerrain::drawTerrain()
     {
         PROFILER_CPU_TIMESLICE("Select");
         cpu_timer_start(&cpuSelectTimer);
-        patchCount = 0;
-        size_t level = LODCount-1;
-        for (float bz=minZ; bz<maxZ; bz+=chunkSize)
-            for (float bx=minX; bx<maxX; bx+=chunkSize)
-                selectQuadsForDrawing(level, bx, bz, chunkSize);
+        selectQuadsForDrawing();
         cpu_timer_stop(&cpuSelectTimer);
     }
 
+    {
+        PROFILER_CPU_TIMESLICE("CopyPatches");
+
+        //Patches are sorted front to back, so only the farthest are dropped on overflow
+        patchCount        = core::min<size_t>(selectedPatchCount, MAX_PATCH_COUNT);
+        droppedPatchCount = selectedPatchCount-patchCount;
+
+        instData = gfx::frameAllocVertices<PatchData>(patchCount, &baseInstance);
+
+        size_t copied = 0;
+        for (size_t i=0; i<visibleRootCount && copied<patchCount; ++i)
+        {
+            const SelectionRoot& root = visibleRoots[i];
+
+            size_t count = core::min(root.count, patchCount-copied);
+            memcpy(instData+copied, selectLists[root.list].data+root.offset, sizeof(PatchData)*count);
+            copied += count;
+        }
+    }
+
     cpu_timer_start(&cpuRenderTimer);
     gfx::gpu_timer_start(&gpuTimer);
 
@@ -343,6 +586,30 @@ void CDLODTerrain::setHeightmap(uint16_t* data, size_t width, size_t height)
     maxX = minX+(width-1)*cellSize;
     maxZ = minZ+(height-1)*cellSize;
 
+    rootCount = 0;
+    for (float bz=minZ; bz<maxZ; bz+=chunkSize)
+        for (float bx=minX; bx<maxX; bx+=chunkSize)
+            ++rootCount;
+
+    roots        = (SelectionRoot*)realloc(roots,        sizeof(SelectionRoot)*rootCount);
+    visibleRoots = (SelectionRoot*)realloc(visibleRoots, sizeof(SelectionRoot)*rootCount);
+
+    SelectionRoot* root = roots;
+    for (float bz=minZ; bz<maxZ; bz+=chunkSize)
+    {
+        for (float bx=minX; bx<maxX; bx+=chunkSize)
+        {
+            root->bx     = bx;
+            root->bz     = bz;
+            root->dist2  = 0.0f;
+            root->flags  = 0;
+            root->list   = 0;
+            root->offset = 0;
+            root->count  = 0;
+            ++root;
+        }
+    }
+
     heightScale = 65535.0f/732.0f;
     minY        = -39.938129f;//0.0f;
     maxY        =  133.064011f;//heightScale;
@@ -4,12 +4,15 @@
 #include <gfx/gfx.h>
 
 struct PatchData;
+struct PatchList;
+struct SelectionRoot;
 
 class CDLODTerrain
 {
 public:
     static const size_t MAX_LOD_COUNT = 8;
     static const size_t MAX_PATCH_COUNT = 4096;
+    static const size_t MAX_SELECT_WORKERS = 64;
 
     size_t patchDim;
     size_t LODCount;
@@ -20,7 +23,8 @@ public:
 
     float LODRange  [MAX_LOD_COUNT];
 
-    ml::mat4x4 selectionMVP; //matrix has changed column order (x, z, y, w) in order to simplify simd calculations
+    ml::mat4x4         selectionMVP; //matrix has changed column order (x, z, y, w) in order to simplify simd calculations
+    ml::frustum_planes selectionPlanes;
     ml::vec3   viewPoint;
     float      vertDistToTerrain;
     size_t     maxLevel;
@@ -28,6 +32,15 @@ public:
     PatchData* instData;
     size_t     patchCount;
     size_t     maxPatchCount;
+    size_t     selectedPatchCount;
+    size_t     droppedPatchCount; //selected patches not fitting into MAX_PATCH_COUNT, farthest ones are dropped
+
+    PatchList*     selectLists;  //per worker lists of selected patches
+    SelectionRoot* roots;        //all root chunks
+    SelectionRoot* visibleRoots; //root chunks passed frustum test, sorted front to back
+    size_t         rootCount;
+    size_t         visibleRootCount;
+
     GLsizei    idxCount;
 
     GLuint prgTerrain;
@@ -41,7 +54,7 @@ public:
     void generateGeometry(size_t vertexCount);
     void setHeightmap(uint16_t* data, size_t width, size_t height);
 
-    void selectQuadsForDrawing(size_t level, float bx, float bz, float patchSize, bool skipFrustumTest=false);
+    void selectQuadsForDrawing();
 
     void initialize();
     void cleanup();
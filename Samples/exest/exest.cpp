@@ -270,6 +270,12 @@ namespace app
         int vtx = patches*terrain.patchDim*terrain.patchDim;
         _snprintf(str, 256, "Patches: %d, Vtx: %d", patches, vtx);
         vg::drawString(vg::defaultFont, 25.0f, 119.0f, 0xFFFFFFFF, str, strlen(str));
+
+        if (terrain.droppedPatchCount)
+        {
+            _snprintf(str, 256, "Patch buffer overflow: %d patches dropped", (int)terrain.droppedPatchCount);
+            vg::drawString(vg::defaultFont, 25.0f, 137.0f, 0xFF0000FF, str, strlen(str));
+        }
     }
 
     void update(float dt)
@@ -71,63 +71,16 @@ void rcMeshLoaderObj::addTriangle(int a, int b, int c, int& cap)
 	m_triCount++;
 }
 
-static char* parseRow(char* buf, char* bufEnd, char* row, int len)
-{
-	bool cont = false;
-	bool start = true;
-	bool done = false;
-	int n = 0;
-	while (!done && buf < bufEnd)
-	{
-		char c = *buf;
-		buf++;
-		// multirow
-		switch (c)
-		{
-			case '\\':
-				cont = true; // multirow
-				break;
-			case '\n':
-				if (start) break;
-				done = true;
-				break;
-			case '\r':
-				break;
-			case '\t':
-			case ' ':
-				if (start) break;
-			default:
-				start = false;
-				cont = false;
-				row[n++] = c;
-				if (n >= len-1)
-					done = true;
-				break;
-		}
-	}
-	row[n] = '\0';
-	return buf;
-}
-
-static int parseFace(char* row, int* data, int n, int vcnt)
+static int parseFace(str_view_t row, int* data, int n, int vcnt)
 {
+    str_view_t vertex;
     int j = 0;
-    while (*row != '\0')
+    // Vertex is "v", "v/vt", "v//vn" or "v/vt/vn", only position index is used
+    while (str_next_token(&row, &vertex))
     {
-        // Skip initial white space
-        while (*row != '\0' && (*row == ' ' || *row == '\t'))
-            row++;
-        char* s = row;
-        // Find vertex delimiter and terminated the string there for conversion.
-        while (*row != '\0' && *row != ' ' && *row != '\t')
-        {
-            if (*row == '/') *row = '\0';
-            row++;
-        }
-        if (*s == '\0')
-            continue;
         intmax_t res;
-        cstr_toimax(s, 128, 0, 0, &res);
+        if (cstr_toimax(vertex.str, vertex.size, 10, 0, &res) != EOK)
+            continue;
         int vi = (int)res;
         data[j++] = vi < 0 ? vi + vcnt : vi - 1;
         if (j >= n) return j;
@@ -137,38 +90,40 @@ static int parseFace(char* row, int* data, int n, int vcnt)
 
 bool rcMeshLoaderObj::load(const char* filename)
 {
-    memory_t    mem = {0, 0, 0};
-    mem_file(&mem, filename);
+    text_reader_t reader;
 
-    if (!mem.buffer)
+    if (!text_reader_open(&reader, filename))
         return false;
 
-    char* src = (char*)mem.buffer;
-    char* srcEnd = (char*)mem.buffer + mem.size;
-	char row[512];
+	str_view_t row;
 	int face[32];
-	float x,y,z;
+	float pos[3];
 	int nv;
 	int vcap = 0;
 	int tcap = 0;
 	
-	while (src < srcEnd)
+	while (text_reader_line(&reader, &row))
 	{
-		// Parse one row
-		row[0] = '\0';
-		src = parseRow(src, srcEnd, row, sizeof(row)/sizeof(char));
+		// Skip leading white space
+		while (row.size && (row.str[0] == ' ' || row.str[0] == '\t'))
+		{
+			++row.str;
+			--row.size;
+		}
+		if (row.size < 2) continue;
 		// Skip comments
-		if (row[0] == '#') continue;
-		if (row[0] == 'v' && row[1] != 'n' && row[1] != 't')
+		if (row.str[0] == '#') continue;
+		if (row.str[0] == 'v' && (row.str[1] == ' ' || row.str[1] == '\t'))
 		{
 			// Vertex pos
-			cstr_scanf(row+1, 512-1, "%f %f %f", &x, &y, &z);
-			addVertex(x, y, z, vcap);
+			if (cstr_tofloats(row.str+1, row.size-1, 0, pos, 3) == 3)
+				addVertex(pos[0], pos[1], pos[2], vcap);
 		}
-		if (row[0] == 'f')
+		if (row.str[0] == 'f' && (row.str[1] == ' ' || row.str[1] == '\t'))
 		{
 			// Faces
-			nv = parseFace(row+1, face, 32, m_vertCount);
+			str_view_t indices = { row.str+1, row.size-1 };
+			nv = parseFace(indices, face, 32, m_vertCount);
 			for (int i = 2; i < nv; ++i)
 			{
 				const int a = face[0];
@@ -181,6 +136,8 @@ bool rcMeshLoaderObj::load(const char* filename)
 		}
 	}
 
+    text_reader_close(&reader);
+
 	// Calculate normals.
 	m_normals = new float[m_triCount*3];
 	for (int i = 0; i < m_triCount*3; i += 3)
@@ -210,8 +167,6 @@ bool rcMeshLoaderObj::load(const char* filename)
 	
 	cstr_copy(m_filename, filename);
 	m_filename[sizeof(m_filename)-1] = '\0';
-	
-    mem_free(&mem);
 
 	return true;
 }
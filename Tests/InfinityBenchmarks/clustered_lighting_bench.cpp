@@ -0,0 +1,171 @@
+#include <math.h>
+#include <stdio.h>
+#include <fwk/clustered_lighting.h>
+
+enum bench_private
+{
+    BENCH_WIDTH       = 1920,
+    BENCH_HEIGHT      = 1080,
+    BENCH_TILE_DIM    = 64,
+    BENCH_DIM_Z       = 64,
+    BENCH_ITERATIONS  = 100,
+    BENCH_MAX_LIGHTS  = 20000,
+    VALIDATION_LIGHTS = 1000,
+};
+
+static float lightX[BENCH_MAX_LIGHTS];
+static float lightY[BENCH_MAX_LIGHTS];
+static float lightZ[BENCH_MAX_LIGHTS];
+static float lightRange[BENCH_MAX_LIGHTS];
+
+static uint32_t randomState = 0x12345678;
+
+static float randomRange(float minValue, float maxValue)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return minValue + (maxValue - minValue) * float(randomState & 0xFFFFFF) / float(0xFFFFFF);
+}
+
+// Lights fill a box in front of the camera(looking along -z), radius is chosen
+// so that lights roughly tile the volume like in Demo
+static light_soa_t generateLights(uint32_t count)
+{
+    const float extent = 200.0f;
+    const float radius = powf(extent * extent * extent / float(count), 1.0f / 3.0f);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        lightX[i]     = randomRange(-extent * 0.5f, extent * 0.5f);
+        lightY[i]     = randomRange(-extent * 0.5f, extent * 0.5f);
+        lightZ[i]     = randomRange(-extent, 0.0f);
+        lightRange[i] = randomRange(0.7f * radius, radius);
+    }
+
+    light_soa_t lights = {lightX, lightY, lightZ, lightRange, count};
+
+    return lights;
+}
+
+static light_grid_desc_t benchGridDesc()
+{
+    light_grid_desc_t desc = {BENCH_WIDTH, BENCH_HEIGHT, BENCH_TILE_DIM, BENCH_TILE_DIM, BENCH_DIM_Z, 1.03805f, 4.0f};
+
+    return desc;
+}
+
+// Brute force reference: every light against every cluster
+static bool validate(const light_grid_t* grid, const light_grid_desc_t& desc, v128 proj[4], const light_soa_t& lights)
+{
+    CORE_ALIGN(16) float p[16];
+    for (int i = 0; i < 4; ++i) vi_store_v4(p + 4 * i, proj[i]);
+
+    uint32_t* expected = (uint32_t*)malloc(sizeof(uint32_t) * grid->numClusters);
+    memset(expected, 0, sizeof(uint32_t) * grid->numClusters);
+
+    float distScale = desc.sliceScale / (desc.sliceBase - 1.0f);
+    bool  passed    = true;
+
+    for (uint32_t l = 0; l < lights.count; ++l)
+    {
+        // Identity model view, view space equals world space
+        float cx = lights.x[l], cy = lights.y[l], dist = -lights.z[l], r = lights.range[l];
+
+        for (uint32_t z = 0; z < grid->dimZ; ++z)
+        {
+            float dn = (powf(desc.sliceBase, float(z    )) - 1.0f) * distScale;
+            float df = (powf(desc.sliceBase, float(z + 1)) - 1.0f) * distScale;
+            float dz = core::max(0.0f, core::max(dn - dist, dist - df));
+
+            for (uint32_t y = 0; y < grid->dimY; ++y)
+            {
+                float sB = (2.0f * float( y      * desc.tileDimY) / float(desc.height) - 1.0f + p[9]) / p[5];
+                float sT = (2.0f * float((y + 1) * desc.tileDimY) / float(desc.height) - 1.0f + p[9]) / p[5];
+                float dy = core::max(0.0f, core::max(core::min(sB * dn, sB * df) - cy, cy - core::max(sT * dn, sT * df)));
+
+                for (uint32_t x = 0; x < grid->dimX; ++x)
+                {
+                    float sL = (2.0f * float( x      * desc.tileDimX) / float(desc.width) - 1.0f + p[8]) / p[0];
+                    float sR = (2.0f * float((x + 1) * desc.tileDimX) / float(desc.width) - 1.0f + p[8]) / p[0];
+                    float dx = core::max(0.0f, core::max(core::min(sL * dn, sL * df) - cx, cx - core::max(sR * dn, sR * df)));
+
+                    if (dx * dx + dy * dy + dz * dz > r * r) continue;
+
+                    uint32_t cluster = (z * grid->dimY + y) * grid->dimX + x;
+                    ++expected[cluster];
+
+                    bool found = false;
+                    for (int32_t i = 0; i < grid->counts[cluster] && !found; ++i)
+                    {
+                        found = grid->lightList[grid->offsets[cluster] + i] == l;
+                    }
+                    passed &= found;
+                }
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < grid->numClusters; ++c)
+    {
+        passed &= (int32_t)expected[c] == grid->counts[c];
+    }
+
+    free(expected);
+
+    return passed;
+}
+
+static void benchmark(light_grid_builder_t builder, uint32_t numLights)
+{
+    v128 modelView[4], proj[4];
+    ml::make_identity_mat4(modelView);
+    ml::make_perspective_mat4(proj, 60.0f * FLT_DEG_TO_RAD_SCALE, float(BENCH_WIDTH) / float(BENCH_HEIGHT), 0.1f, 1000.0f);
+
+    light_grid_desc_t   desc   = benchGridDesc();
+    light_soa_t         lights = generateLights(numLights);
+    const light_grid_t* grid   = 0;
+
+    uint64_t minTime = UINT64_MAX, totalTime = 0;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+    {
+        uint64_t start = timerAbsoluteTime();
+        grid = lightGridBuild(builder, desc, modelView, proj, lights);
+        uint64_t time = timerAbsoluteTime() - start;
+
+        minTime    = core::min(minTime, time);
+        totalTime += time;
+    }
+
+    printf("%6u lights, %ux%ux%u clusters: avg %7.3f ms, min %7.3f ms, %u light indices\n",
+           numLights, grid->dimX, grid->dimY, grid->dimZ,
+           totalTime / 1000.0 / BENCH_ITERATIONS, minTime / 1000.0, grid->lightListSize);
+}
+
+int run_clustered_lighting_bench()
+{
+    printf("Clustered light assignment, %u workers\n", mt::workerCount());
+
+    light_grid_builder_t builder = lightGridCreateBuilder(BENCH_MAX_LIGHTS);
+
+    v128 modelView[4], proj[4];
+    ml::make_identity_mat4(modelView);
+    ml::make_perspective_mat4(proj, 60.0f * FLT_DEG_TO_RAD_SCALE, float(BENCH_WIDTH) / float(BENCH_HEIGHT), 0.1f, 1000.0f);
+
+    light_grid_desc_t   desc   = benchGridDesc();
+    light_soa_t         lights = generateLights(VALIDATION_LIGHTS);
+    const light_grid_t* grid   = lightGridBuild(builder, desc, modelView, proj, lights);
+
+    bool passed = validate(grid, desc, proj, lights);
+    printf("Validation against brute force: %s\n", passed ? "passed" : "FAILED");
+
+    benchmark(builder, 1000);
+    benchmark(builder, 5000);
+    benchmark(builder, 10000);
+    benchmark(builder, 20000);
+
+    lightGridDestroyBuilder(builder);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,26 @@
+#include <core/core.h>
+
+int run_clustered_lighting_bench();
+int run_mjson_bench();
+int run_mem_bench();
+int run_math_bench();
+int run_transform_bench();
+
+extern "C" int assert_handler(const char* cond, const char* file, int line) { return true; }
+
+int main(int argc, char **argv)
+{
+    int res = EXIT_SUCCESS;
+
+    core::init();
+
+    res |= run_clustered_lighting_bench();
+    res |= run_mjson_bench();
+    res |= run_mem_bench();
+    res |= run_math_bench();
+    res |= run_transform_bench();
+
+    core::fini();
+
+    return res;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <core/core.h>
+
+enum bench_private
+{
+    // Arrays stay in L1 to measure computation only
+    BENCH_COUNT   = 4096,
+    BENCH_REPEATS = 256,
+};
+
+typedef void (*bench_func_t)(float* dst, const float* x, const float* y, size_t count);
+
+#define BENCH_UNARY(name, scalar, vector, array)                                        \
+    static void name##Scalar(float* dst, const float* x, const float*, size_t count)    \
+    {                                                                                   \
+        for (size_t i = 0; i < count; ++i) dst[i] = scalar(x[i]);                       \
+    }                                                                                   \
+    static void name##Vector(float* dst, const float* x, const float*, size_t count)    \
+    {                                                                                   \
+        for (size_t i = 0; i < count; i += 4)                                           \
+            vi_store_v4(dst + i, vector(vi_load_v4(x + i)));                            \
+    }                                                                                   \
+    static void name##Array(float* dst, const float* x, const float*, size_t count)     \
+    {                                                                                   \
+        array(dst, x, count);                                                           \
+    }
+
+#define BENCH_BINARY(name, scalar, vector, array)                                       \
+    static void name##Scalar(float* dst, const float* x, const float* y, size_t count)  \
+    {                                                                                   \
+        for (size_t i = 0; i < count; ++i) dst[i] = scalar(x[i], y[i]);                 \
+    }                                                                                   \
+    static void name##Vector(float* dst, const float* x, const float* y, size_t count)  \
+    {                                                                                   \
+        for (size_t i = 0; i < count; i += 4)                                           \
+            vi_store_v4(dst + i, vector(vi_load_v4(x + i), vi_load_v4(y + i)));         \
+    }                                                                                   \
+    static void name##Array(float* dst, const float* x, const float* y, size_t count)   \
+    {                                                                                   \
+        array(dst, x, y, count);                                                        \
+    }
+
+static float invSqrt(float x)
+{
+    return 1.0f / ml::sqrt(x);
+}
+
+BENCH_UNARY (sin,   ml::sin,     ml::sin,   ml::sinArray)
+BENCH_UNARY (exp,   ml::exp,     ml::exp,   ml::expArray)
+BENCH_UNARY (exp2,  ml::exp2,    ml::exp2,  ml::exp2Array)
+BENCH_UNARY (ln,    ml::ln,      ml::ln,    ml::lnArray)
+BENCH_UNARY (lg2,   ml::lg2,     ml::lg2,   ml::lg2Array)
+BENCH_UNARY (rsqrt, invSqrt,     ml::rsqrt, ml::rsqrtArray)
+BENCH_BINARY(pow,   ml::pow,     ml::pow,   ml::powArray)
+BENCH_BINARY(atan2, ml::atan2,   ml::atan2, ml::atan2Array)
+
+// Returns ns per element, best of few runs
+static double measure(bench_func_t func, float* dst, const float* x, const float* y)
+{
+    uint64_t minTime = UINT64_MAX;
+
+    for (int run = 0; run < 3; ++run)
+    {
+        uint64_t start = timerAbsoluteTime();
+        for (size_t i = 0; i < BENCH_REPEATS; ++i)
+        {
+            func(dst, x, y, BENCH_COUNT);
+        }
+        minTime = core::min(minTime, timerAbsoluteTime() - start);
+    }
+
+    return (double)minTime * 1000.0 / (double)(BENCH_COUNT * BENCH_REPEATS);
+}
+
+static void benchmark(const char* name, bench_func_t scalar, bench_func_t vector, bench_func_t array,
+                      float* dst, const float* x, const float* y)
+{
+    double scalarTime = measure(scalar, dst, x, y);
+    double vectorTime = measure(vector, dst, x, y);
+    double arrayTime  = measure(array,  dst, x, y);
+
+    printf("%-8s %8.2f %8.2f %8.2f %8.1fx\n", name, scalarTime, vectorTime, arrayTime, scalarTime / arrayTime);
+}
+
+int run_math_bench()
+{
+    CORE_ALIGN(16) static float x[BENCH_COUNT], y[BENCH_COUNT], dst[BENCH_COUNT];
+
+    for (size_t i = 0; i < BENCH_COUNT; ++i)
+    {
+        x[i] = 0.01f + 100.0f * (float)i / BENCH_COUNT;
+        y[i] = 2.0f  - 4.0f   * (float)i / BENCH_COUNT;
+    }
+
+    bool hasAVX2 = (core::cpu_features() & core::CPU_FEATURE_AVX2) != 0;
+    printf("Transcendental functions, ns per element\n%-8s %8s %8s %8s %9s\n", "", "libm", "v128", hasAVX2 ? "AVX2" : "array", "speedup");
+
+    benchmark("sin",   sinScalar,   sinVector,   sinArray,   dst, x, y);
+    benchmark("exp",   expScalar,   expVector,   expArray,   dst, y, y);
+    benchmark("exp2",  exp2Scalar,  exp2Vector,  exp2Array,  dst, y, y);
+    benchmark("ln",    lnScalar,    lnVector,    lnArray,    dst, x, y);
+    benchmark("lg2",   lg2Scalar,   lg2Vector,   lg2Array,   dst, x, y);
+    benchmark("rsqrt", rsqrtScalar, rsqrtVector, rsqrtArray, dst, x, y);
+    benchmark("pow",   powScalar,   powVector,   powArray,   dst, x, y);
+    benchmark("atan2", atan2Scalar, atan2Vector, atan2Array, dst, y, x);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <core/core.h>
+
+enum bench_private
+{
+    BENCH_MIN_SIZE    = 8,
+    BENCH_MAX_SIZE    = 64 * 1024 * 1024,
+    // Every measurement touches about this much memory, but at least few times
+    BENCH_TOTAL_BYTES = 256 * 1024 * 1024,
+    BENCH_MIN_REPEATS = 4,
+};
+
+typedef void (*bench_func_t)(uint8_t* dst, const uint8_t* src, size_t size);
+
+static void libcSet(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    memset(dst, 0x5A, size);
+}
+
+static void memSet(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    mem_set(dst, size, 0x5A);
+}
+
+static void libcCopy(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    memcpy(dst, src, size);
+}
+
+static void memCopy(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    mem_copy(dst, src, size);
+}
+
+// Returns GB/s, best of few runs
+static double measure(bench_func_t func, uint8_t* dst, const uint8_t* src, size_t size)
+{
+    size_t   repeats = core::max<size_t>(BENCH_TOTAL_BYTES / size, BENCH_MIN_REPEATS);
+    uint64_t minTime = UINT64_MAX;
+
+    for (int run = 0; run < 3; ++run)
+    {
+        uint64_t start = timerAbsoluteTime();
+        for (size_t i = 0; i < repeats; ++i)
+        {
+            func(dst, src, size);
+        }
+        minTime = core::min(minTime, timerAbsoluteTime() - start);
+    }
+
+    return (double)size * repeats / (double)core::max<uint64_t>(minTime, 1) / 1000.0;
+}
+
+static bool benchmark(const char* name, bench_func_t libcFunc, bench_func_t memFunc, uint8_t* dst, uint8_t* ref, const uint8_t* src)
+{
+    bool hasAVX = (core::cpu_features() & core::CPU_FEATURE_AVX) != 0;
+    bool passed = true;
+
+    printf("%s, GB/s\n%10s %8s %8s %8s\n", name, "size", "libc", "SSE2", "AVX");
+
+    for (size_t size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 2)
+    {
+        double libcSpeed = measure(libcFunc, dst, src, size);
+
+        libcFunc(ref, src, size);
+
+        int    prev      = mem_utils_select(MEM_UTILS_SSE2);
+        double sse2Speed = measure(memFunc, dst, src, size);
+        passed &= memcmp(dst, ref, size) == 0;
+
+        double avxSpeed  = 0.0;
+        if (hasAVX)
+        {
+            mem_utils_select(MEM_UTILS_AVX);
+            avxSpeed = measure(memFunc, dst, src, size);
+            passed &= memcmp(dst, ref, size) == 0;
+        }
+
+        mem_utils_select(prev);
+
+        if (size < 1024 * 1024)
+            printf("%8u B ", (uint32_t)size);
+        else
+            printf("%7u MB ", (uint32_t)(size >> 20));
+
+        printf("%8.2f %8.2f %8.2f\n", libcSpeed, sse2Speed, avxSpeed);
+    }
+
+    return passed;
+}
+
+int run_mem_bench()
+{
+    uint8_t* src = (uint8_t*)malloc(BENCH_MAX_SIZE);
+    uint8_t* dst = (uint8_t*)malloc(BENCH_MAX_SIZE);
+    uint8_t* ref = (uint8_t*)malloc(BENCH_MAX_SIZE);
+
+    for (size_t i = 0; i < BENCH_MAX_SIZE; ++i)
+    {
+        src[i] = (uint8_t)(i * 7 + (i >> 10));
+    }
+
+    // Touch pages before timing
+    memset(dst, 0, BENCH_MAX_SIZE);
+    memset(ref, 0, BENCH_MAX_SIZE);
+
+    bool passed = true;
+
+    passed &= benchmark("mem_set",  libcSet,  memSet,  dst, ref, src);
+    passed &= benchmark("mem_copy", libcCopy, memCopy, dst, ref, src);
+
+    printf("same output as libc: %s\n", passed ? "yes" : "NO");
+
+    free(src);
+    free(dst);
+    free(ref);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
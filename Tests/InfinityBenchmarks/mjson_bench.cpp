@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <core/core.h>
+#include <mjson.h>
+
+enum bench_private
+{
+    BENCH_ITERATIONS = 10,
+    BENCH_NUM_KEYS   = 4096,
+    BENCH_LOOKUPS    = 160000,
+};
+
+// Material description like in Demo/Med, pretty printed one has indentation, comments and unquoted keys
+static const char* compactRecord =
+    "{\"name\":\"material_%u\",\"diffuse\":[%u.5,0.25,1e-3],\"flags\":%u,\"double_sided\":true,\"normal_map\":null,"
+    "\"texture\":\"textures/sponza/some/long/directory/name/texture_%u.dds\","
+    "\"comment\":\"escaped \\\"quotes\\\"\\tand \\u00e9 in the middle of a longer string\"}\n";
+
+static const char* prettyRecord =
+    "    {\n"
+    "        name         = \"material_%u\"\n"
+    "        diffuse      = [%u.5, 0.25, 1e-3]\n"
+    "        flags        = %u\n"
+    "        double_sided = true\n"
+    "        normal_map   = null\n"
+    "        // texture path relative to data root\n"
+    "        texture      = \"textures/sponza/some/long/directory/name/texture_%u.dds\"\n"
+    "        comment      = \"escaped \\\"quotes\\\"\\tand \\u00e9 in the middle of a longer string\"\n"
+    "    }\n";
+
+static size_t generateJSON(char* buf, size_t size, const char* record)
+{
+    size_t   len = 0;
+    uint32_t i   = 0;
+
+    len += sprintf(buf, "[\n");
+    while (len + 1024 < size)
+    {
+        len += sprintf(buf + len, record, i, i, i, i);
+        ++i;
+    }
+    len += sprintf(buf + len, "]\n");
+
+    return len;
+}
+
+static double parseTime(const char* text, size_t size, void* storage, size_t storageSize, bool simd)
+{
+    int prevSIMD = mjson_enable_simd(simd);
+
+    uint64_t minTime = UINT64_MAX;
+    for (int i = 0; i < BENCH_ITERATIONS; ++i)
+    {
+        mjson_element_t top;
+
+        uint64_t start = timerAbsoluteTime();
+        mjson_parse(text, size, storage, storageSize, &top);
+        minTime = core::min(minTime, timerAbsoluteTime() - start);
+    }
+
+    mjson_enable_simd(prevSIMD);
+
+    return minTime / 1000.0;
+}
+
+static bool benchmarkParse(const char* name, const char* record, size_t textSize)
+{
+    size_t storageSize = textSize * 2;
+
+    char*  text   = (char*)malloc(textSize);
+    void*  scalar = malloc(storageSize);
+    void*  simd   = malloc(storageSize);
+
+    size_t size = generateJSON(text, textSize, record);
+
+    // Both paths have to produce exactly the same storage
+    memset(scalar, 0, storageSize);
+    memset(simd,   0, storageSize);
+
+    mjson_element_t topScalar, topSIMD;
+
+    int prevSIMD = mjson_enable_simd(0);
+    int resScalar = mjson_parse(text, size, scalar, storageSize, &topScalar);
+    mjson_enable_simd(1);
+    int resSIMD = mjson_parse(text, size, simd, storageSize, &topSIMD);
+    mjson_enable_simd(prevSIMD);
+
+    bool passed = resScalar && resSIMD && memcmp(scalar, simd, storageSize) == 0;
+
+    double scalarTime = parseTime(text, size, scalar, storageSize, false);
+    double simdTime   = parseTime(text, size, simd,   storageSize, true);
+
+    printf("%-8s %5.1f MB: scalar %7.2f ms (%6.1f MB/s), SIMD %7.2f ms (%6.1f MB/s), same output: %s\n",
+           name, size / (1024.0 * 1024.0),
+           scalarTime, size / 1000.0 / scalarTime,
+           simdTime,   size / 1000.0 / simdTime,
+           passed ? "yes" : "NO");
+
+    free(text);
+    free(scalar);
+    free(simd);
+
+    return passed;
+}
+
+static bool benchmarkLookup()
+{
+    const size_t textSize = BENCH_NUM_KEYS * 32;
+
+    char*  text    = (char*)malloc(textSize);
+    void*  storage = malloc(textSize * 2);
+    size_t len     = 0;
+
+    len += sprintf(text, "{\n");
+    for (uint32_t i = 0; i < BENCH_NUM_KEYS; ++i)
+    {
+        len += sprintf(text + len, "    key_%u = %u\n", i, i);
+    }
+    len += sprintf(text + len, "}\n");
+
+    mjson_element_t dict;
+    bool passed = mjson_parse(text, len, storage, textSize * 2, &dict) != 0;
+
+    size_t        indexSize = mjson_index_size(dict);
+    void*         indexMem  = malloc(indexSize);
+    mjson_index_t index     = mjson_index_build(dict, indexMem, indexSize);
+
+    char keys[16][16];
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        sprintf(keys[i], "key_%u", i * BENCH_NUM_KEYS / 16 + 7);
+    }
+
+    int32_t  sumLinear = 0, sumIndexed = 0;
+    uint64_t start;
+
+    // Linear search is too slow to do all lookups, time is scaled
+    start = timerAbsoluteTime();
+    for (uint32_t i = 0; i < BENCH_LOOKUPS / 1000; ++i)
+    {
+        sumLinear += mjson_get_int(mjson_get_member(dict, keys[i & 15]), 0);
+    }
+    double linearTime = (timerAbsoluteTime() - start) / 1000.0 * 1000.0;
+
+    start = timerAbsoluteTime();
+    for (uint32_t i = 0; i < BENCH_LOOKUPS; ++i)
+    {
+        sumIndexed += mjson_get_int(mjson_index_get_member(index, keys[i & 15]), 0);
+    }
+    double indexedTime = (timerAbsoluteTime() - start) / 1000.0;
+
+    passed &= index != 0 && sumLinear * 1000 == sumIndexed;
+
+    printf("%u lookups in %u keys dictionary: linear %8.2f ms, indexed %6.2f ms\n",
+           BENCH_LOOKUPS, BENCH_NUM_KEYS, linearTime, indexedTime);
+
+    free(indexMem);
+    free(storage);
+    free(text);
+
+    return passed;
+}
+
+int run_mjson_bench()
+{
+    printf("mjson parsing\n");
+
+    bool passed = true;
+
+    passed &= benchmarkParse("compact", compactRecord, 8 * 1024 * 1024);
+    passed &= benchmarkParse("pretty",  prettyRecord,  8 * 1024 * 1024);
+    passed &= benchmarkLookup();
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <core/core.h>
+
+enum bench_private
+{
+    // Lights in clustered lighting demo, data stays in cache
+    BENCH_SMALL_COUNT    = 1024,
+    // Data is streamed from memory
+    BENCH_LARGE_COUNT    = 128 * 1024,
+    BENCH_TOTAL_ELEMENTS = 4 * 1024 * 1024,
+    BENCH_NUM_STREAMS    = 48,
+    BENCH_STREAM_PADDING = 16,
+};
+
+// Same data in AoS form for per element functions and in SoA streams for batch ones
+struct transform_data_t
+{
+    v128*          points;
+    v128*          pointsOut;
+    v128*          matA;
+    v128*          matB;
+    v128*          matR;
+    ml::dual_quat* dqA;
+    ml::dual_quat* dqB;
+    ml::dual_quat* dqR;
+    v128*          quats;
+
+    // Inputs are streams 0-31, outputs 32-47
+    float*         streamMemory;
+    float*         streams[BENCH_NUM_STREAMS];
+
+    v128           m[4];
+    v128           q;
+    ml::dual_quat  dq;
+};
+
+typedef void (*bench_func_t)(transform_data_t* data, size_t count);
+
+static ml::vec3_soa inputPoints(transform_data_t* data)
+{
+    ml::vec3_soa p = { data->streams[0], data->streams[1], data->streams[2] };
+    return p;
+}
+
+static ml::vec3_soa outputPoints(transform_data_t* data)
+{
+    ml::vec3_soa p = { data->streams[32], data->streams[33], data->streams[34] };
+    return p;
+}
+
+static ml::mat4_soa matrices(transform_data_t* data, size_t first)
+{
+    ml::mat4_soa m;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        m.m[i / 4][i % 4] = data->streams[first + i];
+    }
+
+    return m;
+}
+
+static ml::dual_quat_soa dualQuats(transform_data_t* data, size_t first)
+{
+    float** s = data->streams + first;
+    ml::dual_quat_soa dq = { { s[0], s[1], s[2], s[3] }, { s[4], s[5], s[6], s[7] } };
+    return dq;
+}
+
+static void pointsMat4AoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        data->pointsOut[i] = ml::mul_mat4_vec4(data->m, data->points[i]);
+    }
+}
+
+static void pointsMat4SoA(transform_data_t* data, size_t count)
+{
+    ml::vec3_soa src = inputPoints(data), dst = outputPoints(data);
+    ml::transformPointsSoA(&dst, data->m, &src, count);
+}
+
+static void pointsQuatAoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        data->pointsOut[i] = ml::rotate_vec3_quat(data->q, data->points[i]);
+    }
+}
+
+// Quaternion is converted to matrix once
+static void pointsQuatSoA(transform_data_t* data, size_t count)
+{
+    v128 m[4];
+    ml::quat_to_mat4(m, data->q);
+
+    ml::vec3_soa src = inputPoints(data), dst = outputPoints(data);
+    ml::transformVectorsSoA(&dst, m, &src, count);
+}
+
+static void pointsDualQuatAoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        data->pointsOut[i] = ml::transform_vec3_dual_quat(&data->dq, data->points[i]);
+    }
+}
+
+static void pointsDualQuatSoA(transform_data_t* data, size_t count)
+{
+    v128 real = vi_loadu_v4(&data->dq.real);
+    v128 dual = vi_loadu_v4(&data->dq.dual);
+    v128 m[4];
+
+    ml::quat_to_mat4x3(m, real);
+    m[3] = ml::make_p3(ml::translation_dual_quat(real, dual));
+
+    ml::vec3_soa src = inputPoints(data), dst = outputPoints(data);
+    ml::transformPointsSoA(&dst, m, &src, count);
+}
+
+static void mulMat4AoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        ml::mul_mat4(data->matR + i*4, data->matA + i*4, data->matB + i*4);
+    }
+}
+
+static void mulMat4SoA(transform_data_t* data, size_t count)
+{
+    ml::mat4_soa a = matrices(data, 0), b = matrices(data, 16), r = matrices(data, 32);
+    ml::mulMat4SoA(&r, &a, &b, count);
+}
+
+static void mulDualQuatAoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        ml::mul_dual_quat(&data->dqR[i], &data->dqA[i], &data->dqB[i]);
+    }
+}
+
+static void mulDualQuatSoA(transform_data_t* data, size_t count)
+{
+    ml::dual_quat_soa a = dualQuats(data, 0), b = dualQuats(data, 8), r = dualQuats(data, 32);
+    ml::mulDualQuatSoA(&r, &a, &b, count);
+}
+
+static void quatToMat4x3AoS(transform_data_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        ml::quat_to_mat4x3(data->matR + i*4, data->quats[i]);
+    }
+}
+
+static void quatToMat4x3SoA(transform_data_t* data, size_t count)
+{
+    ml::quat_soa q = { data->streams[0], data->streams[1], data->streams[2], data->streams[3] };
+    ml::mat4_soa m = matrices(data, 32);
+    ml::quatToMat4x3SoA(&m, &q, count);
+}
+
+// Returns ns per element, best of few runs
+static double measure(bench_func_t func, transform_data_t* data, size_t count)
+{
+    size_t   repeats = BENCH_TOTAL_ELEMENTS / count;
+    uint64_t minTime = UINT64_MAX;
+
+    for (int run = 0; run < 3; ++run)
+    {
+        uint64_t start = timerAbsoluteTime();
+        for (size_t i = 0; i < repeats; ++i)
+        {
+            func(data, count);
+        }
+        minTime = core::min(minTime, timerAbsoluteTime() - start);
+    }
+
+    return (double)minTime * 1000.0 / (double)(count * repeats);
+}
+
+static void benchmark(const char* name, bench_func_t aos, bench_func_t soa, transform_data_t* data)
+{
+    double aosSmall = measure(aos, data, BENCH_SMALL_COUNT);
+    double soaSmall = measure(soa, data, BENCH_SMALL_COUNT);
+    double aosLarge = measure(aos, data, BENCH_LARGE_COUNT);
+    double soaLarge = measure(soa, data, BENCH_LARGE_COUNT);
+
+    printf("%-16s %8.2f %8.2f %7.1fx %8.2f %8.2f %7.1fx\n", name,
+           aosSmall, soaSmall, aosSmall / soaSmall, aosLarge, soaLarge, aosLarge / soaLarge);
+}
+
+static float randomValue()
+{
+    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static v128 randomQuat()
+{
+    return ml::normalize_quat(vi_set(randomValue(), randomValue(), randomValue(), randomValue()));
+}
+
+int run_transform_bench()
+{
+    const size_t count = BENCH_LARGE_COUNT;
+
+    transform_data_t data;
+
+    data.points    = (v128*)         _mm_malloc(count * sizeof(v128), 16);
+    data.pointsOut = (v128*)         _mm_malloc(count * sizeof(v128), 16);
+    data.matA      = (v128*)         _mm_malloc(count * sizeof(v128) * 4, 16);
+    data.matB      = (v128*)         _mm_malloc(count * sizeof(v128) * 4, 16);
+    data.matR      = (v128*)         _mm_malloc(count * sizeof(v128) * 4, 16);
+    data.dqA       = (ml::dual_quat*)_mm_malloc(count * sizeof(ml::dual_quat), 16);
+    data.dqB       = (ml::dual_quat*)_mm_malloc(count * sizeof(ml::dual_quat), 16);
+    data.dqR       = (ml::dual_quat*)_mm_malloc(count * sizeof(ml::dual_quat), 16);
+    data.quats     = (v128*)         _mm_malloc(count * sizeof(v128), 16);
+
+    // Streams are padded by cache line, otherwise all of them map to the same L1 sets
+    size_t streamStride = count + BENCH_STREAM_PADDING;
+    data.streamMemory = (float*)_mm_malloc(streamStride * BENCH_NUM_STREAMS * sizeof(float), 64);
+
+    for (size_t s = 0; s < BENCH_NUM_STREAMS; ++s)
+    {
+        data.streams[s] = data.streamMemory + s * streamStride;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        data.points[i] = vi_set(randomValue() * 100.0f, randomValue() * 100.0f, randomValue() * 100.0f, 1.0f);
+        data.quats[i]  = randomQuat();
+
+        for (size_t s = 0; s < 32; ++s)
+        {
+            data.streams[s][i] = randomValue();
+        }
+
+        for (size_t c = 0; c < 4; ++c)
+        {
+            data.matA[i*4 + c] = vi_set(data.streams[c*4][i], data.streams[c*4 + 1][i], data.streams[c*4 + 2][i], data.streams[c*4 + 3][i]);
+            data.matB[i*4 + c] = vi_set(data.streams[16 + c*4][i], data.streams[17 + c*4][i], data.streams[18 + c*4][i], data.streams[19 + c*4][i]);
+        }
+
+        vi_storeu_v4(&data.dqA[i].real, data.matA[i*4 + 0]);
+        vi_storeu_v4(&data.dqA[i].dual, data.matA[i*4 + 1]);
+        vi_storeu_v4(&data.dqB[i].real, data.matA[i*4 + 2]);
+        vi_storeu_v4(&data.dqB[i].dual, data.matA[i*4 + 3]);
+    }
+
+    // Touch output pages before timing
+    memset(data.pointsOut, 0, count * sizeof(v128));
+    memset(data.matR,      0, count * sizeof(v128) * 4);
+    memset(data.dqR,       0, count * sizeof(ml::dual_quat));
+
+    for (size_t s = 32; s < BENCH_NUM_STREAMS; ++s)
+    {
+        memset(data.streams[s], 0, count * sizeof(float));
+    }
+
+    ml::make_rotation_mat4(data.m, 0.5f, 0.0f, 0.6f, 0.8f);
+    data.m[3] = vi_set(10.0f, -5.0f, 3.0f, 1.0f);
+    data.q    = randomQuat();
+
+    ml::quat orient;
+    ml::vec3 offset = { 10.0f, -5.0f, 3.0f };
+    vi_storeu_v4(&orient, randomQuat());
+    ml::make_dual_quat(&data.dq, &orient, &offset);
+
+    bool hasAVX2 = (core::cpu_features() & core::CPU_FEATURE_AVX2) != 0;
+    printf("Batch transforms(%s), ns per element\n%-16s %8s %8s %8s %8s %8s %8s\n", hasAVX2 ? "AVX2" : "SSE4.1",
+           "", "AoS 1K", "SoA 1K", "speedup", "AoS 128K", "SoA 128K", "speedup");
+
+    benchmark("points mat4",      pointsMat4AoS,     pointsMat4SoA,     &data);
+    benchmark("points quat",      pointsQuatAoS,     pointsQuatSoA,     &data);
+    benchmark("points dual quat", pointsDualQuatAoS, pointsDualQuatSoA, &data);
+    benchmark("mul mat4",         mulMat4AoS,        mulMat4SoA,        &data);
+    benchmark("mul dual quat",    mulDualQuatAoS,    mulDualQuatSoA,    &data);
+    benchmark("quat to mat4x3",   quatToMat4x3AoS,   quatToMat4x3SoA,   &data);
+
+    _mm_free(data.points);
+    _mm_free(data.pointsOut);
+    _mm_free(data.matA);
+    _mm_free(data.matB);
+    _mm_free(data.matR);
+    _mm_free(data.dqA);
+    _mm_free(data.dqB);
+    _mm_free(data.dqR);
+    _mm_free(data.quats);
+    _mm_free(data.streamMemory);
+
+    return EXIT_SUCCESS;
+}
@@ -1,4 +1,5 @@
 #include <sput.h>
+#include <math.h>
 
 #include <core/core.h>
 #include <etlsf.h>
@@ -73,6 +74,137 @@ void test_cstr_todouble()
     }
 }
 
+void test_cstr_todouble_rounding()
+{
+#define NUM_ROUNDING_TESTS 11
+    struct test_data_t{
+        const char* str;
+        errno_t     exp_err;
+        double      exp_val;
+    } testData[NUM_ROUNDING_TESTS] = {
+        { "0.1000000000000000055511151231257827021181583404541015625", EOK, 0.1 },
+        { "9007199254740993",                                         EOK, 9007199254740992.0 },
+        { "9007199254740993.0000000000000000001",                     EOK, 9007199254740994.0 },
+        { "2.2250738585072011e-308",                                  EOK, 2.2250738585072011e-308 },
+        { "1e23",                                                     EOK, 1e23 },
+        { "4.9406564584124654e-324",                                  ERANGE, 4.9406564584124654e-324 },
+        { "1.7976931348623157e308",                                   EOK, 1.7976931348623157e308 },
+        { "123456789012345678901234567890",                           EOK, 123456789012345678901234567890.0 },
+        { "1e400",                                                    ERANGE, HUGE_VAL },
+        { "-1e400",                                                   ERANGE, -HUGE_VAL },
+        { "1e-400",                                                   ERANGE, 0.0 },
+    };
+
+    for (int i = 0; i < NUM_ROUNDING_TESTS; ++i)
+    {
+        double res;
+        const char* end;
+        size_t len = strlen(testData[i].str);
+        errno_t err = cstr_todouble(testData[i].str, len + 1, &end, &res);
+        sput_fail_unless(err == testData[i].exp_err, "Check error");
+        sput_fail_unless(res == testData[i].exp_val, "Check return value");
+        sput_fail_unless(end - testData[i].str == len, "Check len");
+    }
+}
+
+void test_cstr_tofloat()
+{
+#define NUM_FLOAT32_TESTS 7
+    struct test_data_t{
+        const char* str;
+        errno_t     exp_err;
+        float       exp_val;
+    } testData[NUM_FLOAT32_TESTS] = {
+        { "0.3",                EOK,    0.3f },
+        { "16777217",           EOK,    16777216.0f },
+        { "3.4028235e38",       EOK,    3.4028235e38f },
+        { "1.000000059604644775390625", EOK, 1.0f },
+        { "1.4e-45",            ERANGE, 1.4e-45f },
+        { "3.5e38",             ERANGE, HUGE_VALF },
+        { "1e-50",              ERANGE, 0.0f },
+    };
+
+    for (int i = 0; i < NUM_FLOAT32_TESTS; ++i)
+    {
+        float res;
+        const char* end;
+        size_t len = strlen(testData[i].str);
+        errno_t err = cstr_tofloat(testData[i].str, len + 1, &end, &res);
+        sput_fail_unless(err == testData[i].exp_err, "Check error");
+        sput_fail_unless(res == testData[i].exp_val, "Check return value");
+        sput_fail_unless(end - testData[i].str == len, "Check len");
+    }
+
+    {
+        const char str[] = " 1.0 -2.5\t3e2 x 4";
+        const char* end;
+        float v[4];
+        rsize_t parsed = cstr_tofloats(str, sizeof(str), &end, v, 4);
+        sput_fail_unless(parsed == 3, "Check parsed count");
+        sput_fail_unless(v[0] == 1.0f && v[1] == -2.5f && v[2] == 300.0f, "Check return value");
+        sput_fail_unless(end == str + 13, "Check len");
+    }
+}
+
+void test_cstr_toimax_long()
+{
+    {
+        const char str[] = "9223372036854775807";
+        intmax_t res;
+        const char* end;
+        errno_t err = cstr_toimax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == EOK, "Check error");
+        sput_fail_unless(res == INTMAX_MAX, "Check return value");
+        sput_fail_unless(end - str == sizeof(str) - 1, "Check len");
+    }
+
+    {
+        const char str[] = "-9223372036854775808";
+        intmax_t res;
+        const char* end;
+        errno_t err = cstr_toimax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == EOK, "Check error");
+        sput_fail_unless(res == INTMAX_MIN, "Check return value");
+    }
+
+    {
+        const char str[] = "9223372036854775808";
+        intmax_t res;
+        const char* end;
+        errno_t err = cstr_toimax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == ERANGE, "Check error");
+        sput_fail_unless(res == INTMAX_MAX, "Check return value");
+    }
+
+    {
+        const char str[] = "18446744073709551615";
+        uintmax_t res;
+        const char* end;
+        errno_t err = cstr_toumax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == EOK, "Check error");
+        sput_fail_unless(res == UINTMAX_MAX, "Check return value");
+    }
+
+    {
+        const char str[] = "18446744073709551616";
+        uintmax_t res;
+        const char* end;
+        errno_t err = cstr_toumax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == ERANGE, "Check error");
+        sput_fail_unless(res == UINTMAX_MAX, "Check return value");
+    }
+
+    {
+        const char str[] = "1234567890123x";
+        uintmax_t res;
+        const char* end;
+        errno_t err = cstr_toumax(str, sizeof(str), 10, &end, &res);
+        sput_fail_unless(err == EOK, "Check error");
+        sput_fail_unless(res == 1234567890123ull, "Check return value");
+        sput_fail_unless(end - str == 13, "Check len");
+    }
+}
+
 void test_cstr_toimax()
 {
 #define NUM_IMAX_TESTS 9
@@ -222,20 +354,52 @@ void test_cstr_tokenize()
 }
 
 
+void test_text_reader()
+{
+    const char text[] = "v 1.0 2.0\r\n\n  f 1 2 3\nlast";
+    text_reader_t reader;
+    str_view_t    line, token;
+
+    text_reader_init(&reader, text, sizeof(text) - 1);
+
+    sput_fail_unless(text_reader_line(&reader, &line) && str_equal(line, "v 1.0 2.0"), "Check line without CR LF");
+    sput_fail_unless(text_reader_line(&reader, &line) && line.size == 0, "Check empty line");
+    sput_fail_unless(text_reader_line(&reader, &line) && str_equal(line, "  f 1 2 3"), "Check line");
+
+    sput_fail_unless(str_next_token(&line, &token) && str_equal(token, "f"), "Check token");
+    sput_fail_unless(str_next_token(&line, &token) && str_equal(token, "1"), "Check token");
+    sput_fail_unless(str_next_token(&line, &token) && str_equal(token, "2"), "Check token");
+    sput_fail_unless(str_next_token(&line, &token) && str_equal(token, "3"), "Check token");
+    sput_fail_unless(!str_next_token(&line, &token), "Check end of tokens");
+
+    sput_fail_unless(text_reader_line(&reader, &line) && str_equal(line, "last"), "Check last line without line break");
+    sput_fail_unless(!text_reader_line(&reader, &line), "Check end of text");
+
+    text_reader_close(&reader);
+}
+
 int run_cstr_tests()
 {
     sput_start_testing();
 
     sput_enter_suite("CSTR: test cstr_todouble");
     sput_run_test(test_cstr_todouble);
+    sput_enter_suite("CSTR: test cstr_todouble rounding");
+    sput_run_test(test_cstr_todouble_rounding);
+    sput_enter_suite("CSTR: test cstr_tofloat");
+    sput_run_test(test_cstr_tofloat);
     sput_enter_suite("CSTR: test cstr_toimax");
     sput_run_test(test_cstr_toimax);
     sput_enter_suite("CSTR: test cstr_toumax");
     sput_run_test(test_cstr_toumax);
+    sput_enter_suite("CSTR: test cstr_toimax long numbers");
+    sput_run_test(test_cstr_toimax_long);
     sput_enter_suite("CSTR: test cstr_scanf");
     sput_run_test(test_cstr_scanf);
     sput_enter_suite("CSTR: test cstr_tokenize");
     sput_run_test(test_cstr_tokenize);
+    sput_enter_suite("CSTR: test text_reader");
+    sput_run_test(test_text_reader);
 
     sput_finish_testing();
 
@@ -303,6 +303,202 @@ void test_bug_unsuitable_range_assert()
     etlsf_destroy(arena);
 }
 
+void test_large_max_allocs()
+{
+    const uint32_t  MAX_ALLOCS = 0x20000;
+    const uint32_t  MIN_ALLOC  = 0x100;
+    const uint32_t  MEM_SIZE   = MIN_ALLOC * MAX_ALLOCS;
+
+    static etlsf_alloc_t allocs[MAX_ALLOCS];
+
+    etlsf_t  arena = etlsf_create(MEM_SIZE, MAX_ALLOCS);
+
+    bool tests_passed = true;
+    for (uint32_t i=0; i < MAX_ALLOCS; ++i)
+    {
+        allocs[i] = etlsf_alloc_range(arena, MIN_ALLOC);
+
+        tests_passed &= etlsf_alloc_is_valid(arena, allocs[i]) != 0;
+        tests_passed &= (etlsf_alloc_offset(arena, allocs[i]) == i*MIN_ALLOC);
+    }
+    sput_fail_unless(tests_passed, "More than 65535 allocations succeeded, offsets are correct");
+    sput_fail_unless(allocs[MAX_ALLOCS-1].value > 0xFFFF, "Ids do not fit in 16 bits");
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, etlsf_alloc_range(arena, MIN_ALLOC)), "Additional allocation failed");
+
+    for (uint32_t i=0; i < MAX_ALLOCS; ++i)
+    {
+        etlsf_free_range(arena, allocs[i]);
+    }
+
+    etlsf_alloc_t id = etlsf_alloc_range(arena, MEM_SIZE);
+    sput_fail_unless(etlsf_alloc_offset(arena, id) == 0 && etlsf_alloc_size(arena, id) == MEM_SIZE, "All ranges were merged back");
+
+    etlsf_destroy(arena);
+}
+
+void test_defragment()
+{
+    etlsf_t  arena;
+
+    etlsf_alloc_t      ids[8];
+    etlsf_relocation_t relocations[8];
+
+    arena = etlsf_create(8 * 1024, 128);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        ids[i] = etlsf_alloc_range(arena, 1024);
+    }
+
+    etlsf_free_range(arena, ids[0]);
+    etlsf_free_range(arena, ids[3]);
+    etlsf_free_range(arena, ids[4]);
+    etlsf_free_range(arena, ids[6]);
+
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, etlsf_alloc_range(arena, 2 * 1024 + 256)), "Free space is fragmented");
+
+    uint32_t count = etlsf_defragment(arena, relocations, 8);
+
+    sput_fail_unless(count == 4, "Every allocation after first hole is moved");
+    sput_fail_unless(relocations[0].id.value == ids[1].value && relocations[0].src_offset == 1024 && relocations[0].dst_offset == 0, "Relocation test");
+    sput_fail_unless(relocations[1].id.value == ids[2].value && relocations[1].src_offset == 2048 && relocations[1].dst_offset == 1024, "Relocation test");
+    sput_fail_unless(relocations[2].id.value == ids[5].value && relocations[2].src_offset == 5120 && relocations[2].dst_offset == 2048, "Relocation test");
+    sput_fail_unless(relocations[3].id.value == ids[7].value && relocations[3].src_offset == 7168 && relocations[3].dst_offset == 3072, "Relocation test");
+
+    bool tests_passed = true;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        tests_passed &= relocations[i].size == 1024;
+        tests_passed &= etlsf_alloc_offset(arena, relocations[i].id) == relocations[i].dst_offset;
+        tests_passed &= etlsf_alloc_size(arena, relocations[i].id) == 1024;
+    }
+    sput_fail_unless(tests_passed, "Ids are kept, offsets are updated");
+
+    etlsf_alloc_t id = etlsf_alloc_range(arena, 4 * 1024);
+    sput_fail_unless(etlsf_alloc_is_valid(arena, id) && etlsf_alloc_offset(arena, id) == 4 * 1024, "Free space is merged at the end");
+    sput_fail_unless(etlsf_defragment(arena, relocations, 8) == 0, "Nothing to move in compacted arena");
+
+    etlsf_free_range(arena, id);
+    etlsf_free_range(arena, ids[1]);
+    etlsf_free_range(arena, ids[5]);
+
+    count = etlsf_defragment(arena, relocations, 1);
+    sput_fail_unless(count == 1 && relocations[0].id.value == ids[2].value && relocations[0].dst_offset == 0, "Compaction stops at max_relocations");
+    count = etlsf_defragment(arena, relocations, 8);
+    sput_fail_unless(count == 1 && relocations[0].id.value == ids[7].value && relocations[0].dst_offset == 1024, "Compaction continues");
+
+    id = etlsf_alloc_range(arena, 6 * 1024);
+    sput_fail_unless(etlsf_alloc_is_valid(arena, id) && etlsf_alloc_offset(arena, id) == 2 * 1024, "Free space is merged at the end");
+
+    etlsf_destroy(arena);
+}
+
+void test_defragment_overlapped()
+{
+    etlsf_t  arena;
+
+    etlsf_alloc_t      id0, id1;
+    etlsf_relocation_t relocation;
+
+    arena = etlsf_create(4 * 1024, 128);
+
+    id0 = etlsf_alloc_range(arena, 256);
+    id1 = etlsf_alloc_range(arena, 2 * 1024);
+    etlsf_free_range(arena, id0);
+
+    sput_fail_unless(etlsf_defragment(arena, &relocation, 1) == 1, "Allocation is moved");
+    sput_fail_unless(relocation.src_offset == 256 && relocation.dst_offset == 0 && relocation.size == 2 * 1024, "Source and destination overlap");
+    sput_fail_unless(etlsf_alloc_offset(arena, id1) == 0, "Allocation is first in arena");
+
+    id0 = etlsf_alloc_range(arena, 2 * 1024);
+    sput_fail_unless(etlsf_alloc_offset(arena, id0) == 2 * 1024 && etlsf_alloc_size(arena, id0) == 2 * 1024, "Rest of arena is single range");
+
+    etlsf_destroy(arena);
+}
+
+enum thread_test_private
+{
+    THREAD_TEST_ITERATIONS = 64 * 1024,
+    THREAD_TEST_GRAIN      = 1024,
+    THREAD_TEST_ARENA_SIZE = 16 * 1024 * 1024,
+};
+
+static atomic_t threadTestFailures;
+
+static void alloc_free_range(uint32_t begin, uint32_t end, void* arg)
+{
+    etlsf_t       arena = (etlsf_t)arg;
+    etlsf_alloc_t held[4] = {};
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        etlsf_alloc_t& slot = held[i % 4];
+
+        if (etlsf_alloc_is_valid(arena, slot))
+        {
+            etlsf_free_range(arena, slot);
+        }
+
+        slot = etlsf_alloc_range(arena, 256 + (i % 17) * 256);
+
+        if (!etlsf_alloc_is_valid(arena, slot) || (etlsf_alloc_offset(arena, slot) & 0xFF))
+        {
+            _InterlockedIncrement(&threadTestFailures);
+        }
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        etlsf_free_range(arena, held[i]);
+    }
+}
+
+void test_thread_safe()
+{
+    etlsf_t arena = etlsf_create_ex(THREAD_TEST_ARENA_SIZE, 4096, ETLSF_THREAD_SAFE);
+
+    threadTestFailures = 0;
+    mt::jobWait(mt::parallelFor(alloc_free_range, arena, THREAD_TEST_ITERATIONS, THREAD_TEST_GRAIN));
+
+    sput_fail_unless(threadTestFailures == 0, "Concurrent allocations succeeded");
+
+    // Deferred frees are released by next allocation
+    etlsf_alloc_t id = etlsf_alloc_range(arena, THREAD_TEST_ARENA_SIZE);
+    sput_fail_unless(etlsf_alloc_offset(arena, id) == 0 && etlsf_alloc_size(arena, id) == THREAD_TEST_ARENA_SIZE, "All ranges were merged back");
+
+    etlsf_destroy(arena);
+}
+
+void test_thread_safe_defragment()
+{
+    etlsf_t            arena = etlsf_create_ex(4 * 1024, 128, ETLSF_THREAD_SAFE);
+    etlsf_relocation_t relocation;
+
+    etlsf_alloc_t id0 = etlsf_alloc_range(arena, 1024);
+    etlsf_alloc_t id1 = etlsf_alloc_range(arena, 1024);
+    etlsf_alloc_t id2 = etlsf_alloc_range(arena, 1024);
+    etlsf_free_range(arena, id0);
+
+    sput_fail_unless(etlsf_defragment_begin(arena, &relocation, 1) == 1, "Allocation is moved");
+
+    // Arena is locked while data is copied, frees wait for defragment end
+    etlsf_free_range(arena, id2);
+    sput_fail_unless(!etlsf_alloc_is_valid(arena, id2), "Free is deferred");
+
+    etlsf_defragment_end(arena);
+
+    etlsf_alloc_t id = etlsf_alloc_range(arena, 3 * 1024);
+    sput_fail_unless(etlsf_alloc_offset(arena, id1) == 0 && etlsf_alloc_offset(arena, id) == 1024, "Deferred free is merged after defragment");
+
+    sput_fail_unless(etlsf_defragment_begin(arena, &relocation, 1) == 0, "Nothing to move in compacted arena");
+    etlsf_defragment_end(arena);
+
+    etlsf_free_range(arena, id);
+    sput_fail_unless(etlsf_alloc_is_valid(arena, etlsf_alloc_range(arena, 3 * 1024)), "Arena is unlocked after empty defragment");
+
+    etlsf_destroy(arena);
+}
+
 int run_etlsf_tests()
 {
     core::init();
@@ -326,6 +522,13 @@ int run_etlsf_tests()
     sput_run_test(test_merge_next);
     sput_enter_suite("ETLSF: max allocs");
     sput_run_test(test_max_allocs);
+    sput_run_test(test_large_max_allocs);
+    sput_enter_suite("ETLSF: defragment");
+    sput_run_test(test_defragment);
+    sput_run_test(test_defragment_overlapped);
+    sput_enter_suite("ETLSF: thread safe");
+    sput_run_test(test_thread_safe);
+    sput_run_test(test_thread_safe_defragment);
     sput_enter_suite("ETLSF: bugs");
     sput_run_test(test_bug_no_suitable_range_assert);
     sput_run_test(test_bug_unsuitable_range_assert);
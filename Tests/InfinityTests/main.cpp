@@ -4,8 +4,12 @@
 int run_vg_tests();
 int run_etlsf_tests();
 int run_math_tests();
+int run_vi_tests();
 int run_bit_tests();
 int run_cstr_tests();
+int run_mt_tests();
+int run_pool_tests();
+int run_mem_tests();
 
 extern "C" int assert_handler(const char* cond, const char* file, int line) { return true; }
 
@@ -16,8 +20,12 @@ int main(int argc, char **argv)
     res |= run_bit_tests();
     res |= run_etlsf_tests();
     res |= run_math_tests();
+    res |= run_vi_tests();
     res |= run_vg_tests();
     res |= run_cstr_tests();
+    res |= run_mt_tests();
+    res |= run_pool_tests();
+    res |= run_mem_tests();
 
     return res;
 }
\ No newline at end of file
@@ -290,6 +290,580 @@ void test_vector_math()
     }
 }
 
+// Classifies box by clip space coordinates of its 8 corners, plane by plane
+static int referenceFrustumTest(v128* m, const float bmin[3], const float bmax[3])
+{
+    int  outside = 0;
+    bool allin   = true;
+
+    for (int plane = 0; plane < 6; ++plane)
+    {
+        int numOut = 0;
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            v128 p = vi_set(
+                (corner&1) ? bmax[0] : bmin[0],
+                (corner&2) ? bmax[1] : bmin[1],
+                (corner&4) ? bmax[2] : bmin[2],
+                1.0f
+            );
+            float c[4];
+            vi_storeu_v4(c, ml::mul_mat4_vec4(m, p));
+
+            float d = (plane&1) ? c[3] - c[plane/2] : c[3] + c[plane/2];
+            numOut += d < 0.0f;
+        }
+        outside |= numOut==8;
+        allin   &= numOut==0;
+    }
+
+    return outside ? ml::IT_OUTSIDE : allin ? ml::IT_INSIDE : ml::IT_INTERSECT;
+}
+
+void test_frustum_culling()
+{
+    v128 proj[4], view[4], vp[4];
+
+    ml::make_perspective_mat4(proj, 60.0f * FLT_DEG_TO_RAD_SCALE, 1.5f, 0.5f, 500.0f);
+
+    {
+        ml::mat4x4 frustum = {proj[0], proj[1], proj[2], proj[3]};
+
+        ml::frustum_planes planes;
+        ml::extractFrustumPlanes(&planes, &frustum);
+
+        // Box in front of camera, behind camera and around camera
+        int result[4];
+        ml::intersectionTestSOA4(result, &planes,
+            vi_set( -1.0f, -1.0f, -1.0f, 600.0f), vi_set( -1.0f, -1.0f, -1.0f, -1.0f), vi_set(-20.0f, 10.0f, -20.0f, -20.0f),
+            vi_set(  1.0f,  1.0f,  1.0f, 700.0f), vi_set(  1.0f,  1.0f,  1.0f,  1.0f), vi_set(-10.0f, 20.0f,  20.0f, -10.0f));
+
+        sput_fail_unless(result[0]==ml::IT_INSIDE,    "Box in front of camera is inside");
+        sput_fail_unless(result[1]==ml::IT_OUTSIDE,   "Box behind camera is outside");
+        sput_fail_unless(result[2]==ml::IT_INTERSECT, "Box around camera intersects");
+        sput_fail_unless(result[3]==ml::IT_OUTSIDE,   "Box to the right of frustum is outside");
+    }
+
+    ml::make_rotation_mat4(view, 0.7f, 0.0f, 1.0f, 0.0f);
+    ml::mul_mat4(vp, proj, view);
+
+    ml::mat4x4 frustum = {vp[0], vp[1], vp[2], vp[3]};
+
+    ml::frustum_planes planes;
+    ml::extractFrustumPlanes(&planes, &frustum);
+
+    srand(1234);
+
+    int mismatches = 0;
+    for (int i = 0; i < 1024; i += 4)
+    {
+        float bmin[3][4], bmax[3][4];
+        for (int j = 0; j < 4; ++j)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                float c = (float)(rand() % 2000 - 1000) * 0.25f;
+                float e = (float)(rand() % 400 + 1) * 0.25f;
+                bmin[k][j] = c - e;
+                bmax[k][j] = c + e;
+            }
+        }
+
+        int result[4];
+        ml::intersectionTestSOA4(result, &planes,
+            vi_loadu_v4(bmin[0]), vi_loadu_v4(bmin[1]), vi_loadu_v4(bmin[2]),
+            vi_loadu_v4(bmax[0]), vi_loadu_v4(bmax[1]), vi_loadu_v4(bmax[2]));
+
+        for (int j = 0; j < 4; ++j)
+        {
+            float boxMin[3] = {bmin[0][j], bmin[1][j], bmin[2][j]};
+            float boxMax[3] = {bmax[0][j], bmax[1][j], bmax[2][j]};
+            mismatches += result[j]!=referenceFrustumTest(vp, boxMin, boxMax);
+        }
+    }
+    sput_fail_unless(mismatches==0, "intersectionTestSOA4 matches per corner test");
+
+    {
+        v128 m = vi_set(-1.0f, 1.0f, -0.0f, 2.0f);
+        sput_fail_unless(vi_mask(m)==0x05, "check vi_mask");
+    }
+}
+
+void test_batch_culling()
+{
+    v128 proj[4], view[4], vp[4];
+
+    ml::make_perspective_mat4(proj, 60.0f * FLT_DEG_TO_RAD_SCALE, 1.5f, 0.5f, 500.0f);
+    ml::make_rotation_mat4(view, -0.3f, 1.0f, 0.0f, 0.0f);
+    ml::mul_mat4(vp, proj, view);
+
+    ml::mat4x4 frustum = {vp[0], vp[1], vp[2], vp[3]};
+
+    ml::frustum_planes planes;
+    ml::extractFrustumPlanes(&planes, &frustum);
+
+    // Count is not multiple of SIMD width to test tail processing
+    const size_t COUNT = 1003;
+
+    static float minX[COUNT], minY[COUNT], minZ[COUNT];
+    static float maxX[COUNT], maxY[COUNT], maxZ[COUNT];
+    static float radius[COUNT];
+    static uint32_t visible[COUNT];
+
+    srand(4321);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        float cx = (float)(rand() % 2000 - 1000) * 0.25f;
+        float cy = (float)(rand() % 2000 - 1000) * 0.25f;
+        float cz = (float)(rand() % 2000 - 1000) * 0.25f;
+        float e  = (float)(rand() % 200 + 1) * 0.25f;
+
+        minX[i] = cx - e; maxX[i] = cx + e;
+        minY[i] = cy - e; maxY[i] = cy + e;
+        minZ[i] = cz - e; maxZ[i] = cz + e;
+        radius[i] = e;
+    }
+
+    {
+        size_t numVisible = ml::cullAABBs(visible, &planes, COUNT, minX, minY, minZ, maxX, maxY, maxZ);
+
+        size_t expected   = 0;
+        bool   sameOrder  = true;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            int result[4];
+            ml::intersectionTestSOA4(result, &planes,
+                vi_set_all(minX[i]), vi_set_all(minY[i]), vi_set_all(minZ[i]),
+                vi_set_all(maxX[i]), vi_set_all(maxY[i]), vi_set_all(maxZ[i]));
+
+            if (result[0]!=ml::IT_OUTSIDE)
+            {
+                sameOrder &= expected<numVisible && visible[expected]==i;
+                ++expected;
+            }
+        }
+
+        sput_fail_unless(numVisible>0 && numVisible<COUNT, "Some AABBs are culled");
+        sput_fail_unless(numVisible==expected && sameOrder, "cullAABBs matches intersectionTestSOA4");
+    }
+
+    {
+        // Centers of AABBs are used as sphere centers
+        static float x[COUNT], y[COUNT], z[COUNT];
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            x[i] = (minX[i] + maxX[i]) * 0.5f;
+            y[i] = (minY[i] + maxY[i]) * 0.5f;
+            z[i] = (minZ[i] + maxZ[i]) * 0.5f;
+        }
+
+        size_t numVisible = ml::cullSpheres(visible, &planes, COUNT, x, y, z, radius);
+
+        size_t expected  = 0;
+        bool   sameOrder = true;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            bool outside = false;
+            for (int p = 0; p < 6; ++p)
+            {
+                float dist = x[i] * vi_get_x(planes.nx[p]) + (y[i] * vi_get_x(planes.ny[p]) + (z[i] * vi_get_x(planes.nz[p]) + vi_get_x(planes.d[p])));
+                outside |= dist < -radius[i];
+            }
+
+            if (!outside)
+            {
+                sameOrder &= expected<numVisible && visible[expected]==i;
+                ++expected;
+            }
+        }
+
+        sput_fail_unless(numVisible>0 && numVisible<COUNT, "Some spheres are culled");
+        sput_fail_unless(numVisible==expected && sameOrder, "cullSpheres matches scalar plane test");
+    }
+
+    sput_fail_unless(ml::cullAABBs(visible, &planes, 0, minX, minY, minZ, maxX, maxY, maxZ)==0, "cullAABBs handles empty input");
+}
+
+// Error of result in units of last place of reference rounded to float, denormals have fixed ulp
+static double ulpError(float result, double reference)
+{
+    if (reference != reference)
+    {
+        return result != result ? 0.0 : DBL_MAX;
+    }
+
+    if ((float)reference == result)
+    {
+        return 0.0;
+    }
+
+    if (result != result || fabsf(result) == INFINITY || fabs(reference) > FLT_MAX)
+    {
+        return DBL_MAX;
+    }
+
+    int exponent;
+    frexp(reference, &exponent);
+
+    return fabs(result - reference) / ldexp(1.0, core::max(exponent - 24, -149));
+}
+
+static float randomFloat(float lo, float hi)
+{
+    float t = (float)((rand() & 0x7FFF) * 0x8000 + (rand() & 0x7FFF)) / (float)(0x8000 * 0x8000);
+    return lo + (hi - lo) * t;
+}
+
+static bool sameFloat(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0 || (a != a && b != b);
+}
+
+typedef void   (*unary_array_func_t)(float* dst, const float* x, size_t count);
+typedef double (*unary_reference_t)(double x);
+
+static double maxUlpError(unary_array_func_t func, unary_reference_t reference, const float* x, float* result, size_t count)
+{
+    func(result, x, count);
+
+    double maxError = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        maxError = core::max(maxError, ulpError(result[i], reference(x[i])));
+    }
+
+    return maxError;
+}
+
+static double refSin  (double x) { return sin(x); }
+static double refCos  (double x) { return cos(x); }
+static double refExp  (double x) { return exp(x); }
+static double refExp2 (double x) { return pow(2.0, x); }
+static double refLn   (double x) { return log(x); }
+static double refLg2  (double x) { return log(x) / log(2.0); }
+static double refRsqrt(double x) { return 1.0 / sqrt(x); }
+
+void test_transcendental_precision()
+{
+    // Count is not multiple of SIMD width to test tail processing
+    const size_t COUNT = 4099;
+
+    static float x[COUNT], y[COUNT], r[COUNT], c[COUNT];
+
+    srand(1234);
+
+    for (size_t i = 0; i < COUNT; ++i) x[i] = randomFloat(-FLT_PI, FLT_PI);
+    sput_fail_unless(maxUlpError(ml::sinArray, refSin, x, r, COUNT) <= 1.5, "sin error is within 1.5 ulp for |x| <= pi");
+    sput_fail_unless(maxUlpError(ml::cosArray, refCos, x, r, COUNT) <= 1.5, "cos error is within 1.5 ulp for |x| <= pi");
+
+    {
+        for (size_t i = 0; i < COUNT; ++i) x[i] = randomFloat(-8192.0f, 8192.0f);
+        ml::sincosArray(r, c, x, COUNT);
+
+        double maxError = 0.0;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            maxError = core::max(maxError, fabs(r[i] - sin((double)x[i])));
+            maxError = core::max(maxError, fabs(c[i] - cos((double)x[i])));
+        }
+        sput_fail_unless(maxError <= 8e-8, "sincos absolute error is within 8e-8 for |x| <= 8192");
+    }
+
+    for (size_t i = 0; i < COUNT; ++i) x[i] = randomFloat(-104.0f, 89.0f);
+    sput_fail_unless(maxUlpError(ml::expArray, refExp, x, r, COUNT) <= 1.0, "exp error is within 1 ulp");
+
+    for (size_t i = 0; i < COUNT; ++i) x[i] = randomFloat(-151.0f, 128.0f);
+    sput_fail_unless(maxUlpError(ml::exp2Array, refExp2, x, r, COUNT) <= 1.5, "exp2 error is within 1.5 ulp");
+
+    // Log inputs cover whole range including denormals
+    for (size_t i = 0; i < COUNT; ++i) x[i] = ldexpf(randomFloat(1.0f, 2.0f), rand() % 276 - 148);
+    sput_fail_unless(maxUlpError(ml::lnArray,  refLn,  x, r, COUNT) <= 1.0, "ln error is within 1 ulp");
+    sput_fail_unless(maxUlpError(ml::lg2Array, refLg2, x, r, COUNT) <= 1.5, "lg2 error is within 1.5 ulp");
+
+    for (size_t i = 0; i < COUNT; ++i) x[i] = ldexpf(randomFloat(1.0f, 2.0f), rand() % 276 - 148);
+    sput_fail_unless(maxUlpError(ml::rsqrtArray, refRsqrt, x, r, COUNT) <= 4.0, "rsqrt error is within 4 ulp");
+
+    {
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            float scale = ldexpf(1.0f, rand() % 120 - 60);
+            x[i] = randomFloat(-1.0f, 1.0f) * scale;
+            y[i] = randomFloat(-1.0f, 1.0f) * scale;
+        }
+        ml::atan2Array(r, y, x, COUNT);
+
+        double maxError = 0.0;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            maxError = core::max(maxError, ulpError(r[i], atan2((double)y[i], (double)x[i])));
+        }
+        sput_fail_unless(maxError <= 3.5, "atan2 error is within 3.5 ulp");
+    }
+
+    {
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            x[i] = randomFloat(0.0f, rand() % 2 ? 1.0f : 1000.0f);
+            y[i] = randomFloat(-8.0f, 8.0f);
+        }
+        ml::powArray(r, x, y, COUNT);
+
+        bool withinBound = true;
+        for (size_t i = 0; i < COUNT; ++i)
+        {
+            double exponent = fabs(y[i] * log((double)x[i]) / log(2.0));
+            withinBound &= ulpError(r[i], pow((double)x[i], (double)y[i])) <= 2.0 + 1.25 * exponent;
+        }
+        sput_fail_unless(withinBound, "pow error is within 2 + 1.25*|y*lg2(x)| ulp");
+    }
+}
+
+void test_transcendental_special_values()
+{
+    static const float values[] = {
+        0.0f, -0.0f, INFINITY, -INFINITY, NAN, 1.0f, -1.0f, 0.5f, 2.0f, 100.0f, -100.0f,
+        FLT_MIN, FLT_MAX, -FLT_MAX, 1e-45f, 88.72283f, 89.0f, -104.0f, -150.0f, 128.0f
+    };
+    const size_t COUNT = ARRAY_SIZE(values);
+
+    float r[COUNT];
+    bool  matches;
+
+#define CHECK_UNARY(func, libm, cond, name)                         \
+    func(r, values, COUNT);                                         \
+    matches = true;                                                 \
+    for (size_t i = 0; i < COUNT; ++i)                              \
+    {                                                               \
+        float v = values[i];                                        \
+        if (cond) matches &= sameFloat(r[i], libm(v));              \
+    }                                                               \
+    sput_fail_unless(matches, name);
+
+    CHECK_UNARY(ml::sinArray,   sinf,  !isfinite(v) || fabsf(v) < 1e-3f, "sin special values match libm");
+    CHECK_UNARY(ml::cosArray,   cosf,  !isfinite(v) || v == 0.0f,        "cos special values match libm");
+    CHECK_UNARY(ml::expArray,   expf,  !isfinite(v) || v == 0.0f || v >= 89.0f || v <= -104.0f, "exp special values match libm");
+    CHECK_UNARY(ml::exp2Array,  exp2f, !isfinite(v) || v == floorf(v),   "exp2 special values match libm");
+    CHECK_UNARY(ml::lnArray,    logf,  !isfinite(v) || v <= 0.0f || v == 1.0f, "ln special values match libm");
+    CHECK_UNARY(ml::lg2Array,   log2f, !isfinite(v) || v <= 0.0f || v == 1.0f || v == 2.0f, "lg2 special values match libm");
+    CHECK_UNARY(ml::rsqrtArray, 1.0f/sqrtf, !isfinite(v) || v <= 0.0f,   "rsqrt special values match libm");
+
+#undef CHECK_UNARY
+
+    {
+        // Smallest denormal is not exact, but must not turn into inf or NaN
+        float v = 1e-45f, res;
+        ml::rsqrtArray(&res, &v, 1);
+        sput_fail_unless(ulpError(res, refRsqrt(v)) <= 4.0, "rsqrt of smallest denormal is within 4 ulp");
+    }
+
+    matches = true;
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        for (size_t j = 0; j < COUNT; ++j)
+        {
+            float a = values[i], b = values[j], res;
+
+            ml::atan2Array(&res, &a, &b, 1);
+            bool special = !isfinite(a) || !isfinite(b) || a == 0.0f || b == 0.0f;
+            if (special) matches &= sameFloat(res, atan2f(a, b));
+        }
+    }
+    sput_fail_unless(matches, "atan2 special values match libm");
+
+    matches = true;
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        for (size_t j = 0; j < COUNT; ++j)
+        {
+            float a = values[i], b = values[j], res;
+
+            // Sign of negative base is not handled
+            if (signbit(a)) continue;
+
+            ml::powArray(&res, &a, &b, 1);
+            bool special = !isfinite(a) || !isfinite(b) || a == 0.0f || a == 1.0f || b == 0.0f;
+            if (special) matches &= sameFloat(res, powf(a, b));
+        }
+    }
+    sput_fail_unless(matches, "pow special values match libm");
+}
+
+void test_transcendental_batch()
+{
+    // Not multiple of 8, array functions may use AVX2 path
+    const size_t COUNT = 1027;
+
+    static float x[COUNT], y[COUNT], r[COUNT], c[COUNT];
+
+    srand(5678);
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        x[i] = randomFloat(-100.0f, 100.0f);
+        y[i] = randomFloat(-100.0f, 100.0f);
+    }
+
+    bool matches = true;
+
+#define CHECK_ARRAY(array_expr, vector_expr, name)                  \
+    array_expr;                                                     \
+    matches = true;                                                 \
+    for (size_t i = 0; i + 4 <= COUNT; i += 4)                      \
+    {                                                               \
+        v128 vx = vi_loadu_v4(x + i), vy = vi_loadu_v4(y + i);      \
+        CORE_ALIGN(16) float v[4];                                  \
+        vi_store_v4(v, vector_expr);                                \
+        for (size_t k = 0; k < 4; ++k)                              \
+            matches &= sameFloat(r[i + k], v[k]);                   \
+    }                                                               \
+    sput_fail_unless(matches, name);
+
+    CHECK_ARRAY(ml::sinArray  (r, x, COUNT),    ml::sin  (vx),     "sinArray matches v128 sin");
+    CHECK_ARRAY(ml::cosArray  (r, x, COUNT),    ml::cos  (vx),     "cosArray matches v128 cos");
+    CHECK_ARRAY(ml::expArray  (r, x, COUNT),    ml::exp  (vx),     "expArray matches v128 exp");
+    CHECK_ARRAY(ml::exp2Array (r, x, COUNT),    ml::exp2 (vx),     "exp2Array matches v128 exp2");
+    CHECK_ARRAY(ml::lnArray   (r, x, COUNT),    ml::ln   (vx),     "lnArray matches v128 ln");
+    CHECK_ARRAY(ml::lg2Array  (r, x, COUNT),    ml::lg2  (vx),     "lg2Array matches v128 lg2");
+    CHECK_ARRAY(ml::rsqrtArray(r, x, COUNT),    ml::rsqrt(vx),     "rsqrtArray matches v128 rsqrt");
+    CHECK_ARRAY(ml::powArray  (r, x, y, COUNT), ml::pow  (vx, vy), "powArray matches v128 pow");
+    CHECK_ARRAY(ml::atan2Array(r, y, x, COUNT), ml::atan2(vy, vx), "atan2Array matches v128 atan2");
+
+#undef CHECK_ARRAY
+
+    ml::sincosArray(r, c, x, COUNT);
+    matches = true;
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        float s = x[i];
+        v128  vs, vc;
+        ml::sincos(&vs, &vc, vi_set_all(s));
+        matches &= sameFloat(r[i], vi_get_x(vs)) && sameFloat(c[i], vi_get_x(vc));
+    }
+    sput_fail_unless(matches, "sincosArray matches v128 sincos including tail");
+
+    // In place processing
+    for (size_t i = 0; i < COUNT; ++i) r[i] = x[i];
+    ml::expArray(r, r, COUNT);
+    ml::expArray(c, x, COUNT);
+    sput_fail_unless(memcmp(r, c, sizeof(r)) == 0, "expArray works in place");
+}
+
+void test_soa_transforms()
+{
+    enum { COUNT = 1027 };
+
+    static float src[32][COUNT];
+    static float dst[16][COUNT];
+
+    for (size_t s = 0; s < 32; ++s)
+    {
+        for (size_t i = 0; i < COUNT; ++i) src[s][i] = randomFloat(-2.0f, 2.0f);
+    }
+
+    v128 m[4];
+    for (int c = 0; c < 4; ++c)
+    {
+        m[c] = vi_set(randomFloat(-2.0f, 2.0f), randomFloat(-2.0f, 2.0f), randomFloat(-2.0f, 2.0f), randomFloat(-2.0f, 2.0f));
+    }
+
+    ml::vec3_soa p = { src[0], src[1], src[2] };
+    ml::vec3_soa r = { dst[0], dst[1], dst[2] };
+
+    bool matches = true;
+    ml::transformPointsSoA(&r, m, &p, COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        CORE_ALIGN(16) float e[4];
+        vi_store_v4(e, ml::mul_mat4_vec4(m, vi_set(p.x[i], p.y[i], p.z[i], 1.0f)));
+        matches &= r.x[i] == e[0] && r.y[i] == e[1] && r.z[i] == e[2];
+    }
+    sput_fail_unless(matches, "transformPointsSoA matches mul_mat4_vec4");
+
+    matches = true;
+    ml::transformVectorsSoA(&r, m, &p, COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        CORE_ALIGN(16) float e[4];
+        vi_store_v4(e, ml::mul_mat4_vec4(m, vi_set(p.x[i], p.y[i], p.z[i], 0.0f)));
+        matches &= r.x[i] == e[0] && r.y[i] == e[1] && r.z[i] == e[2];
+    }
+    sput_fail_unless(matches, "transformVectorsSoA matches mul_mat4_vec4 with w = 0");
+
+    ml::mat4_soa ma, mb, mr;
+    for (int i = 0; i < 16; ++i)
+    {
+        ma.m[i / 4][i % 4] = src[i];
+        mb.m[i / 4][i % 4] = src[16 + i];
+        mr.m[i / 4][i % 4] = dst[i];
+    }
+
+    matches = true;
+    ml::mulMat4SoA(&mr, &ma, &mb, COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        v128 a[4], b[4], e[4];
+        for (int c = 0; c < 4; ++c)
+        {
+            a[c] = vi_set(ma.m[c][0][i], ma.m[c][1][i], ma.m[c][2][i], ma.m[c][3][i]);
+            b[c] = vi_set(mb.m[c][0][i], mb.m[c][1][i], mb.m[c][2][i], mb.m[c][3][i]);
+        }
+        ml::mul_mat4(e, a, b);
+        for (int c = 0; c < 4; ++c)
+        {
+            CORE_ALIGN(16) float v[4];
+            vi_store_v4(v, e[c]);
+            for (int j = 0; j < 4; ++j) matches &= mr.m[c][j][i] == v[j];
+        }
+    }
+    sput_fail_unless(matches, "mulMat4SoA matches mul_mat4");
+
+    ml::dual_quat_soa q0 = { { src[0], src[1], src[2],  src[3]  }, { src[4],  src[5],  src[6],  src[7]  } };
+    ml::dual_quat_soa q1 = { { src[8], src[9], src[10], src[11] }, { src[12], src[13], src[14], src[15] } };
+    ml::dual_quat_soa qr = { { dst[0], dst[1], dst[2],  dst[3]  }, { dst[4],  dst[5],  dst[6],  dst[7]  } };
+
+    matches = true;
+    ml::mulDualQuatSoA(&qr, &q0, &q1, COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        ml::dual_quat a = { { q0.real.x[i], q0.real.y[i], q0.real.z[i], q0.real.w[i] }, { q0.dual.x[i], q0.dual.y[i], q0.dual.z[i], q0.dual.w[i] } };
+        ml::dual_quat b = { { q1.real.x[i], q1.real.y[i], q1.real.z[i], q1.real.w[i] }, { q1.dual.x[i], q1.dual.y[i], q1.dual.z[i], q1.dual.w[i] } };
+        ml::dual_quat e;
+        ml::mul_dual_quat(&e, &a, &b);
+        matches &= qr.real.x[i] == e.real.x && qr.real.y[i] == e.real.y && qr.real.z[i] == e.real.z && qr.real.w[i] == e.real.w;
+        matches &= qr.dual.x[i] == e.dual.x && qr.dual.y[i] == e.dual.y && qr.dual.z[i] == e.dual.z && qr.dual.w[i] == e.dual.w;
+    }
+    sput_fail_unless(matches, "mulDualQuatSoA matches mul_dual_quat");
+
+    float maxError = 0.0f;
+    ml::quatToMat4x3SoA(&mr, &q0.real, COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        v128 e[3];
+        ml::quat_to_mat4x3(e, vi_set(q0.real.x[i], q0.real.y[i], q0.real.z[i], q0.real.w[i]));
+        for (int c = 0; c < 3; ++c)
+        {
+            CORE_ALIGN(16) float v[4];
+            vi_store_v4(v, e[c]);
+            for (int j = 0; j < 3; ++j) maxError = core::max(maxError, fabsf(mr.m[c][j][i] - v[j]));
+            matches &= mr.m[c][3][i] == 0.0f;
+        }
+    }
+    // Quaternions are not normalized, elements are up to 16
+    sput_fail_unless(maxError <= 16.0f * 4.0f * FLT_EPSILON, "quatToMat4x3SoA matches quat_to_mat4x3");
+    sput_fail_unless(matches, "quatToMat4x3SoA writes 0 to row 3");
+
+    // In place, source and destination are the same streams
+    ml::vec3_soa e = { dst[3], dst[4], dst[5] };
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        dst[0][i] = src[0][i]; dst[1][i] = src[1][i]; dst[2][i] = src[2][i];
+    }
+    ml::transformPointsSoA(&r, m, &r, COUNT);
+    ml::transformPointsSoA(&e, m, &p, COUNT);
+    sput_fail_unless(memcmp(dst[0], dst[3], sizeof(dst[0]) * 3) == 0, "transformPointsSoA works in place");
+}
+
 int run_math_tests()
 {
     sput_start_testing();
@@ -297,6 +871,18 @@ int run_math_tests()
     sput_enter_suite("Math: test vector code");
     sput_run_test(test_vector_math);
 
+    sput_enter_suite("Math: test frustum culling");
+    sput_run_test(test_frustum_culling);
+    sput_run_test(test_batch_culling);
+
+    sput_enter_suite("Math: test transcendental functions");
+    sput_run_test(test_transcendental_precision);
+    sput_run_test(test_transcendental_special_values);
+    sput_run_test(test_transcendental_batch);
+
+    sput_enter_suite("Math: test SoA batch transforms");
+    sput_run_test(test_soa_transforms);
+
     sput_finish_testing();
 
     return sput_get_return_value();
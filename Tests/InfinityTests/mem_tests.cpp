@@ -0,0 +1,406 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+enum mem_tests_private
+{
+    TEST_MAX_SIZE = 300,
+    TEST_BUF_SIZE = TEST_MAX_SIZE + 256,
+
+    ALLOC_NUM_THREADS   = 4,
+    ALLOC_NUM_OBJECTS   = 8192,
+    ALLOC_KEEP_STRIDE   = 8,
+    ALLOC_LARGE_STRIDE  = 17,
+    ALLOC_NUM_ROUNDS    = 20,
+    ALLOC_SLAB_SIZE     = 64 * 1024,
+    ALLOC_CHURN_SLABS   = 3,
+    ALLOC_CHURN_OBJECTS = ALLOC_CHURN_SLABS * ALLOC_SLAB_SIZE / 16,
+    ALLOC_CHURN_ROUNDS  = 1000,
+};
+
+static uint8_t bufRef[TEST_BUF_SIZE];
+static uint8_t bufTest[TEST_BUF_SIZE];
+
+static void fillRandom(uint32_t seed)
+{
+    for (size_t i = 0; i < TEST_BUF_SIZE; ++i)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        bufRef[i] = bufTest[i] = (uint8_t)seed;
+    }
+}
+
+static bool testImplementation(int impl)
+{
+    return impl == MEM_UTILS_SSE2 || (core::cpu_features() & core::CPU_FEATURE_AVX);
+}
+
+// Every size and alignment of small and medium ranges is compared with libc, which
+// covers head/tail handling and both copy directions of overlapping moves
+void test_mem_set()
+{
+    for (int impl = MEM_UTILS_SSE2; impl <= MEM_UTILS_AVX; ++impl)
+    {
+        if (!testImplementation(impl)) continue;
+
+        int  prev   = mem_utils_select(impl);
+        bool passed = true;
+
+        for (size_t len = 0; len <= TEST_MAX_SIZE; ++len)
+        {
+            for (size_t offset = 0; offset < 64; ++offset)
+            {
+                fillRandom((uint32_t)(len * 64 + offset + 1));
+
+                memset(bufRef + offset, 0xA5, len);
+                mem_set(bufTest + offset, len, 0xA5);
+
+                passed &= memcmp(bufRef, bufTest, TEST_BUF_SIZE) == 0;
+            }
+        }
+
+        sput_fail_unless(passed, impl == MEM_UTILS_AVX ? "AVX mem_set" : "SSE2 mem_set");
+
+        mem_utils_select(prev);
+    }
+}
+
+void test_mem_set_typed()
+{
+    for (int impl = MEM_UTILS_SSE2; impl <= MEM_UTILS_AVX; ++impl)
+    {
+        if (!testImplementation(impl)) continue;
+
+        int  prev   = mem_utils_select(impl);
+        bool passed = true;
+
+        for (size_t len = 0; len <= TEST_MAX_SIZE / 4; ++len)
+        {
+            for (size_t offset = 0; offset < 64; offset += 2)
+            {
+                fillRandom((uint32_t)(len * 64 + offset + 1));
+
+                uint16_t* ref16 = (uint16_t*)(bufRef + offset);
+                for (size_t i = 0; i < len; ++i) ref16[i] = 0x1234;
+                mem_set16((uint16_t*)(bufTest + offset), len, 0x1234);
+
+                uint32_t* ref32 = (uint32_t*)(bufRef + 128 + offset * 2);
+                for (size_t i = 0; i < len; ++i) ref32[i] = 0x89ABCDEF;
+                mem_set32((uint32_t*)(bufTest + 128 + offset * 2), len, 0x89ABCDEF);
+
+                passed &= memcmp(bufRef, bufTest, TEST_BUF_SIZE) == 0;
+            }
+        }
+
+        sput_fail_unless(passed, impl == MEM_UTILS_AVX ? "AVX typed mem_set" : "SSE2 typed mem_set");
+
+        mem_utils_select(prev);
+    }
+}
+
+void test_mem_move()
+{
+    for (int impl = MEM_UTILS_SSE2; impl <= MEM_UTILS_AVX; ++impl)
+    {
+        if (!testImplementation(impl)) continue;
+
+        int  prev   = mem_utils_select(impl);
+        bool passed = true;
+
+        for (size_t len = 0; len <= TEST_MAX_SIZE; ++len)
+        {
+            for (size_t src = 0; src < 128; src += 5)
+            {
+                for (size_t dst = 0; dst < 128; dst += 3)
+                {
+                    fillRandom((uint32_t)(len * 128 * 128 + src * 128 + dst + 1));
+
+                    memmove(bufRef + dst, bufRef + src, len);
+                    mem_move(bufTest + dst, bufTest + src, len);
+
+                    passed &= memcmp(bufRef, bufTest, TEST_BUF_SIZE) == 0;
+                }
+            }
+        }
+
+        sput_fail_unless(passed, impl == MEM_UTILS_AVX ? "AVX mem_move" : "SSE2 mem_move");
+
+        mem_utils_select(prev);
+    }
+}
+
+void test_mem_copy_large()
+{
+    const size_t size = 6 * 1024 * 1024;
+
+    uint8_t* src = (uint8_t*)malloc(size);
+    uint8_t* dst = (uint8_t*)malloc(size);
+
+    for (size_t i = 0; i < size; ++i) src[i] = (uint8_t)(i * 7 + (i >> 12));
+
+    for (int impl = MEM_UTILS_SSE2; impl <= MEM_UTILS_AVX; ++impl)
+    {
+        if (!testImplementation(impl)) continue;
+
+        int prev = mem_utils_select(impl);
+
+        // Non-temporal path, 4MB and bigger
+        memset(dst, 0, size);
+        mem_copy(dst + 3, src + 1, size - 64);
+        sput_fail_unless(memcmp(dst + 3, src + 1, size - 64) == 0 && dst[2] == 0 && dst[size - 61] == 0, "Streaming copy");
+
+        mem_set(dst + 1, size - 2, 0x5A);
+        sput_fail_unless(dst[0] == 0 && dst[1] == 0x5A && dst[size - 2] == 0x5A && dst[size - 1] == 0, "Streaming set");
+
+        // Overlapping big move never streams
+        memcpy(dst, src, size);
+        mem_move(dst + 4097, dst, size - 8192);
+        sput_fail_unless(memcmp(dst + 4097, src, size - 8192) == 0, "Big overlapping move");
+
+        mem_utils_select(prev);
+    }
+
+    free(src);
+    free(dst);
+}
+
+void test_mem_copy_typed()
+{
+    uint16_t src16[37], dst16[37];
+    uint32_t src32[37], dst32[37];
+
+    for (uint32_t i = 0; i < 37; ++i)
+    {
+        src16[i] = (uint16_t)(i * 1000);
+        src32[i] = i * 100000;
+        dst16[i] = 0;
+        dst32[i] = 0;
+    }
+
+    mem_copy16(dst16, src16, 37);
+    mem_copy32(dst32, src32, 37);
+
+    sput_fail_unless(memcmp(dst16, src16, sizeof(src16)) == 0, "mem_copy16 copies from source");
+    sput_fail_unless(memcmp(dst32, src32, sizeof(src32)) == 0, "mem_copy32 length is in elements");
+}
+
+static mspace_t allocSpace;
+static void*    allocObjects[ALLOC_NUM_THREADS][ALLOC_NUM_OBJECTS];
+static void*    allocChurnObjects[ALLOC_CHURN_OBJECTS];
+static void*    allocChurnPins[ALLOC_CHURN_ROUNDS];
+static atomic_t allocBarrier;
+static atomic_t allocCorrupted;
+
+// Every ALLOC_LARGE_STRIDE object bypasses thread caches
+static size_t allocSize(uint32_t i)
+{
+    return i % ALLOC_LARGE_STRIDE == 0 ? 300 + i % 4000 : 1 + i % 256;
+}
+
+static uint8_t allocTag(uint32_t thread, uint32_t i)
+{
+    return (uint8_t)(thread * 131 + i * 7 + 1);
+}
+
+static void* allocObject(size_t size, uint8_t tag)
+{
+    uint8_t* ptr = (uint8_t*)mem_alloc(allocSpace, size, 8);
+
+    if (ptr)
+    {
+        memset(ptr, tag, size);
+    }
+    else
+    {
+        _InterlockedIncrement(&allocCorrupted);
+    }
+
+    return ptr;
+}
+
+static void freeObject(void* ptr, size_t size, uint8_t tag)
+{
+    const uint8_t* bytes = (const uint8_t*)ptr;
+
+    if (bytes[0] != tag || bytes[size - 1] != tag)
+    {
+        _InterlockedIncrement(&allocCorrupted);
+    }
+
+    mem_free(allocSpace, ptr);
+}
+
+static void allocWait(long count)
+{
+    _InterlockedIncrement(&allocBarrier);
+    while (allocBarrier < count)
+    {
+        SDL_Delay(0);
+    }
+}
+
+static int SDLCALL allocThread(void* arg)
+{
+    uint32_t thread   = (uint32_t)(uintptr_t)arg;
+    uint32_t neighbor = (thread + 1) % ALLOC_NUM_THREADS;
+
+    for (uint32_t i = 0; i < ALLOC_NUM_OBJECTS; ++i)
+    {
+        allocObjects[thread][i] = allocObject(allocSize(i), allocTag(thread, i));
+    }
+
+    allocWait(ALLOC_NUM_THREADS);
+
+    // Frees of objects owned by other live thread go to its remote list
+    for (uint32_t i = 1; i < ALLOC_NUM_OBJECTS; i += 2)
+    {
+        freeObject(allocObjects[neighbor][i], allocSize(i), allocTag(neighbor, i));
+    }
+
+    allocWait(ALLOC_NUM_THREADS * 2);
+
+    for (uint32_t i = 1; i < ALLOC_NUM_OBJECTS; i += 2)
+    {
+        allocObjects[thread][i] = allocObject(allocSize(i), allocTag(thread, i));
+    }
+
+    allocWait(ALLOC_NUM_THREADS * 3);
+
+    // Kept objects are freed after the thread exits
+    for (uint32_t i = 0; i < ALLOC_NUM_OBJECTS; ++i)
+    {
+        if (i % ALLOC_KEEP_STRIDE)
+        {
+            freeObject(allocObjects[thread][i], allocSize(i), allocTag(thread, i));
+        }
+    }
+
+    mem_thread_fini();
+
+    return 0;
+}
+
+static int SDLCALL allocAdoptThread(void*)
+{
+    // Adopts cache of exited thread, its objects are freed locally or to central lists
+    void* own[ALLOC_KEEP_STRIDE];
+    for (uint32_t i = 0; i < ALLOC_KEEP_STRIDE; ++i)
+    {
+        own[i] = allocObject(allocSize(i), allocTag(ALLOC_NUM_THREADS, i));
+    }
+
+    for (uint32_t thread = 0; thread < ALLOC_NUM_THREADS; ++thread)
+    {
+        for (uint32_t i = 0; i < ALLOC_NUM_OBJECTS; i += ALLOC_KEEP_STRIDE)
+        {
+            freeObject(allocObjects[thread][i], allocSize(i), allocTag(thread, i));
+        }
+    }
+
+    for (uint32_t i = 0; i < ALLOC_KEEP_STRIDE; ++i)
+    {
+        freeObject(own[i], allocSize(i), allocTag(ALLOC_NUM_THREADS, i));
+    }
+
+    mem_thread_fini();
+
+    return 0;
+}
+
+void test_mem_alloc_threads()
+{
+    allocSpace     = mem_create_space(1 << 20);
+    allocCorrupted = 0;
+
+    for (uint32_t round = 0; round < ALLOC_NUM_ROUNDS; ++round)
+    {
+        SDL_Thread* threads[ALLOC_NUM_THREADS];
+
+        allocBarrier = 0;
+        for (uint32_t i = 0; i < ALLOC_NUM_THREADS; ++i)
+        {
+            threads[i] = SDL_CreateThread(allocThread, "AllocThread", (void*)(uintptr_t)i);
+        }
+        for (uint32_t i = 0; i < ALLOC_NUM_THREADS; ++i)
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+
+        SDL_WaitThread(SDL_CreateThread(allocAdoptThread, "AllocAdoptThread", NULL), NULL);
+    }
+
+    sput_fail_unless(allocCorrupted == 0, "Objects stay intact with cross-thread frees and frees after thread exit");
+
+    mem_destroy_space(allocSpace);
+}
+
+// Slabs become empty and are released every round, pins take their place, so new slabs
+// get new addresses and every slab table slot is used over time. Large frees look slabs up.
+void test_mem_alloc_slab_churn()
+{
+    allocSpace     = mem_create_space(1 << 20);
+    allocCorrupted = 0;
+
+    for (uint32_t round = 0; round < ALLOC_CHURN_ROUNDS; ++round)
+    {
+        size_t   size  = 16 * (1 + round % 16);
+        uint32_t count = (uint32_t)(ALLOC_CHURN_SLABS * ALLOC_SLAB_SIZE / size);
+        uint8_t  tag   = allocTag(0, round);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            allocChurnObjects[i] = allocObject(size, tag);
+        }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            freeObject(allocChurnObjects[i], size, tag);
+        }
+
+        // Flushes cached objects, slabs beyond the kept empty ones are released
+        mem_thread_fini();
+
+        allocChurnPins[round] = mem_alloc(allocSpace, ALLOC_SLAB_SIZE, 8);
+
+        void* large = allocObject(1000, tag);
+        freeObject(large, 1000, tag);
+    }
+
+    for (uint32_t i = 0; i < ALLOC_CHURN_ROUNDS; ++i)
+    {
+        mem_free(allocSpace, allocChurnPins[i]);
+    }
+
+    mem_thread_fini();
+
+    sput_fail_unless(allocCorrupted == 0, "Objects stay intact while slabs are released and registered again");
+
+    mem_destroy_space(allocSpace);
+}
+
+int run_mem_tests()
+{
+    sput_start_testing();
+
+    sput_enter_suite("MEM: test mem_set");
+    sput_run_test(test_mem_set);
+    sput_enter_suite("MEM: test mem_set16/mem_set32");
+    sput_run_test(test_mem_set_typed);
+    sput_enter_suite("MEM: test mem_move");
+    sput_run_test(test_mem_move);
+    sput_enter_suite("MEM: test large copies");
+    sput_run_test(test_mem_copy_large);
+    sput_enter_suite("MEM: test mem_copy16/mem_copy32");
+    sput_run_test(test_mem_copy_typed);
+    sput_enter_suite("MEM: test thread caches");
+    sput_run_test(test_mem_alloc_threads);
+    sput_enter_suite("MEM: test slab release churn");
+    sput_run_test(test_mem_alloc_slab_churn);
+
+    sput_finish_testing();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,365 @@
+#include <sput.h>
+
+#include <SDL2/SDL.h>
+#include <core/core.h>
+
+enum test_private
+{
+    PARALLEL_FOR_SIZE  = 100000,
+    PARALLEL_FOR_GRAIN = 257,
+    NUM_CHILD_JOBS     = 100,
+    NUM_ITERATIONS     = 100,
+    NUM_ASYNC_TASKS    = 1000,
+    RING_SIZE          = 64,
+    NUM_RING_ITEMS     = 100000,
+    NUM_RING_PRODUCERS = 4,
+    MAX_TEST_JOBS      = 1 << 16,
+};
+
+static uint32_t  rangeData[PARALLEL_FOR_SIZE];
+static atomic_t  rangeSum;
+static atomic_t  childCount;
+static atomic_t  childCountInContinuation;
+static atomic_t  asyncTaskCount;
+
+static void sumRange(uint32_t begin, uint32_t end, void* arg)
+{
+    uint32_t* data = (uint32_t*)arg;
+    long      sum  = 0;
+
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        sum += data[i];
+    }
+
+    _InterlockedExchangeAdd(&rangeSum, sum);
+}
+
+static void childJob(uint32_t, void*)
+{
+    _InterlockedIncrement(&childCount);
+}
+
+static void parentJob(uint32_t job, void*)
+{
+    for (int i = 0; i < NUM_CHILD_JOBS; ++i)
+    {
+        mt::jobRun(mt::jobCreateChild(job, childJob, 0));
+    }
+}
+
+static void continuationJob(uint32_t, void*)
+{
+    childCountInContinuation = childCount;
+}
+
+static void asyncTask(void*)
+{
+    _InterlockedIncrement(&asyncTaskCount);
+}
+
+static void signalEventJob(uint32_t, void* arg)
+{
+    mt::eventSignal(*(uint32_t*)arg);
+}
+
+static core::spsc_ring_t<uint32_t, RING_SIZE> spscRing;
+static core::mpsc_ring_t<uint32_t, RING_SIZE> mpscRing;
+static core::mpmc_ring_t<uint32_t, RING_SIZE> mpmcRing;
+static atomic_t  ringConsumedSum;
+
+static void spscProducerJob(uint32_t, void*)
+{
+    uint32_t batch[8];
+    for (uint32_t i = 0; i < NUM_RING_ITEMS; i += ARRAY_SIZE(batch))
+    {
+        for (uint32_t j = 0; j < ARRAY_SIZE(batch); ++j) batch[j] = i + j;
+
+        size_t pushed = 0;
+        while (pushed < ARRAY_SIZE(batch))
+        {
+            pushed += core::spsc_ring_push_batch(spscRing, batch + pushed, ARRAY_SIZE(batch) - pushed);
+        }
+    }
+}
+
+static void mpProducerJob(uint32_t begin, uint32_t end, void* arg)
+{
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        if (arg == &mpscRing)
+            core::mpsc_ring_push_wait(mpscRing, i % 7);
+        else
+            core::mpmc_ring_push_wait(mpmcRing, i % 7);
+    }
+}
+
+static void mpmcConsumerJob(uint32_t, void* arg)
+{
+    uint32_t count = *(uint32_t*)arg;
+    long     sum   = 0;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t value;
+        core::mpmc_ring_pop_wait(mpmcRing, &value);
+        sum += value;
+    }
+
+    _InterlockedExchangeAdd(&ringConsumedSum, sum);
+}
+
+void test_parallel_for()
+{
+    long expected = 0;
+
+    for (uint32_t i = 0; i < PARALLEL_FOR_SIZE; ++i)
+    {
+        rangeData[i] = i % 7;
+        expected += rangeData[i];
+    }
+
+    bool tests_passed = true;
+    for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        rangeSum = 0;
+
+        uint32_t job = mt::parallelFor(sumRange, rangeData, PARALLEL_FOR_SIZE, PARALLEL_FOR_GRAIN);
+        mt::jobWait(job);
+
+        tests_passed &= mt::jobIsFinished(job);
+        tests_passed &= (rangeSum == expected);
+    }
+    sput_fail_unless(tests_passed, "All elements are processed exactly once");
+
+    rangeSum = 0;
+    mt::jobWait(mt::parallelFor(sumRange, rangeData, 0, PARALLEL_FOR_GRAIN));
+    sput_fail_unless(rangeSum == 0, "Empty range");
+}
+
+void test_children_and_continuations()
+{
+    bool tests_passed = true;
+    for (int i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        childCount               = 0;
+        childCountInContinuation = 0;
+
+        uint32_t parent       = mt::jobCreate(parentJob, 0);
+        uint32_t continuation = mt::jobCreate(continuationJob, 0);
+
+        tests_passed &= mt::jobAddContinuation(parent, continuation);
+
+        mt::jobRun(parent);
+        mt::jobWait(parent);
+
+        tests_passed &= (childCount == NUM_CHILD_JOBS);
+
+        mt::jobWait(continuation);
+
+        tests_passed &= (childCountInContinuation == NUM_CHILD_JOBS);
+    }
+    sput_fail_unless(tests_passed, "Parent waits for all children, continuation runs after parent");
+}
+
+void test_events()
+{
+    static uint32_t events[NUM_ASYNC_TASKS];
+
+    asyncTaskCount = 0;
+
+    bool tests_passed = true;
+    for (int i = 0; i < NUM_ASYNC_TASKS; ++i)
+    {
+        tests_passed &= (mt::addAsyncTask(asyncTask, 0, &events[i]) == mt::noError);
+    }
+    sput_fail_unless(tests_passed, "Event table grows beyond initial page");
+
+    mt::eventWaitAll(events, NUM_ASYNC_TASKS);
+    sput_fail_unless(asyncTaskCount == NUM_ASYNC_TASKS, "All tasks finished after eventWaitAll");
+
+    for (int i = 0; i < NUM_ASYNC_TASKS; ++i)
+    {
+        mt::syncAndReleaseEvent(events[i]);
+    }
+
+    uint32_t stale = events[0];
+    sput_fail_unless(mt::eventIsSignaled(stale), "Released handle is treated as signaled");
+
+    events[0] = mt::eventCreate();
+    events[1] = mt::eventCreate();
+    sput_fail_unless(events[0] != stale, "Reused event gets new generation");
+    sput_fail_unless(!mt::eventIsSignaled(events[0]), "New event is not signaled");
+
+    mt::jobRun(mt::jobCreate(signalEventJob, &events[1]));
+    sput_fail_unless(mt::eventWaitAny(events, 2) == 1, "eventWaitAny returns signaled event");
+
+    mt::eventRelease(events[0]);
+    mt::eventRelease(events[1]);
+}
+
+void test_rings()
+{
+    // Main thread consumes without executing jobs, producers and MPMC consumer need own workers
+    if (mt::workerCount() < 3)
+    {
+        return;
+    }
+
+    core::spsc_ring_reset(spscRing);
+
+    uint32_t producer = mt::jobCreate(spscProducerJob, 0);
+    mt::jobRun(producer);
+
+    bool tests_passed = true;
+    for (uint32_t i = 0; i < NUM_RING_ITEMS; ++i)
+    {
+        uint32_t value;
+        core::spsc_ring_pop_wait(spscRing, &value);
+        tests_passed &= (value == i);
+    }
+    mt::jobWait(producer);
+    sput_fail_unless(tests_passed, "SPSC ring preserves order");
+    sput_fail_unless(core::spsc_ring_used(spscRing) == 0, "SPSC ring is empty");
+
+    long expected = 0;
+    for (uint32_t i = 0; i < NUM_RING_ITEMS; ++i)
+    {
+        expected += i % 7;
+    }
+
+    core::mpsc_ring_reset(mpscRing);
+    uint32_t producers = mt::parallelFor(mpProducerJob, &mpscRing, NUM_RING_ITEMS, NUM_RING_ITEMS / NUM_RING_PRODUCERS);
+
+    long sum = 0;
+    for (uint32_t i = 0; i < NUM_RING_ITEMS; ++i)
+    {
+        uint32_t value;
+        core::mpsc_ring_pop_wait(mpscRing, &value);
+        sum += value;
+    }
+    mt::jobWait(producers);
+    sput_fail_unless(sum == expected, "MPSC ring delivers every element once");
+
+    core::mpmc_ring_reset(mpmcRing);
+    ringConsumedSum = 0;
+
+    static uint32_t consumerCount = NUM_RING_ITEMS / 2;
+    uint32_t consumer = mt::jobCreate(mpmcConsumerJob, &consumerCount);
+    mt::jobRun(consumer);
+    producers = mt::parallelFor(mpProducerJob, &mpmcRing, NUM_RING_ITEMS, NUM_RING_ITEMS / NUM_RING_PRODUCERS);
+
+    mpmcConsumerJob(0, &consumerCount);
+    mt::jobWait(producers);
+    mt::jobWait(consumer);
+    sput_fail_unless(ringConsumedSum == expected, "MPMC ring delivers every element once");
+    sput_fail_unless(core::mpmc_ring_used(mpmcRing) == 0, "MPMC ring is empty");
+}
+
+static int SDLCALL externalThread(void* arg)
+{
+    static uint32_t events[NUM_ASYNC_TASKS];
+
+    bool tests_passed = true;
+    for (int i = 0; i < NUM_ASYNC_TASKS; ++i)
+    {
+        tests_passed &= (mt::addAsyncTask(asyncTask, 0, &events[i]) == mt::noError);
+    }
+
+    for (int i = 0; i < NUM_ASYNC_TASKS; ++i)
+    {
+        mt::syncAndReleaseEvent(events[i]);
+    }
+
+    mt::jobWait(mt::parallelFor(sumRange, rangeData, PARALLEL_FOR_SIZE, PARALLEL_FOR_GRAIN));
+
+    *(bool*)arg = tests_passed;
+
+    return 0;
+}
+
+void test_external_thread()
+{
+    long expected = 0;
+
+    for (uint32_t i = 0; i < PARALLEL_FOR_SIZE; ++i)
+    {
+        rangeData[i] = i % 7;
+        expected += rangeData[i];
+    }
+
+    asyncTaskCount = 0;
+    rangeSum       = 0;
+
+    // Jobs of external thread are executed by worker threads
+    bool tasks_added = false;
+    SDL_WaitThread(SDL_CreateThread(externalThread, "ExternalThread", &tasks_added), NULL);
+
+    sput_fail_unless(tasks_added, "Tasks are accepted from thread outside of job system");
+    sput_fail_unless(asyncTaskCount == NUM_ASYNC_TASKS, "All tasks of external thread finished");
+    sput_fail_unless(rangeSum == expected, "Parallel for from external thread processed all elements");
+}
+
+void test_job_slots_exhausted()
+{
+    static uint32_t jobs[MAX_TEST_JOBS];
+
+    childCount = 0;
+
+    uint32_t numJobs = 0;
+    while (numJobs < MAX_TEST_JOBS)
+    {
+        uint32_t job = mt::jobCreate(childJob, 0);
+        if (job == mt::INVALID_HANDLE)
+        {
+            break;
+        }
+        jobs[numJobs++] = job;
+    }
+    sput_fail_unless(numJobs < MAX_TEST_JOBS, "Job creation fails when all slots are in flight");
+    sput_fail_unless(mt::addAsyncTask(asyncTask, 0) == mt::queueFull, "Async task reports full queue");
+
+    rangeSum = 0;
+    mt::jobWait(mt::parallelFor(sumRange, rangeData, PARALLEL_FOR_SIZE, PARALLEL_FOR_GRAIN));
+    sput_fail_unless(rangeSum > 0, "Parallel for runs in place without free slots");
+
+    for (uint32_t i = 0; i < numJobs; ++i)
+    {
+        mt::jobRun(jobs[i]);
+    }
+    for (uint32_t i = 0; i < numJobs; ++i)
+    {
+        mt::jobWait(jobs[i]);
+    }
+    sput_fail_unless(childCount == (long)numJobs, "All created jobs run after slots are available again");
+
+    uint32_t job = mt::jobCreate(childJob, 0);
+    sput_fail_unless(job != mt::INVALID_HANDLE, "Slots are reused");
+    mt::jobRun(job);
+    mt::jobWait(job);
+}
+
+int run_mt_tests()
+{
+    core::init();
+
+    sput_start_testing();
+
+    sput_enter_suite("MT: parallel for");
+    sput_run_test(test_parallel_for);
+    sput_enter_suite("MT: children and continuations");
+    sput_run_test(test_children_and_continuations);
+    sput_enter_suite("MT: events");
+    sput_run_test(test_events);
+    sput_enter_suite("MT: lock-free rings");
+    sput_run_test(test_rings);
+    sput_enter_suite("MT: external threads");
+    sput_run_test(test_external_thread);
+    sput_run_test(test_job_slots_exhausted);
+
+    sput_finish_testing();
+
+    core::fini();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,112 @@
+#include <sput.h>
+
+#include <core/core.h>
+
+enum test_private
+{
+    TEST_HANDLE_TYPE = 5,
+    TEST_PAGE_SIZE   = 16,
+    TEST_CAPACITY    = 64,
+};
+
+struct test_item_t
+{
+    uint32_t value;
+    float    data[3];
+};
+
+void test_pool()
+{
+    core::pool_t<test_item_t> pool;
+    core::pool_init(pool, TEST_PAGE_SIZE, TEST_CAPACITY / TEST_PAGE_SIZE);
+
+    test_item_t* items[TEST_CAPACITY];
+
+    bool tests_passed = true;
+    for (uint32_t i = 0; i < TEST_CAPACITY; ++i)
+    {
+        items[i] = core::pool_alloc(pool);
+        tests_passed &= items[i] != 0;
+        items[i]->value = i;
+    }
+    sput_fail_unless(tests_passed, "Pool grows by pages up to capacity");
+    sput_fail_unless(core::pool_alloc(pool) == 0, "Exhausted pool returns 0");
+
+    for (uint32_t i = 0; i < TEST_CAPACITY; ++i)
+    {
+        tests_passed &= items[i]->value == i;
+    }
+    sput_fail_unless(tests_passed, "Objects are pointer stable across page growth");
+
+    test_item_t* freed = items[TEST_CAPACITY / 2];
+    core::pool_free(pool, freed);
+    sput_fail_unless(pool.count == TEST_CAPACITY - 1, "Free decrements count");
+    sput_fail_unless(core::pool_alloc(pool) == freed, "Freed object is reused");
+
+    core::pool_fini(pool);
+}
+
+void test_handle_table()
+{
+    core::handle_table_t<test_item_t> table;
+    core::handle_table_init(table, TEST_HANDLE_TYPE, TEST_PAGE_SIZE, TEST_CAPACITY);
+
+    uint32_t handles[TEST_CAPACITY];
+
+    bool tests_passed = true;
+    for (uint32_t i = 0; i < TEST_CAPACITY; ++i)
+    {
+        test_item_t* item = 0;
+        handles[i] = core::handle_table_alloc(table, &item);
+        tests_passed &= handles[i] != core::HANDLE_INVALID;
+        tests_passed &= core::handle_type(handles[i]) == TEST_HANDLE_TYPE;
+        item->value = i;
+    }
+    sput_fail_unless(tests_passed, "Table grows by pages up to capacity");
+    sput_fail_unless(core::handle_table_alloc(table) == core::HANDLE_INVALID, "Full table returns invalid handle");
+
+    for (uint32_t i = 0; i < TEST_CAPACITY; i += 2)
+    {
+        tests_passed &= core::handle_table_free(table, handles[i]);
+    }
+    sput_fail_unless(tests_passed, "Free of live handles");
+    sput_fail_unless(core::handle_table_size(table) == TEST_CAPACITY / 2, "Dense size after free");
+    sput_fail_unless(!core::handle_table_free(table, handles[0]), "Double free is rejected");
+    sput_fail_unless(core::handle_table_get(table, handles[0]) == 0, "Stale handle lookup returns 0");
+
+    for (uint32_t i = 1; i < TEST_CAPACITY; i += 2)
+    {
+        test_item_t* item = core::handle_table_get(table, handles[i]);
+        tests_passed &= item && item->value == i;
+    }
+    sput_fail_unless(tests_passed, "Live handles survive compaction");
+
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < core::handle_table_size(table); ++i)
+    {
+        sum += table.items[i].value;
+        tests_passed &= core::handle_table_get(table, table.denseHandles[i]) == &table.items[i];
+    }
+    sput_fail_unless(tests_passed, "Dense items map back to their handles");
+    sput_fail_unless(sum == (TEST_CAPACITY / 2) * (TEST_CAPACITY / 2), "Dense iteration visits all live items");
+
+    uint32_t reused = core::handle_table_alloc(table);
+    sput_fail_unless(core::handle_index(reused) == core::handle_index(handles[TEST_CAPACITY - 2]), "Slot is reused");
+    sput_fail_unless(reused != handles[TEST_CAPACITY - 2], "Reused slot gets new generation");
+
+    core::handle_table_fini(table);
+}
+
+int run_pool_tests()
+{
+    sput_start_testing();
+
+    sput_enter_suite("Pool: alloc and free");
+    sput_run_test(test_pool);
+    sput_enter_suite("Handle table: generational handles");
+    sput_run_test(test_handle_table);
+
+    sput_finish_testing();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,240 @@
+#include <sput.h>
+
+#include <core/core.h>
+
+static bool hasAVX2()
+{
+    return (core::cpu_features() & core::CPU_FEATURE_AVX2) != 0;
+}
+
+static bool sameBits(const float* a, const float* b, size_t count)
+{
+    return memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+void test_vi8_load_store()
+{
+    if (!hasAVX2()) return;
+
+    CORE_ALIGN(32) float src[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+    CORE_ALIGN(32) float dst[9];
+
+    vi8_store(dst, vi8_set(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    sput_fail_unless(sameBits(dst, src, 8), "vi8_set stores components in order");
+
+    vi8_storeu(dst + 1, vi8_load(src));
+    sput_fail_unless(sameBits(dst + 1, src, 8), "vi8_load/vi8_storeu");
+
+    vi8_store(dst, vi8_loadu(dst + 1));
+    sput_fail_unless(sameBits(dst, src, 8), "vi8_loadu/vi8_store");
+
+    v256 v = vi8_combine(vi_set(0.0f, 1.0f, 2.0f, 3.0f), vi_set(4.0f, 5.0f, 6.0f, 7.0f));
+    vi8_store(dst, v);
+    sput_fail_unless(sameBits(dst, src, 8), "vi8_combine");
+    sput_fail_unless(vi_cmpx_eq(vi8_get_lo(v), vi_set_x(0.0f)) && vi_cmpx_eq(vi8_get_hi(v), vi_set_x(4.0f)), "vi8_get_lo/vi8_get_hi");
+    sput_fail_unless(vi8_get_x(v) == 0.0f, "vi8_get_x");
+    sput_fail_unless(vi8_hadd(v) == 28.0f, "vi8_hadd");
+
+    float table[16];
+    for (int i = 0; i < 16; ++i) table[i] = (float)(i * 10);
+    vi8_store(dst, vi8_gather(table, _mm256_setr_epi32(15, 0, 3, 3, 8, 1, 14, 2)));
+    float gathered[8] = { 150.0f, 0.0f, 30.0f, 30.0f, 80.0f, 10.0f, 140.0f, 20.0f };
+    sput_fail_unless(sameBits(dst, gathered, 8), "vi8_gather");
+
+    vi8_zeroupper();
+}
+
+void test_vi8_math()
+{
+    if (!hasAVX2()) return;
+
+    CORE_ALIGN(32) float dst[8];
+
+    v256 a = vi8_set(-2.5f, -1.5f, -0.5f, 0.5f, 1.5f, 2.5f, 3.0f, -0.0f);
+    v256 b = vi8_set_all(2.0f);
+
+    vi8_store(dst, vi8_round(a));
+    float rounded[8] = { -2.0f, -2.0f, -0.0f, 0.0f, 2.0f, 2.0f, 3.0f, -0.0f };
+    sput_fail_unless(sameBits(dst, rounded, 8), "vi8_round rounds to nearest even");
+
+    vi8_store(dst, vi8_floor(a));
+    sput_fail_unless(dst[0] == -3.0f && dst[3] == 0.0f && dst[5] == 2.0f, "vi8_floor");
+
+    vi8_store(dst, vi8_ceil(a));
+    sput_fail_unless(dst[0] == -2.0f && dst[3] == 1.0f && dst[5] == 3.0f, "vi8_ceil");
+
+    vi8_store(dst, vi8_mad(a, b, vi8_set_all(1.0f)));
+    sput_fail_unless(dst[0] == -4.0f && dst[6] == 7.0f, "vi8_mad");
+
+    if (core::cpu_features() & core::CPU_FEATURE_FMA)
+    {
+        // 1 + 2^-12 squared needs 25 bits, rounding only once keeps 2^-24 term
+        v256 x = vi8_set_all(1.0f + 1.0f / 4096.0f);
+        vi8_store(dst, vi8_sub(vi8_fma(x, x, vi8_set_all(-1.0f)), vi8_mad(x, x, vi8_set_all(-1.0f))));
+        sput_fail_unless(dst[0] == 1.0f / 16777216.0f, "vi8_fma is rounded once");
+    }
+
+    vi8_store(dst, vi8_abs(a));
+    sput_fail_unless(dst[0] == 2.5f && dst[4] == 1.5f && !signbit(dst[7]), "vi8_abs");
+
+    vi8_store(dst, vi8_clamp(a, vi8_set_all(-1.0f), vi8_set_all(1.0f)));
+    sput_fail_unless(dst[0] == -1.0f && dst[2] == -0.5f && dst[5] == 1.0f, "vi8_clamp");
+
+    vi8_store(dst, vi8_sat(a));
+    sput_fail_unless(dst[0] == 0.0f && dst[3] == 0.5f && dst[6] == 1.0f, "vi8_sat");
+
+    vi8_store(dst, vi8_cvt_to_float(vi8_cvt_to_int(a)));
+    sput_fail_unless(dst[0] == -2.0f && dst[1] == -2.0f && dst[5] == 2.0f, "vi8_cvt_to_int rounds to nearest even");
+
+    vi8_zeroupper();
+}
+
+void test_vi8_compare_select()
+{
+    if (!hasAVX2()) return;
+
+    CORE_ALIGN(32) float dst[8];
+
+    v256 a = vi8_set(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    v256 b = vi8_set(7.0f, 6.0f, 5.0f, 4.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    v256 n = vi8_seti_all(VI_QNAN_AS_INT);
+
+    sput_fail_unless(vi8_mask(vi8_cmp_lt(a, b)) == 0x0F, "vi8_cmp_lt");
+    sput_fail_unless(vi8_mask(vi8_cmp_le(a, b)) == 0xFF, "vi8_cmp_le");
+    sput_fail_unless(vi8_mask(vi8_cmp_gt(a, b)) == 0x00, "vi8_cmp_gt");
+    sput_fail_unless(vi8_mask(vi8_cmp_ge(a, b)) == 0xF0, "vi8_cmp_ge");
+    sput_fail_unless(vi8_mask(vi8_cmp_eq(a, b)) == 0xF0, "vi8_cmp_eq");
+    sput_fail_unless(vi8_mask(vi8_cmp_ne(a, b)) == 0x0F, "vi8_cmp_ne");
+    sput_fail_unless(vi8_mask(vi8_cmp_eq(n, n)) == 0x00 && vi8_mask(vi8_cmp_ne(n, n)) == 0xFF, "Compares with NaN");
+
+    sput_fail_unless(vi8_all(vi8_cmp_le(a, b)) && !vi8_all(vi8_cmp_lt(a, b)), "vi8_all");
+    sput_fail_unless(vi8_any(vi8_cmp_lt(a, b)) && !vi8_any(vi8_cmp_gt(a, b)), "vi8_any");
+
+    vi8_store(dst, vi8_select(a, b, vi8_cmp_lt(a, b)));
+    float selected[8] = { 7.0f, 6.0f, 5.0f, 4.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+    sput_fail_unless(sameBits(dst, selected, 8), "vi8_select picks b where mask is set");
+
+    v256 mask = vi8_cmp_ge(a, b);
+    sput_fail_unless(vi8_mask(vi8_andnot(vi8_seti_all(VI_CMP_TRUE), mask)) == 0x0F, "vi8_andnot is a & ~b");
+    sput_fail_unless(vi8_mask(vi8_xor(mask, vi8_cmp_lt(a, b))) == 0xFF, "vi8_xor");
+    sput_fail_unless(vi8_mask(vi8_and(mask, vi8_cmp_eq(a, b))) == 0xF0, "vi8_and");
+    sput_fail_unless(vi8_mask(vi8_or(mask, vi8_cmp_lt(a, b))) == 0xFF, "vi8_or");
+
+    vi8_zeroupper();
+}
+
+void test_vi8_shuffle()
+{
+    if (!hasAVX2()) return;
+
+    CORE_ALIGN(32) float dst[8];
+
+    v256 a = vi8_set(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    v256 b = vi8_set(8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+
+    vi8_store(dst, vi8_swizzle<VI_W, VI_Z, VI_Y, VI_X>(a));
+    float swizzled[8] = { 3.0f, 2.0f, 1.0f, 0.0f, 7.0f, 6.0f, 5.0f, 4.0f };
+    sput_fail_unless(sameBits(dst, swizzled, 8), "vi8_swizzle works within halves");
+
+    vi8_store(dst, vi8_shuffle<VI_X, VI_Z, VI_Y, VI_W>(a, b));
+    float shuffled[8] = { 0.0f, 2.0f, 9.0f, 11.0f, 4.0f, 6.0f, 13.0f, 15.0f };
+    sput_fail_unless(sameBits(dst, shuffled, 8), "vi8_shuffle works within halves");
+
+    vi8_store(dst, vi8_permute(a, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+    float permuted[8] = { 7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f };
+    sput_fail_unless(sameBits(dst, permuted, 8), "vi8_permute crosses halves");
+
+    vi8_zeroupper();
+}
+
+// Uses most of the traits operations, results should not depend on width
+template <typename simd>
+static void wideKernel(float* dst, const float* src, size_t count)
+{
+    typedef typename simd::vf vf;
+    typedef typename simd::vi vi;
+
+    for (size_t i = 0; i < count; i += simd::width)
+    {
+        vf x = simd::load(src + i);
+        vf a = simd::abs(x);
+        vf r = simd::round(simd::mul(x, simd::set(0.37f)));
+        vi n = simd::cvt_to_int(simd::min(simd::max(r, simd::set(-1000.0f)), simd::set(1000.0f)));
+        n = simd::iadd(simd::template isra<2>(n), simd::template isrl<28>(simd::isub(n, simd::iset(3))));
+        vf e = simd::as_float(simd::iand(simd::as_int(x), simd::iset(0x7F800000)));
+
+        vf p = simd::mad(simd::div(x, simd::add(a, simd::set(1.0f))), simd::sqrt(a), simd::cvt_to_float(n));
+        p = simd::select(p, simd::rsqrt(a), x);
+        p = simd::select(p, simd::neg(e), simd::bit_or(simd::cmp_gt(a, simd::set(1e30f)), simd::cmp_unord(x, x)));
+        p = simd::bit_xor(p, simd::bit_and(simd::cmp_le(a, simd::set(0.25f)), simd::seti(VI_SIGN_MASK)));
+        p = simd::bit_andnot(p, simd::as_float(simd::template isll<31>(simd::icmp_eq(n, simd::iset(0)))));
+
+        simd::store(dst + i, simd::sub(p, simd::bit_and(simd::cmp_eq(x, simd::zero()), simd::set(0.5f))));
+    }
+
+    simd::finish();
+}
+
+void test_wide_traits()
+{
+    enum { COUNT = 1024 };
+
+    float src[COUNT];
+    float ref[COUNT];
+    float res[COUNT];
+
+    float special[] = {
+        0.0f, -0.0f, 0.25f, -0.25f, 0.5f, 1.0f, -1.0f, 2.5f, -2.5f, 1e-40f, -1e-40f, 1e38f, -1e38f,
+        FLT_MAX, -FLT_MAX, INFINITY, -INFINITY, NAN
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(special); ++i) src[i] = special[i];
+
+    for (size_t i = ARRAY_SIZE(special); i < COUNT; ++i)
+    {
+        src[i] = ((float)rand() / RAND_MAX - 0.5f) * (float)(1 << (i % 24));
+    }
+
+    wideKernel<vi_scalar_t>(ref, src, COUNT);
+
+    wideKernel<vi_sse41_t>(res, src, COUNT);
+    sput_fail_unless(sameBits(res, ref, COUNT), "SSE4.1 traits match scalar");
+
+    if (hasAVX2())
+    {
+        wideKernel<vi_avx2_t>(res, src, COUNT);
+        sput_fail_unless(sameBits(res, ref, COUNT), "AVX2 traits match scalar");
+    }
+}
+
+static int selectScalar() { return 1; }
+static int selectSSE41()  { return 4; }
+static int selectAVX2()   { return 8; }
+
+void test_cpu_select()
+{
+    uint32_t features = core::cpu_features();
+    int      width    = core::cpu_select(selectScalar, selectSSE41, selectAVX2)();
+
+    int expected = (features & core::CPU_FEATURE_AVX2) ? 8 : (features & core::CPU_FEATURE_SSE41) ? 4 : 1;
+    sput_fail_unless(width == expected, "cpu_select picks widest supported implementation");
+}
+
+int run_vi_tests()
+{
+    sput_start_testing();
+
+    sput_enter_suite("VI: test 8 wide functions");
+    sput_run_test(test_vi8_load_store);
+    sput_run_test(test_vi8_math);
+    sput_run_test(test_vi8_compare_select);
+    sput_run_test(test_vi8_shuffle);
+
+    sput_enter_suite("VI: test width generic traits");
+    sput_run_test(test_wide_traits);
+    sput_run_test(test_cpu_select);
+
+    sput_finish_testing();
+
+    return sput_get_return_value();
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+
+#include <core/core.h>
+#include <datafmt/model_file.h>
+
+// Converts md5 mesh with animations or OBJ file to model container(see datafmt/model_file.h),
+// paths are relative to current directory and use '/' as separator.
+
+extern "C" int assert_handler(const char* cond, const char* file, int line) { return true; }
+
+static bool hasExtension(const char* path, const char* ext)
+{
+    size_t pathLen = strlen(path);
+    size_t extLen  = strlen(ext);
+
+    return pathLen >= extLen && _stricmp(path + pathLen - extLen, ext) == 0;
+}
+
+static void printUsage()
+{
+    fprintf(stderr,
+        "Usage: ModelConverter <out.mdl> <in.md5mesh> [in.md5anim ...]\n"
+        "       ModelConverter <out.mdl> <in.obj> [-scale <s>]\n"
+    );
+}
+
+static void printInfo(const model_file_t* model)
+{
+    uint32_t numMeshes, numJoints, numClips;
+
+    modelFileChunk(model, MODEL_CHUNK_MESHES,        sizeof(model_file_mesh_t), &numMeshes);
+    modelFileChunk(model, MODEL_CHUNK_JOINT_PARENTS, sizeof(int32_t),           &numJoints);
+    modelFileChunk(model, MODEL_CHUNK_CLIPS,         sizeof(model_file_clip_t), &numClips);
+
+    printf("%u meshes, %u joints, %u clips, %u bytes\n", numMeshes, numJoints, numClips, (uint32_t)model->header->size);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const char*  outName = argv[1];
+    const char*  inName  = argv[2];
+    model_file_t model;
+    bool         converted = false;
+
+    core::init();
+
+    PHYSFS_init(argv[0]);
+    PHYSFS_mount(".", 0, 1);
+    PHYSFS_setWriteDir(".");
+
+    if (hasExtension(inName, ".md5mesh"))
+    {
+        converted = modelFileConvertMD5(&model, inName, argv + 3, argc - 3);
+    }
+    else if (hasExtension(inName, ".obj"))
+    {
+        bool  hasScale = argc == 5 && strcmp(argv[3], "-scale") == 0;
+        float scale    = hasScale ? (float)atof(argv[4]) : 1.0f;
+
+        if (argc == 3 || hasScale)
+        {
+            converted = modelFileConvertOBJ(&model, inName, scale);
+        }
+        else
+        {
+            printUsage();
+        }
+    }
+    else
+    {
+        printUsage();
+    }
+
+    if (converted)
+    {
+        printInfo(&model);
+
+        if (!modelFileSave(&model, outName))
+        {
+            fprintf(stderr, "Failed to write %s\n", outName);
+            converted = false;
+        }
+
+        modelFileClose(&model);
+    }
+    else
+    {
+        fprintf(stderr, "Failed to convert %s\n", inName);
+    }
+
+    PHYSFS_deinit();
+
+    core::fini();
+
+    return converted ? EXIT_SUCCESS : EXIT_FAILURE;
+}
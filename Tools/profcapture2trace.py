@@ -0,0 +1,105 @@
+# Converts capture saved with profilerSaveCapture to Chrome trace event JSON,
+# result can be opened in chrome://tracing or ui.perfetto.dev.
+#
+# usage: profcapture2trace.py capture.bin [trace.json]
+
+import sys, struct, json
+
+CAPTURE_MAGIC   = 0x46525049
+CAPTURE_VERSION = 1
+
+PHASE_BEGIN  = 0
+PHASE_END    = 1
+PHASE_MARKER = 2
+
+HEADER_FORMAT = "<IIQIIIIII"
+THREAD_FORMAT = "<H30s"
+EVENT_FORMAT  = "<HHI"
+
+def readCapture(data):
+	offset = 0
+
+	magic, version, freq, quantShift, endTime, numEvents, numThreads, numNames, numDropped = struct.unpack_from(HEADER_FORMAT, data, offset)
+	offset += struct.calcsize(HEADER_FORMAT)
+
+	if magic != CAPTURE_MAGIC or version != CAPTURE_VERSION:
+		raise ValueError("not a profiler capture or unsupported version")
+
+	if numDropped:
+		sys.stderr.write("warning: %d events were dropped during capture\n" % numDropped)
+
+	threads = []
+	for i in range(numThreads):
+		tid, name = struct.unpack_from(THREAD_FORMAT, data, offset)
+		offset += struct.calcsize(THREAD_FORMAT)
+		threads.append((tid, name.split(b"\0")[0].decode("utf-8", "replace")))
+
+	names = []
+	for i in range(numNames):
+		length, = struct.unpack_from("<H", data, offset)
+		offset += 2
+		names.append(data[offset:offset+length].decode("utf-8", "replace"))
+		offset += length
+
+	events = []
+	for i in range(numEvents):
+		eventID, tid, bits = struct.unpack_from(EVENT_FORMAT, data, offset)
+		offset += struct.calcsize(EVENT_FORMAT)
+		events.append((eventID, tid, bits & 3, bits >> 2))
+
+	# Quantized ticks to microseconds
+	scale = float(1 << quantShift) * 1000000.0 / freq
+
+	return threads, names, events, endTime, scale
+
+def convert(threads, names, events, endTime, scale):
+	trace = []
+
+	for tid, name in threads:
+		trace.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": tid, "args": {"name": name or "Thread%d" % tid}})
+
+	def eventName(eventID):
+		return names[eventID] if eventID < len(names) and names[eventID] else "Event%d" % eventID
+
+	# Capture could start or stop in the middle of scope:
+	# drop unmatched ends and close scopes still open at the end of capture
+	stacks = {}
+	for eventID, tid, phase, timestamp in events:
+		stack = stacks.setdefault(tid, [])
+		entry = {"name": eventName(eventID), "pid": 0, "tid": tid, "ts": timestamp * scale}
+
+		if phase == PHASE_BEGIN:
+			stack.append(eventID)
+			entry["ph"] = "B"
+		elif phase == PHASE_END:
+			if not stack or stack[-1] != eventID:
+				continue
+			stack.pop()
+			entry["ph"] = "E"
+		elif phase == PHASE_MARKER:
+			entry["ph"] = "i"
+			entry["s"]  = "g"
+		else:
+			continue
+
+		trace.append(entry)
+
+	for tid, stack in stacks.items():
+		while stack:
+			trace.append({"name": eventName(stack.pop()), "ph": "E", "pid": 0, "tid": tid, "ts": endTime * scale})
+
+	return {"traceEvents": trace, "displayTimeUnit": "ms"}
+
+if __name__ == "__main__":
+	if len(sys.argv) < 2:
+		print("usage: profcapture2trace.py capture.bin [trace.json]")
+		sys.exit(1)
+
+	inputFile  = sys.argv[1]
+	outputFile = sys.argv[2] if len(sys.argv) > 2 else inputFile + ".json"
+
+	with open(inputFile, "rb") as file:
+		data = file.read()
+
+	with open(outputFile, "w") as file:
+		json.dump(convert(*readCapture(data)), file)